@@ -0,0 +1,130 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "AddressPool.h"
+
+#include <bit>
+
+AddressPool::AddressPool(std::uint32_t first, std::uint32_t last)
+{
+    setRange(first, last);
+}
+
+void AddressPool::setRange(std::uint32_t first, std::uint32_t last)
+{
+    m_first = first;
+    m_last = last;
+    m_usedCount = 0;
+    m_used.assign((getSize() + 63) / 64, 0);
+}
+
+std::uint32_t AddressPool::getFirst() const
+{
+    return m_first;
+}
+
+std::uint32_t AddressPool::getLast() const
+{
+    return m_last;
+}
+
+std::uint32_t AddressPool::getSize() const
+{
+    if (m_last < m_first)
+        return 0;
+
+    return m_last - m_first + 1;
+}
+
+std::uint32_t AddressPool::getUsedCount() const
+{
+    return m_usedCount;
+}
+
+std::uint32_t AddressPool::getUtilization() const
+{
+    const auto size = getSize();
+    if (size == 0)
+        return 100;
+
+    return static_cast<std::uint32_t>(static_cast<std::uint64_t>(m_usedCount) * 100 / size);
+}
+
+bool AddressPool::contains(std::uint32_t ipAddress) const
+{
+    return m_first <= ipAddress && ipAddress <= m_last;
+}
+
+bool AddressPool::isUsed(std::uint32_t ipAddress) const
+{
+    if (!contains(ipAddress))
+        return false;
+
+    const auto index = ipAddress - m_first;
+    return (m_used[index / 64] >> (index % 64)) & 1;
+}
+
+void AddressPool::markUsed(std::uint32_t ipAddress)
+{
+    if (!contains(ipAddress) || isUsed(ipAddress))
+        return;
+
+    const auto index = ipAddress - m_first;
+    m_used[index / 64] |= 1ull << (index % 64);
+    ++m_usedCount;
+}
+
+void AddressPool::markFree(std::uint32_t ipAddress)
+{
+    if (!isUsed(ipAddress))
+        return;
+
+    const auto index = ipAddress - m_first;
+    m_used[index / 64] &= ~(1ull << (index % 64));
+    --m_usedCount;
+}
+
+std::uint32_t AddressPool::findFree(std::uint32_t start) const
+{
+    const auto size = getSize();
+    if (m_usedCount >= size)
+        return 0;
+
+    if (!contains(start))
+        start = m_first;
+
+    /*
+     * Look at one 64 bit word at a time. The first word is masked so that addresses before start are skipped,
+     * those are only looked at after wrapping around. The last word may have bits past the end of the range, which
+     * are never set, so anything found there is checked against the size.
+    */
+    const auto wordCount = static_cast<std::uint32_t>(m_used.size());
+    const auto startIndex = start - m_first;
+    const auto startWord = startIndex / 64;
+
+    for (auto i = 0u; i <= wordCount; ++i)
+    {
+        const auto word = (startWord + i) % wordCount;
+        auto freeBits = ~m_used[word];
+
+        if (i == 0)
+            freeBits &= ~0ull << (startIndex % 64);
+        else if (i == wordCount)
+            freeBits &= ~(~0ull << (startIndex % 64)); // Back at the start word, only the part skipped at first.
+
+        while (freeBits != 0)
+        {
+            const auto index = word * 64 + static_cast<std::uint32_t>(std::countr_zero(freeBits));
+            if (index < size)
+                return m_first + index;
+
+            freeBits &= freeBits - 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Keeps track of which addresses in a DHCP range are in use, one bit per address.
+ * The number of used addresses is kept alongside, so utilization is known without scanning anything.
+*/
+class AddressPool
+{
+public:
+    AddressPool() = default;
+
+    AddressPool(std::uint32_t first, std::uint32_t last);
+
+    // Changes the range and marks every address as free.
+    void setRange(std::uint32_t first, std::uint32_t last);
+
+    std::uint32_t getFirst() const;
+
+    std::uint32_t getLast() const;
+
+    std::uint32_t getSize() const;
+
+    std::uint32_t getUsedCount() const;
+
+    // Used addresses in percent of the range, 0 - 100.
+    std::uint32_t getUtilization() const;
+
+    bool contains(std::uint32_t ipAddress) const;
+
+    // Addresses outside the range are never in use as far as the pool is concerned.
+    bool isUsed(std::uint32_t ipAddress) const;
+
+    // Both are no-ops for addresses outside the range, or already in the requested state.
+    void markUsed(std::uint32_t ipAddress);
+
+    void markFree(std::uint32_t ipAddress);
+
+    // Returns the first free address at or after start, wrapping around to the beginning of the range.
+    // Skips 64 used addresses at a time. Returns 0 if every address is used.
+    std::uint32_t findFree(std::uint32_t start) const;
+
+private:
+    std::uint32_t m_first{};
+    std::uint32_t m_last{};
+    std::uint32_t m_usedCount{};
+    std::vector<std::uint64_t> m_used;
+};
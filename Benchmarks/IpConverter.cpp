@@ -0,0 +1,122 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "IpConverter.h"
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Compares the fixed buffer parsers and formatters with the std::string based way they used to be done.
+ * Build with -DBUILD_BENCHMARKS=ON and a release build type, then run DhcpdBenchmarks.
+*/
+
+namespace
+{
+constexpr int Iterations = 2'000'000;
+
+volatile std::uint64_t sink;
+
+namespace legacy
+{
+std::string formatIpAddress(std::uint32_t address)
+{
+    return std::to_string((address & 0xFF000000) >> 24) + "."
+         + std::to_string((address & 0x00FF0000) >> 16) + "."
+         + std::to_string((address & 0x0000FF00) >> 8 ) + "."
+         + std::to_string( address & 0x000000FF);
+}
+
+std::string formatHardwareAddress(std::uint64_t address)
+{
+    auto toHex = [](unsigned long long value)
+    {
+        return std::format("{:02X}", value);
+    };
+
+    return toHex((address & 0x0000FF0000000000ull) >> 40) + ":"
+         + toHex((address & 0x000000FF00000000ull) >> 32) + ":"
+         + toHex((address & 0x00000000FF000000ull) >> 24) + ":"
+         + toHex((address & 0x0000000000FF0000ull) >> 16) + ":"
+         + toHex((address & 0x000000000000FF00ull) >> 8 ) + ":"
+         + toHex( address & 0x00000000000000FFull);
+}
+
+std::uint32_t parseIpAddress(std::string_view address)
+{
+    std::uint32_t ret{};
+    for (int i = 0; i < 4; ++i)
+    {
+        auto pos = address.find('.');
+        ret = (ret << 8) | static_cast<std::uint8_t>(std::stoi(std::string(address.substr(0, pos))));
+        address = address.substr(pos + 1);
+    }
+    return ret;
+}
+
+std::uint64_t parseHardwareAddress(std::string_view address)
+{
+    std::uint64_t ret{};
+    for (int i = 0; i < 6; ++i)
+    {
+        auto pos = address.find(':');
+        ret = (ret << 8) | static_cast<std::uint8_t>(std::stoi(std::string(address.substr(0, pos)), nullptr, 16));
+        address = address.substr(pos + 1);
+    }
+    return ret;
+}
+}
+
+void run(std::string_view name, auto&& function)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < Iterations; ++i)
+        function(i);
+    const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+
+    std::cout << std::format("{:<32} {:8.1f} ns/op\n", name, elapsed.count() / Iterations);
+}
+}
+
+int main()
+{
+    std::vector<std::string> ipAddresses;
+    std::vector<std::string> hwAddresses;
+    for (std::uint32_t i = 0; i < 1024; ++i)
+    {
+        ipAddresses.emplace_back(convertIpAddress(0xC0A80000 + i * 37));
+        hwAddresses.emplace_back(convertHardwareAddress(0x020000000000ull + i * 7919));
+    }
+
+    run("format ip (std::string)", [](int i) { sink = sink + legacy::formatIpAddress(0xC0A80000 + i).size(); });
+    run("format ip (fixed buffer)", [](int i) { sink = sink + formatIpAddress(0xC0A80000 + i).length; });
+
+    run("format hw (std::string)", [](int i) { sink = sink + legacy::formatHardwareAddress(0x020000000000ull + i).size(); });
+    run("format hw (fixed buffer)", [](int i) { sink = sink + formatHardwareAddress(0x020000000000ull + i).length; });
+
+    run("parse ip (std::stoi)", [&](int i) { sink = sink + legacy::parseIpAddress(ipAddresses[i & 1023]); });
+    run("parse ip (from_chars)", [&](int i)
+    {
+        std::uint32_t address{};
+        parseIpAddress(ipAddresses[i & 1023], address);
+        sink = sink + address;
+    });
+
+    run("parse hw (std::stoi)", [&](int i) { sink = sink + legacy::parseHardwareAddress(hwAddresses[i & 1023]); });
+    run("parse hw (lookup table)", [&](int i)
+    {
+        std::uint64_t address{};
+        parseHardwareAddress(hwAddresses[i & 1023], address);
+        sink = sink + address;
+    });
+
+    return 0;
+}
@@ -6,16 +6,28 @@
 */
 
 #include "BootpHandler.h"
+#include "ClientClassifier.h"
+#include "ConflictProber.h"
 #include "Structures.h"
 #include "Serializer.h"
 #include "IpConverter.h"
+#include "LoadBalancer.h"
 #include "Logger.h"
+#include "RateLimiter.h"
+#include "Statistics.h"
 
 #include <cstdlib> // for system(), remove when arp manipulation is done without calling /sbin/arp
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
 #include <format>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <unordered_map>
 
 constexpr auto ArpProgram{ "/sbin/arp" };
@@ -55,9 +67,9 @@ std::span<const BOOTPOptionKey> getParameterList(const BOOTP& bootp)
     return parameterListHolder.getParameters();
 }
 
-std::uint32_t getRequestedIpAddress(const BOOTP& bootp)
+std::uint32_t getIpAddressOption(const BOOTP& bootp, BOOTPOptionKey key)
 {
-    auto it = bootp.options.find(Option_RequestedIp);
+    auto it = bootp.options.find(key);
     if (it == bootp.options.end())
         return 0;
 
@@ -68,26 +80,21 @@ std::uint32_t getRequestedIpAddress(const BOOTP& bootp)
     return ipListHolder.getIps().front();
 }
 
-void provideParameterList(const Network& network, const BOOTP& bootp, BOOTP& offer)
+std::uint32_t getRequestedIpAddress(const BOOTP& bootp)
 {
-    /* DHCP Offer */
-    auto& offerMessageTypeOption = offer.options[Option_MessageType];
-    offerMessageTypeOption = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_Offer);
-
-    /*
-     * It appears that even though all the following are _options_, they appear to be _required_ to form a "valid" DHCP
-     * response. Well-made clients should ask for these in the options request, but for example Sony's PS4 appear to
-     * not provide anything useful in the options request and simply assumes these to appear *magically*. So here goes:
-    */
-
-    /* Server identifer */
-    auto& serverIdentifierOption = offer.options[Option_ServerIdentifier];
-    serverIdentifierOption = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(network.getDhcpServerIdentifier());
+    return getIpAddressOption(bootp, Option_RequestedIp);
+}
 
-    /* IP lease duration / time */
-    auto& ipLeaseTimeOption = offer.options[Option_IPLeaseTime];
-    ipLeaseTimeOption = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(network.getLeaseTime());
+std::uint32_t getServerIdentifier(const BOOTP& bootp)
+{
+    return getIpAddressOption(bootp, Option_ServerIdentifier);
+}
 
+/*
+ * The options that only depend on the network configuration. These go into the response templates.
+*/
+void provideConfigurationOptions(const Network& network, BOOTP& offer)
+{
     /* Subnet mask */
     std::uint32_t subnetMask = (~0 << (32 - network.getNetworkSize()));
     auto& subnetMaskOption = offer.options[Option_SubnetMask];
@@ -109,6 +116,84 @@ void provideParameterList(const Network& network, const BOOTP& bootp, BOOTP& off
     auto& broadcastAddressOption = offer.options[Option_BroadcastAddress];
     std::vector<std::uint32_t> broadcastAddressIpList = { broadcastAddress };
     broadcastAddressOption = std::make_unique<IpListBOOTPOption>(std::move(broadcastAddressIpList));
+}
+
+/*
+ * Everything in a reply that only depends on the configuration and the client's class, encoded once up front.
+ * Applying it to a reply is a few assignments and sharing a pointer, nothing is encoded per message.
+*/
+struct ResponseTemplate
+{
+    std::uint32_t siaddr{};
+    std::array<std::uint8_t, 64> sname{};
+    std::array<std::uint8_t, 128> file{};
+    std::shared_ptr<const std::vector<std::uint8_t>> options;
+
+    void applyTo(BOOTP& reply) const
+    {
+        reply.siaddr = siaddr;
+        reply.sname = sname;
+        reply.file = file;
+        reply.encodedOptions = options;
+    }
+};
+
+ResponseTemplate encodeResponseTemplate(const Network& network, const ClientClassConfiguration* bootClass)
+{
+    ResponseTemplate responseTemplate;
+
+    BOOTP reply;
+    provideConfigurationOptions(network, reply);
+
+    if (bootClass)
+    {
+        responseTemplate.siaddr = bootClass->nextServer;
+        std::copy(bootClass->serverName.begin(), bootClass->serverName.end(), responseTemplate.sname.begin());
+        std::copy(bootClass->bootFile.begin(), bootClass->bootFile.end(), responseTemplate.file.begin());
+
+        /* Some firmware only looks at the options, some only at the fixed fields. */
+        reply.options[Option_BootFileName] = std::make_unique<RawBOOTPOption>(bootClass->bootFile);
+        if (!bootClass->serverName.empty())
+            reply.options[Option_TftpServerName] = std::make_unique<RawBOOTPOption>(bootClass->serverName);
+
+        /*
+         * PXE clients want to see option 60 in the reply. Option 43 with PXE_DISCOVERY_CONTROL set to 8 tells them to
+         * download the boot file right away, instead of looking for boot servers first.
+        */
+        const auto isPxe = std::any_of(bootClass->vendorClasses.begin(), bootClass->vendorClasses.end(),
+                                       [](const auto& vendorClass) { return vendorClass.starts_with("PXEClient"); });
+        if (isPxe)
+        {
+            reply.options[Option_VendorClass] = std::make_unique<RawBOOTPOption>("PXEClient");
+            reply.options[Option_VendorSpecific] = std::make_unique<RawBOOTPOption>(std::vector<std::uint8_t>{ 6, 1, 8, 255 });
+        }
+    }
+
+    responseTemplate.options = std::make_shared<const std::vector<std::uint8_t>>(serializeOptions(reply));
+    return responseTemplate;
+}
+
+void provideParameterList(const Network& network, const BOOTP& bootp, BOOTP& offer)
+{
+    /* DHCP Offer */
+    auto& offerMessageTypeOption = offer.options[Option_MessageType];
+    offerMessageTypeOption = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_Offer);
+
+    /*
+     * It appears that even though all the following are _options_, they appear to be _required_ to form a "valid" DHCP
+     * response. Well-made clients should ask for these in the options request, but for example Sony's PS4 appear to
+     * not provide anything useful in the options request and simply assumes these to appear *magically*. So here goes:
+    */
+
+    /* Server identifer */
+    auto& serverIdentifierOption = offer.options[Option_ServerIdentifier];
+    serverIdentifierOption = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(network.getDhcpServerIdentifier());
+
+    /* Subnet mask, routers, DNS servers and broadcast come from the response template. */
+
+    /* IP lease duration / time */
+    auto& ipLeaseTimeOption = offer.options[Option_IPLeaseTime];
+    ipLeaseTimeOption = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(network.getLeaseTime(bootp.chaddr));
 
     std::string optionslog;
 
@@ -152,7 +237,7 @@ void provideParameterList(const Network& network, const BOOTP& bootp, BOOTP& off
             {
                 optionslog += "58/RenewalTime, ";
                 auto& option = offer.options[Option_RenewalTime];
-                option = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(network.getRenewalTime());
+                option = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(network.getRenewalTime(bootp.chaddr));
                 break;
             }
 
@@ -160,7 +245,7 @@ void provideParameterList(const Network& network, const BOOTP& bootp, BOOTP& off
             {
                 optionslog += "59/RebindingTime, ";
                 auto& option = offer.options[Option_RebindingTime];
-                option = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(network.getRebindingTime());
+                option = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(network.getRebindingTime(bootp.chaddr));
                 break;
             }
 
@@ -185,35 +270,434 @@ void provideParameterList(const Network& network, const BOOTP& bootp, BOOTP& off
     }
 
     Log::Debug("Parameter request from {} - {}",
-               convertHardwareAddress(bootp.chaddr),
+               formatHardwareAddress(bootp.chaddr),
                optionslog);
 }
 
+/*
+ * The lease time may have changed since the offer was made (adaptive lease time), so the ACK must carry the times
+ * that were actually recorded for the lease.
+*/
+void provideLeaseTimes(const Network& network, const Lease& lease, BOOTP& offer)
+{
+    offer.options[Option_IPLeaseTime] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(lease.leaseTime);
+
+    if (offer.options.contains(Option_RenewalTime))
+        offer.options[Option_RenewalTime] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(network.getRenewalTime(lease));
+
+    if (offer.options.contains(Option_RebindingTime))
+        offer.options[Option_RebindingTime] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(network.getRebindingTime(lease));
+}
+
 } // anonymous ns
 
 struct BootpHandlerPrivate
 {
-    explicit BootpHandlerPrivate(std::string deviceName_)
+    BootpHandlerPrivate(std::string deviceName_, LeaseListener leaseListener, std::optional<std::vector<Lease>> leases)
         : deviceName(std::move(deviceName_))
+        , loadBalanceDroppedCounter(Statistics::GetCounter(deviceName, "loadbalance_dropped"))
+        , loadBalanceTakeoverCounter(Statistics::GetCounter(deviceName, "loadbalance_takeover"))
+        , clientRateLimitedCounter(Statistics::GetCounter(deviceName, "ratelimit_client_dropped"))
+        , interfaceRateLimitedCounter(Statistics::GetCounter(deviceName, "ratelimit_interface_dropped"))
+        , poolSizeGauge(Statistics::GetCounter(deviceName, "pool_size"))
+        , poolUsedGauge(Statistics::GetCounter(deviceName, "pool_used"))
+        , leaseTimeGauge(Statistics::GetCounter(deviceName, "lease_time_seconds"))
+        , historyLookupsCounter(Statistics::GetCounter(deviceName, "history_lookups"))
+        , historyHitsCounter(Statistics::GetCounter(deviceName, "history_hits"))
+        , quarantineSizeGauge(Statistics::GetCounter(deviceName, "quarantine_size"))
+        , quarantinedCounter(Statistics::GetCounter(deviceName, "quarantine_added"))
+        , quarantineExpiredCounter(Statistics::GetCounter(deviceName, "quarantine_expired"))
+        , probesSentCounter(Statistics::GetCounter(deviceName, "conflict_probes"))
+        , probeConflictsCounter(Statistics::GetCounter(deviceName, "conflict_probe_conflicts"))
+        , informRepliedCounter(Statistics::GetCounter(deviceName, "inform_replied"))
+        , informDroppedCounter(Statistics::GetCounter(deviceName, "inform_dropped"))
     {
-        auto config = Configuration::GetNetworkConfiguration(deviceName);
-        auto leases = Configuration::GetPersistentLeasesByInterface(deviceName);
-        network.configure(std::move(config), leases);
+        configurationGeneration = Configuration::GetGeneration();
+        const auto snapshot = Configuration::GetSnapshot();
+
+        if (!leases)
+            leases = Configuration::GetPersistentLeasesByInterface(deviceName);
+
+        network.setLeaseListener(std::move(leaseListener));
+        if (const auto it = snapshot->networks.find(deviceName); it != snapshot->networks.end())
+            applyConfiguration(*prepareConfiguration(deviceName, it->second));
+        else
+            applyConfiguration(*prepareConfiguration(deviceName, NetworkConfiguration{}));
+
+        for (const auto& lease : *leases)
+            network.importLease(lease);
+        updateStatistics();
+    }
+
+    ~BootpHandlerPrivate()
+    {
+        if (preparer.joinable())
+            preparer.join();
     }
 
     std::unordered_map<std::uint64_t, BOOTP> offers;
     Network network;
     std::string deviceName;
+    ClientClassifier clientClassifier;
+
+    ResponseTemplate defaultTemplate;
+    std::vector<ResponseTemplate> classTemplates; // By client class, only used for the classes in bootClasses.
+    ClientClassMask bootClasses{};
+
+    /* The receiver thread admits requests while the processor thread may swap in a new configuration. */
+    std::mutex admissionMutex;
+
+    LoadBalancer loadBalancer;
+    Statistics::Counter& loadBalanceDroppedCounter;
+    Statistics::Counter& loadBalanceTakeoverCounter;
+
+    RateLimiter rateLimiter;
+    Statistics::Counter& clientRateLimitedCounter;
+    Statistics::Counter& interfaceRateLimitedCounter;
+    Statistics::Counter& poolSizeGauge;
+    Statistics::Counter& poolUsedGauge;
+
+    struct PoolGauges
+    {
+        Statistics::Counter& size;
+        Statistics::Counter& used;
+    };
+    std::vector<PoolGauges> poolGauges; // In the same order as the network's pools.
 
-    std::optional<BootpResponse> handleDhcpDiscover(const BOOTP& bootp)
+    Statistics::Counter& leaseTimeGauge;
+    Statistics::Counter& historyLookupsCounter;
+    Statistics::Counter& historyHitsCounter;
+    Statistics::Counter& quarantineSizeGauge;
+    Statistics::Counter& quarantinedCounter;
+    Statistics::Counter& quarantineExpiredCounter;
+
+    std::unique_ptr<ConflictProber> conflictProber;
+    Statistics::Counter& probesSentCounter;
+    Statistics::Counter& probeConflictsCounter;
+
+    std::vector<std::uint8_t> informReply;
+    Statistics::Counter& informRepliedCounter;
+    Statistics::Counter& informDroppedCounter;
+
+    std::uint64_t configurationGeneration{};
+
+    /*
+     * Everything the interface makes of its configuration. After a reload it's made on a thread of its own, and swapped
+     * in between requests. The leases are the interface's own and are kept.
+    */
+    struct PreparedConfiguration
+    {
+        Network network; // Configured without leases.
+        ClientClassifier clientClassifier;
+        LoadBalancer loadBalancer;
+        RateLimiter rateLimiter;
+        std::unique_ptr<ConflictProber> conflictProber;
+        ResponseTemplate defaultTemplate;
+        std::vector<ResponseTemplate> classTemplates;
+        ClientClassMask bootClasses{};
+        std::vector<PoolGauges> poolGauges;
+        std::vector<std::uint8_t> informReply;
+    };
+
+    std::thread preparer; // Makes the next configuration, or frees the previous one.
+    std::unique_ptr<PreparedConfiguration> prepared;
+    std::atomic_bool preparedReady{};
+    bool preparing{};
+
+    static std::unique_ptr<PreparedConfiguration> prepareConfiguration(const std::string& deviceName, const NetworkConfiguration& config)
+    {
+        auto prepared = std::make_unique<PreparedConfiguration>();
+
+        prepared->network.configure(NetworkConfiguration(config));
+        prepared->clientClassifier.compile(config.clientClasses);
+        prepared->loadBalancer.configure(config.loadBalanceServer, config.loadBalanceServers, config.loadBalanceThreshold);
+        prepared->rateLimiter.configure(config.clientRateLimit, config.clientRateBurst,
+                                        config.interfaceRateLimit, config.interfaceRateBurst,
+                                        config.rateLimitTableSize);
+
+        if (config.conflictProbeTimeout > 0)
+        {
+            prepared->conflictProber = std::make_unique<ConflictProber>(deviceName,
+                                                                        std::chrono::milliseconds(config.conflictProbeTimeout),
+                                                                        config.conflictProbeCacheTime);
+        }
+
+        encodeResponseTemplates(*prepared, config.clientClasses);
+        prepared->informReply = encodeInformReply(prepared->network, prepared->defaultTemplate);
+
+        for (std::size_t i = 0; i < prepared->network.getPoolCount(); ++i)
+        {
+            const auto& poolName = prepared->network.getPoolName(i);
+            prepared->poolGauges.push_back({ Statistics::GetCounter(deviceName, "address_pool_size", "pool", poolName),
+                                             Statistics::GetCounter(deviceName, "address_pool_used", "pool", poolName) });
+        }
+
+        return prepared;
+    }
+
+    // Swaps the prepared configuration in, leaving prepared with the old one.
+    void applyConfiguration(PreparedConfiguration& prepared)
+    {
+        network.reconfigure(prepared.network);
+        std::swap(clientClassifier, prepared.clientClassifier);
+        {
+            std::lock_guard lockGuard(admissionMutex);
+            std::swap(loadBalancer, prepared.loadBalancer);
+            std::swap(rateLimiter, prepared.rateLimiter);
+        }
+        std::swap(conflictProber, prepared.conflictProber);
+        std::swap(defaultTemplate, prepared.defaultTemplate);
+        std::swap(classTemplates, prepared.classTemplates);
+        std::swap(bootClasses, prepared.bootClasses);
+        std::swap(poolGauges, prepared.poolGauges);
+        std::swap(informReply, prepared.informReply);
+        updateStatistics();
+    }
+
+    /*
+     * Checked before every request, which costs one atomic load until the configuration is reloaded. The reload itself
+     * (parsing, validation) was done by whoever loaded it. What the interface makes of it is made on another thread,
+     * while requests are handled with the current configuration, and swapped in once done. Leases, outstanding offers,
+     * the history and quarantine are kept.
+    */
+    void refreshConfiguration()
+    {
+        if (preparing)
+        {
+            if (!preparedReady.load(std::memory_order_acquire))
+                return;
+
+            preparer.join();
+            preparing = false;
+            preparedReady = false;
+
+            applyConfiguration(*prepared);
+            Log::Info("Reloaded configuration for interface {}", deviceName);
+
+            /* The old configuration may hold a lot to free (reservations), and the conflict prober's thread to join. */
+            preparer = std::thread([retired = std::move(prepared)] {});
+        }
+
+        const auto generation = Configuration::GetGeneration();
+        if (generation == configurationGeneration)
+            return;
+
+        configurationGeneration = generation;
+
+        auto snapshot = Configuration::GetSnapshot();
+        if (!snapshot->networks.contains(deviceName))
+        {
+            Log::Warning("Interface {} is no longer configured, it keeps running with its old configuration until restarted", deviceName);
+            return;
+        }
+
+        if (preparer.joinable())
+            preparer.join(); // Done freeing the one before.
+
+        preparing = true;
+        preparer = std::thread([this, snapshot = std::move(snapshot)]
+        {
+            prepared = prepareConfiguration(deviceName, snapshot->networks.at(deviceName));
+            preparedReady.store(true, std::memory_order_release);
+        });
+    }
+
+    void updateStatistics()
+    {
+        poolSizeGauge.set(network.getPoolSize());
+        poolUsedGauge.set(network.getPoolUsedCount());
+
+        for (std::size_t i = 0; i < poolGauges.size(); ++i)
+        {
+            poolGauges[i].size.set(network.getPool(i).getSize());
+            poolGauges[i].used.set(network.getPool(i).getUsedCount());
+        }
+        leaseTimeGauge.set(network.getLeaseTime());
+        historyLookupsCounter.set(network.getHistoryLookups());
+        historyHitsCounter.set(network.getHistoryHits());
+        quarantineSizeGauge.set(network.getQuarantineSize());
+        quarantinedCounter.set(network.getQuarantinedCount());
+        quarantineExpiredCounter.set(network.getQuarantineExpiredCount());
+    }
+
+    static void encodeResponseTemplates(PreparedConfiguration& prepared, const std::vector<ClientClassConfiguration>& clientClasses)
+    {
+        prepared.defaultTemplate = encodeResponseTemplate(prepared.network, nullptr);
+
+        for (std::size_t i = 0; i < clientClasses.size(); ++i)
+        {
+            if (clientClasses[i].bootFile.empty())
+            {
+                prepared.classTemplates.emplace_back();
+                continue;
+            }
+
+            prepared.classTemplates.emplace_back(encodeResponseTemplate(prepared.network, &clientClasses[i]));
+            prepared.bootClasses |= ClientClassMask{ 1 } << i;
+        }
+    }
+
+    void applyResponseTemplate(BOOTP& offer, ClientClassMask clientClasses) const
+    {
+        selectResponseTemplate(clientClasses).applyTo(offer);
+
+        /* Merged as bytes, the host's options replace the template's ones with the same code. */
+        if (const auto* hostOptions = network.getHostOptions(offer.chaddr); hostOptions && !hostOptions->encodedOptions.empty())
+        {
+            offer.encodedOptions = std::make_shared<const std::vector<std::uint8_t>>(
+                mergeEncodedOptions(*offer.encodedOptions, hostOptions->encodedOptions));
+        }
+    }
+
+    // The client's first class (in order of definition) with boot parameters decides.
+    const ResponseTemplate& selectResponseTemplate(ClientClassMask clientClasses) const
+    {
+        const auto classes = clientClasses & bootClasses;
+        if (classes == 0)
+            return defaultTemplate;
+
+        return classTemplates[std::countr_zero(classes)];
+    }
+
+    /*
+     * The reply to a DHCPINFORM only carries configuration, so it is serialized once up front.
+     * RFC 2131 4.3.5: No lease time and no yiaddr, the client already has its address.
+    */
+    static std::vector<std::uint8_t> encodeInformReply(const Network& network, const ResponseTemplate& defaultTemplate)
+    {
+        BOOTP reply;
+        reply.operation = BOOTP_Reply;
+        reply.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_ACK);
+        reply.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(network.getDhcpServerIdentifier());
+        reply.encodedOptions = defaultTemplate.options;
+
+        return serializeBootp(reply);
+    }
+
+    /*
+     * Handled straight from the raw datagram, nothing is de-serialized and neither leases nor offers are touched.
+    */
+    std::optional<BootpResponse> handleDhcpInform(std::span<const std::uint8_t> data)
+    {
+        std::uint32_t clientAddress{};
+        if (!peekClientIpAddress(data, clientAddress) || clientAddress == 0)
+        {
+            informDroppedCounter.increment();
+            return std::nullopt; // Nowhere sensible to reply to.
+        }
+
+        BootpResponse response;
+        response.target = clientAddress;
+        response.data = informReply;
+        if (!copyRequestHeader(data, response.data))
+        {
+            informDroppedCounter.increment();
+            return std::nullopt;
+        }
+
+        informRepliedCounter.increment();
+        return response;
+    }
+
+    /*
+     * Addresses the prober found in use are quarantined, which keeps the allocator away from them and makes
+     * getAvailableAddress refuse them for a client that was already offered one.
+    */
+    void collectProbeConflicts()
+    {
+        if (!conflictProber)
+            return;
+
+        for (auto ipAddress : conflictProber->takeConflicts())
+        {
+            probeConflictsCounter.increment();
+            network.quarantineAddress(ipAddress, conflictProber->getCacheTime());
+        }
+    }
+
+    /*
+     * The first thing done with a request, as most of them are for a peer when the load is shared between several
+     * servers. Only the fixed header is read, and the caller holds admissionMutex. RFC 2131 4.4.1 has the client send
+     * the same secs in its DHCPREQUEST as in its DHCPDISCOVER, so a client we took over from a peer is taken over again
+     * when it requests the offer.
+    */
+    bool admitLoadBalanced(std::span<const std::uint8_t> data)
+    {
+        if (!loadBalancer.isEnabled())
+            return true;
+
+        const auto clientIdentifier = peekClientHardwareAddress(data);
+        std::uint16_t secondsElapsed{};
+        std::uint32_t clientAddress{};
+        if (clientIdentifier.empty() || !peekSecondsElapsed(data, secondsElapsed) || !peekClientIpAddress(data, clientAddress))
+            return false; // Too short to be anything we would answer anyway.
+
+        switch (loadBalancer.admit(clientIdentifier, secondsElapsed, clientAddress != 0))
+        {
+            case LoadBalancer::Verdict::Accept:
+                return true;
+
+            case LoadBalancer::Verdict::Takeover:
+                loadBalanceTakeoverCounter.increment();
+                return true;
+
+            case LoadBalancer::Verdict::Drop:
+                loadBalanceDroppedCounter.increment();
+                return false;
+        }
+
+        return true;
+    }
+
+    /*
+     * Only looks at the fixed header, so a flood costs as little as possible before being dropped.
+     * Drops are deliberately not logged, only counted, for the same reason. The caller holds admissionMutex.
+    */
+    bool admitRequest(std::span<const std::uint8_t> data)
+    {
+        if (!rateLimiter.isEnabled())
+            return true;
+
+        std::uint64_t hwAddress{};
+        if (!peekHardwareAddress(data, hwAddress))
+            return false; // Too short to be anything we would answer anyway.
+
+        const auto now = std::chrono::steady_clock::now().time_since_epoch();
+        const auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+
+        switch (rateLimiter.admit(hwAddress, nowMs))
+        {
+            case RateLimiter::Verdict::Accept:
+                return true;
+
+            case RateLimiter::Verdict::ClientLimited:
+                clientRateLimitedCounter.increment();
+                return false;
+
+            case RateLimiter::Verdict::InterfaceLimited:
+                interfaceRateLimitedCounter.increment();
+                return false;
+        }
+
+        return true;
+    }
+
+    std::optional<BootpResponse> handleDhcpDiscover(const BOOTP& bootp, ClientClassMask clientClasses)
     {
         if (bootp.operation != BOOTP_Request)
             return std::nullopt; // This would be a bug in the DHCP client.
 
-        auto address = network.getAvailableAddress(bootp.chaddr);
+        auto address = network.getAvailableAddress(bootp.chaddr, 0, clientClasses);
         if (address == 0)
             return std::nullopt;  // exhausted network, don't offer anything.
 
+        /*
+         * Probe in the background, the outcome is known by the time the client requests it (mostly).
+         * Not an address the client had before: It would answer the probe itself, having kept using it.
+        */
+        if (conflictProber && !network.hasHeldAddress(bootp.chaddr, address) && conflictProber->probe(address))
+            probesSentCounter.increment();
+
         auto& offer = offers[bootp.chaddr];
         offer = bootp;
         offer.operation = BOOTP_Reply;
@@ -221,6 +705,7 @@ struct BootpHandlerPrivate
         offer.yiaddr = address;
 
         provideParameterList(network, bootp, offer);
+        applyResponseTemplate(offer, clientClasses);
 
         BootpResponse response;
         response.target = address;
@@ -229,16 +714,16 @@ struct BootpHandlerPrivate
             return std::nullopt; // Logged by serializer.
 
         Log::Info("Offering address {} to {}",
-                   convertIpAddress(address),
-                   convertHardwareAddress(bootp.chaddr));
+                   formatIpAddress(address),
+                   formatHardwareAddress(bootp.chaddr));
 
-        addArpEntry(deviceName, convertIpAddress(address), convertHardwareAddress(bootp.chaddr));
+        addArpEntry(deviceName, formatIpAddress(address).view(), formatHardwareAddress(bootp.chaddr).view());
 
         offers[bootp.chaddr] = std::move(offer);
         return response;
     }
 
-    std::optional<BootpResponse> handleDhcpRequest(const BOOTP& bootp)
+    std::optional<BootpResponse> handleDhcpRequest(const BOOTP& bootp, ClientClassMask clientClasses, const RelayAgentIds& relayAgent)
     {
         auto markOfferWithNak = [this] (BOOTP& offer)
         {
@@ -248,8 +733,23 @@ struct BootpHandlerPrivate
                     network.getDhcpServerIdentifier());
             offer.yiaddr = 0;
             offer.ciaddr = 0;
+            ResponseTemplate{}.applyTo(offer); // Nothing but the above.
         };
 
+        /*
+         * RFC 2131 4.3.2: A client requesting an offer names the server it picked. Ours wasn't, so it's withdrawn. When
+         * load balancing, a peer and us both offer to a client that waited past the threshold.
+        */
+        const auto serverIdentifier = getServerIdentifier(bootp);
+        if (serverIdentifier != 0 && serverIdentifier != network.getDhcpServerIdentifier())
+        {
+            Log::Info("Ignoring request from {}, it picked the offer of {}",
+                      formatHardwareAddress(bootp.chaddr),
+                      formatIpAddress(serverIdentifier));
+            offers.erase(bootp.chaddr);
+            return std::nullopt;
+        }
+
         /*
          * No offer was given to this hardware address, check for existing leases.
         */
@@ -258,11 +758,19 @@ struct BootpHandlerPrivate
             const auto& lease = network.getLease(bootp.chaddr);
 
             /*
-             * We don't know about this hardware address, send a NAK.
+             * We don't know about this hardware address, send a NAK. Unless the load is shared: The client may be
+             * rebinding with a lease from a peer, which a NAK would take away from it. RFC 2131 4.3.2 has us stay
+             * silent.
             */
+            if (!Network::isLeaseEntryValid(lease) && loadBalancer.isEnabled())
+            {
+                Log::Info("Ignoring request from {}, we don't know them but a peer may", formatHardwareAddress(bootp.chaddr));
+                return std::nullopt;
+            }
+
             if (!Network::isLeaseEntryValid(lease))
             {
-                Log::Info("Sending NAK to {} because we don't know them", convertHardwareAddress(bootp.chaddr));
+                Log::Info("Sending NAK to {} because we don't know them", formatHardwareAddress(bootp.chaddr));
                 auto nak = bootp;
                 markOfferWithNak(nak);
                 BootpResponse response;
@@ -289,36 +797,38 @@ struct BootpHandlerPrivate
             offer.yiaddr = lease.ipAddress;
             offer.options.clear();
             provideParameterList(network, bootp, offer);
+            applyResponseTemplate(offer, clientClasses);
         }
 
         auto& offer = offers[bootp.chaddr];
         auto requestedIpAddress = getRequestedIpAddress(bootp);
-        auto address = network.getAvailableAddress(bootp.chaddr, requestedIpAddress);
+        auto address = network.getAvailableAddress(bootp.chaddr, requestedIpAddress, clientClasses);
 
         if (offer.yiaddr != requestedIpAddress || address != requestedIpAddress)
         {
             markOfferWithNak(offer);
             Log::Info("Sending NAK to {} because these aren't equal: yiaddr={}, requested={}, network={}",
-                       convertHardwareAddress(bootp.chaddr),
-                       convertIpAddress(offer.yiaddr),
-                       convertIpAddress(requestedIpAddress),
-                       convertIpAddress(address));
+                       formatHardwareAddress(bootp.chaddr),
+                       formatIpAddress(offer.yiaddr),
+                       formatIpAddress(requestedIpAddress),
+                       formatIpAddress(address));
         }
         else
         {
-            if (network.reserveAddress(bootp.chaddr, address))
+            if (network.reserveAddress(bootp.chaddr, address, relayAgent))
             {
                 offer.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_ACK);
+                provideLeaseTimes(network, network.getLease(bootp.chaddr), offer);
                 Log::Info("Sending ACK on address {} to {}",
-                           convertIpAddress(address),
-                           convertHardwareAddress(bootp.chaddr));
+                           formatIpAddress(address),
+                           formatHardwareAddress(bootp.chaddr));
             }
             else
             {
                 markOfferWithNak(offer);
                 Log::Info("Sending NAK to {} because address reservation of {} failed (exhausted network or requested address is illegal)",
-                           convertHardwareAddress(bootp.chaddr),
-                           convertIpAddress(address));
+                           formatHardwareAddress(bootp.chaddr),
+                           formatIpAddress(address));
             }
         }
 
@@ -338,32 +848,55 @@ struct BootpHandlerPrivate
 
     void handleDhcpRelease(const BOOTP& bootp)
     {
-        Log::Info("Releasing address {} from {}", convertIpAddress(bootp.ciaddr), convertHardwareAddress(bootp.chaddr));
+        Log::Info("Releasing address {} from {}", formatIpAddress(bootp.ciaddr), formatHardwareAddress(bootp.chaddr));
         network.releaseAddress(bootp.ciaddr);
     }
 
-    std::optional<BootpResponse> handleRequest(const BOOTP& bootp)
+    void handleDhcpDecline(const BOOTP& bootp)
+    {
+        /* RFC 2131 4.3.3: The declined address is in the requested IP option, ciaddr is 0. */
+        auto address = getRequestedIpAddress(bootp);
+        if (address == 0)
+            address = bootp.ciaddr;
+
+        offers.erase(bootp.chaddr);
+
+        if (network.declineAddress(bootp.chaddr, address))
+        {
+            Log::Warning("Address {} declined by {}, quarantined for {} seconds",
+                         formatIpAddress(address),
+                         formatHardwareAddress(bootp.chaddr),
+                         network.getQuarantineTime());
+        }
+        else
+        {
+            Log::Info("Ignoring decline of address {} from {}, it has no lease on it",
+                      formatIpAddress(address),
+                      formatHardwareAddress(bootp.chaddr));
+        }
+    }
+
+    std::optional<BootpResponse> handleRequest(const BOOTP& bootp, ClientClassMask clientClasses, const RelayAgentIds& relayAgent)
     {
         auto messageType = getMessageType(bootp);
         switch (messageType)
         {
             case DHCP_Discover:
-                Log::Info("Handling DHCP Discover from {}", convertHardwareAddress(bootp.chaddr));
-                return handleDhcpDiscover(bootp);
+                Log::Info("Handling DHCP Discover from {}", formatHardwareAddress(bootp.chaddr));
+                return handleDhcpDiscover(bootp, clientClasses);
 
             case DHCP_Request:
-                Log::Info("Handling DHCP Request from {}", convertHardwareAddress(bootp.chaddr));
-                return handleDhcpRequest(bootp);
+                Log::Info("Handling DHCP Request from {}", formatHardwareAddress(bootp.chaddr));
+                return handleDhcpRequest(bootp, clientClasses, relayAgent);
 
             case DHCP_Release:
-                Log::Info("Handling DHCP Release from {}", convertHardwareAddress(bootp.chaddr));
+                Log::Info("Handling DHCP Release from {}", formatHardwareAddress(bootp.chaddr));
                 handleDhcpRelease(bootp);
                 break;
 
             case DHCP_Decline:
-                Log::Info("Handling DHCP Decline (as a release) from {}", convertHardwareAddress(bootp.chaddr));
-                // TODO in fact, reserve the address internally as it's most likely unusable anyway.
-                handleDhcpRelease(bootp);
+                Log::Info("Handling DHCP Decline from {}", formatHardwareAddress(bootp.chaddr));
+                handleDhcpDecline(bootp);
                 break;
 
             default:
@@ -374,15 +907,42 @@ struct BootpHandlerPrivate
     }
 }; // BootpHandlerPrivate
 
-BootpHandler::BootpHandler(std::string deviceName)
+BootpHandler::BootpHandler(std::string deviceName, LeaseListener leaseListener, std::optional<std::vector<Lease>> leases)
 {
-    mp = std::make_unique<BootpHandlerPrivate>(std::move(deviceName));
+    mp = std::make_unique<BootpHandlerPrivate>(std::move(deviceName), std::move(leaseListener), std::move(leases));
 }
 
 BootpHandler::~BootpHandler() = default;
 
+const LeaseTable& BootpHandler::getLeaseTable() const
+{
+    return mp->network.getLeaseTable();
+}
+
+bool BootpHandler::admitRequest(std::span<const std::uint8_t> data)
+{
+    std::lock_guard lockGuard(mp->admissionMutex);
+
+    if (!mp->admitLoadBalanced(data))
+        return false; // Another server's client, counted by admitLoadBalanced.
+
+    return mp->admitRequest(data); // Counted by admitRequest, not logged.
+}
+
+void BootpHandler::refreshConfiguration()
+{
+    mp->refreshConfiguration();
+}
+
 std::optional<BootpResponse> BootpHandler::handleRequest(std::span<const std::uint8_t> data)
 {
+    mp->refreshConfiguration();
+
+    if (peekMessageType(data) == DHCP_Inform)
+        return mp->handleDhcpInform(data); // Counted by handleDhcpInform.
+
+    mp->collectProbeConflicts();
+
     BOOTP request;
     if (!deserializeBootp(data, request))
     {
@@ -390,5 +950,11 @@ std::optional<BootpResponse> BootpHandler::handleRequest(std::span<const std::ui
         return std::nullopt;
     }
 
-    return mp->handleRequest(request);
+    const auto clientClasses = mp->clientClassifier.classify(data);
+    if (clientClasses != 0)
+        Log::Debug("Client {} is in classes {:#x}", formatHardwareAddress(request.chaddr), clientClasses);
+
+    auto response = mp->handleRequest(request, clientClasses, peekRelayAgentIds(data));
+    mp->updateStatistics();
+    return response;
 }
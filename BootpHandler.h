@@ -30,7 +30,21 @@ class BootpHandler
 {
     std::unique_ptr<BootpHandlerPrivate> mp;
 public:
-    explicit BootpHandler(std::string deviceName);
+    // Leases are loaded from the interface's lease file, unless given.
+    explicit BootpHandler(std::string deviceName, LeaseListener leaseListener = {},
+                          std::optional<std::vector<Lease>> leases = std::nullopt);
     ~BootpHandler();
+
+    // Load balancing and rate limiting, from the fixed header only. Meant for the thread receiving the requests, so
+    // that those dropped never take up room in the queue. May be called while another thread is in handleRequest.
+    bool admitRequest(std::span<const std::uint8_t> data);
+
+    // Swaps in a reloaded configuration once it's ready. handleRequest does this too, call it when there's nothing to handle.
+    void refreshConfiguration();
+
+    // For requests already admitted by admitRequest.
     std::optional<BootpResponse> handleRequest(std::span<const std::uint8_t> data);
+
+    // The interface's leases, safe to read from any thread.
+    const LeaseTable& getLeaseTable() const;
 };
@@ -7,6 +7,9 @@
 
 #include "BootpSocket.h"
 #include "BootpHandler.h"
+#include "RequestQueue.h"
+#include "Serializer.h"
+#include "Statistics.h"
 #include "Logger.h"
 
 #include <unistd.h>
@@ -17,6 +20,9 @@
 
 #include <cerrno>
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 #include <atomic>
 
@@ -31,6 +37,10 @@ struct BootpSocketPrivate
 
     void setupSocket();
     void socketThreadFn();
+    void processorThreadFn();
+
+    void enqueueRequest(std::vector<std::uint8_t>&& data);
+    bool dequeueRequest(QueuedRequest& request);
 
     std::uint16_t serverPort{ 67 };
     std::uint16_t clientPort{ 68 };
@@ -39,11 +49,18 @@ struct BootpSocketPrivate
     BootpHandler bootpHandler;
 
     std::thread receiverThread;
+    std::thread processorThread;
     std::atomic_bool running{};
     int sockfd{};
 
-    explicit BootpSocketPrivate(std::string&& deviceName_)
-        : bootpHandler(deviceName_)
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    RequestQueue requestQueue;
+
+    BootpSocketPrivate(std::string&& deviceName_, LeaseListener&& leaseListener, std::optional<std::vector<Lease>>&& leases)
+        : bootpHandler(deviceName_, std::move(leaseListener), std::move(leases))
+        , requestQueue(Statistics::GetCounter(deviceName_, "queue_full_dropped"),
+                       Statistics::GetCounter(deviceName_, "stale_discover_dropped"))
     {
         deviceName = std::move(deviceName_);
     }
@@ -54,7 +71,7 @@ struct BootpSocketPrivate
         addr.sin_addr.s_addr = htonl(target);
         addr.sin_port = htons(clientPort);
 
-        Log::Debug("Sending response to {} on {} bytes", convertIpAddress(target), data.size());
+        Log::Debug("Sending response to {} on {} bytes", formatIpAddress(target), data.size());
 
         auto bytesSent = sendto(sockfd, data.data(), data.size(), 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
         if (bytesSent == 0)
@@ -68,7 +85,7 @@ struct BootpSocketPrivate
         }
         else
         {
-            Log::Debug("Successfully responded with {} bytes to {}", bytesSent, convertIpAddress(target));
+            Log::Debug("Successfully responded with {} bytes to {}", bytesSent, formatIpAddress(target));
         }
     }
 };
@@ -165,26 +182,73 @@ void BootpSocketPrivate::socketThreadFn()
             continue;
         }
 
+        /* Dropped before anything is allocated or queued, so a flood can't crowd out the requests we do answer. */
+        if (!bootpHandler.admitRequest({ data, static_cast<std::size_t>(ret) }))
+            continue;
+
         std::vector<std::uint8_t> dataVector;
         dataVector.insert(dataVector.end(), data, data + ret);
         Log::Debug("Socket got data on adapter {} ({} bytes)", deviceName, dataVector.size());
 
-        auto response = bootpHandler.handleRequest(std::move(dataVector));
+        enqueueRequest(std::move(dataVector));
+    }
+
+    queueCondition.notify_all();
+}
+
+void BootpSocketPrivate::processorThreadFn()
+{
+    QueuedRequest request;
+    while (dequeueRequest(request))
+    {
+        auto response = bootpHandler.handleRequest(request.data);
         if (response)
         {
             sendResponse(response->target, response->data);
         }
     }
+}
+
+void BootpSocketPrivate::enqueueRequest(std::vector<std::uint8_t>&& data)
+{
+    {
+        std::lock_guard lockGuard(queueMutex);
+        if (!requestQueue.push(std::move(data), std::chrono::steady_clock::now()))
+            return; // Counted by the queue.
+    }
+
+    queueCondition.notify_one();
+}
+
+bool BootpSocketPrivate::dequeueRequest(QueuedRequest& request)
+{
+    std::unique_lock lock(queueMutex);
+
+    while (running)
+    {
+        if (requestQueue.pop(request, std::chrono::steady_clock::now()))
+            return true;
+
+        if (queueCondition.wait_for(lock, std::chrono::seconds(1)) == std::cv_status::timeout)
+        {
+            /* A reload must not wait for a request to get through admission with the old configuration. */
+            lock.unlock();
+            bootpHandler.refreshConfiguration();
+            lock.lock();
+        }
+    }
 
-    ::close(sockfd);
+    return false;
 }
 
-BootpSocket::BootpSocket(std::uint16_t serverPort, std::uint16_t clientPort, std::string deviceName)
+BootpSocket::BootpSocket(std::uint16_t serverPort, std::uint16_t clientPort, std::string deviceName,
+                         LeaseListener leaseListener, std::optional<std::vector<Lease>> leases)
 {
-    mp = std::make_unique<BootpSocketPrivate>(std::move(deviceName));
+    mp = std::make_unique<BootpSocketPrivate>(std::move(deviceName), std::move(leaseListener), std::move(leases));
     mp->serverPort = serverPort;
     mp->clientPort = clientPort;
     mp->running = true;
+    mp->processorThread = std::thread(&BootpSocketPrivate::processorThreadFn, mp.get());
     mp->receiverThread = std::thread(&BootpSocketPrivate::socketThreadFn, mp.get());
 }
 
@@ -192,6 +256,17 @@ BootpSocket::~BootpSocket()
 {
     Log::Info("Destroying Bootp socket for {}", mp->deviceName);
     mp->running = false;
+    mp->queueCondition.notify_all();
     if (mp->receiverThread.joinable())
         mp->receiverThread.join();
+    if (mp->processorThread.joinable())
+        mp->processorThread.join();
+
+    /* Closed only after both threads are done, as the processor thread sends responses on it. */
+    ::close(mp->sockfd);
+}
+
+const LeaseTable& BootpSocket::getLeaseTable() const
+{
+    return mp->bootpHandler.getLeaseTable();
 }
@@ -7,15 +7,24 @@
 
 #pragma once
 
+#include "Network.h"
+
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 struct BootpSocketPrivate;
 class BootpSocket
 {
     std::unique_ptr<BootpSocketPrivate> mp;
 public:
-    BootpSocket(std::uint16_t serverPort, std::uint16_t clientPort, std::string deviceName);
+    // Leases are loaded from the interface's lease file, unless given. The listener is told about every lease change.
+    BootpSocket(std::uint16_t serverPort, std::uint16_t clientPort, std::string deviceName,
+                LeaseListener leaseListener = {}, std::optional<std::vector<Lease>> leases = std::nullopt);
     ~BootpSocket();
+
+    // The interface's leases, safe to read from any thread.
+    const LeaseTable& getLeaseTable() const;
 };
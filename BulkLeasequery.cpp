@@ -0,0 +1,466 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "BulkLeasequery.h"
+#include "IpConverter.h"
+#include "Logger.h"
+#include "Serializer.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <ctime>
+
+#include <algorithm>
+#include <memory>
+
+namespace
+{
+constexpr auto PollInterval = std::chrono::milliseconds(100);
+
+/* A query is at most the largest message the length prefix can announce. */
+constexpr std::size_t MaxInput = 2 + 0xFFFF;
+
+/* Pages read in one go while none of them has a lease to send, before the other connections get their turn. */
+constexpr std::size_t MaxEmptyPages = 64;
+
+void writeBigEndian(std::uint8_t* ptr, std::uint32_t value)
+{
+    ptr[0] = static_cast<std::uint8_t>(value >> 24);
+    ptr[1] = static_cast<std::uint8_t>(value >> 16);
+    ptr[2] = static_cast<std::uint8_t>(value >> 8);
+    ptr[3] = static_cast<std::uint8_t>(value);
+}
+
+void writeBigEndian(std::uint8_t* ptr, std::uint64_t value)
+{
+    writeBigEndian(ptr, static_cast<std::uint32_t>(value >> 32));
+    writeBigEndian(ptr + 4, static_cast<std::uint32_t>(value));
+}
+
+std::string_view getStatusText(BulkLeasequery::Status status)
+{
+    switch (status)
+    {
+        case BulkLeasequery::Status::Success: return "Success";
+        case BulkLeasequery::Status::UnspecFail: return "Query failed";
+        case BulkLeasequery::Status::QueryTerminated: return "Query terminated";
+        case BulkLeasequery::Status::MalformedQuery: return "Not a DHCPBULKLEASEQUERY";
+        case BulkLeasequery::Status::NotAllowed: return "Only queries by hardware address, relay-id, remote-id or address are supported";
+    }
+
+    return {};
+}
+}
+
+bool BulkLeasequery::Query::matches(const Lease& lease) const
+{
+    return (hwAddress == 0 || lease.hwAddress == hwAddress)
+        && (relayAgent.relayId == 0 || lease.relayAgent.relayId == relayAgent.relayId)
+        && (relayAgent.remoteId == 0 || lease.relayAgent.remoteId == relayAgent.remoteId)
+        && range.contains(lease.ipAddress);
+}
+
+BulkLeasequery::Status BulkLeasequery::ParseQuery(std::span<const std::uint8_t> message, Query& query)
+{
+    query = {};
+    if (message.size() >= 8)
+        query.transactionId = (std::uint32_t{ message[4] } << 24) | (message[5] << 16) | (message[6] << 8) | message[7];
+
+    if (message.size() < 240 || message[0] != BOOTP_Request || peekMessageType(message) != DHCP_BulkLeaseQuery)
+        return Status::MalformedQuery;
+
+    /* Leases only know the client by its hardware address, not by client identifier. */
+    if (!peekOption(message, Option_ClientIdentifier).empty())
+        return Status::NotAllowed;
+
+    const auto hardwareType = message[1];
+    const auto hardwareAddressLength = message[2];
+    if (hardwareAddressLength != 0)
+    {
+        if (hardwareType != 1 || hardwareAddressLength != 6)
+            return Status::NotAllowed;
+
+        peekHardwareAddress(message, query.hwAddress);
+    }
+
+    query.relayAgent = peekRelayAgentIds(message);
+
+    std::uint32_t clientAddress{};
+    peekClientIpAddress(message, clientAddress);
+    if (clientAddress != 0)
+    {
+        const auto mask = peekOption(message, Option_SubnetMask);
+        query.range.mask = mask.size() == 4 ? (std::uint32_t{ mask[0] } << 24) | (mask[1] << 16) | (mask[2] << 8) | mask[3]
+                                            : ~std::uint32_t{};
+        query.range.address = clientAddress & query.range.mask;
+    }
+
+    return Status::Success;
+}
+
+BulkLeasequeryServer::BulkLeasequeryServer(std::uint32_t address, std::uint16_t port, std::vector<Subnet> allowed)
+    : m_address(address)
+    , m_port(port)
+    , m_allowed(std::move(allowed))
+{
+}
+
+BulkLeasequeryServer::~BulkLeasequeryServer()
+{
+    stop();
+}
+
+void BulkLeasequeryServer::addInterface(const LeaseTable& table, std::uint32_t serverIdentifier, std::uint32_t maximumLeaseTime)
+{
+    m_interfaces.push_back({ &table, serverIdentifier, maximumLeaseTime });
+}
+
+bool BulkLeasequeryServer::start()
+{
+    m_listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listenfd < 0)
+    {
+        const auto e = errno;
+        Log::Critical("Bulk leasequery socket() error, errno={}", e);
+        return false;
+    }
+
+    int yes = 1;
+    setsockopt(m_listenfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(m_address);
+    addr.sin_port = htons(m_port);
+    if (bind(m_listenfd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || listen(m_listenfd, MaxConnections) != 0)
+    {
+        const auto e = errno;
+        Log::Critical("Bulk leasequery couldn't listen on {}:{}, errno={}", formatIpAddress(m_address), m_port, e);
+        close(m_listenfd);
+        m_listenfd = -1;
+        return false;
+    }
+
+    socklen_t addrlen = sizeof(addr);
+    getsockname(m_listenfd, reinterpret_cast<sockaddr*>(&addr), &addrlen);
+    m_port = ntohs(addr.sin_port);
+
+    m_running = true;
+    m_thread = std::thread(&BulkLeasequeryServer::threadFn, this);
+    return true;
+}
+
+std::uint16_t BulkLeasequeryServer::getPort() const
+{
+    return m_port;
+}
+
+void BulkLeasequeryServer::stop()
+{
+    m_running = false;
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if (m_listenfd >= 0)
+    {
+        close(m_listenfd);
+        m_listenfd = -1;
+    }
+}
+
+void BulkLeasequeryServer::threadFn()
+{
+    Log::Info("Bulk leasequery listening on {}:{}", formatIpAddress(m_address), m_port);
+
+    std::vector<Connection> connections;
+    std::vector<pollfd> pollfds;
+
+    while (m_running)
+    {
+        pollfds.assign(1, { m_listenfd, POLLIN, 0 });
+        for (const auto& connection : connections)
+        {
+            short events{};
+            if (!connection.inputClosed && connection.input.size() < MaxInput)
+                events |= POLLIN;
+            if (!connection.output.empty() || connection.querying)
+                events |= POLLOUT;
+
+            pollfds.push_back({ connection.sockfd, events, 0 });
+        }
+
+        if (poll(pollfds.data(), pollfds.size(), static_cast<int>(PollInterval.count())) < 0)
+            continue;
+
+        const auto now = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < connections.size(); ++i)
+        {
+            auto& connection = connections[i];
+            const auto events = pollfds[i + 1].revents;
+
+            bool keep = (events & (POLLERR | POLLNVAL)) == 0;
+            if (keep && (events & (POLLIN | POLLHUP)))
+                keep = receiveInput(connection);
+            if (keep)
+                keep = serve(connection);
+
+            if (keep && now - connection.lastActivity > IdleTimeout)
+            {
+                Log::Info("Bulk leasequery connection from {} idle for too long", formatIpAddress(connection.peerAddress));
+                keep = false;
+            }
+
+            if (!keep)
+            {
+                close(connection.sockfd);
+                connection.sockfd = -1;
+            }
+        }
+
+        std::erase_if(connections, [](const Connection& connection) { return connection.sockfd < 0; });
+
+        if (pollfds[0].revents & POLLIN)
+            acceptConnection(connections);
+    }
+
+    for (const auto& connection : connections)
+        close(connection.sockfd);
+}
+
+void BulkLeasequeryServer::acceptConnection(std::vector<Connection>& connections)
+{
+    sockaddr_in addr{};
+    socklen_t addrlen = sizeof(addr);
+    const int sockfd = accept(m_listenfd, reinterpret_cast<sockaddr*>(&addr), &addrlen);
+    if (sockfd < 0)
+        return;
+
+    const auto peerAddress = ntohl(addr.sin_addr.s_addr);
+    const bool allowed = std::any_of(m_allowed.begin(), m_allowed.end(),
+                                     [peerAddress](const Subnet& subnet) { return subnet.contains(peerAddress); });
+    if (!allowed)
+    {
+        Log::Warning("Bulk leasequery connection from {} refused, it's not in bulk_leasequery_allow", formatIpAddress(peerAddress));
+        close(sockfd);
+        return;
+    }
+
+    if (connections.size() >= MaxConnections)
+    {
+        Log::Warning("Bulk leasequery connection from {} refused, {} connections already", formatIpAddress(peerAddress), MaxConnections);
+        close(sockfd);
+        return;
+    }
+
+    auto& connection = connections.emplace_back();
+    connection.sockfd = sockfd;
+    connection.peerAddress = peerAddress;
+    connection.lastActivity = std::chrono::steady_clock::now();
+}
+
+bool BulkLeasequeryServer::receiveInput(Connection& connection)
+{
+    const auto filled = connection.input.size();
+    connection.input.resize(MaxInput);
+
+    const auto received = recv(connection.sockfd, connection.input.data() + filled, MaxInput - filled, MSG_DONTWAIT);
+    connection.input.resize(filled + static_cast<std::size_t>(std::max<ssize_t>(received, 0)));
+
+    if (received == 0)
+        connection.inputClosed = true;
+    else if (received > 0)
+        connection.lastActivity = std::chrono::steady_clock::now();
+    else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        return false;
+
+    return true;
+}
+
+bool BulkLeasequeryServer::sendOutput(Connection& connection)
+{
+    const auto sent = ::send(connection.sockfd, connection.output.data() + connection.outputSent,
+                             connection.output.size() - connection.outputSent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+    connection.outputSent += static_cast<std::size_t>(sent);
+    connection.lastActivity = std::chrono::steady_clock::now();
+    if (connection.outputSent == connection.output.size())
+    {
+        connection.output.clear();
+        connection.outputSent = 0;
+    }
+
+    return true;
+}
+
+/*
+ * Only produces more to send once everything before it is sent, so each connection holds at most a page of replies.
+ * Returns false once the connection is done with.
+*/
+bool BulkLeasequeryServer::serve(Connection& connection)
+{
+    if (connection.output.empty())
+    {
+        if (!connection.querying)
+            startQuery(connection);
+        if (connection.querying)
+            continueQuery(connection);
+    }
+
+    if (!connection.output.empty() && !sendOutput(connection))
+        return false;
+
+    /* Queries are answered in the order they came, a peer that has closed its end is done when all are answered. */
+    return !connection.inputClosed || connection.querying || !connection.output.empty();
+}
+
+void BulkLeasequeryServer::startQuery(Connection& connection)
+{
+    if (connection.input.size() < 2)
+        return;
+
+    const std::size_t size = (connection.input[0] << 8) | connection.input[1];
+    if (connection.input.size() < 2 + size)
+        return;
+
+    const auto status = BulkLeasequery::ParseQuery(std::span(connection.input).subspan(2, size), connection.query);
+    connection.input.erase(connection.input.begin(), connection.input.begin() + 2 + static_cast<std::ptrdiff_t>(size));
+
+    if (status != BulkLeasequery::Status::Success)
+    {
+        Log::Warning("Bulk leasequery from {} refused: {}", formatIpAddress(connection.peerAddress), getStatusText(status));
+        appendStatus(connection, status, getStatusText(status));
+        return;
+    }
+
+    Log::Info("Bulk leasequery from {}", formatIpAddress(connection.peerAddress));
+    connection.querying = true;
+    connection.interfaceIndex = 0;
+    connection.slot = 0;
+    connection.reply.data.clear();
+}
+
+void BulkLeasequeryServer::continueQuery(Connection& connection)
+{
+    const auto now = std::time(nullptr);
+
+    for (std::size_t page = 0; page < MaxEmptyPages && connection.output.empty(); ++page)
+    {
+        if (connection.interfaceIndex == m_interfaces.size())
+        {
+            BOOTP done;
+            done.operation = BOOTP_Reply;
+            done.transactionId = connection.query.transactionId;
+            done.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_LeaseQueryDone);
+            done.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(getServerIdentifier());
+            appendMessage(connection, serializeBootp(done));
+
+            connection.querying = false;
+            return;
+        }
+
+        const auto& interface = m_interfaces[connection.interfaceIndex];
+        if (connection.reply.data.empty())
+            makeReplyTemplate(connection);
+
+        auto& reply = connection.reply;
+        connection.slot = interface.table->forEachInSlots(connection.slot, PageSlots, [&](const Lease& lease)
+        {
+            if (!connection.query.matches(lease))
+                return;
+
+            const auto leaseTime = lease.leaseTime != 0 ? lease.leaseTime : interface.maximumLeaseTime;
+            const auto expiry = lease.startTime + static_cast<std::time_t>(leaseTime);
+            if (expiry <= now)
+                return;
+
+            const auto offset = connection.output.size() + 2;
+            appendMessage(connection, reply.data);
+
+            auto* message = connection.output.data() + offset;
+            writeBigEndian(message + 12, lease.ipAddress); // ciaddr
+            writeBigEndian(message + 28, lease.hwAddress << 16); // chaddr
+            writeBigEndian(message + reply.leaseTimeOffset, static_cast<std::uint32_t>(expiry - now));
+            writeBigEndian(message + reply.baseTimeOffset, static_cast<std::uint32_t>(now));
+            writeBigEndian(message + reply.startTimeOffset, static_cast<std::uint32_t>(std::max<std::time_t>(now - lease.startTime, 0)));
+        });
+
+        if (connection.slot >= interface.table->getSlotCount())
+        {
+            ++connection.interfaceIndex;
+            connection.slot = 0;
+            connection.reply.data.clear();
+        }
+    }
+}
+
+void BulkLeasequeryServer::makeReplyTemplate(Connection& connection)
+{
+    const auto& interface = m_interfaces[connection.interfaceIndex];
+
+    BOOTP reply;
+    reply.operation = BOOTP_Reply;
+    reply.transactionId = connection.query.transactionId;
+    reply.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_LeaseActive);
+    reply.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(interface.serverIdentifier);
+    reply.encodedOptions = std::make_shared<const std::vector<std::uint8_t>>(std::vector<std::uint8_t>{
+        Option_IPLeaseTime, 4, 0, 0, 0, 0,
+        Option_BaseTime, 4, 0, 0, 0, 0,
+        Option_StartTimeOfState, 4, 0, 0, 0, 0,
+        Option_DhcpState, 1, BulkLeasequery::StateActive
+    });
+
+    auto& data = connection.reply.data;
+    data = serializeBootp(reply);
+
+    auto offsetOf = [&data](BOOTPOptionKey key)
+    {
+        return static_cast<std::size_t>(peekOption(data, key).data() - data.data());
+    };
+
+    connection.reply.leaseTimeOffset = offsetOf(Option_IPLeaseTime);
+    connection.reply.baseTimeOffset = offsetOf(Option_BaseTime);
+    connection.reply.startTimeOffset = offsetOf(Option_StartTimeOfState);
+}
+
+std::uint32_t BulkLeasequeryServer::getServerIdentifier() const
+{
+    if (m_address != 0 || m_interfaces.empty())
+        return m_address;
+
+    return m_interfaces.front().serverIdentifier;
+}
+
+void BulkLeasequeryServer::appendMessage(Connection& connection, std::span<const std::uint8_t> message) const
+{
+    auto& output = connection.output;
+    const auto offset = output.size();
+    output.resize(offset + 2 + message.size());
+    output[offset] = static_cast<std::uint8_t>(message.size() >> 8);
+    output[offset + 1] = static_cast<std::uint8_t>(message.size());
+    std::copy(message.begin(), message.end(), output.begin() + static_cast<std::ptrdiff_t>(offset) + 2);
+}
+
+void BulkLeasequeryServer::appendStatus(Connection& connection, BulkLeasequery::Status status, std::string_view text) const
+{
+    std::vector<std::uint8_t> statusCode{ static_cast<std::uint8_t>(status) };
+    statusCode.insert(statusCode.end(), text.begin(), text.end());
+
+    BOOTP reply;
+    reply.operation = BOOTP_Reply;
+    reply.transactionId = connection.query.transactionId;
+    reply.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_LeaseQueryStatus);
+    reply.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(getServerIdentifier());
+    reply.options[Option_StatusCode] = std::make_unique<RawBOOTPOption>(std::move(statusCode));
+    appendMessage(connection, serializeBootp(reply));
+}
@@ -0,0 +1,156 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include "Configuration.h"
+#include "LeaseTable.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/*
+ * Bulk leasequery (RFC 6926). Relay agents and address management systems connect over TCP and ask for the active
+ * leases, ie. to rebuild their state after a restart. Each message is preceded by its length as 2 octets.
+ *
+ * A DHCPBULKLEASEQUERY is answered by a DHCPLEASEACTIVE for every active lease matching it, and then a
+ * DHCPLEASEQUERYDONE. A query that can't be answered gets a DHCPLEASEQUERYSTATUS with the reason instead.
+*/
+namespace BulkLeasequery
+{
+    // The status-code option, RFC 6926 section 6.2.2.
+    enum class Status : std::uint8_t
+    {
+        Success,
+        UnspecFail,
+        QueryTerminated,
+        MalformedQuery,
+        NotAllowed
+    };
+
+    // The dhcp-state option, RFC 6926 section 6.2.7.
+    constexpr std::uint8_t StateActive{ 2 };
+
+    /*
+     * What a DHCPBULKLEASEQUERY asks for. Leases must match every filter given, and without any filter every active
+     * lease is sent. The filters are chaddr, and the relay-id and remote-id suboptions of the relay agent information.
+     * As an extension, ciaddr together with the subnet mask option asks for the leases within that network.
+    */
+    struct Query
+    {
+        std::uint32_t transactionId{};
+        std::uint64_t hwAddress{}; // 0 for any.
+        RelayAgentIds relayAgent;  // Digests, 0 for any.
+        Subnet range;              // Mask 0 for any.
+
+        [[nodiscard]]
+        bool matches(const Lease& lease) const;
+    };
+
+    // Returns Success with query filled in, or why it can't be answered. transactionId is filled in either way.
+    Status ParseQuery(std::span<const std::uint8_t> message, Query& query);
+}
+
+/*
+ * Serves bulk leasequery on a thread of its own. The leases are read from the interfaces' lease tables, so serving
+ * never waits for, or holds up, the threads answering DHCP. Each connection goes through the tables a page of slots
+ * at a time, sending one page before reading the next, so a query uses little memory however many leases there are
+ * and a slow reader only slows itself down. Leases changing while a query is sent may be sent either before or
+ * after the change, or not at all if they moved past the page being read.
+*/
+class BulkLeasequeryServer
+{
+public:
+    static constexpr std::size_t MaxConnections = 16;
+    static constexpr std::size_t PageSlots = 256;
+    static constexpr auto IdleTimeout = std::chrono::seconds(60);
+
+    BulkLeasequeryServer(std::uint32_t address, std::uint16_t port, std::vector<Subnet> allowed);
+    ~BulkLeasequeryServer();
+
+    BulkLeasequeryServer(const BulkLeasequeryServer&) = delete;
+    BulkLeasequeryServer& operator=(const BulkLeasequeryServer&) = delete;
+
+    // Must be called before start(). The table must outlive this. Leases without a lease time of their own (loaded
+    // from the lease file) are taken to have the interface's maximum lease time, as the network gives them.
+    void addInterface(const LeaseTable& table, std::uint32_t serverIdentifier, std::uint32_t maximumLeaseTime);
+
+    // Returns false if the address couldn't be listened on.
+    bool start();
+
+    // The port listened on, useful when started with port 0.
+    [[nodiscard]]
+    std::uint16_t getPort() const;
+
+    void stop();
+
+private:
+    struct Interface
+    {
+        const LeaseTable* table;
+        std::uint32_t serverIdentifier;
+        std::uint32_t maximumLeaseTime;
+    };
+
+    /*
+     * A DHCPLEASEACTIVE for one interface and query, serialized once. Each lease is sent as a copy with the lease's
+     * fields written in at these offsets.
+    */
+    struct ReplyTemplate
+    {
+        std::vector<std::uint8_t> data;
+        std::size_t leaseTimeOffset{};
+        std::size_t baseTimeOffset{};
+        std::size_t startTimeOffset{};
+    };
+
+    struct Connection
+    {
+        int sockfd{ -1 };
+        std::uint32_t peerAddress{};
+        std::vector<std::uint8_t> input;
+        bool inputClosed{}; // The peer may shut down its end once it has sent its queries.
+        std::vector<std::uint8_t> output;
+        std::size_t outputSent{};
+        std::chrono::steady_clock::time_point lastActivity;
+
+        bool querying{};
+        BulkLeasequery::Query query;
+        std::size_t interfaceIndex{};
+        std::size_t slot{};
+        ReplyTemplate reply;
+    };
+
+    std::uint32_t m_address;
+    std::uint16_t m_port;
+    std::vector<Subnet> m_allowed;
+    std::vector<Interface> m_interfaces;
+
+    int m_listenfd{ -1 };
+    std::thread m_thread;
+    std::atomic_bool m_running{};
+
+    void threadFn();
+    void acceptConnection(std::vector<Connection>& connections);
+    bool receiveInput(Connection& connection);
+    bool sendOutput(Connection& connection);
+    bool serve(Connection& connection);
+    void startQuery(Connection& connection);
+    void continueQuery(Connection& connection);
+    void makeReplyTemplate(Connection& connection);
+
+    [[nodiscard]]
+    std::uint32_t getServerIdentifier() const;
+
+    void appendMessage(Connection& connection, std::span<const std::uint8_t> message) const;
+    void appendStatus(Connection& connection, BulkLeasequery::Status status, std::string_view text) const;
+};
@@ -0,0 +1,134 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "ClientClassifier.h"
+#include "Serializer.h"
+
+#include <algorithm>
+
+namespace
+{
+std::string_view toStringView(std::span<const std::uint8_t> data)
+{
+    return { reinterpret_cast<const char*>(data.data()), data.size() };
+}
+}
+
+ClientClassifier::ClientClassifier(const std::vector<ClientClassConfiguration>& classes)
+{
+    compile(classes);
+}
+
+void ClientClassifier::compile(const std::vector<ClientClassConfiguration>& classes)
+{
+    m_ouis.clear();
+    m_vendorClasses.clear();
+    m_vendorPrefixes.clear();
+    m_vendorPrefixLengths.clear();
+    m_userClasses.clear();
+
+    for (std::size_t i = 0; i < classes.size() && i < MaxClientClasses; ++i)
+    {
+        const auto bit = ClientClassMask{ 1 } << i;
+        const auto& clientClass = classes[i];
+
+        for (auto oui : clientClass.ouis)
+            m_ouis[oui] |= bit;
+
+        for (const auto& vendorClass : clientClass.vendorClasses)
+        {
+            if (vendorClass.ends_with('*'))
+            {
+                const auto prefix = vendorClass.substr(0, vendorClass.size() - 1);
+                m_vendorPrefixes[prefix] |= bit;
+                if (std::find(m_vendorPrefixLengths.begin(), m_vendorPrefixLengths.end(), prefix.size()) == m_vendorPrefixLengths.end())
+                    m_vendorPrefixLengths.emplace_back(prefix.size());
+            }
+            else
+            {
+                m_vendorClasses[vendorClass] |= bit;
+            }
+        }
+
+        for (const auto& userClass : clientClass.userClasses)
+            m_userClasses[userClass] |= bit;
+    }
+}
+
+bool ClientClassifier::isEmpty() const
+{
+    return m_ouis.empty() && m_vendorClasses.empty() && m_vendorPrefixes.empty() && m_userClasses.empty();
+}
+
+ClientClassMask ClientClassifier::classify(std::span<const std::uint8_t> data) const
+{
+    if (isEmpty())
+        return 0;
+
+    std::uint64_t hwAddress{};
+    if (!peekHardwareAddress(data, hwAddress))
+        return 0;
+
+    return classify(hwAddress, toStringView(peekOption(data, Option_VendorClass)), peekOption(data, Option_UserClass));
+}
+
+ClientClassMask ClientClassifier::classify(std::uint64_t hwAddress, std::string_view vendorClass,
+                                           std::span<const std::uint8_t> userClass) const
+{
+    ClientClassMask classes{};
+
+    if (!m_ouis.empty())
+    {
+        auto it = m_ouis.find(static_cast<std::uint32_t>(hwAddress >> 24));
+        if (it != m_ouis.end())
+            classes |= it->second;
+    }
+
+    if (!vendorClass.empty())
+    {
+        classes |= lookup(m_vendorClasses, vendorClass);
+
+        for (auto length : m_vendorPrefixLengths)
+        {
+            if (length <= vendorClass.size())
+                classes |= lookup(m_vendorPrefixes, vendorClass.substr(0, length));
+        }
+    }
+
+    if (!userClass.empty())
+        classes |= classifyUserClass(userClass);
+
+    return classes;
+}
+
+ClientClassMask ClientClassifier::lookup(const StringTable& table, std::string_view value) const
+{
+    if (table.empty())
+        return 0;
+
+    auto it = table.find(value);
+    return it != table.end() ? it->second : 0;
+}
+
+ClientClassMask ClientClassifier::classifyUserClass(std::span<const std::uint8_t> userClass) const
+{
+    if (m_userClasses.empty())
+        return 0;
+
+    /* Plenty of clients (ie. Windows) send the user class as a plain string. */
+    auto classes = lookup(m_userClasses, toStringView(userClass));
+
+    /* RFC 3004: A list of length prefixed user classes. */
+    while (userClass.size() >= 2u && userClass.size() >= 1u + userClass.front())
+    {
+        const auto length = userClass.front();
+        classes |= lookup(m_userClasses, toStringView(userClass.subspan(1, length)));
+        userClass = userClass.subspan(1u + length);
+    }
+
+    return classes;
+}
@@ -0,0 +1,59 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include "Configuration.h"
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Decides which client classes a request belongs to, straight from the raw datagram.
+ * The class definitions are compiled up front into lookup tables keyed by OUI, vendor class (option 60) and
+ * user class (option 77), each holding the mask of classes matching it. Classifying a request is then a few
+ * hash lookups, without copying any strings.
+*/
+class ClientClassifier
+{
+public:
+    ClientClassifier() = default;
+
+    explicit ClientClassifier(const std::vector<ClientClassConfiguration>& classes);
+
+    void compile(const std::vector<ClientClassConfiguration>& classes);
+
+    bool isEmpty() const;
+
+    ClientClassMask classify(std::span<const std::uint8_t> data) const;
+
+    ClientClassMask classify(std::uint64_t hwAddress, std::string_view vendorClass, std::span<const std::uint8_t> userClass) const;
+
+private:
+    struct StringHash
+    {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view value) const { return std::hash<std::string_view>{}(value); }
+    };
+
+    using StringTable = std::unordered_map<std::string, ClientClassMask, StringHash, std::equal_to<>>;
+
+    std::unordered_map<std::uint32_t, ClientClassMask> m_ouis;
+    StringTable m_vendorClasses;
+    StringTable m_vendorPrefixes;
+    std::vector<std::size_t> m_vendorPrefixLengths; // One lookup per distinct prefix length.
+    StringTable m_userClasses;
+
+    ClientClassMask lookup(const StringTable& table, std::string_view value) const;
+
+    ClientClassMask classifyUserClass(std::span<const std::uint8_t> userClass) const;
+};
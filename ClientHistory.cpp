@@ -0,0 +1,100 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "ClientHistory.h"
+#include "IpConverter.h"
+
+ClientHistory::ClientHistory(std::uint32_t capacity)
+{
+    setCapacity(capacity);
+}
+
+void ClientHistory::setCapacity(std::uint32_t capacity)
+{
+    /* Rounded up in 64 bits, capacities near the top of the range must not wrap around to 0. */
+    m_setCount = static_cast<std::uint32_t>((std::uint64_t{ capacity } + SetSize - 1) / SetSize);
+    m_entries.assign(std::size_t{ m_setCount } * SetSize, {});
+    m_age = 0;
+}
+
+std::uint32_t ClientHistory::getCapacity() const
+{
+    return static_cast<std::uint32_t>(m_entries.size());
+}
+
+void ClientHistory::remember(std::uint64_t hwAddress, std::uint32_t ipAddress)
+{
+    auto* set = findSet(hwAddress);
+    if (!set || ipAddress == 0)
+        return;
+
+    /* Reuse the entry of this hardware address if it has one, otherwise the oldest (unused entries have age 0). */
+    Entry* entry = &set[0];
+    for (auto i = 0u; i < SetSize; ++i)
+    {
+        if (set[i].ipAddress != 0 && set[i].hwAddress == hwAddress)
+        {
+            entry = &set[i];
+            break;
+        }
+
+        if (set[i].age < entry->age)
+            entry = &set[i];
+    }
+
+    entry->hwAddress = hwAddress;
+    entry->ipAddress = ipAddress;
+    entry->age = ++m_age;
+
+    /* The age would wrap after 4 billion entries, start over rather than evicting the wrong entries. */
+    if (m_age == UINT32_MAX)
+        setCapacity(getCapacity());
+}
+
+std::uint32_t ClientHistory::recall(std::uint64_t hwAddress) const
+{
+    const auto* set = findSet(hwAddress);
+    if (!set)
+        return 0;
+
+    for (auto i = 0u; i < SetSize; ++i)
+    {
+        if (set[i].ipAddress != 0 && set[i].hwAddress == hwAddress)
+            return set[i].ipAddress;
+    }
+
+    return 0;
+}
+
+void ClientHistory::forget(std::uint64_t hwAddress)
+{
+    auto* set = findSet(hwAddress);
+    if (!set)
+        return;
+
+    for (auto i = 0u; i < SetSize; ++i)
+    {
+        if (set[i].ipAddress != 0 && set[i].hwAddress == hwAddress)
+            set[i] = {};
+    }
+}
+
+ClientHistory::Entry* ClientHistory::findSet(std::uint64_t hwAddress)
+{
+    if (m_setCount == 0)
+        return nullptr;
+
+    return m_entries.data() + (hashHardwareAddress(hwAddress) % m_setCount) * SetSize;
+}
+
+const ClientHistory::Entry* ClientHistory::findSet(std::uint64_t hwAddress) const
+{
+    if (m_setCount == 0)
+        return nullptr;
+
+    return m_entries.data() + (hashHardwareAddress(hwAddress) % m_setCount) * SetSize;
+}
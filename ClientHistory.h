@@ -0,0 +1,56 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Remembers which address a hardware address last had, after its lease is gone.
+ *
+ * Entries are stored in a flat array, split into small sets. A hardware address always hashes to the same set,
+ * so lookups only look at a handful of entries. When a set is full the least recently remembered entry in it
+ * is replaced, so the history stays bounded no matter how many clients come and go.
+*/
+class ClientHistory
+{
+public:
+    ClientHistory() = default;
+
+    explicit ClientHistory(std::uint32_t capacity);
+
+    // Rounded up to a whole number of sets. 0 disables the history.
+    void setCapacity(std::uint32_t capacity);
+
+    std::uint32_t getCapacity() const;
+
+    void remember(std::uint64_t hwAddress, std::uint32_t ipAddress);
+
+    // Returns 0 if the hardware address isn't remembered.
+    std::uint32_t recall(std::uint64_t hwAddress) const;
+
+    void forget(std::uint64_t hwAddress);
+
+private:
+    static constexpr std::uint32_t SetSize{ 4 };
+
+    struct Entry
+    {
+        std::uint64_t hwAddress{};
+        std::uint32_t ipAddress{}; // 0 when the entry is unused.
+        std::uint32_t age{};
+    };
+
+    std::vector<Entry> m_entries;
+    std::uint32_t m_setCount{};
+    std::uint32_t m_age{};
+
+    Entry* findSet(std::uint64_t hwAddress);
+
+    const Entry* findSet(std::uint64_t hwAddress) const;
+};
@@ -6,21 +6,37 @@
 */
 
 #include "Configuration.h"
+#include "ConfigurationImage.h"
 #include "IpConverter.h"
+#include "LeaseFile.h"
 #include "Logger.h"
+#include "MappedFile.h"
+#include "ReservationFile.h"
 #include "StaticConfig.h"
 
 #include <cstring>
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <exception>
 #include <fstream>
 #include <string_view>
 
 namespace
 {
-std::string PidFileName;
-std::unordered_map<std::string,NetworkConfiguration> Configs;
-std::string LogFileName;
-Log::Level LogLevel{Log::Level::Info };
+/*
+ * Readers take a reference to the current snapshot and keep using it for as long as they like. A reload builds a
+ * whole new snapshot and swaps it in, the old one is freed when its last reader lets go of it.
+*/
+std::atomic<std::shared_ptr<const ConfigurationSnapshot>> CurrentSnapshot{ std::make_shared<const ConfigurationSnapshot>() };
+std::atomic<std::uint64_t> CurrentGeneration;
+
+void publish(std::shared_ptr<const ConfigurationSnapshot> snapshot)
+{
+    CurrentSnapshot.store(std::move(snapshot));
+    CurrentGeneration.fetch_add(1, std::memory_order_release);
+}
 
 std::vector<std::string> parseParameterList(std::string_view val)
 {
@@ -62,6 +78,36 @@ std::vector<std::string> parseParameterList(std::string_view val)
     return parameterList;
 }
 
+// The whole text must be a number that fits in T, so "-1" is rejected for unsigned types and "10abc" is never 10.
+template<typename T>
+bool parseNumber(std::string_view text, T& number)
+{
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), number);
+    return !text.empty() && ec == std::errc() && ptr == text.data() + text.size();
+}
+
+bool parseSubnet(std::string_view text, Subnet& subnet)
+{
+    // 10.0.0.0/8, or a single address
+
+    const auto slash = text.find('/');
+    if (!parseIpAddress(text.substr(0, slash), subnet.address))
+        return false;
+
+    unsigned prefixLength{ 32 };
+    if (slash != std::string_view::npos)
+    {
+        const auto length = text.substr(slash + 1);
+        auto [ptr, ec] = std::from_chars(length.data(), length.data() + length.size(), prefixLength);
+        if (length.empty() || ec != std::errc() || ptr != length.data() + length.size() || prefixLength > 32)
+            return false;
+    }
+
+    subnet.mask = prefixLength == 0 ? 0 : ~std::uint32_t{} << (32 - prefixLength);
+    subnet.address &= subnet.mask;
+    return true;
+}
+
 bool handleConfig_network(std::string_view val, NetworkConfiguration& config) try
 {
     // network 192.168.200.0/24
@@ -150,6 +196,207 @@ bool handleConfig_dhcp_last(std::string_view val, NetworkConfiguration& config)
     return ok && config.dhcpLast != 0;
 }
 
+bool handleConfig_pool(std::string_view val, NetworkConfiguration& config)
+{
+    // pool guest 192.168.200.100 192.168.200.199
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'pool' specified without value");
+        return false;
+    }
+
+    auto parameterList = parseParameterList(val);
+    if (parameterList.size() != 3 && parameterList.size() != 4)
+    {
+        Log::Critical("Configuration error: Parameter 'pool' must be given a name, first and last address, and optionally a client class");
+        return false;
+    }
+
+    PoolConfiguration pool;
+    pool.name = parameterList[0];
+
+    bool firstOk{};
+    bool lastOk{};
+    pool.first = convertIpAddress(parameterList[1], firstOk);
+    pool.last = convertIpAddress(parameterList[2], lastOk);
+
+    if (!firstOk || !lastOk || pool.first == 0 || pool.first > pool.last)
+    {
+        Log::Critical("Configuration error: Parameter 'pool' {} must have a first address not above the last", pool.name);
+        return false;
+    }
+
+    if (parameterList.size() == 4)
+    {
+        auto it = std::find_if(config.clientClasses.begin(), config.clientClasses.end(),
+                               [&](const auto& clientClass) { return clientClass.name == parameterList[3]; });
+        if (it == config.clientClasses.end())
+        {
+            Log::Critical("Configuration error: Parameter 'pool' {} refers to client class {}, which isn't defined (yet)",
+                          pool.name, parameterList[3]);
+            return false;
+        }
+
+        pool.clientClasses = ClientClassMask{ 1 } << std::distance(config.clientClasses.begin(), it);
+    }
+
+    for (const auto& other : config.pools)
+    {
+        if (other.name == pool.name)
+        {
+            Log::Critical("Configuration error: Parameter 'pool' {} is specified more than once", pool.name);
+            return false;
+        }
+
+        if (pool.first <= other.last && other.first <= pool.last)
+        {
+            Log::Critical("Configuration error: Parameter 'pool' {} overlaps with pool {}", pool.name, other.name);
+            return false;
+        }
+    }
+
+    config.pools.emplace_back(std::move(pool));
+    return true;
+}
+
+bool handleConfig_class(std::string_view val, NetworkConfiguration& config)
+{
+    // class phones oui 00:04:f2 00:1b:54
+    // class pxe vendor PXEClient*
+    // class kiosk user_class kiosk
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'class' specified without value");
+        return false;
+    }
+
+    auto parameterList = parseParameterList(val);
+    if (parameterList.size() < 3)
+    {
+        Log::Critical("Configuration error: Parameter 'class' must be given a name, a match type and at least one value");
+        return false;
+    }
+
+    const auto& name = parameterList[0];
+    const auto& type = parameterList[1];
+
+    auto it = std::find_if(config.clientClasses.begin(), config.clientClasses.end(),
+                           [&](const auto& clientClass) { return clientClass.name == name; });
+    if (it == config.clientClasses.end())
+    {
+        if (config.clientClasses.size() == MaxClientClasses)
+        {
+            Log::Critical("Configuration error: Parameter 'class' can't define more than {} classes", MaxClientClasses);
+            return false;
+        }
+
+        it = config.clientClasses.emplace(config.clientClasses.end());
+        it->name = name;
+    }
+
+    for (auto value = parameterList.begin() + 2; value != parameterList.end(); ++value)
+    {
+        if (type == "oui")
+        {
+            /* Parsed as a full hardware address with the last three bytes zeroed. */
+            bool ok{};
+            const auto hwAddress = convertHardwareAddress(*value + ":00:00:00", ok);
+            if (!ok)
+            {
+                Log::Critical("Configuration error: Parameter 'class' {} has an invalid OUI: {}", name, *value);
+                return false;
+            }
+            it->ouis.emplace_back(static_cast<std::uint32_t>(hwAddress >> 24));
+        }
+        else if (type == "vendor")
+            it->vendorClasses.emplace_back(*value);
+        else if (type == "user_class")
+            it->userClasses.emplace_back(*value);
+        else
+        {
+            Log::Critical("Configuration error: Parameter 'class' match type must be either oui, vendor or user_class");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool handleConfig_boot(std::string_view val, NetworkConfiguration& config)
+{
+    // boot pxe 192.168.200.2 pxelinux.0 tftp.example.com
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'boot' specified without value");
+        return false;
+    }
+
+    auto parameterList = parseParameterList(val);
+    if (parameterList.size() != 3 && parameterList.size() != 4)
+    {
+        Log::Critical("Configuration error: Parameter 'boot' must be given a client class, next server and boot file, and optionally a server name");
+        return false;
+    }
+
+    auto it = std::find_if(config.clientClasses.begin(), config.clientClasses.end(),
+                           [&](const auto& clientClass) { return clientClass.name == parameterList[0]; });
+    if (it == config.clientClasses.end())
+    {
+        Log::Critical("Configuration error: Parameter 'boot' refers to client class {}, which isn't defined (yet)", parameterList[0]);
+        return false;
+    }
+
+    bool ok{};
+    it->nextServer = convertIpAddress(parameterList[1], ok);
+    if (!ok)
+        return false;
+
+    it->bootFile = parameterList[2];
+    if (it->bootFile.size() > NetworkDefaults::maximumBootFileLength)
+    {
+        Log::Critical("Configuration error: Parameter 'boot' boot file can be at most {} characters", NetworkDefaults::maximumBootFileLength);
+        return false;
+    }
+
+    if (parameterList.size() == 4)
+    {
+        it->serverName = parameterList[3];
+        if (it->serverName.size() > NetworkDefaults::maximumServerNameLength)
+        {
+            Log::Critical("Configuration error: Parameter 'boot' server name can be at most {} characters", NetworkDefaults::maximumServerNameLength);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool handleConfig_pool_selection(std::string_view val, NetworkConfiguration& config)
+{
+    // pool_selection least_used
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'pool_selection' specified without value");
+        return false;
+    }
+
+    if (val == "ordered")
+        config.poolSelection = PoolSelection::Ordered;
+    else if (val == "least_used")
+        config.poolSelection = PoolSelection::LeastUsed;
+    else
+    {
+        Log::Critical("Configuration error: Parameter 'pool_selection' must be either ordered or least_used");
+        return false;
+    }
+
+    return true;
+}
+
 bool handleConfig_dns_servers(std::string_view val, NetworkConfiguration& config)
 {
     // dns_servers serverip1 serverip2
@@ -185,8 +432,13 @@ bool handleConfig_lease_time(std::string_view val, NetworkConfiguration& config)
         return false;
     }
 
-    config.leaseTime = std::stoi(std::string(val));
-    return config.leaseTime > 0;
+    if (!parseNumber(val, config.leaseTime) || config.leaseTime == 0)
+    {
+        Log::Critical("Configuration error: Parameter 'lease_time' must be a time in seconds, above 0");
+        return false;
+    }
+
+    return true;
 }
 
 bool handleConfig_renewal_time(std::string_view val, NetworkConfiguration& config)
@@ -199,8 +451,13 @@ bool handleConfig_renewal_time(std::string_view val, NetworkConfiguration& confi
         return false;
     }
 
-    config.renewalTime = std::stoi(std::string(val));
-    return config.renewalTime > 0;
+    if (!parseNumber(val, config.renewalTime) || config.renewalTime == 0)
+    {
+        Log::Critical("Configuration error: Parameter 'renewal_time' must be a time in seconds, above 0");
+        return false;
+    }
+
+    return true;
 }
 
 bool handleConfig_rebinding_time(std::string_view val, NetworkConfiguration& config)
@@ -213,8 +470,77 @@ bool handleConfig_rebinding_time(std::string_view val, NetworkConfiguration& con
         return false;
     }
 
-    config.rebindingTime = std::stoi(std::string(val));
-    return config.rebindingTime > 0;
+    if (!parseNumber(val, config.rebindingTime) || config.rebindingTime == 0)
+    {
+        Log::Critical("Configuration error: Parameter 'rebinding_time' must be a time in seconds, above 0");
+        return false;
+    }
+
+    return true;
+}
+
+bool handleConfig_lease_jitter(std::string_view val, NetworkConfiguration& config)
+{
+    // lease_jitter 10
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'lease_jitter' specified without value");
+        return false;
+    }
+
+    unsigned jitter{};
+    if (!parseNumber(val, jitter) || jitter > 50)
+    {
+        Log::Critical("Configuration error: Parameter 'lease_jitter' must be between 0 and 50 (percent)");
+        return false;
+    }
+
+    config.leaseJitter = static_cast<std::uint8_t>(jitter);
+    return true;
+}
+
+bool handleConfig_adaptive_lease_time(std::string_view val, NetworkConfiguration& config)
+{
+    // adaptive_lease_time 600 86400 25 75
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'adaptive_lease_time' specified without value");
+        return false;
+    }
+
+    auto parameterList = parseParameterList(val);
+    if (parameterList.size() != 2 && parameterList.size() != 4)
+    {
+        Log::Critical("Configuration error: Parameter 'adaptive_lease_time' must be given a minimum and maximum lease time, and optionally low and high utilization watermarks");
+        return false;
+    }
+
+    if (!parseNumber(parameterList[0], config.minimumLeaseTime) || !parseNumber(parameterList[1], config.maximumLeaseTime)
+        || config.minimumLeaseTime == 0 || config.minimumLeaseTime > config.maximumLeaseTime)
+    {
+        Log::Critical("Configuration error: Parameter 'adaptive_lease_time' minimum must be above 0 and not above maximum");
+        return false;
+    }
+
+    if (parameterList.size() == 4)
+    {
+        /* Checked before narrowing, 300 must not wrap around to 44. */
+        unsigned lowWatermark{};
+        unsigned highWatermark{};
+        if (!parseNumber(parameterList[2], lowWatermark) || !parseNumber(parameterList[3], highWatermark)
+            || lowWatermark >= highWatermark || highWatermark > 100)
+        {
+            Log::Critical("Configuration error: Parameter 'adaptive_lease_time' low watermark must be below high watermark, which can be at most 100");
+            return false;
+        }
+
+        config.utilizationLowWatermark = static_cast<std::uint8_t>(lowWatermark);
+        config.utilizationHighWatermark = static_cast<std::uint8_t>(highWatermark);
+    }
+
+    return true;
 }
 
 bool handleConfig_lease_file(std::string_view val, NetworkConfiguration& config)
@@ -231,40 +557,357 @@ bool handleConfig_lease_file(std::string_view val, NetworkConfiguration& config)
     return !config.leaseFile.empty();
 }
 
-bool handleConfig_reserve(std::string_view val, NetworkConfiguration& config)
+bool parseHostOption(std::string_view option, HostOptions& hostOptions)
+{
+    // hostname=printer  router=192.168.200.2  dns_servers=1.1.1.1,8.8.8.8  domain=example.com  lease_time=86400
+
+    auto separator = option.find('=');
+    if (separator == std::string_view::npos || separator + 1 == option.size())
+    {
+        Log::Critical("Configuration error: Parameter 'reserve' option {} must be given as name=value", option);
+        return false;
+    }
+
+    const auto name = option.substr(0, separator);
+    const auto value = option.substr(separator + 1);
+
+    auto encode = [&hostOptions](BOOTPOptionKey key, BOOTPOption&& bootpOption)
+    {
+        hostOptions.encodedOptions.emplace_back(key);
+        auto data = bootpOption.serialize();
+        hostOptions.encodedOptions.insert(hostOptions.encodedOptions.end(), data.begin(), data.end());
+    };
+
+    auto parseIpList = [&](std::vector<std::uint32_t>& ipList)
+    {
+        for (auto list = value; !list.empty();)
+        {
+            const auto end = list.find(',');
+            bool ok{};
+            ipList.emplace_back(convertIpAddress(list.substr(0, end), ok));
+            if (!ok)
+                return false;
+            list = end == std::string_view::npos ? std::string_view{} : list.substr(end + 1);
+        }
+        return !ipList.empty() && ipList.size() <= 63;
+    };
+
+    if (name == "hostname" || name == "domain")
+    {
+        if (value.size() > 255)
+        {
+            Log::Critical("Configuration error: Parameter 'reserve' option {} can be at most 255 characters", name);
+            return false;
+        }
+        encode(name == "hostname" ? Option_HostName : Option_DomainName, RawBOOTPOption(value));
+    }
+    else if (name == "router" || name == "dns_servers")
+    {
+        std::vector<std::uint32_t> ipList;
+        if (!parseIpList(ipList))
+        {
+            Log::Critical("Configuration error: Parameter 'reserve' option {} must be a comma separated list of IP addresses", name);
+            return false;
+        }
+        encode(name == "router" ? Option_Router : Option_DomainNameServer, IpListBOOTPOption(std::move(ipList)));
+    }
+    else if (name == "lease_time")
+    {
+        /* A wrapped around -1 would become the interface's maximum lease time, and keep loaded leases forever. */
+        if (!parseNumber(value, hostOptions.leaseTime) || hostOptions.leaseTime == 0)
+        {
+            Log::Critical("Configuration error: Parameter 'reserve' option lease_time must be a time in seconds, above 0");
+            return false;
+        }
+    }
+    else
+    {
+        Log::Critical("Configuration error: Parameter 'reserve' has unknown option {}", name);
+        return false;
+    }
+
+    return true;
+}
+
+bool handleConfig_reserve(std::string_view val, NetworkConfiguration& config)
+{
+    // reserve 11:22:33:44:55:66 192.168.200.123 [hostname=printer router=192.168.200.2 ...]
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'reserve' specified without value");
+        return false;
+    }
+
+    auto parameterList = parseParameterList(val);
+    if (parameterList.size() < 2)
+    {
+        Log::Critical("Configuration error: Parameter 'reserve' specified with too few values");
+        return false;
+    }
+
+    const auto& hwaddrStr = parameterList[0];
+    const auto& ipaddrStr = parameterList[1];
+
+    bool hwok{};
+    bool ipok{};
+
+    auto hwaddr = convertHardwareAddress(hwaddrStr, hwok);
+    auto ipaddr = convertIpAddress(ipaddrStr, ipok);
+
+    if (!hwok || !ipok)
+        return false;
+
+    config.reservations[hwaddr] = ipaddr;
+
+    if (parameterList.size() > 2)
+    {
+        HostOptions hostOptions;
+        for (auto option = parameterList.begin() + 2; option != parameterList.end(); ++option)
+        {
+            if (!parseHostOption(*option, hostOptions))
+                return false;
+        }
+
+        config.hostOptions[hwaddr] = std::move(hostOptions);
+    }
+    else
+    {
+        config.hostOptions.erase(hwaddr);
+    }
+
+    return true;
+}
+
+bool handleConfig_reservations_file(std::string_view val, NetworkConfiguration& config)
+{
+    // reservations_file /etc/tdhcpd/eth0.reservations
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'reservations_file' specified without value");
+        return false;
+    }
+
+    return ReservationFile::Load(std::string(val), config.reservations);
+}
+
+bool handleConfig_history_size(std::string_view val, NetworkConfiguration& config)
+{
+    // history_size 1024
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'history_size' specified without value");
+        return false;
+    }
+
+    if (!parseNumber(val, config.historySize) || config.historySize > NetworkDefaults::maximumHistorySize)
+    {
+        Log::Critical("Configuration error: Parameter 'history_size' must be between 0 and {} clients", NetworkDefaults::maximumHistorySize);
+        return false;
+    }
+
+    return true;
+}
+
+bool handleConfig_allocation(std::string_view val, NetworkConfiguration& config)
+{
+    // allocation hash
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'allocation' specified without value");
+        return false;
+    }
+
+    if (val == "first_fit")
+        config.allocationPolicy = AllocationPolicy::FirstFit;
+    else if (val == "hash")
+        config.allocationPolicy = AllocationPolicy::Hash;
+    else
+    {
+        Log::Critical("Configuration error: Parameter 'allocation' must be either first_fit or hash");
+        return false;
+    }
+
+    return true;
+}
+
+bool handleConfig_decline_quarantine(std::string_view val, NetworkConfiguration& config)
+{
+    // decline_quarantine 3600
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'decline_quarantine' specified without value");
+        return false;
+    }
+
+    if (!parseNumber(val, config.quarantineTime))
+    {
+        Log::Critical("Configuration error: Parameter 'decline_quarantine' must be a time in seconds, 0 or more");
+        return false;
+    }
+
+    return true;
+}
+
+bool handleConfig_conflict_probe(std::string_view val, NetworkConfiguration& config)
+{
+    // conflict_probe 500 300
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'conflict_probe' specified without value");
+        return false;
+    }
+
+    auto parameterList = parseParameterList(val);
+    if (parameterList.size() > 2)
+    {
+        Log::Critical("Configuration error: Parameter 'conflict_probe' specified with too many values");
+        return false;
+    }
+
+    std::uint32_t timeout{};
+    if (!parseNumber(parameterList[0], timeout) || timeout == 0 || timeout > 10000)
+    {
+        Log::Critical("Configuration error: Parameter 'conflict_probe' timeout must be between 1 and 10000 milliseconds");
+        return false;
+    }
+
+    config.conflictProbeTimeout = timeout;
+
+    if (parameterList.size() == 2)
+    {
+        std::uint32_t cacheTime{};
+        if (!parseNumber(parameterList[1], cacheTime) || cacheTime == 0)
+        {
+            Log::Critical("Configuration error: Parameter 'conflict_probe' cache time must be a number of seconds above 0");
+            return false;
+        }
+
+        config.conflictProbeCacheTime = cacheTime;
+    }
+
+    return true;
+}
+
+bool handleConfig_rate_limit(std::string_view key, std::string_view val, std::uint32_t& rate, std::uint32_t& burst)
+{
+    // rate_limit_client 5 10
+    // rate_limit_interface 200 400
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter '{}' specified without value", key);
+        return false;
+    }
+
+    auto parameterList = parseParameterList(val);
+    if (parameterList.size() > 2)
+    {
+        Log::Critical("Configuration error: Parameter '{}' specified with too many values", key);
+        return false;
+    }
+
+    std::uint32_t parsedRate{};
+    if (!parseNumber(parameterList[0], parsedRate) || parsedRate == 0 || parsedRate > NetworkDefaults::maximumRateLimit)
+    {
+        Log::Critical("Configuration error: Parameter '{}' rate must be between 1 and {} requests per second", key, NetworkDefaults::maximumRateLimit);
+        return false;
+    }
+
+    /* Default burst is two seconds worth of requests, which fits as the rate is bounded. */
+    std::uint32_t parsedBurst{ parsedRate * 2 };
+    if (parameterList.size() == 2
+        && (!parseNumber(parameterList[1], parsedBurst) || parsedBurst == 0 || parsedBurst > NetworkDefaults::maximumRateLimit * 2))
+    {
+        Log::Critical("Configuration error: Parameter '{}' burst size must be between 1 and {} requests", key, NetworkDefaults::maximumRateLimit * 2);
+        return false;
+    }
+
+    rate = parsedRate;
+    burst = parsedBurst;
+    return true;
+}
+
+bool handleConfig_rate_limit_table_size(std::string_view val, NetworkConfiguration& config)
+{
+    // rate_limit_table_size 4096
+
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'rate_limit_table_size' specified without value");
+        return false;
+    }
+
+    std::uint32_t tableSize{};
+    if (!parseNumber(val, tableSize) || tableSize == 0 || tableSize > NetworkDefaults::maximumRateLimitTableSize)
+    {
+        Log::Critical("Configuration error: Parameter 'rate_limit_table_size' must be between 1 and {}", NetworkDefaults::maximumRateLimitTableSize);
+        return false;
+    }
+
+    config.rateLimitTableSize = tableSize;
+    return true;
+}
+
+bool handleConfig_load_balance(std::string_view val, NetworkConfiguration& config)
 {
-    // reserve 11:22:33:44:55:66 192.168.200.123
+    // load_balance 1/2
 
     if (val.empty())
     {
-        Log::Critical("Configuration error: Parameter 'reserve' specified without value");
+        Log::Critical("Configuration error: Parameter 'load_balance' specified without value");
         return false;
     }
 
-    auto parameterList = parseParameterList(val);
-    if (parameterList.size() != 2)
+    const auto slash = val.find('/');
+    std::uint8_t server{};
+    std::uint8_t servers{};
+    if (slash == std::string_view::npos || !parseNumber(val.substr(0, slash), server) || !parseNumber(val.substr(slash + 1), servers))
     {
-        Log::Critical("Configuration error: Parameter 'reserve' specified with too few values");
+        Log::Critical("Configuration error: Parameter 'load_balance' must be given as <server>/<servers>, ie. 1/2");
         return false;
     }
 
-    const auto& hwaddrStr = parameterList[0];
-    const auto& ipaddrStr = parameterList[1];
+    if (servers < 1 || server < 1 || server > servers)
+    {
+        Log::Critical("Configuration error: Parameter 'load_balance' must be between 1/1 and 255/255, with the server not above the number of servers");
+        return false;
+    }
 
-    bool hwok{};
-    bool ipok{};
+    config.loadBalanceServer = static_cast<std::uint8_t>(server - 1);
+    config.loadBalanceServers = servers;
+    return true;
+}
 
-    auto hwaddr = convertHardwareAddress(hwaddrStr, hwok);
-    auto ipaddr = convertIpAddress(ipaddrStr, ipok);
+bool handleConfig_load_balance_threshold(std::string_view val, NetworkConfiguration& config)
+{
+    // load_balance_threshold 3
 
-    if (!hwok || !ipok)
+    if (val.empty())
+    {
+        Log::Critical("Configuration error: Parameter 'load_balance_threshold' specified without value");
         return false;
+    }
+
+    if (!parseNumber(val, config.loadBalanceThreshold))
+    {
+        Log::Critical("Configuration error: Parameter 'load_balance_threshold' must be between 0 and 65535 seconds");
+        return false;
+    }
 
-    config.reservations[hwaddr] = ipaddr;
     return true;
 }
 
-bool handleConfigEntry(std::string_view key, std::string_view val, NetworkConfiguration& config)
+/*
+ * Also used when reloading a running server, where an exception escaping a handler would take the whole server down
+ * instead of only failing the reload.
+*/
+bool handleConfigEntry(std::string_view key, std::string_view val, NetworkConfiguration& config) try
 {
     if (key == "network")
         return handleConfig_network(val, config);
@@ -281,6 +924,18 @@ bool handleConfigEntry(std::string_view key, std::string_view val, NetworkConfig
     else if (key == "dhcp_last")
         return handleConfig_dhcp_last(val, config);
 
+    else if (key == "pool")
+        return handleConfig_pool(val, config);
+
+    else if (key == "pool_selection")
+        return handleConfig_pool_selection(val, config);
+
+    else if (key == "class")
+        return handleConfig_class(val, config);
+
+    else if (key == "boot")
+        return handleConfig_boot(val, config);
+
     else if (key == "dns_servers")
         return handleConfig_dns_servers(val, config);
 
@@ -293,17 +948,58 @@ bool handleConfigEntry(std::string_view key, std::string_view val, NetworkConfig
     else if (key == "rebinding_time")
         return handleConfig_rebinding_time(val, config);
 
+    else if (key == "lease_jitter")
+        return handleConfig_lease_jitter(val, config);
+
+    else if (key == "adaptive_lease_time")
+        return handleConfig_adaptive_lease_time(val, config);
+
     else if (key == "lease_file")
         return handleConfig_lease_file(val, config);
 
     else if (key == "reserve")
         return handleConfig_reserve(val, config);
 
+    else if (key == "reservations_file")
+        return handleConfig_reservations_file(val, config);
+
+    else if (key == "history_size")
+        return handleConfig_history_size(val, config);
+
+    else if (key == "allocation")
+        return handleConfig_allocation(val, config);
+
+    else if (key == "decline_quarantine")
+        return handleConfig_decline_quarantine(val, config);
+
+    else if (key == "conflict_probe")
+        return handleConfig_conflict_probe(val, config);
+
+    else if (key == "rate_limit_client")
+        return handleConfig_rate_limit(key, val, config.clientRateLimit, config.clientRateBurst);
+
+    else if (key == "rate_limit_interface")
+        return handleConfig_rate_limit(key, val, config.interfaceRateLimit, config.interfaceRateBurst);
+
+    else if (key == "rate_limit_table_size")
+        return handleConfig_rate_limit_table_size(val, config);
+
+    else if (key == "load_balance")
+        return handleConfig_load_balance(val, config);
+
+    else if (key == "load_balance_threshold")
+        return handleConfig_load_balance_threshold(val, config);
+
     Log::Critical("Configuration error: Unknown config key {}", key);
     return false;
 }
+catch (const std::exception& e)
+{
+    Log::Critical("Configuration error: Parameter '{}' has an invalid value '{}' ({})", key, val, e.what());
+    return false;
+}
 
-bool loadFromFileImpl(const std::string& path, NetworkConfiguration* current)
+bool loadFromFileImpl(const std::string& path, ConfigurationSnapshot& snapshot, NetworkConfiguration* current)
 {
     auto stripCommentAndWhitespace = [](std::string_view input) -> std::string_view
     {
@@ -386,7 +1082,7 @@ bool loadFromFileImpl(const std::string& path, NetworkConfiguration* current)
                 return false;
             }
 
-            if (!loadFromFileImpl(std::string(val), current))
+            if (!loadFromFileImpl(std::string(val), snapshot, current))
                 return false; // Errors are already logged.
 
             continue;
@@ -399,7 +1095,7 @@ bool loadFromFileImpl(const std::string& path, NetworkConfiguration* current)
                 return false;
             }
 
-            current = &(Configs[std::string(val)]);
+            current = &(snapshot.networks[std::string(val)]);
             continue;
         }
         else if (key == "pidfile")
@@ -410,7 +1106,7 @@ bool loadFromFileImpl(const std::string& path, NetworkConfiguration* current)
                 return false;
             }
 
-            PidFileName = val;
+            snapshot.pidFileName = val;
             continue;
         }
         else if (key == "logfile")
@@ -421,7 +1117,151 @@ bool loadFromFileImpl(const std::string& path, NetworkConfiguration* current)
                 return false;
             }
 
-            LogFileName = val;
+            snapshot.logFileName = val;
+            continue;
+        }
+        else if (key == "statsfile")
+        {
+            if (val.empty())
+            {
+                Log::Critical("Configuration error: Parameter 'statsfile' specified without value");
+                return false;
+            }
+
+            snapshot.statisticsFileName = val;
+            continue;
+        }
+        else if (key == "live_leases")
+        {
+            unsigned interval{};
+            auto [ptr, ec] = std::from_chars(val.data(), val.data() + val.size(), interval);
+            if (val.empty() || ec != std::errc() || ptr != val.data() + val.size() || interval == 0)
+            {
+                Log::Critical("Configuration error: Parameter 'live_leases' must be given an interval in milliseconds");
+                return false;
+            }
+
+            snapshot.liveLeaseInterval = interval;
+            continue;
+        }
+        else if (key == "failover")
+        {
+            if (val == "primary")
+                snapshot.failoverRole = FailoverRole::Primary;
+            else if (val == "standby")
+                snapshot.failoverRole = FailoverRole::Standby;
+            else
+            {
+                Log::Critical("Configuration error: Parameter 'failover' must be either primary or standby");
+                return false;
+            }
+
+            continue;
+        }
+        else if (key == "failover_address")
+        {
+            if (!parseIpAddress(val, snapshot.failoverAddress))
+            {
+                Log::Critical("Configuration error: Parameter 'failover_address' must be an IPv4 address");
+                return false;
+            }
+
+            continue;
+        }
+        else if (key == "failover_peer")
+        {
+            if (!parseIpAddress(val, snapshot.failoverPeer))
+            {
+                Log::Critical("Configuration error: Parameter 'failover_peer' must be an IPv4 address");
+                return false;
+            }
+
+            continue;
+        }
+        else if (key == "failover_port")
+        {
+            auto [ptr, ec] = std::from_chars(val.data(), val.data() + val.size(), snapshot.failoverPort);
+            if (val.empty() || ec != std::errc() || ptr != val.data() + val.size() || snapshot.failoverPort == 0)
+            {
+                Log::Critical("Configuration error: Parameter 'failover_port' must be a port number");
+                return false;
+            }
+
+            continue;
+        }
+        else if (key == "failover_timeout")
+        {
+            auto [ptr, ec] = std::from_chars(val.data(), val.data() + val.size(), snapshot.failoverTimeout);
+            if (val.empty() || ec != std::errc() || ptr != val.data() + val.size() || snapshot.failoverTimeout < FailoverDefaults::minimumTimeout)
+            {
+                Log::Critical("Configuration error: Parameter 'failover_timeout' must be given a time in milliseconds, at least {}", FailoverDefaults::minimumTimeout);
+                return false;
+            }
+
+            continue;
+        }
+        else if (key == "bulk_leasequery")
+        {
+            if (!parseIpAddress(val, snapshot.bulkLeasequeryAddress))
+            {
+                Log::Critical("Configuration error: Parameter 'bulk_leasequery' must be an IPv4 address, or 0.0.0.0 for all");
+                return false;
+            }
+
+            snapshot.bulkLeasequery = true;
+            continue;
+        }
+        else if (key == "bulk_leasequery_port")
+        {
+            auto [ptr, ec] = std::from_chars(val.data(), val.data() + val.size(), snapshot.bulkLeasequeryPort);
+            if (val.empty() || ec != std::errc() || ptr != val.data() + val.size() || snapshot.bulkLeasequeryPort == 0)
+            {
+                Log::Critical("Configuration error: Parameter 'bulk_leasequery_port' must be a port number");
+                return false;
+            }
+
+            continue;
+        }
+        else if (key == "bulk_leasequery_allow")
+        {
+            const auto parameterList = parseParameterList(val);
+            if (parameterList.empty())
+            {
+                Log::Critical("Configuration error: Parameter 'bulk_leasequery_allow' specified without value");
+                return false;
+            }
+
+            for (const auto& parameter : parameterList)
+            {
+                if (!parseSubnet(parameter, snapshot.bulkLeasequeryAllowed.emplace_back()))
+                {
+                    Log::Critical("Configuration error: Parameter 'bulk_leasequery_allow' must be given addresses or networks in CIDR, not {}", parameter);
+                    return false;
+                }
+            }
+
+            continue;
+        }
+        else if (key == "lease_events")
+        {
+            if (val.empty())
+            {
+                Log::Critical("Configuration error: Parameter 'lease_events' specified without value");
+                return false;
+            }
+
+            snapshot.leaseEventSocket = val;
+            continue;
+        }
+        else if (key == "lease_events_buffer")
+        {
+            auto [ptr, ec] = std::from_chars(val.data(), val.data() + val.size(), snapshot.leaseEventBuffer);
+            if (val.empty() || ec != std::errc() || ptr != val.data() + val.size() || snapshot.leaseEventBuffer == 0)
+            {
+                Log::Critical("Configuration error: Parameter 'lease_events_buffer' must be given a size in KiB");
+                return false;
+            }
+
             continue;
         }
         else if (key == "loglevel")
@@ -432,7 +1272,7 @@ bool loadFromFileImpl(const std::string& path, NetworkConfiguration* current)
                 return false;
             }
 
-            LogLevel = Log::ToLogLevel(val);
+            snapshot.logLevel = Log::ToLogLevel(val);
             continue;
         }
 
@@ -440,18 +1280,18 @@ bool loadFromFileImpl(const std::string& path, NetworkConfiguration* current)
         {
             // log error that "interface" is not yet specified.
             Log::Critical("Configuration error: 'interface' not defined before reading {}", key);
-            Configs.clear();
+            snapshot.networks.clear();
             break;
         }
 
         if (!handleConfigEntry(key, val, *current))
         {
-            Configs.clear();
+            snapshot.networks.clear();
             break;
         }
     }
 
-    if (Configs.empty())
+    if (snapshot.networks.empty())
     {
         Log::Critical("Error while reading configuration!");
         return false;
@@ -460,7 +1300,7 @@ bool loadFromFileImpl(const std::string& path, NetworkConfiguration* current)
     /*
      * Handle optional parameters (except "reserve")
     */
-    for (auto& [interface, config] : Configs)
+    for (auto& [interface, config] : snapshot.networks)
     {
         if (config.renewalTime == NetworkDefaults::renewalTime)
             config.renewalTime = static_cast<std::uint32_t>(config.leaseTime * 0.5);
@@ -484,129 +1324,258 @@ bool loadFromFileImpl(const std::string& path, NetworkConfiguration* current)
     return true;
 }
 
-} // Anonymous ns
-
-bool Configuration::LoadFromFile(const std::string& path)
+bool validateNetwork(const std::string& interface, const NetworkConfiguration& config)
 {
-    return loadFromFileImpl(path, nullptr);
-}
+    if (config.networkSize > 32)
+    {
+        Log::Critical("Configuration error: Network prefix length {} is above 32 for interface {}", config.networkSize, interface);
+        return false;
+    }
 
-std::vector<std::string> Configuration::GetConfiguredInterfaces()
-{
-    std::vector<std::string> interfaces;
-    interfaces.reserve(Configs.size());
+    const auto netmask = config.networkSize == 0 ? 0u : ~0u << (32 - config.networkSize);
+    const auto network = config.networkSpace & netmask;
+    const auto broadcast = network | ~netmask;
 
-    for (const auto& [interface, config] : Configs)
+    auto isHostAddress = [&](std::uint32_t address)
     {
-        interfaces.emplace_back(interface);
+        return (address & netmask) == network && address != network && address != broadcast;
+    };
+
+    bool ok = true;
+
+    auto checkRange = [&](std::string_view name, std::uint32_t first, std::uint32_t last)
+    {
+        if (first > last)
+        {
+            Log::Critical("Configuration error: {} on interface {} ends before it starts", name, interface);
+            ok = false;
+        }
+
+        if (!isHostAddress(first) || !isHostAddress(last))
+        {
+            Log::Critical("Configuration error: {} {} - {} is not within the network {}/{} of interface {}",
+                          name, formatIpAddress(first), formatIpAddress(last), formatIpAddress(network), config.networkSize, interface);
+            ok = false;
+        }
+    };
+
+    /* Pools overlapping each other are refused when they're read. */
+    if (config.pools.empty())
+        checkRange("DHCP range", config.dhcpFirst, config.dhcpLast);
+
+    for (const auto& pool : config.pools)
+        checkRange(std::format("Pool {}", pool.name), pool.first, pool.last);
+
+    std::unordered_map<std::uint32_t, std::uint64_t> reservedBy;
+    reservedBy.reserve(config.reservations.size());
+
+    for (const auto& [hwAddress, ipAddress] : config.reservations)
+    {
+        if (!isHostAddress(ipAddress))
+        {
+            Log::Critical("Configuration error: Reservation of {} for {} is not within the network of interface {}",
+                          formatIpAddress(ipAddress), formatHardwareAddress(hwAddress), interface);
+            ok = false;
+        }
+
+        auto [it, inserted] = reservedBy.emplace(ipAddress, hwAddress);
+        if (!inserted)
+        {
+            Log::Critical("Configuration error: {} is reserved for both {} and {} on interface {}",
+                          formatIpAddress(ipAddress), formatHardwareAddress(it->second), formatHardwareAddress(hwAddress), interface);
+            ok = false;
+        }
     }
 
-    return interfaces;
-}
+    if (config.renewalTime >= config.rebindingTime || config.rebindingTime >= config.leaseTime)
+    {
+        Log::Critical("Configuration error: Interface {} must have renewal_time < rebinding_time < lease_time", interface);
+        ok = false;
+    }
 
-NetworkConfiguration Configuration::GetNetworkConfiguration(const std::string& interface)
-{
-    return Configs[interface];
+    /* The parser already refuses these, but a compiled configuration only passes through here. */
+    for (const auto& clientClass : config.clientClasses)
+    {
+        if (clientClass.bootFile.size() > NetworkDefaults::maximumBootFileLength
+            || clientClass.serverName.size() > NetworkDefaults::maximumServerNameLength)
+        {
+            Log::Critical("Configuration error: Boot file or server name of client class {} on interface {} is too long", clientClass.name, interface);
+            ok = false;
+        }
+    }
+
+    if (config.historySize > NetworkDefaults::maximumHistorySize || config.rateLimitTableSize > NetworkDefaults::maximumRateLimitTableSize)
+    {
+        Log::Critical("Configuration error: history_size or rate_limit_table_size on interface {} is too large", interface);
+        ok = false;
+    }
+
+    if (config.routers != 0 && !isHostAddress(config.routers))
+        Log::Warning("Router {} is not within the network of interface {}", formatIpAddress(config.routers), interface);
+
+    return ok;
 }
 
-std::vector<Lease> Configuration::GetPersistentLeasesByInterface(const std::string& interface)
+} // Anonymous ns
+
+bool Configuration::LoadFromFile(const std::string& path)
 {
-    const auto& filename = Configs[interface].leaseFile;
-    if (filename.empty())
-        return {};
+    auto snapshot = std::make_shared<ConfigurationSnapshot>();
+
+    {
+        MappedFile file(path);
+        if (ConfigurationImage::IsImage(file.getData()))
+        {
+            /* Validated again, as the image may have been compiled by another version or edited since. */
+            if (!ConfigurationImage::Decode(file.getData(), *snapshot) || !Validate(*snapshot))
+                return false;
+
+            Log::Info("Loaded compiled configuration {} with {} interfaces", path, snapshot->networks.size());
+            publish(std::move(snapshot));
+            return true;
+        }
+    }
+
+    if (!loadFromFileImpl(path, *snapshot, nullptr) || !Validate(*snapshot))
+        return false;
 
-    return GetPersistentLeasesByFile(filename);
+    publish(std::move(snapshot));
+    return true;
 }
 
-std::vector<Lease> Configuration::GetPersistentLeasesByFile(const std::string& filename)
+bool Configuration::Validate(const ConfigurationSnapshot& snapshot)
 {
-    std::ifstream ifs(filename, std::ios::in | std::ios::binary);
-    if (!ifs.is_open())
-        return {};
+    if (snapshot.networks.empty())
+    {
+        Log::Critical("Configuration error: No interfaces configured");
+        return false;
+    }
 
-    char buffer[1024]{};
-    std::vector<std::uint8_t> data;
+    bool ok = true;
+    for (const auto& [interface, config] : snapshot.networks)
+        ok = validateNetwork(interface, config) && ok;
 
-    while (ifs.good() && !ifs.eof())
+    if (snapshot.failoverRole != FailoverRole::None && snapshot.failoverAddress == 0)
     {
-        ifs.read(buffer, sizeof(buffer));
-        auto readCount = ifs.gcount();
-
-        if (readCount > 0)
-            data.insert(data.end(), buffer, buffer + readCount);
+        Log::Critical("Configuration error: Parameter 'failover' needs 'failover_address'");
+        ok = false;
     }
 
-    std::vector<Lease> leases;
-    leases.reserve(16);
+    if (snapshot.failoverRole == FailoverRole::Standby && snapshot.failoverPeer == 0)
+    {
+        Log::Critical("Configuration error: Parameter 'failover standby' needs 'failover_peer'");
+        ok = false;
+    }
 
-    auto readLease = [&data](int index, Lease& lease)
+    if (snapshot.bulkLeasequery && snapshot.bulkLeasequeryAllowed.empty())
     {
-        const auto offset = index * LeaseLen;
-        if (offset + LeaseLen - 1 > data.size())
-            return false; // EOF
+        Log::Critical("Configuration error: Parameter 'bulk_leasequery' needs 'bulk_leasequery_allow'");
+        ok = false;
+    }
 
-        memcpy(&lease.startTime, data.data() + offset, StartTimeLen);
-        memcpy(&lease.hwAddress, data.data() + offset + StartTimeLen, HwAddressLen);
-        memcpy(&lease.ipAddress, data.data() + offset + StartTimeLen + HwAddressLen, IpAddressLen);
+    return ok;
+}
 
-        return true; // More to read
-    };
+bool Configuration::SaveCompiled(const std::string& path)
+{
+    const auto data = ConfigurationImage::Encode(*GetSnapshot());
 
-    bool readNextLease = true;
-    int index = 0;
-    while (readNextLease)
+    std::ofstream ofs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open())
     {
-        auto& lease = leases.emplace_back();
-        readNextLease = readLease(index, lease);
-        if (lease.startTime == 0)
-            leases.pop_back();
-        ++index;
+        Log::Critical("Couldn't open {} for writing", path);
+        return false;
     }
 
-    return leases;
+    ofs.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!ofs.good())
+    {
+        Log::Critical("Couldn't write compiled configuration to {}", path);
+        return false;
+    }
+
+    return true;
 }
 
-void Configuration::SavePersistentLeases(const std::vector<Lease>& leases, const std::string& leaseFile)
+std::shared_ptr<const ConfigurationSnapshot> Configuration::GetSnapshot()
 {
-    std::vector<std::uint8_t> data;
-    data.reserve(320);
+    return CurrentSnapshot.load();
+}
 
-    for (const auto& lease : leases)
-    {
-        const auto* startTimePtr = reinterpret_cast<const std::uint8_t*>(&lease.startTime);
-        data.insert(data.end(), startTimePtr, startTimePtr + StartTimeLen);
+std::uint64_t Configuration::GetGeneration()
+{
+    return CurrentGeneration.load(std::memory_order_acquire);
+}
 
-        const auto* hwAddressPtr = reinterpret_cast<const std::uint8_t*>(&lease.hwAddress);
-        data.insert(data.end(), hwAddressPtr, hwAddressPtr + HwAddressLen);
+std::vector<std::string> Configuration::GetConfiguredInterfaces()
+{
+    std::vector<std::string> interfaces;
+    const auto snapshot = GetSnapshot();
+    interfaces.reserve(snapshot->networks.size());
 
-        const auto* ipAddressPtr = reinterpret_cast<const std::uint8_t*>(&lease.ipAddress);
-        data.insert(data.end(), ipAddressPtr, ipAddressPtr + IpAddressLen);
+    for (const auto& [interface, config] : snapshot->networks)
+    {
+        interfaces.emplace_back(interface);
     }
 
-    std::ofstream ofs(leaseFile);
-    if (!ofs.is_open())
+    return interfaces;
+}
+
+std::vector<Lease> Configuration::GetPersistentLeasesByInterface(const std::string& interface)
+{
+    const auto snapshot = GetSnapshot();
+    const auto it = snapshot->networks.find(interface);
+    if (it == snapshot->networks.end() || it->second.leaseFile.empty())
+        return {};
+
+    return GetPersistentLeasesByFile(it->second.leaseFile);
+}
+
+std::vector<Lease> Configuration::GetPersistentLeasesByFile(const std::string& filename)
+{
+    LeaseFile file(filename);
+    if (!file.isOpen())
+        return {};
+
+    std::vector<Lease> leases;
+    leases.reserve(file.getRecordCount());
+    file.forEach([&leases](const Lease& lease) { leases.push_back(lease); });
+
+    return leases;
+}
+
+void Configuration::SavePersistentLeases(const std::vector<Lease>& leases, const std::string& leaseFile)
+{
+    LeaseFileWriter writer(leaseFile);
+    if (!writer.isOpen())
     {
         Log::Warning("Couldn't write to lease file {}", leaseFile);
         return;
     }
 
-    ofs.write(reinterpret_cast<const char*>(data.data()),
-              static_cast<long>(data.size()));
+    for (const auto& lease : leases)
+        writer.write(lease);
+
+    if (!writer.commit())
+        Log::Warning("Couldn't write to lease file {}", leaseFile);
+}
 
-    ofs.close();
+std::string Configuration::GetPidFileName()
+{
+    return GetSnapshot()->pidFileName;
 }
 
-const std::string& Configuration::GetPidFileName()
+std::string Configuration::GetLogFileName()
 {
-    return PidFileName;
+    return GetSnapshot()->logFileName;
 }
 
-const std::string& Configuration::GetLogFileName()
+std::string Configuration::GetStatisticsFileName()
 {
-    return LogFileName;
+    return GetSnapshot()->statisticsFileName;
 }
 
 Log::Level Configuration::GetLogLevel()
 {
-    return LogLevel;
+    return GetSnapshot()->logLevel;
 }
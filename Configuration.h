@@ -11,6 +11,7 @@
 #include "IpConverter.h"
 #include "Logger.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -29,8 +30,65 @@ namespace NetworkDefaults
     constexpr auto leaseTime{ 3600 };
     constexpr auto renewalTime{ 1800 }; // 1/2 of 3600
     constexpr auto rebindingTime{ 3150 }; // 7/8 of 3600
+    constexpr auto maximumRateLimit{ 1000000 }; // Requests per second, bursts can be twice this.
+    constexpr auto rateLimitTableSize{ 4096 };
+    constexpr auto maximumRateLimitTableSize{ 1048576 };
+    constexpr auto utilizationLowWatermark{ 25 };
+    constexpr auto utilizationHighWatermark{ 75 };
+    constexpr auto historySize{ 1024 };
+    constexpr auto maximumHistorySize{ 1048576 };
+    constexpr auto quarantineTime{ 3600 };
+    constexpr auto conflictProbeCacheTime{ 300 };
+    constexpr auto loadBalanceThreshold{ 3 };
+    constexpr auto maximumBootFileLength{ 127 }; // Both fit the fixed BOOTP header fields with a terminating zero.
+    constexpr auto maximumServerNameLength{ 63 };
 }
 
+enum class AllocationPolicy
+{
+    FirstFit, // Lowest available address in the DHCP range.
+    Hash      // Starts looking from an address picked by the hardware address, so clients tend to get the same one.
+};
+
+enum class PoolSelection
+{
+    Ordered,  // The first pool with a free address, in the order they're configured.
+    LeastUsed // The pool with the lowest utilization.
+};
+
+/* One bit per client class, in the order the classes are defined. */
+using ClientClassMask = std::uint64_t;
+constexpr auto MaxClientClasses = 64;
+
+struct ClientClassConfiguration
+{
+    std::string name;
+    std::vector<std::uint32_t> ouis; // First three bytes of the hardware address.
+    std::vector<std::string> vendorClasses; // Option 60, a trailing * matches by prefix.
+    std::vector<std::string> userClasses; // Option 77.
+
+    // Network boot (PXE), used when bootFile isn't empty.
+    std::uint32_t nextServer{}; // siaddr
+    std::string bootFile; // file, and option 67
+    std::string serverName; // sname, and option 66
+};
+
+/* Per-host extras given on a reserve line, validated and encoded when the configuration is loaded. */
+struct HostOptions
+{
+    std::uint32_t leaseTime{}; // 0 uses the interface's lease time.
+    std::vector<std::uint8_t> encodedOptions; // Options (code, length, payload) replacing the interface's.
+};
+
+struct PoolConfiguration
+{
+    std::string name;
+    std::uint32_t first{};
+    std::uint32_t last{};
+    ClientClassMask clientClasses{}; // Only clients in one of these classes get addresses from the pool, 0 allows all.
+};
+
+/* Fields added here must also be added to the compiled configuration, see ConfigurationImage.cpp. */
 struct NetworkConfiguration
 {
     std::uint32_t networkSpace{ NetworkDefaults::space };
@@ -39,21 +97,114 @@ struct NetworkConfiguration
     std::uint32_t dhcpServerIdentifier{ NetworkDefaults::serverIdentifier };
     std::uint32_t dhcpFirst{ NetworkDefaults::first };
     std::uint32_t dhcpLast{ NetworkDefaults::last };
+    std::vector<PoolConfiguration> pools; // Replaces dhcpFirst and dhcpLast when not empty.
+    PoolSelection poolSelection{ PoolSelection::Ordered };
+    std::vector<ClientClassConfiguration> clientClasses;
     std::vector<std::uint32_t> dnsServers;
     std::uint32_t leaseTime{ NetworkDefaults::leaseTime };
     std::uint32_t renewalTime{ NetworkDefaults::renewalTime };
     std::uint32_t rebindingTime{ NetworkDefaults::rebindingTime };
+    std::uint8_t leaseJitter{}; // Percent, 0 disables.
+    std::uint32_t minimumLeaseTime{}; // Adaptive lease time, disabled when both are 0.
+    std::uint32_t maximumLeaseTime{};
+    std::uint8_t utilizationLowWatermark{ NetworkDefaults::utilizationLowWatermark };
+    std::uint8_t utilizationHighWatermark{ NetworkDefaults::utilizationHighWatermark };
     std::string leaseFile;
     std::unordered_map<std::uint64_t, std::uint32_t> reservations;
+    std::unordered_map<std::uint64_t, HostOptions> hostOptions;
+    std::uint32_t historySize{ NetworkDefaults::historySize };
+    AllocationPolicy allocationPolicy{ AllocationPolicy::FirstFit };
+    std::uint32_t quarantineTime{ NetworkDefaults::quarantineTime };
+    std::uint32_t conflictProbeTimeout{}; // Milliseconds, 0 disables conflict probing.
+    std::uint32_t conflictProbeCacheTime{ NetworkDefaults::conflictProbeCacheTime };
+    std::uint32_t clientRateLimit{}; // Requests per second per hardware address, 0 disables.
+    std::uint32_t clientRateBurst{};
+    std::uint32_t interfaceRateLimit{}; // Requests per second for the whole interface, 0 disables.
+    std::uint32_t interfaceRateBurst{};
+    std::uint32_t rateLimitTableSize{ NetworkDefaults::rateLimitTableSize };
+    std::uint8_t loadBalanceServer{}; // Counting from 0.
+    std::uint8_t loadBalanceServers{}; // Servers sharing the clients, 0 disables load balancing.
+    std::uint16_t loadBalanceThreshold{ NetworkDefaults::loadBalanceThreshold }; // Seconds
+};
+
+enum class FailoverRole
+{
+    None,
+    Primary, // Serves clients and sends every lease change to the standby.
+    Standby  // Keeps a copy of the primary's leases, and serves clients once the primary goes silent.
+};
+
+namespace FailoverDefaults
+{
+    constexpr std::uint16_t port{ 647 };
+    constexpr std::uint32_t timeout{ 3000 }; // Milliseconds
+    constexpr std::uint32_t minimumTimeout{ 300 }; // The primary sends heartbeats 3 times per timeout.
+}
+
+namespace BulkLeasequeryDefaults
+{
+    constexpr std::uint16_t port{ 67 }; // RFC 6926 uses the DHCP server port, over TCP.
+}
+
+namespace LeaseEventDefaults
+{
+    constexpr std::uint32_t buffer{ 256 }; // KiB per subscriber
+}
+
+/* An address and netmask, ie. from "10.0.0.0/8". The address has no bits outside the mask. */
+struct Subnet
+{
+    std::uint32_t address{};
+    std::uint32_t mask{};
+
+    [[nodiscard]]
+    bool contains(std::uint32_t ipAddress) const { return (ipAddress & mask) == address; }
+};
+
+/*
+ * Everything read from the configuration. Never changed once it has been loaded, a reload makes a new one.
+*/
+struct ConfigurationSnapshot
+{
+    std::string pidFileName;
+    std::string logFileName;
+    std::string statisticsFileName;
+    Log::Level logLevel{ Log::Level::Info };
+    std::uint32_t liveLeaseInterval{}; // Milliseconds, 0 disables publishing leases in shared memory.
+    FailoverRole failoverRole{ FailoverRole::None };
+    std::uint32_t failoverAddress{}; // The standby's address, which it listens on and the primary connects to.
+    std::uint16_t failoverPort{ FailoverDefaults::port };
+    std::uint32_t failoverTimeout{ FailoverDefaults::timeout }; // Milliseconds without word from the primary.
+    std::uint32_t failoverPeer{}; // The primary's address, the only one the standby accepts a connection from.
+    bool bulkLeasequery{};
+    std::uint32_t bulkLeasequeryAddress{}; // 0 listens on every address.
+    std::uint16_t bulkLeasequeryPort{ BulkLeasequeryDefaults::port };
+    std::vector<Subnet> bulkLeasequeryAllowed; // Who may connect.
+    std::string leaseEventSocket; // Empty disables publishing lease events.
+    std::uint32_t leaseEventBuffer{ LeaseEventDefaults::buffer }; // KiB
+    std::unordered_map<std::string, NetworkConfiguration> networks;
 };
 
 namespace Configuration
 {
+    // Loads either a configuration file or a compiled configuration made by SaveCompiled(), and makes it the current
+    // snapshot. Also used for reloading, the current snapshot stays as it is if loading fails.
     bool LoadFromFile(const std::string& path);
 
-    std::vector<std::string> GetConfiguredInterfaces();
+    // Checks a configuration as a whole, ie. that ranges and reservations are within their network.
+    // Every problem found is logged, not just the first.
+    bool Validate(const ConfigurationSnapshot& snapshot);
 
-    NetworkConfiguration GetNetworkConfiguration(const std::string& interface);
+    // Writes the current snapshot as a compiled configuration.
+    bool SaveCompiled(const std::string& path);
+
+    // Safe to call from any thread. The snapshot stays valid for as long as it's held, even across reloads.
+    std::shared_ptr<const ConfigurationSnapshot> GetSnapshot();
+
+    // Increases every time a new snapshot is loaded. Cheaper than GetSnapshot() for checking if anything changed.
+    std::uint64_t GetGeneration();
+
+    std::vector<std::string> GetConfiguredInterfaces();
 
     std::vector<Lease> GetPersistentLeasesByInterface(const std::string& interface);
 
@@ -61,9 +212,11 @@ namespace Configuration
 
     void SavePersistentLeases(const std::vector<Lease>& leases, const std::string& leaseFile);
 
-    const std::string& GetPidFileName();
+    std::string GetPidFileName();
+
+    std::string GetLogFileName();
 
-    const std::string& GetLogFileName();
+    std::string GetStatisticsFileName();
 
     Log::Level GetLogLevel();
 }
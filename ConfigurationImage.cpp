@@ -0,0 +1,458 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "ConfigurationImage.h"
+#include "ReservationFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace
+{
+std::uint32_t checksum(std::span<const std::uint8_t> data)
+{
+    std::uint32_t hash = 2166136261u;
+    for (auto byte : data)
+    {
+        hash ^= byte;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+class ImageWriter
+{
+    std::vector<std::uint8_t>& m_data;
+
+public:
+    explicit ImageWriter(std::vector<std::uint8_t>& data)
+        : m_data(data)
+    {}
+
+    // Not vector::insert(), GCC 12 warns about it writing out of bounds when optimizing.
+    void append(const void* bytes, std::size_t size)
+    {
+        const auto offset = m_data.size();
+        m_data.resize(offset + size);
+        if (size > 0)
+            std::memcpy(m_data.data() + offset, bytes, size);
+    }
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    void write(const T& value)
+    {
+        append(&value, sizeof(T));
+    }
+
+    void writeSize(std::size_t size)
+    {
+        write(static_cast<std::uint32_t>(size));
+    }
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    void writeList(std::span<const T> values)
+    {
+        writeSize(values.size());
+        append(values.data(), values.size_bytes());
+    }
+
+    void writeString(std::string_view text)
+    {
+        writeList(std::span<const char>(text.data(), text.size()));
+    }
+
+    void writeStrings(const std::vector<std::string>& texts)
+    {
+        writeSize(texts.size());
+        for (const auto& text : texts)
+            writeString(text);
+    }
+};
+
+/* Every read is bounds checked. After the first failure everything reads as empty and ok() returns false. */
+class ImageReader
+{
+    std::span<const std::uint8_t> m_data;
+    bool m_ok{ true };
+
+    const std::uint8_t* take(std::size_t size)
+    {
+        if (!m_ok || size > m_data.size())
+        {
+            m_ok = false;
+            return nullptr;
+        }
+
+        const auto* ptr = m_data.data();
+        m_data = m_data.subspan(size);
+        return ptr;
+    }
+
+public:
+    explicit ImageReader(std::span<const std::uint8_t> data)
+        : m_data(data)
+    {}
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    T read()
+    {
+        T value{};
+        if (const auto* ptr = take(sizeof(T)))
+            std::memcpy(&value, ptr, sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    std::vector<T> readList()
+    {
+        const auto count = read<std::uint32_t>();
+        const auto* ptr = take(std::size_t{ count } * sizeof(T));
+        if (!ptr)
+            return {};
+
+        std::vector<T> values(count);
+        std::memcpy(values.data(), ptr, std::size_t{ count } * sizeof(T));
+        return values;
+    }
+
+    std::string readString(std::size_t maximumSize = std::numeric_limits<std::uint32_t>::max())
+    {
+        const auto count = read<std::uint32_t>();
+        if (count > maximumSize)
+            m_ok = false;
+
+        const auto* ptr = take(count);
+        if (!ptr)
+            return {};
+
+        return { reinterpret_cast<const char*>(ptr), count };
+    }
+
+    std::vector<std::string> readStrings()
+    {
+        const auto count = read<std::uint32_t>();
+        if (count > m_data.size() / sizeof(std::uint32_t))
+        {
+            m_ok = false;
+            return {};
+        }
+
+        std::vector<std::string> texts;
+        texts.reserve(count);
+        for (std::uint32_t i = 0; i < count && m_ok; ++i)
+            texts.emplace_back(readString());
+        return texts;
+    }
+
+    // Values past the last enumerator fail the reader instead of producing an enumeration no switch handles.
+    template<typename T>
+        requires std::is_enum_v<T>
+    T readEnum(T last)
+    {
+        const auto value = read<std::uint8_t>();
+        if (value > static_cast<std::uint8_t>(last))
+        {
+            m_ok = false;
+            return {};
+        }
+        return static_cast<T>(value);
+    }
+
+    // Guards the element count of lists read element by element, each element being at least minimumSize bytes.
+    std::uint32_t readCount(std::size_t minimumSize)
+    {
+        const auto count = read<std::uint32_t>();
+        if (count > m_data.size() / minimumSize)
+        {
+            m_ok = false;
+            return 0;
+        }
+        return count;
+    }
+
+    [[nodiscard]]
+    bool ok() const { return m_ok; }
+
+    [[nodiscard]]
+    bool atEnd() const { return m_data.empty(); }
+};
+
+void writeNetwork(ImageWriter& writer, const NetworkConfiguration& config)
+{
+    writer.write(config.networkSpace);
+    writer.write(config.networkSize);
+    writer.write(config.routers);
+    writer.write(config.dhcpServerIdentifier);
+    writer.write(config.dhcpFirst);
+    writer.write(config.dhcpLast);
+
+    writer.writeSize(config.pools.size());
+    for (const auto& pool : config.pools)
+    {
+        writer.writeString(pool.name);
+        writer.write(pool.first);
+        writer.write(pool.last);
+        writer.write(pool.clientClasses);
+    }
+    writer.write(static_cast<std::uint8_t>(config.poolSelection));
+
+    writer.writeSize(config.clientClasses.size());
+    for (const auto& clientClass : config.clientClasses)
+    {
+        writer.writeString(clientClass.name);
+        writer.writeList(std::span(clientClass.ouis));
+        writer.writeStrings(clientClass.vendorClasses);
+        writer.writeStrings(clientClass.userClasses);
+        writer.write(clientClass.nextServer);
+        writer.writeString(clientClass.bootFile);
+        writer.writeString(clientClass.serverName);
+    }
+
+    writer.writeList(std::span(config.dnsServers));
+    writer.write(config.leaseTime);
+    writer.write(config.renewalTime);
+    writer.write(config.rebindingTime);
+    writer.write(config.leaseJitter);
+    writer.write(config.minimumLeaseTime);
+    writer.write(config.maximumLeaseTime);
+    writer.write(config.utilizationLowWatermark);
+    writer.write(config.utilizationHighWatermark);
+    writer.writeString(config.leaseFile);
+
+    std::vector<ReservationFile::Record> reservations;
+    reservations.reserve(config.reservations.size());
+    for (const auto& [hwAddress, ipAddress] : config.reservations)
+        reservations.push_back({ hwAddress, ipAddress, 0 });
+    std::sort(reservations.begin(), reservations.end(), [](const auto& a, const auto& b) { return a.hwAddress < b.hwAddress; });
+    writer.writeList(std::span<const ReservationFile::Record>(reservations));
+
+    std::vector<std::uint64_t> hostOptionAddresses;
+    hostOptionAddresses.reserve(config.hostOptions.size());
+    for (const auto& [hwAddress, hostOptions] : config.hostOptions)
+        hostOptionAddresses.emplace_back(hwAddress);
+    std::sort(hostOptionAddresses.begin(), hostOptionAddresses.end());
+
+    writer.writeSize(hostOptionAddresses.size());
+    for (auto hwAddress : hostOptionAddresses)
+    {
+        const auto& hostOptions = config.hostOptions.at(hwAddress);
+        writer.write(hwAddress);
+        writer.write(hostOptions.leaseTime);
+        writer.writeList(std::span(hostOptions.encodedOptions));
+    }
+
+    writer.write(config.historySize);
+    writer.write(static_cast<std::uint8_t>(config.allocationPolicy));
+    writer.write(config.quarantineTime);
+    writer.write(config.conflictProbeTimeout);
+    writer.write(config.conflictProbeCacheTime);
+    writer.write(config.clientRateLimit);
+    writer.write(config.clientRateBurst);
+    writer.write(config.interfaceRateLimit);
+    writer.write(config.interfaceRateBurst);
+    writer.write(config.rateLimitTableSize);
+    writer.write(config.loadBalanceServer);
+    writer.write(config.loadBalanceServers);
+    writer.write(config.loadBalanceThreshold);
+}
+
+NetworkConfiguration readNetwork(ImageReader& reader)
+{
+    NetworkConfiguration config;
+
+    config.networkSpace = reader.read<std::uint32_t>();
+    config.networkSize = reader.read<std::uint8_t>();
+    config.routers = reader.read<std::uint32_t>();
+    config.dhcpServerIdentifier = reader.read<std::uint32_t>();
+    config.dhcpFirst = reader.read<std::uint32_t>();
+    config.dhcpLast = reader.read<std::uint32_t>();
+
+    const auto poolCount = reader.readCount(sizeof(std::uint32_t) * 3);
+    for (std::uint32_t i = 0; i < poolCount && reader.ok(); ++i)
+    {
+        auto& pool = config.pools.emplace_back();
+        pool.name = reader.readString();
+        pool.first = reader.read<std::uint32_t>();
+        pool.last = reader.read<std::uint32_t>();
+        pool.clientClasses = reader.read<ClientClassMask>();
+    }
+    config.poolSelection = reader.readEnum(PoolSelection::LeastUsed);
+
+    const auto classCount = reader.readCount(sizeof(std::uint32_t) * 7);
+    for (std::uint32_t i = 0; i < classCount && reader.ok(); ++i)
+    {
+        auto& clientClass = config.clientClasses.emplace_back();
+        clientClass.name = reader.readString();
+        clientClass.ouis = reader.readList<std::uint32_t>();
+        clientClass.vendorClasses = reader.readStrings();
+        clientClass.userClasses = reader.readStrings();
+        clientClass.nextServer = reader.read<std::uint32_t>();
+        clientClass.bootFile = reader.readString(NetworkDefaults::maximumBootFileLength);
+        clientClass.serverName = reader.readString(NetworkDefaults::maximumServerNameLength);
+    }
+
+    config.dnsServers = reader.readList<std::uint32_t>();
+    config.leaseTime = reader.read<std::uint32_t>();
+    config.renewalTime = reader.read<std::uint32_t>();
+    config.rebindingTime = reader.read<std::uint32_t>();
+    config.leaseJitter = reader.read<std::uint8_t>();
+    config.minimumLeaseTime = reader.read<std::uint32_t>();
+    config.maximumLeaseTime = reader.read<std::uint32_t>();
+    config.utilizationLowWatermark = reader.read<std::uint8_t>();
+    config.utilizationHighWatermark = reader.read<std::uint8_t>();
+    config.leaseFile = reader.readString();
+
+    const auto reservations = reader.readList<ReservationFile::Record>();
+    config.reservations.reserve(reservations.size());
+    for (const auto& record : reservations)
+        config.reservations.emplace(record.hwAddress, record.ipAddress);
+
+    const auto hostOptionCount = reader.readCount(sizeof(std::uint64_t) + sizeof(std::uint32_t) * 2);
+    for (std::uint32_t i = 0; i < hostOptionCount && reader.ok(); ++i)
+    {
+        const auto hwAddress = reader.read<std::uint64_t>();
+        auto& hostOptions = config.hostOptions[hwAddress];
+        hostOptions.leaseTime = reader.read<std::uint32_t>();
+        hostOptions.encodedOptions = reader.readList<std::uint8_t>();
+    }
+
+    config.historySize = reader.read<std::uint32_t>();
+    config.allocationPolicy = reader.readEnum(AllocationPolicy::Hash);
+    config.quarantineTime = reader.read<std::uint32_t>();
+    config.conflictProbeTimeout = reader.read<std::uint32_t>();
+    config.conflictProbeCacheTime = reader.read<std::uint32_t>();
+    config.clientRateLimit = reader.read<std::uint32_t>();
+    config.clientRateBurst = reader.read<std::uint32_t>();
+    config.interfaceRateLimit = reader.read<std::uint32_t>();
+    config.interfaceRateBurst = reader.read<std::uint32_t>();
+    config.rateLimitTableSize = reader.read<std::uint32_t>();
+    config.loadBalanceServer = reader.read<std::uint8_t>();
+    config.loadBalanceServers = reader.read<std::uint8_t>();
+    config.loadBalanceThreshold = reader.read<std::uint16_t>();
+
+    return config;
+}
+}
+
+bool ConfigurationImage::IsImage(std::span<const std::uint8_t> data)
+{
+    return data.size() >= sizeof(Magic) && std::memcmp(data.data(), Magic, sizeof(Magic)) == 0;
+}
+
+std::vector<std::uint8_t> ConfigurationImage::Encode(const ConfigurationSnapshot& snapshot)
+{
+    std::vector<std::uint8_t> data(sizeof(Header));
+    ImageWriter writer(data);
+
+    writer.writeString(snapshot.pidFileName);
+    writer.writeString(snapshot.logFileName);
+    writer.writeString(snapshot.statisticsFileName);
+    writer.write(static_cast<std::uint8_t>(snapshot.logLevel));
+    writer.write(snapshot.liveLeaseInterval);
+    writer.write(static_cast<std::uint8_t>(snapshot.failoverRole));
+    writer.write(snapshot.failoverAddress);
+    writer.write(snapshot.failoverPort);
+    writer.write(snapshot.failoverTimeout);
+    writer.write(snapshot.failoverPeer);
+    writer.write(static_cast<std::uint8_t>(snapshot.bulkLeasequery));
+    writer.write(snapshot.bulkLeasequeryAddress);
+    writer.write(snapshot.bulkLeasequeryPort);
+    writer.writeList(std::span(snapshot.bulkLeasequeryAllowed));
+    writer.writeString(snapshot.leaseEventSocket);
+    writer.write(snapshot.leaseEventBuffer);
+
+    std::vector<std::string> interfaces;
+    interfaces.reserve(snapshot.networks.size());
+    for (const auto& [interface, config] : snapshot.networks)
+        interfaces.emplace_back(interface);
+    std::sort(interfaces.begin(), interfaces.end());
+
+    writer.writeSize(interfaces.size());
+    for (const auto& interface : interfaces)
+    {
+        writer.writeString(interface);
+        writeNetwork(writer, snapshot.networks.at(interface));
+    }
+
+    const auto payload = std::span(data).subspan(sizeof(Header));
+
+    Header header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.size = payload.size();
+    header.checksum = checksum(payload);
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    return data;
+}
+
+bool ConfigurationImage::Decode(std::span<const std::uint8_t> data, ConfigurationSnapshot& snapshot)
+{
+    if (!IsImage(data) || data.size() < sizeof(Header))
+    {
+        Log::Critical("Configuration error: Not a compiled configuration");
+        return false;
+    }
+
+    Header header{};
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    if (header.version != Version)
+    {
+        Log::Critical("Configuration error: Compiled configuration is version {}, expected {}. Compile it again", header.version, Version);
+        return false;
+    }
+
+    const auto payload = data.subspan(sizeof(Header));
+    if (header.size != payload.size() || header.checksum != checksum(payload))
+    {
+        Log::Critical("Configuration error: Compiled configuration is truncated or damaged");
+        return false;
+    }
+
+    ImageReader reader(payload);
+    ConfigurationSnapshot decoded;
+
+    decoded.pidFileName = reader.readString();
+    decoded.logFileName = reader.readString();
+    decoded.statisticsFileName = reader.readString();
+    decoded.logLevel = reader.readEnum(Log::Level::Critical);
+    decoded.liveLeaseInterval = reader.read<std::uint32_t>();
+    decoded.failoverRole = reader.readEnum(FailoverRole::Standby);
+    decoded.failoverAddress = reader.read<std::uint32_t>();
+    decoded.failoverPort = reader.read<std::uint16_t>();
+    decoded.failoverTimeout = reader.read<std::uint32_t>();
+    decoded.failoverPeer = reader.read<std::uint32_t>();
+    decoded.bulkLeasequery = reader.read<std::uint8_t>() != 0;
+    decoded.bulkLeasequeryAddress = reader.read<std::uint32_t>();
+    decoded.bulkLeasequeryPort = reader.read<std::uint16_t>();
+    decoded.bulkLeasequeryAllowed = reader.readList<Subnet>();
+    decoded.leaseEventSocket = reader.readString();
+    decoded.leaseEventBuffer = reader.read<std::uint32_t>();
+
+    const auto interfaceCount = reader.readCount(sizeof(std::uint32_t));
+    for (std::uint32_t i = 0; i < interfaceCount && reader.ok(); ++i)
+    {
+        auto interface = reader.readString();
+        decoded.networks[std::move(interface)] = readNetwork(reader);
+    }
+
+    if (!reader.ok() || !reader.atEnd())
+    {
+        Log::Critical("Configuration error: Compiled configuration is invalid or doesn't match its version");
+        return false;
+    }
+
+    snapshot = std::move(decoded);
+    return true;
+}
@@ -0,0 +1,49 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include "Configuration.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/*
+ * A compiled configuration, made by "tdhcpd --compile-config". Holds everything the configuration file, its includes
+ * and any reservations files describe, already validated, so the daemon can start without parsing any text.
+ *
+ * A header is followed by the payload: Every field in a fixed order in native byte order (like the lease file), with
+ * strings and lists prefixed by their length. Reservations are stored as a list sorted by hardware address, in the
+ * record format of the reservations file. The header carries a checksum of the payload, so a truncated or damaged
+ * image is refused instead of half loaded. So is an image of another version, which must be compiled again.
+*/
+namespace ConfigurationImage
+{
+    constexpr char Magic[4] = { 'T', 'D', 'C', 'I' };
+    constexpr std::uint32_t Version = 7;
+
+    struct Header
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t size; // Of the payload following the header.
+        std::uint32_t checksum; // FNV-1a of the payload.
+        std::uint32_t reserved;
+    };
+
+    static_assert(sizeof(Header) == 24);
+
+    [[nodiscard]]
+    bool IsImage(std::span<const std::uint8_t> data);
+
+    [[nodiscard]]
+    std::vector<std::uint8_t> Encode(const ConfigurationSnapshot& snapshot);
+
+    // Errors are logged, snapshot is left alone unless the whole image could be read.
+    bool Decode(std::span<const std::uint8_t> data, ConfigurationSnapshot& snapshot);
+}
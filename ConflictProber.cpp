@@ -0,0 +1,241 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "ConflictProber.h"
+#include "IpConverter.h"
+#include "Logger.h"
+
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+/* Probes sent in one go, the replies to all of them are then waited for together. */
+constexpr auto MaxProbesPerBatch = 32u;
+
+std::uint16_t icmpChecksum(const std::uint8_t* data, std::size_t length)
+{
+    std::uint32_t sum{};
+    for (std::size_t i = 0; i + 1 < length; i += 2)
+        sum += static_cast<std::uint32_t>(data[i] << 8 | data[i + 1]);
+
+    if (length % 2)
+        sum += static_cast<std::uint32_t>(data[length - 1] << 8);
+
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return static_cast<std::uint16_t>(~sum);
+}
+}
+
+struct ConflictProberPrivate
+{
+    std::string deviceName;
+    std::chrono::milliseconds timeout;
+    std::uint32_t cacheTime;
+
+    std::uint16_t identifier{ static_cast<std::uint16_t>(getpid()) };
+    std::uint16_t sequence{};
+    int sockfd{ -1 };
+
+    std::thread workerThread;
+    std::atomic_bool running{ true };
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::uint32_t> pending;
+    std::unordered_map<std::uint32_t, std::chrono::steady_clock::time_point> probedAt;
+    std::vector<std::uint32_t> conflicts;
+
+    void setupSocket()
+    {
+        sockfd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+        if (sockfd < 0)
+        {
+            const auto e = errno;
+            Log::Critical("Conflict probing disabled on {}, ICMP socket() error, errno={}", deviceName, e);
+            return;
+        }
+
+        auto ret = setsockopt(sockfd, SOL_SOCKET, SO_BINDTODEVICE, deviceName.c_str(), deviceName.size());
+        if (ret != 0)
+        {
+            const auto e = errno;
+            Log::Warning("Conflict probe socket setsockopt SO_BINDTODEVICE failed, errno={}", e);
+        }
+    }
+
+    void sendEchoRequest(std::uint32_t ipAddress)
+    {
+        std::uint8_t packet[sizeof(icmphdr)]{};
+        auto* icmp = reinterpret_cast<icmphdr*>(packet);
+        icmp->type = ICMP_ECHO;
+        icmp->code = 0;
+        icmp->un.echo.id = htons(identifier);
+        icmp->un.echo.sequence = htons(++sequence);
+        icmp->checksum = htons(icmpChecksum(packet, sizeof(packet)));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(ipAddress);
+
+        if (sendto(sockfd, packet, sizeof(packet), 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            const auto e = errno;
+            Log::Debug("Conflict probe of {} failed to send, errno={}", formatIpAddress(ipAddress), e);
+        }
+    }
+
+    // Returns the sender of an echo reply to one of our requests, or 0 for anything else.
+    std::uint32_t receiveEchoReply()
+    {
+        std::uint8_t buffer[512];
+        const auto length = recv(sockfd, buffer, sizeof(buffer), 0);
+        if (length < static_cast<ssize_t>(sizeof(iphdr)))
+            return 0;
+
+        /* Raw ICMP sockets get the IP header too. */
+        const auto* ip = reinterpret_cast<const iphdr*>(buffer);
+        const auto headerLength = ip->ihl * 4u;
+        if (length < static_cast<ssize_t>(headerLength + sizeof(icmphdr)))
+            return 0;
+
+        const auto* icmp = reinterpret_cast<const icmphdr*>(buffer + headerLength);
+        if (icmp->type != ICMP_ECHOREPLY || ntohs(icmp->un.echo.id) != identifier)
+            return 0;
+
+        return ntohl(ip->saddr);
+    }
+
+    void probeBatch(std::unordered_set<std::uint32_t> batch)
+    {
+        for (auto ipAddress : batch)
+            sendEchoRequest(ipAddress);
+
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!batch.empty() && running)
+        {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0)
+                break;
+
+            pollfd pfd{ sockfd, POLLIN, 0 };
+            if (poll(&pfd, 1, static_cast<int>(remaining.count())) < 1)
+                continue;
+
+            const auto sender = receiveEchoReply();
+            if (batch.erase(sender) == 0)
+                continue;
+
+            Log::Warning("Conflict probe: Address {} is already in use on {}", formatIpAddress(sender), deviceName);
+
+            std::lock_guard lockGuard(mutex);
+            conflicts.emplace_back(sender);
+        }
+    }
+
+    void workerThreadFn()
+    {
+        setupSocket();
+
+        while (running)
+        {
+            std::unordered_set<std::uint32_t> batch;
+
+            {
+                std::unique_lock lock(mutex);
+                condition.wait_for(lock, std::chrono::seconds(1), [this] { return !pending.empty() || !running; });
+
+                while (!pending.empty() && batch.size() < MaxProbesPerBatch)
+                {
+                    batch.insert(pending.front());
+                    pending.pop_front();
+                }
+            }
+
+            if (!batch.empty() && sockfd >= 0)
+                probeBatch(std::move(batch));
+        }
+
+        if (sockfd >= 0)
+            ::close(sockfd);
+    }
+};
+
+ConflictProber::ConflictProber(std::string deviceName, std::chrono::milliseconds timeout, std::uint32_t cacheTime)
+{
+    mp = std::make_unique<ConflictProberPrivate>();
+    mp->deviceName = std::move(deviceName);
+    mp->timeout = timeout;
+    mp->cacheTime = cacheTime;
+    mp->workerThread = std::thread(&ConflictProberPrivate::workerThreadFn, mp.get());
+}
+
+ConflictProber::~ConflictProber()
+{
+    mp->running = false;
+    mp->condition.notify_all();
+    if (mp->workerThread.joinable())
+        mp->workerThread.join();
+}
+
+bool ConflictProber::probe(std::uint32_t ipAddress)
+{
+    const auto now = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard lockGuard(mp->mutex);
+
+        auto [it, inserted] = mp->probedAt.try_emplace(ipAddress, now);
+        if (!inserted)
+        {
+            if (now - it->second < std::chrono::seconds(mp->cacheTime))
+                return false; // Probed recently, the result (if it was in use) is already known.
+            it->second = now;
+        }
+
+        /* Forget about old probes now and then, so the cache doesn't grow forever. */
+        if (mp->probedAt.size() > 4096)
+            std::erase_if(mp->probedAt, [&](const auto& kv) { return now - kv.second >= std::chrono::seconds(mp->cacheTime); });
+
+        mp->pending.emplace_back(ipAddress);
+    }
+
+    mp->condition.notify_one();
+    return true;
+}
+
+std::vector<std::uint32_t> ConflictProber::takeConflicts()
+{
+    std::lock_guard lockGuard(mp->mutex);
+
+    std::vector<std::uint32_t> conflicts;
+    conflicts.swap(mp->conflicts);
+    return conflicts;
+}
+
+std::uint32_t ConflictProber::getCacheTime() const
+{
+    return mp->cacheTime;
+}
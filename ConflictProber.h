@@ -0,0 +1,38 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Checks whether addresses are already in use (ie. by a device with a static address inside the DHCP range),
+ * by sending an ICMP echo request from a worker thread of its own.
+ *
+ * Nothing here blocks the caller: Probes are queued, and addresses found in use are collected later.
+ * Results are cached for a while, so an address isn't probed again on every DISCOVER.
+*/
+struct ConflictProberPrivate;
+class ConflictProber
+{
+    std::unique_ptr<ConflictProberPrivate> mp;
+public:
+    ConflictProber(std::string deviceName, std::chrono::milliseconds timeout, std::uint32_t cacheTime);
+    ~ConflictProber();
+
+    // Queues the address for probing, unless it has been probed within the cache time. Returns true if queued.
+    bool probe(std::uint32_t ipAddress);
+
+    // Addresses found to be in use since the last call.
+    std::vector<std::uint32_t> takeConflicts();
+
+    std::uint32_t getCacheTime() const;
+};
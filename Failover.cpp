@@ -0,0 +1,514 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "Failover.h"
+#include "Logger.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <span>
+
+namespace
+{
+/* How long the primary waits before connecting again, and the standby's granularity for noticing the timeout. */
+constexpr auto ReconnectInterval = std::chrono::seconds(1);
+constexpr auto PollInterval = std::chrono::milliseconds(100);
+
+timeval toTimeval(std::chrono::milliseconds duration)
+{
+    timeval tv{};
+    tv.tv_sec = static_cast<time_t>(duration.count() / 1000);
+    tv.tv_usec = static_cast<suseconds_t>(duration.count() % 1000 * 1000);
+    return tv;
+}
+
+sockaddr_in toSockaddr(std::uint32_t address, std::uint16_t port)
+{
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(address);
+    addr.sin_port = htons(port);
+    return addr;
+}
+
+bool sendAll(int sockfd, const void* data, std::size_t size, int flags)
+{
+    const auto* ptr = static_cast<const std::uint8_t*>(data);
+    while (size > 0)
+    {
+        const auto sent = send(sockfd, ptr, size, flags | MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+
+        ptr += sent;
+        size -= static_cast<std::size_t>(sent);
+    }
+
+    return true;
+}
+
+bool sendMessage(int sockfd, Failover::MessageType type, std::uint64_t sequence, std::span<const Failover::Record> records)
+{
+    Failover::MessageHeader header{};
+    std::memcpy(header.magic, Failover::Magic, sizeof(header.magic));
+    header.type = type;
+    header.count = static_cast<std::uint32_t>(records.size());
+    header.sequence = sequence;
+
+    if (records.empty())
+        return sendAll(sockfd, &header, sizeof(header), 0);
+
+    return sendAll(sockfd, &header, sizeof(header), MSG_MORE) && sendAll(sockfd, records.data(), records.size_bytes(), 0);
+}
+
+Failover::Record toRecord(const std::string& interface, LeaseChange change, const Lease& lease)
+{
+    Failover::Record record{};
+    std::memcpy(record.interface, interface.data(), std::min(interface.size(), sizeof(record.interface)));
+    record.startTime = lease.startTime;
+    record.hwAddress = lease.hwAddress;
+    record.ipAddress = lease.ipAddress;
+    record.leaseTime = lease.leaseTime;
+    record.change = isLeaseHeld(change) ? LeaseChange::Added : LeaseChange::Removed; // All the standby needs to know.
+    return record;
+}
+}
+
+FailoverPrimary::FailoverPrimary(std::uint32_t address, std::uint16_t port, std::chrono::milliseconds heartbeatInterval)
+    : m_address(address)
+    , m_port(port)
+    , m_heartbeatInterval(heartbeatInterval)
+{
+}
+
+FailoverPrimary::~FailoverPrimary()
+{
+    stop();
+}
+
+void FailoverPrimary::stop()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_running = false;
+    }
+
+    m_condition.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void FailoverPrimary::addInterface(const std::string& interface, const LeaseTable& table)
+{
+    m_tables[interface] = &table;
+}
+
+void FailoverPrimary::start()
+{
+    m_running = true;
+    m_thread = std::thread(&FailoverPrimary::threadFn, this);
+}
+
+void FailoverPrimary::leaseChanged(const std::string& interface, LeaseChange change, const Lease& lease)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        if (!m_connected || m_overflowed)
+            return;
+
+        if (m_pending.size() >= MaxPending)
+        {
+            m_overflowed = true;
+            m_pending.clear();
+        }
+        else
+            m_pending.push_back(toRecord(interface, change, lease));
+    }
+
+    m_condition.notify_one();
+}
+
+LeaseListener FailoverPrimary::getLeaseListener(const std::string& interface)
+{
+    return [this, interface](LeaseChange change, const Lease& lease) { leaseChanged(interface, change, lease); };
+}
+
+bool FailoverPrimary::sendSnapshot(int sockfd, std::uint64_t& sequence)
+{
+    if (!sendMessage(sockfd, Failover::MessageType::Reset, ++sequence, {}))
+        return false;
+
+    std::vector<Failover::Record> batch;
+    batch.reserve(Failover::MaxBatchSize);
+    bool ok = true;
+
+    for (const auto& [interface, table] : m_tables)
+    {
+        table->forEach([&](const Lease& lease)
+        {
+            if (!ok)
+                return;
+
+            batch.push_back(toRecord(interface, LeaseChange::Added, lease));
+            if (batch.size() == Failover::MaxBatchSize)
+            {
+                ok = sendMessage(sockfd, Failover::MessageType::Changes, ++sequence, batch);
+                batch.clear();
+            }
+        });
+    }
+
+    return ok && (batch.empty() || sendMessage(sockfd, Failover::MessageType::Changes, ++sequence, batch));
+}
+
+void FailoverPrimary::threadFn()
+{
+    const auto peer = toSockaddr(m_address, m_port);
+    std::vector<Failover::Record> batch;
+    bool connectFailed{};
+
+    while (true)
+    {
+        int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (sockfd < 0)
+        {
+            const auto e = errno;
+            Log::Critical("Failover socket() error, errno={}", e);
+            return;
+        }
+
+        /* A standby that stops reading must not block this thread forever, it's taken as a lost connection. */
+        const auto sendTimeout = toTimeval(m_heartbeatInterval * 3);
+        setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+        int yes = 1;
+        setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+        const bool connected = connect(sockfd, reinterpret_cast<const sockaddr*>(&peer), sizeof(peer)) == 0;
+        if (connected)
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                m_pending.clear();
+                m_connected = true;
+                m_overflowed = false;
+            }
+
+            Log::Info("Connected to failover standby {}:{}, sending leases", formatIpAddress(m_address), m_port);
+
+            std::uint64_t sequence{};
+            bool ok = sendSnapshot(sockfd, sequence);
+
+            while (ok)
+            {
+                {
+                    std::unique_lock lock(m_mutex);
+                    m_condition.wait_for(lock, m_heartbeatInterval, [this] { return !m_running || !m_pending.empty() || m_overflowed; });
+                    if (!m_running)
+                        break;
+
+                    if (m_overflowed)
+                    {
+                        Log::Warning("Failover standby fell too far behind, starting over");
+                        ok = false;
+                        break;
+                    }
+
+                    batch.clear();
+                    batch.swap(m_pending);
+                }
+
+                if (batch.empty())
+                    ok = sendMessage(sockfd, Failover::MessageType::Heartbeat, ++sequence, {});
+
+                for (std::size_t i = 0; ok && i < batch.size(); i += Failover::MaxBatchSize)
+                {
+                    const auto count = std::min(Failover::MaxBatchSize, batch.size() - i);
+                    ok = sendMessage(sockfd, Failover::MessageType::Changes, ++sequence, std::span(batch).subspan(i, count));
+                }
+            }
+
+            {
+                std::lock_guard lock(m_mutex);
+                m_connected = false;
+                m_pending.clear();
+            }
+
+            if (!ok)
+                Log::Warning("Lost connection to failover standby {}:{}", formatIpAddress(m_address), m_port);
+        }
+        else if (!connectFailed)
+        {
+            // Only once, not every time it's retried.
+            Log::Warning("Couldn't connect to failover standby {}:{}, retrying", formatIpAddress(m_address), m_port);
+        }
+
+        connectFailed = !connected;
+        close(sockfd);
+
+        std::unique_lock lock(m_mutex);
+        if (!m_running)
+            return;
+
+        m_condition.wait_for(lock, ReconnectInterval, [this] { return !m_running; });
+        if (!m_running)
+            return;
+    }
+}
+
+FailoverStandby::FailoverStandby(std::uint32_t address, std::uint16_t port, std::uint32_t primaryAddress,
+                                 std::chrono::milliseconds timeout)
+    : m_address(address)
+    , m_port(port)
+    , m_primaryAddress(primaryAddress)
+    , m_timeout(timeout)
+{
+}
+
+FailoverStandby::~FailoverStandby()
+{
+    stop();
+}
+
+void FailoverStandby::addInterface(const std::string& interface, const NetworkConfiguration& config, const std::vector<Lease>& leases)
+{
+    m_configurations[interface] = config;
+    m_networks[interface].configure(NetworkConfiguration(config), leases);
+}
+
+bool FailoverStandby::start()
+{
+    m_listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listenfd < 0)
+    {
+        const auto e = errno;
+        Log::Critical("Failover socket() error, errno={}", e);
+        return false;
+    }
+
+    int yes = 1;
+    setsockopt(m_listenfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    auto addr = toSockaddr(m_address, m_port);
+    if (bind(m_listenfd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || listen(m_listenfd, 1) != 0)
+    {
+        const auto e = errno;
+        Log::Critical("Failover couldn't listen on {}:{}, errno={}", formatIpAddress(m_address), m_port, e);
+        close(m_listenfd);
+        m_listenfd = -1;
+        return false;
+    }
+
+    socklen_t addrlen = sizeof(addr);
+    getsockname(m_listenfd, reinterpret_cast<sockaddr*>(&addr), &addrlen);
+    m_port = ntohs(addr.sin_port);
+
+    m_running = true;
+    m_thread = std::thread(&FailoverStandby::threadFn, this);
+    return true;
+}
+
+std::uint16_t FailoverStandby::getPort() const
+{
+    return m_port;
+}
+
+bool FailoverStandby::isPrimaryDown() const
+{
+    return m_primaryDown;
+}
+
+const LeaseTable& FailoverStandby::getLeaseTable(const std::string& interface) const
+{
+    return m_networks.at(interface).getLeaseTable();
+}
+
+std::unordered_map<std::string, std::vector<Lease>> FailoverStandby::stop()
+{
+    m_running = false;
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if (m_listenfd >= 0)
+    {
+        close(m_listenfd);
+        m_listenfd = -1;
+    }
+
+    std::unordered_map<std::string, std::vector<Lease>> leases;
+    for (const auto& [interface, network] : m_networks)
+        leases[interface] = network.getAllLeases();
+
+    return leases;
+}
+
+void FailoverStandby::threadFn()
+{
+    Log::Info("Failover standby listening on {}:{}", formatIpAddress(m_address), m_port);
+    std::chrono::steady_clock::time_point lastHeard;
+    bool heard{};
+
+    while (m_running)
+    {
+        /* Not before the primary has been heard: One starting later than the standby would find both serving. */
+        if (heard && std::chrono::steady_clock::now() - lastHeard > m_timeout)
+        {
+            Log::Warning("Nothing heard from the failover primary in {} ms, taking over", m_timeout.count());
+            m_primaryDown = true;
+            return;
+        }
+
+        pollfd pfd{ m_listenfd, POLLIN, 0 };
+        if (poll(&pfd, 1, static_cast<int>(PollInterval.count())) < 1)
+            continue;
+
+        sockaddr_in addr{};
+        socklen_t addrlen = sizeof(addr);
+        const int sockfd = accept(m_listenfd, reinterpret_cast<sockaddr*>(&addr), &addrlen);
+        if (sockfd < 0)
+            continue;
+
+        const auto peer = ntohl(addr.sin_addr.s_addr);
+        if (peer != m_primaryAddress)
+        {
+            Log::Warning("Failover connection from {} refused, the primary is {}", formatIpAddress(peer), formatIpAddress(m_primaryAddress));
+            close(sockfd);
+            continue;
+        }
+
+        Log::Info("Failover primary connected from {}", formatIpAddress(peer));
+        serveConnection(sockfd, lastHeard, heard);
+        close(sockfd);
+    }
+}
+
+/*
+ * The primary only counts as heard once its Reset has been applied, so a connection that never gets that far can't
+ * have the standby take over when it goes away.
+*/
+void FailoverStandby::serveConnection(int sockfd, std::chrono::steady_clock::time_point& lastHeard, bool& heard)
+{
+    const auto receiveTimeout = toTimeval(PollInterval);
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &receiveTimeout, sizeof(receiveTimeout));
+
+    constexpr auto MaxMessageSize = sizeof(Failover::MessageHeader) + Failover::MaxBatchSize * sizeof(Failover::Record);
+    std::vector<std::uint8_t> buffer(MaxMessageSize * 2);
+    std::size_t filled{};
+    auto lastMessage = std::chrono::steady_clock::now();
+    m_nextSequence = 1;
+
+    while (m_running)
+    {
+        const auto received = recv(sockfd, buffer.data() + filled, buffer.size() - filled, 0);
+        if (received == 0)
+        {
+            Log::Warning("Failover primary closed the connection");
+            return;
+        }
+
+        if (received < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                return;
+            if (std::chrono::steady_clock::now() - lastMessage > m_timeout)
+                return;
+            continue;
+        }
+
+        filled += static_cast<std::size_t>(received);
+
+        std::size_t offset{};
+        while (filled - offset >= sizeof(Failover::MessageHeader))
+        {
+            Failover::MessageHeader header;
+            std::memcpy(&header, buffer.data() + offset, sizeof(header));
+
+            if (std::memcmp(header.magic, Failover::Magic, sizeof(header.magic)) != 0 || header.count > Failover::MaxBatchSize)
+            {
+                Log::Warning("Failover primary sent a malformed message, dropping the connection");
+                return;
+            }
+
+            const auto size = sizeof(header) + header.count * sizeof(Failover::Record);
+            if (filled - offset < size)
+                break;
+
+            if (!applyMessage(header, buffer.data() + offset + sizeof(header)))
+                return;
+
+            lastMessage = std::chrono::steady_clock::now();
+            lastHeard = lastMessage;
+            heard = true; // The first message applied is always the Reset.
+            offset += size;
+        }
+
+        std::memmove(buffer.data(), buffer.data() + offset, filled - offset);
+        filled -= offset;
+    }
+}
+
+bool FailoverStandby::applyMessage(const Failover::MessageHeader& header, const std::uint8_t* records)
+{
+    if (header.sequence != m_nextSequence)
+    {
+        Log::Warning("Failover primary sent message {}, expected {}. Starting over", header.sequence, m_nextSequence);
+        return false;
+    }
+
+    if (header.sequence == 1 && header.type != Failover::MessageType::Reset)
+    {
+        Log::Warning("Failover primary didn't start with a Reset, dropping the connection");
+        return false;
+    }
+
+    ++m_nextSequence;
+
+    switch (header.type)
+    {
+    case Failover::MessageType::Heartbeat:
+        break;
+
+    case Failover::MessageType::Reset:
+        for (auto& [interface, network] : m_networks)
+            network.configure(NetworkConfiguration(m_configurations[interface]));
+        break;
+
+    case Failover::MessageType::Changes:
+        for (std::uint32_t i = 0; i < header.count; ++i)
+        {
+            Failover::Record record;
+            std::memcpy(&record, records + i * sizeof(record), sizeof(record));
+
+            const std::string interface(record.interface, strnlen(record.interface, sizeof(record.interface)));
+            const auto it = m_networks.find(interface);
+            if (it == m_networks.end())
+                continue; // Not configured here, the primary's problem to serve.
+
+            if (record.change == LeaseChange::Added)
+                it->second.importLease({ record.startTime, record.hwAddress, record.ipAddress, record.leaseTime });
+            else
+                it->second.importLeaseRemoval(record.hwAddress);
+        }
+        break;
+
+    default:
+        Log::Warning("Failover primary sent an unknown message type {}", static_cast<int>(header.type));
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,168 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include "Configuration.h"
+#include "Network.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Active/standby failover between two servers. The primary serves clients and sends every lease change to the
+ * standby over TCP, and a heartbeat when there's nothing to send. The standby keeps the leases in a network of its
+ * own for each interface, and when it hasn't heard from the primary for a while it takes over serving the clients.
+ *
+ * A connection starts with a Reset message and every lease the primary has, followed by changes as they happen, so
+ * a standby that lost its connection is brought up to date by connecting again. Each message carries the next
+ * sequence number. A standby seeing one out of order drops the connection, which is then started over.
+*/
+namespace Failover
+{
+    constexpr char Magic[4] = { 'T', 'D', 'F', 'O' };
+
+    enum class MessageType : std::uint8_t
+    {
+        Heartbeat,
+        Reset,  // Forget all leases, every lease the primary has follows.
+        Changes
+    };
+
+    struct MessageHeader
+    {
+        char magic[4];
+        MessageType type;
+        std::uint8_t reserved[3];
+        std::uint32_t count; // Records after the header.
+        std::uint64_t sequence;
+    };
+
+    struct Record
+    {
+        char interface[16]; // Zero padded, as IFNAMSIZ.
+        std::int64_t startTime;
+        std::uint64_t hwAddress;
+        std::uint32_t ipAddress;
+        std::uint32_t leaseTime;
+        LeaseChange change; // Added or Removed.
+        std::uint8_t reserved[7];
+    };
+
+    static_assert(sizeof(MessageHeader) == 24 && sizeof(Record) == 48);
+
+    // Most records in one message. Changes waiting to be sent are batched up to this.
+    constexpr std::size_t MaxBatchSize = 512;
+}
+
+/*
+ * The primary's end. Lease changes are queued by the interfaces' threads and sent on a thread of its own, so a slow
+ * or unreachable standby never holds up serving clients. If the standby falls too far behind, the connection is
+ * started over instead of queueing without bound.
+*/
+class FailoverPrimary
+{
+    std::uint32_t m_address;
+    std::uint16_t m_port;
+    std::chrono::milliseconds m_heartbeatInterval;
+    std::unordered_map<std::string, const LeaseTable*> m_tables;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::vector<Failover::Record> m_pending;
+    bool m_connected{};
+    bool m_overflowed{};
+    bool m_running{};
+
+    void threadFn();
+    bool sendSnapshot(int sockfd, std::uint64_t& sequence);
+
+public:
+    static constexpr std::size_t MaxPending = 1 << 20;
+
+    FailoverPrimary(std::uint32_t address, std::uint16_t port, std::chrono::milliseconds heartbeatInterval);
+    ~FailoverPrimary();
+
+    FailoverPrimary(const FailoverPrimary&) = delete;
+    FailoverPrimary& operator=(const FailoverPrimary&) = delete;
+
+    // Must be called before start(). The table is read for the leases to send when connecting, and must outlive this.
+    void addInterface(const std::string& interface, const LeaseTable& table);
+
+    void start();
+
+    // Stops sending. The lease tables aren't read after this returns, and changes are ignored.
+    void stop();
+
+    // Safe to call from any thread. Dropped while not connected, the next connection sends all leases anyway.
+    void leaseChanged(const std::string& interface, LeaseChange change, const Lease& lease);
+
+    // A listener for the interface's network, calling leaseChanged().
+    LeaseListener getLeaseListener(const std::string& interface);
+};
+
+/*
+ * The standby's end. Listens for the primary and applies its changes to a network per interface, configured the same
+ * as the interfaces would be. Once the primary has connected and sent its Reset, and then nothing has been heard for
+ * the timeout, isPrimaryDown() turns true and stop() hands over the leases to serve the clients with. A primary that
+ * never got that far is never taken over for, it may just be starting later. Connections from any other address are
+ * refused.
+*/
+class FailoverStandby
+{
+    std::uint32_t m_address;
+    std::uint16_t m_port;
+    std::uint32_t m_primaryAddress;
+    std::chrono::milliseconds m_timeout;
+    std::unordered_map<std::string, Network> m_networks;
+    std::unordered_map<std::string, NetworkConfiguration> m_configurations;
+
+    int m_listenfd{ -1 };
+    std::thread m_thread;
+    std::atomic_bool m_running{};
+    std::atomic_bool m_primaryDown{};
+    std::uint64_t m_nextSequence{};
+
+    void threadFn();
+    void serveConnection(int sockfd, std::chrono::steady_clock::time_point& lastHeard, bool& heard);
+    bool applyMessage(const Failover::MessageHeader& header, const std::uint8_t* records);
+
+public:
+    // Only connections from primaryAddress are accepted.
+    FailoverStandby(std::uint32_t address, std::uint16_t port, std::uint32_t primaryAddress, std::chrono::milliseconds timeout);
+    ~FailoverStandby();
+
+    FailoverStandby(const FailoverStandby&) = delete;
+    FailoverStandby& operator=(const FailoverStandby&) = delete;
+
+    // Must be called before start(). Starts out with the given leases, ie. from the lease file.
+    void addInterface(const std::string& interface, const NetworkConfiguration& config, const std::vector<Lease>& leases);
+
+    // Returns false if the address couldn't be listened on.
+    bool start();
+
+    // The port listened on, useful when started with port 0.
+    [[nodiscard]]
+    std::uint16_t getPort() const;
+
+    [[nodiscard]]
+    bool isPrimaryDown() const;
+
+    // The interface's leases as replicated so far, safe to read from any thread.
+    const LeaseTable& getLeaseTable(const std::string& interface) const;
+
+    // Stops listening, and returns the leases of each interface.
+    std::unordered_map<std::string, std::vector<Lease>> stop();
+};
@@ -8,100 +8,193 @@
 #include "IpConverter.h"
 #include "Logger.h"
 
-#include <format>
-#include <stdexcept>
+#include <algorithm>
+#include <charconv>
 
-std::uint32_t convertIpAddress(std::string_view address, bool& ok) try
+namespace
 {
-    std::uint8_t part[4]{};
-
-    if (address.empty())
-        return 0;
+// Value of each hexadecimal digit, or -1 for anything that isn't one.
+constexpr auto HexDigitValues = []
+{
+    std::array<std::int8_t, 256> values{};
+    values.fill(-1);
 
-    ok = false; // for exceptions
+    for (int i = 0; i < 10; ++i)
+        values['0' + i] = static_cast<std::int8_t>(i);
 
-    int count = 0;
-    for (std::uint8_t& i : part)
+    for (int i = 0; i < 6; ++i)
     {
-        ++count;
-        auto pos = address.find('.');
-        std::string str(address.substr(0, pos));
-        i = std::stoi(str);
-        address = address.substr(pos + 1);
+        values['A' + i] = static_cast<std::int8_t>(10 + i);
+        values['a' + i] = static_cast<std::int8_t>(10 + i);
     }
 
-    ok = count == 4;
+    return values;
+}();
 
-    return concatenateIpAddress(part[0], part[1], part[2], part[3]);
-}
-catch (const std::invalid_argument&)
+constexpr std::string_view HexDigits = "0123456789ABCDEF";
+
+constexpr bool isHardwareAddressSeparator(char c)
 {
-    Log::Warning("Trying to convert IP address {} to integer failed! Part of the address is not a number", address);
-    return 0;
+    return c == ':' || c == '-';
 }
-catch (const std::out_of_range&)
+}
+
+bool parseIpAddress(std::string_view address, std::uint32_t& ipAddress)
 {
-    // This one kinda doesn't make much sense, since stoi() allows 32-bit numbers, but each "part" of IP address string is 8... oh well.
-    Log::Warning("Trying to convert IP address {} to integer failed! Part of the address is too large", address);
-    return 0;
+    std::uint32_t value{};
+    const auto* ptr = address.data();
+    const auto* end = address.data() + address.size();
+
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i > 0)
+        {
+            if (ptr == end || *ptr != '.')
+                return false;
+            ++ptr;
+        }
+
+        unsigned octet{};
+        auto result = std::from_chars(ptr, end, octet);
+        if (result.ec != std::errc() || octet > 255 || result.ptr - ptr > 3)
+            return false;
+
+        value = (value << 8) | octet;
+        ptr = result.ptr;
+    }
+
+    if (ptr != end)
+        return false;
+
+    ipAddress = value;
+    return true;
 }
 
-std::string convertIpAddress(std::uint32_t address)
+bool parseHardwareAddress(std::string_view address, std::uint64_t& hwAddress)
 {
-    auto ret = std::to_string((address & 0xFF000000) >> 24) + "."
-             + std::to_string((address & 0x00FF0000) >> 16) + "."
-             + std::to_string((address & 0x0000FF00) >> 8 ) + "."
-             + std::to_string( address & 0x000000FF);
-    return ret;
+    std::uint64_t value{};
+
+    // The usual form, 11:22:33:44:55:66, has every digit and separator at a fixed position.
+    // Look all of them up without exiting early, so the compiler is free to unroll and vectorize it.
+    if (address.size() == 17)
+    {
+        bool invalid{};
+        for (std::size_t i = 0; i < 6; ++i)
+        {
+            const auto high = HexDigitValues[static_cast<std::uint8_t>(address[i * 3])];
+            const auto low = HexDigitValues[static_cast<std::uint8_t>(address[i * 3 + 1])];
+            invalid |= (high | low) < 0;
+            value = (value << 8) | static_cast<std::uint8_t>((high << 4) | low);
+        }
+
+        for (std::size_t i = 2; i < 17; i += 3)
+            invalid |= !isHardwareAddressSeparator(address[i]);
+
+        if (invalid)
+            return false;
+
+        hwAddress = value;
+        return true;
+    }
+
+    // Otherwise leading zeroes may have been left out, like 0:1b:2:3c:4:5d.
+    const auto* ptr = address.data();
+    const auto* end = address.data() + address.size();
+
+    for (int i = 0; i < 6; ++i)
+    {
+        if (i > 0)
+        {
+            if (ptr == end || !isHardwareAddressSeparator(*ptr))
+                return false;
+            ++ptr;
+        }
+
+        std::uint8_t octet{};
+        auto result = std::from_chars(ptr, ptr + std::min<std::ptrdiff_t>(2, end - ptr), octet, 16);
+        if (result.ec != std::errc())
+            return false;
+
+        value = (value << 8) | octet;
+        ptr = result.ptr;
+    }
+
+    if (ptr != end)
+        return false;
+
+    hwAddress = value;
+    return true;
 }
 
-std::string convertHardwareAddress(std::uint64_t address)
+IpAddressText formatIpAddress(std::uint32_t address)
 {
-    auto toHex = [](unsigned long long value)
+    IpAddressText text;
+    auto* ptr = text.data.data();
+    auto* const end = text.data.data() + text.data.size();
+
+    for (int shift = 24; shift >= 0; shift -= 8)
     {
-        return std::format("{:02X}", value);
-    };
-
-    auto ret = toHex((address & 0x0000FF0000000000ull) >> 40) + ":"
-             + toHex((address & 0x000000FF00000000ull) >> 32) + ":"
-             + toHex((address & 0x00000000FF000000ull) >> 24) + ":"
-             + toHex((address & 0x0000000000FF0000ull) >> 16) + ":"
-             + toHex((address & 0x000000000000FF00ull) >> 8 ) + ":"
-             + toHex( address & 0x00000000000000FFull);
-    return ret;
+        ptr = std::to_chars(ptr, end, (address >> shift) & 0xFF).ptr;
+        if (shift > 0)
+            *ptr++ = '.';
+    }
+
+    text.length = static_cast<std::uint8_t>(ptr - text.data.data());
+    return text;
 }
 
-std::uint64_t convertHardwareAddress(std::string_view address, bool& ok) try
+HardwareAddressText formatHardwareAddress(std::uint64_t address)
 {
-    std::uint8_t part[6]{};
+    HardwareAddressText text;
+    auto* ptr = text.data.data();
+
+    for (int shift = 40; shift >= 0; shift -= 8)
+    {
+        const auto octet = (address >> shift) & 0xFF;
+        *ptr++ = HexDigits[octet >> 4];
+        *ptr++ = HexDigits[octet & 0x0F];
+        if (shift > 0)
+            *ptr++ = ':';
+    }
+
+    text.length = static_cast<std::uint8_t>(ptr - text.data.data());
+    return text;
+}
 
+std::uint32_t convertIpAddress(std::string_view address, bool& ok)
+{
     if (address.empty())
         return 0;
 
-    ok = false; // for exceptions
+    std::uint32_t ipAddress{};
+    ok = parseIpAddress(address, ipAddress);
 
-    int count = 0;
-    for (std::uint8_t& i : part)
-    {
-        ++count;
-        auto pos = address.find(':');
-        std::string str(address.substr(0, pos));
-        i = std::stoi(str, nullptr, 16);
-        address = address.substr(pos + 1);
-    }
+    if (!ok)
+        Log::Warning("Trying to convert IP address {} to integer failed! Expected 4 numbers from 0 to 255 separated by dots", address);
 
-    ok = count == 6;
+    return ipAddress;
+}
 
-    return concatenateHardwareAddress(part[0], part[1], part[2], part[3], part[4], part[5]);
+std::string convertIpAddress(std::uint32_t address)
+{
+    return std::string(formatIpAddress(address).view());
 }
-catch (const std::invalid_argument&)
+
+std::string convertHardwareAddress(std::uint64_t address)
 {
-    Log::Warning("Trying to convert hardware address {} to integer failed! Part of the address is not a number", address);
-    return 0;
+    return std::string(formatHardwareAddress(address).view());
 }
-catch (const std::out_of_range&)
+
+std::uint64_t convertHardwareAddress(std::string_view address, bool& ok)
 {
-    // This one kinda doesn't make much sense, since stoi() allows 32-bit numbers, but each "part" of IP address string is 8... oh well.
-    Log::Warning("Trying to convert hardware address {} to integer failed! Part of the address is too large", address);
-    return 0;
+    if (address.empty())
+        return 0;
+
+    std::uint64_t hwAddress{};
+    ok = parseHardwareAddress(address, hwAddress);
+
+    if (!ok)
+        Log::Warning("Trying to convert hardware address {} to integer failed! Expected 6 hexadecimal numbers separated by colons", address);
+
+    return hwAddress;
 }
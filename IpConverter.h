@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <array>
+#include <format>
 #include <string>
 #include <string_view>
 #include <cstdint>
@@ -52,6 +54,44 @@ constexpr std::uint64_t concatenateHardwareAddress(std::uint8_t a, std::uint8_t
     return ret;
 }
 
+// Mixes the bits of a hardware address into a well distributed 64 bit hash (the SplitMix64 finalizer).
+// Stable across restarts and servers, so it can be used wherever the same client must get the same result.
+constexpr std::uint64_t hashHardwareAddress(std::uint64_t address)
+{
+    address ^= address >> 30;
+    address *= 0xBF58476D1CE4E5B9ull;
+    address ^= address >> 27;
+    address *= 0x94D049BB133111EBull;
+    address ^= address >> 31;
+    return address;
+}
+
+// Text representation of an address, kept in a fixed buffer so formatting one doesn't allocate.
+// Pass it directly to std::format/Log, or use view() for anything else. The view is only valid as long as this object is.
+template<std::size_t Capacity>
+struct AddressText
+{
+    std::array<char, Capacity> data{};
+    std::uint8_t length{};
+
+    std::string_view view() const { return { data.data(), length }; }
+};
+
+using IpAddressText = AddressText<16>;       // 255.255.255.255
+using HardwareAddressText = AddressText<18>; // AA:BB:CC:DD:EE:FF
+
+// Parses a dotted decimal IP address. Returns false, without logging anything, if it isn't exactly 4 numbers from 0 to 255.
+bool parseIpAddress(std::string_view address, std::uint32_t& ipAddress);
+
+// Parses a hardware address (MAC) of 6 hexadecimal bytes separated by colons or dashes. Returns false, without logging anything, if it isn't valid.
+bool parseHardwareAddress(std::string_view address, std::uint64_t& hwAddress);
+
+// Formats an IP address as dotted decimal.
+IpAddressText formatIpAddress(std::uint32_t address);
+
+// Formats a hardware address (MAC) as 6 uppercase hexadecimal bytes separated by colons.
+HardwareAddressText formatHardwareAddress(std::uint64_t address);
+
 // Converts a string representation of an IP address to a single 4 byte (32bit) integer.
 std::uint32_t convertIpAddress(std::string_view address, bool& ok);
 
@@ -63,3 +103,12 @@ std::uint64_t convertHardwareAddress(std::string_view address, bool& ok);
 
 // Converts a hardware address (MAC) represented as 64bit int to 6 byte hexadecimal string separated by colons.
 std::string convertHardwareAddress(std::uint64_t address);
+
+template<std::size_t Capacity>
+struct std::formatter<AddressText<Capacity>> : std::formatter<std::string_view>
+{
+    auto format(const AddressText<Capacity>& text, auto& context) const
+    {
+        return std::formatter<std::string_view>::format(text.view(), context);
+    }
+};
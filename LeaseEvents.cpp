@@ -0,0 +1,403 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "LeaseEvents.h"
+#include "Logger.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+namespace
+{
+constexpr auto PollInterval = std::chrono::milliseconds(100);
+
+/* The heap is rebuilt from the tracked leases once most of its entries are for leases since renewed or ended. */
+constexpr std::size_t MinCompactSize = 1024;
+
+std::time_t getExpiryTime(const Lease& lease)
+{
+    return lease.startTime + static_cast<std::time_t>(lease.leaseTime);
+}
+
+LeaseEvents::Type toEventType(LeaseChange change)
+{
+    switch (change)
+    {
+        case LeaseChange::Added: return LeaseEvents::Type::Granted;
+        case LeaseChange::Renewed: return LeaseEvents::Type::Renewed;
+        case LeaseChange::Removed: return LeaseEvents::Type::Released;
+        case LeaseChange::Released: return LeaseEvents::Type::Released;
+        case LeaseChange::Expired: return LeaseEvents::Type::Expired;
+        case LeaseChange::Declined: return LeaseEvents::Type::Declined;
+    }
+
+    return LeaseEvents::Type::Released;
+}
+
+LeaseEvents::Record makeRecord(LeaseEvents::Type type, std::uint64_t sequence)
+{
+    LeaseEvents::Record record{};
+    record.length = sizeof(record) - sizeof(record.length);
+    record.type = type;
+    record.sequence = sequence;
+    return record;
+}
+}
+
+LeaseEventPublisher::LeaseEventPublisher(std::string path, std::size_t bufferSize)
+    : m_path(std::move(path))
+    , m_bufferSize(std::max(bufferSize, 2 * sizeof(LeaseEvents::Record))) // Room for a Gap record and an event.
+{
+}
+
+LeaseEventPublisher::~LeaseEventPublisher()
+{
+    stop();
+}
+
+std::size_t LeaseEventPublisher::findInterface(const std::string& interface)
+{
+    const auto it = std::find_if(m_interfaces.begin(), m_interfaces.end(),
+                                 [&interface](const Interface& entry) { return entry.name == interface; });
+    if (it != m_interfaces.end())
+        return static_cast<std::size_t>(it - m_interfaces.begin());
+
+    m_interfaces.emplace_back().name = interface;
+    return m_interfaces.size() - 1;
+}
+
+LeaseListener LeaseEventPublisher::getLeaseListener(const std::string& interface)
+{
+    const auto interfaceIndex = findInterface(interface);
+    return [this, interfaceIndex](LeaseChange change, const Lease& lease) { leaseChanged(interfaceIndex, change, lease); };
+}
+
+void LeaseEventPublisher::addInterface(const std::string& interface, const LeaseTable& table, std::uint32_t maximumLeaseTime)
+{
+    const auto interfaceIndex = findInterface(interface);
+    m_interfaces[interfaceIndex].maximumLeaseTime = maximumLeaseTime;
+
+    const auto now = std::time(nullptr);
+    for (const auto& lease : table.snapshot())
+    {
+        /* Expired before we started, so not ours to report. */
+        const auto leaseTime = lease.leaseTime != 0 ? lease.leaseTime : maximumLeaseTime;
+        if (now - lease.startTime <= leaseTime)
+            track(interfaceIndex, lease);
+    }
+}
+
+bool LeaseEventPublisher::start()
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (m_path.empty() || m_path.size() >= sizeof(addr.sun_path))
+    {
+        Log::Critical("Lease event socket path {} is empty or too long", m_path);
+        return false;
+    }
+    std::memcpy(addr.sun_path, m_path.data(), m_path.size());
+
+    m_listenfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listenfd < 0)
+    {
+        const auto e = errno;
+        Log::Critical("Lease event socket() error, errno={}", e);
+        return false;
+    }
+
+    /* Left behind if the daemon didn't stop cleanly. */
+    unlink(m_path.c_str());
+
+    if (bind(m_listenfd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || listen(m_listenfd, MaxSubscribers) != 0)
+    {
+        const auto e = errno;
+        Log::Critical("Lease events couldn't listen on {}, errno={}", m_path, e);
+        close(m_listenfd);
+        m_listenfd = -1;
+        return false;
+    }
+
+    m_running = true;
+    m_thread = std::thread(&LeaseEventPublisher::threadFn, this);
+    return true;
+}
+
+void LeaseEventPublisher::stop()
+{
+    m_stopped = true;
+    m_running = false;
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if (m_listenfd >= 0)
+    {
+        close(m_listenfd);
+        m_listenfd = -1;
+        unlink(m_path.c_str());
+    }
+}
+
+void LeaseEventPublisher::leaseChanged(std::size_t interfaceIndex, LeaseChange change, const Lease& lease)
+{
+    if (m_stopped)
+        return;
+
+    std::lock_guard lock(m_mutex);
+    if (m_pending.size() >= MaxPending)
+        ++m_pendingLost;
+    else
+        m_pending.push_back({ interfaceIndex, change, lease });
+}
+
+void LeaseEventPublisher::threadFn()
+{
+    Log::Info("Lease events published on {}", m_path);
+
+    std::vector<pollfd> pollfds;
+
+    while (m_running)
+    {
+        pollfds.assign(1, { m_listenfd, POLLIN, 0 });
+        for (const auto& subscriber : m_subscribers)
+            pollfds.push_back({ subscriber.sockfd, static_cast<short>(subscriber.output.empty() ? POLLIN : POLLIN | POLLOUT), 0 });
+
+        if (poll(pollfds.data(), pollfds.size(), static_cast<int>(PollInterval.count())) < 0)
+            continue;
+
+        for (std::size_t i = 0; i < m_subscribers.size(); ++i)
+        {
+            auto& subscriber = m_subscribers[i];
+            const auto events = pollfds[i + 1].revents;
+
+            bool keep = (events & (POLLERR | POLLNVAL)) == 0;
+            if (keep && (events & (POLLIN | POLLHUP)))
+                keep = receiveInput(subscriber);
+            if (keep && (events & POLLOUT))
+                keep = sendOutput(subscriber);
+
+            if (!keep)
+            {
+                close(subscriber.sockfd);
+                subscriber.sockfd = -1;
+            }
+        }
+
+        std::erase_if(m_subscribers, [](const Subscriber& subscriber) { return subscriber.sockfd < 0; });
+
+        if (pollfds[0].revents & POLLIN)
+            acceptSubscriber();
+
+        applyPending();
+        expireLeases();
+
+        /* Tell those who lost events as soon as there's room, rather than with the next event. */
+        for (auto& subscriber : m_subscribers)
+        {
+            if (subscriber.lost > 0)
+                appendGap(subscriber);
+        }
+    }
+
+    for (const auto& subscriber : m_subscribers)
+        close(subscriber.sockfd);
+    m_subscribers.clear();
+}
+
+void LeaseEventPublisher::acceptSubscriber()
+{
+    const int sockfd = accept(m_listenfd, nullptr, nullptr);
+    if (sockfd < 0)
+        return;
+
+    if (m_subscribers.size() >= MaxSubscribers)
+    {
+        Log::Warning("Lease event subscriber refused, {} subscribers already", MaxSubscribers);
+        close(sockfd);
+        return;
+    }
+
+    m_subscribers.emplace_back().sockfd = sockfd;
+}
+
+void LeaseEventPublisher::applyPending()
+{
+    std::deque<Change> pending;
+    std::uint64_t lost{};
+    {
+        std::lock_guard lock(m_mutex);
+        pending.swap(m_pending);
+        lost = std::exchange(m_pendingLost, 0);
+    }
+
+    for (const auto& change : pending)
+        applyChange(change);
+
+    if (lost > 0)
+        publishLost(lost);
+}
+
+/*
+ * Leases are told apart by hardware address. A lease ending is only published if it's the one tracked, so a lease
+ * already reported expired isn't reported again when the network gets around to removing it.
+*/
+void LeaseEventPublisher::applyChange(const Change& change)
+{
+    auto& leases = m_interfaces[change.interfaceIndex].leases;
+    const auto it = leases.find(change.lease.hwAddress);
+
+    if (isLeaseHeld(change.change))
+    {
+        /* A new lease on the address the client had, after it ran out. */
+        if (it != leases.end() && change.change == LeaseChange::Added)
+        {
+            publish(LeaseEvents::Type::Expired, change.interfaceIndex, it->second);
+            leases.erase(it);
+        }
+
+        track(change.interfaceIndex, change.lease);
+        publish(toEventType(change.change), change.interfaceIndex, leases.at(change.lease.hwAddress));
+        return;
+    }
+
+    if (it == leases.end() || it->second.ipAddress != change.lease.ipAddress)
+        return;
+
+    publish(toEventType(change.change), change.interfaceIndex, it->second);
+    leases.erase(it);
+}
+
+void LeaseEventPublisher::expireLeases()
+{
+    const auto now = std::time(nullptr);
+    while (!m_expiries.empty() && m_expiries.front().time < now)
+    {
+        std::pop_heap(m_expiries.begin(), m_expiries.end(), std::greater<>());
+        const auto expiry = m_expiries.back();
+        m_expiries.pop_back();
+
+        auto& leases = m_interfaces[expiry.interfaceIndex].leases;
+        const auto it = leases.find(expiry.hwAddress);
+        if (it == leases.end() || getExpiryTime(it->second) != expiry.time)
+            continue;
+
+        publish(LeaseEvents::Type::Expired, expiry.interfaceIndex, it->second);
+        leases.erase(it);
+    }
+}
+
+void LeaseEventPublisher::track(std::size_t interfaceIndex, Lease lease)
+{
+    auto& interface = m_interfaces[interfaceIndex];
+    if (lease.leaseTime == 0)
+        lease.leaseTime = interface.maximumLeaseTime;
+
+    m_expiries.push_back({ getExpiryTime(lease), interfaceIndex, lease.hwAddress });
+    std::push_heap(m_expiries.begin(), m_expiries.end(), std::greater<>());
+    interface.leases[lease.hwAddress] = lease;
+
+    compactExpiries();
+}
+
+void LeaseEventPublisher::compactExpiries()
+{
+    std::size_t tracked{};
+    for (const auto& interface : m_interfaces)
+        tracked += interface.leases.size();
+
+    if (m_expiries.size() < std::max(MinCompactSize, 2 * tracked))
+        return;
+
+    m_expiries.clear();
+    for (std::size_t i = 0; i < m_interfaces.size(); ++i)
+    {
+        for (const auto& [hwAddress, lease] : m_interfaces[i].leases)
+            m_expiries.push_back({ getExpiryTime(lease), i, hwAddress });
+    }
+
+    std::make_heap(m_expiries.begin(), m_expiries.end(), std::greater<>());
+}
+
+void LeaseEventPublisher::publish(LeaseEvents::Type type, std::size_t interfaceIndex, const Lease& lease)
+{
+    auto record = makeRecord(type, m_sequence++);
+    const auto& name = m_interfaces[interfaceIndex].name;
+    std::memcpy(record.interface, name.data(), std::min(name.size(), sizeof(record.interface)));
+    record.startTime = lease.startTime;
+    record.hwAddress = lease.hwAddress;
+    record.ipAddress = lease.ipAddress;
+    record.leaseTime = lease.leaseTime;
+
+    for (auto& subscriber : m_subscribers)
+    {
+        if ((subscriber.lost > 0 && !appendGap(subscriber)) || !append(subscriber, record))
+        {
+            ++subscriber.lost;
+            subscriber.lastLost = record.sequence;
+        }
+    }
+}
+
+void LeaseEventPublisher::publishLost(std::uint64_t lost)
+{
+    m_sequence += lost;
+    Log::Warning("{} lease events lost, they came faster than they could be published", lost);
+
+    for (auto& subscriber : m_subscribers)
+    {
+        subscriber.lost += lost;
+        subscriber.lastLost = m_sequence - 1;
+    }
+}
+
+bool LeaseEventPublisher::appendGap(Subscriber& subscriber) const
+{
+    auto record = makeRecord(LeaseEvents::Type::Gap, subscriber.lastLost);
+    record.lost = subscriber.lost;
+    if (!append(subscriber, record))
+        return false;
+
+    subscriber.lost = 0;
+    return true;
+}
+
+bool LeaseEventPublisher::append(Subscriber& subscriber, const LeaseEvents::Record& record) const
+{
+    if (subscriber.output.size() + sizeof(record) > m_bufferSize)
+        return false;
+
+    const auto* data = reinterpret_cast<const std::uint8_t*>(&record);
+    subscriber.output.insert(subscriber.output.end(), data, data + sizeof(record));
+    return true;
+}
+
+/* Subscribers aren't expected to send anything, reading only tells when they go away. */
+bool LeaseEventPublisher::receiveInput(const Subscriber& subscriber)
+{
+    std::uint8_t buffer[256];
+    const auto received = recv(subscriber.sockfd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    return received > 0 || (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+}
+
+bool LeaseEventPublisher::sendOutput(Subscriber& subscriber)
+{
+    const auto sent = ::send(subscriber.sockfd, subscriber.output.data(), subscriber.output.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+    subscriber.output.erase(subscriber.output.begin(), subscriber.output.begin() + sent);
+    return true;
+}
@@ -0,0 +1,160 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include "LeaseTable.h"
+#include "Network.h"
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Lease events for other programs on the host, ie. to update DNS or an inventory as leases come and go. Subscribers
+ * connect to a Unix stream socket and are sent a record for every lease granted, renewed, released, expired or
+ * declined from then on. Records are fixed size and in the host's byte order, each starting with its length so
+ * that fields can be added at the end.
+ *
+ * Each subscriber has a buffer of its own. A subscriber reading too slowly to keep up loses the events that don't
+ * fit, and is sent a Gap record telling how many once there's room again. Subscribers never hold up serving DHCP.
+*/
+namespace LeaseEvents
+{
+    enum class Type : std::uint8_t
+    {
+        Granted,
+        Renewed,
+        Released, // By the client, or left behind when the client was given another address.
+        Expired,
+        Declined,
+        Gap       // Events were lost. Only sequence, of the last event lost, and lost are set.
+    };
+
+    struct Record
+    {
+        std::uint32_t length; // Bytes following this field.
+        Type type;
+        std::uint8_t reserved[3];
+        std::uint64_t sequence; // Counts every event, including lost ones.
+        char interface[16];     // Zero padded, as IFNAMSIZ.
+        std::int64_t startTime;
+        std::uint64_t hwAddress;
+        std::uint32_t ipAddress;
+        std::uint32_t leaseTime; // Seconds from startTime, never 0.
+        std::uint64_t lost;
+    };
+
+    static_assert(sizeof(Record) == 64);
+}
+
+/*
+ * Publishes the lease changes of every added interface on a thread of its own. The networks' listeners only queue
+ * the change, which is bounded as well: Changes coming faster than the thread can take them are lost for everyone.
+ *
+ * The networks only find a lease expired when its address or client is next looked at, which may be never. So the
+ * publisher keeps track of the leases itself and reports them expired as their time runs out. Each lease gets one
+ * event ending it, whichever comes first.
+*/
+class LeaseEventPublisher
+{
+public:
+    static constexpr std::size_t MaxSubscribers = 64;
+    static constexpr std::size_t MaxPending = 65536;
+
+    // The socket is made at path by start(), replacing whatever was there. Subscribers buffer up to bufferSize bytes.
+    LeaseEventPublisher(std::string path, std::size_t bufferSize);
+    ~LeaseEventPublisher();
+
+    LeaseEventPublisher(const LeaseEventPublisher&) = delete;
+    LeaseEventPublisher& operator=(const LeaseEventPublisher&) = delete;
+
+    // A listener for the interface's network. Must be called before start().
+    LeaseListener getLeaseListener(const std::string& interface);
+
+    // Must be called before start(). Tracks the interface's leases from the table, ie. loaded from the lease file, to
+    // report them expired. Leases without a lease time of their own are taken to have the interface's maximum lease
+    // time, as the network gives them.
+    void addInterface(const std::string& interface, const LeaseTable& table, std::uint32_t maximumLeaseTime);
+
+    // Returns false if the socket couldn't be created.
+    bool start();
+
+    // Stops publishing, and removes the socket. Changes are ignored after this.
+    void stop();
+
+private:
+    struct Change
+    {
+        std::size_t interfaceIndex;
+        LeaseChange change;
+        Lease lease;
+    };
+
+    struct Expiry
+    {
+        std::time_t time;
+        std::size_t interfaceIndex;
+        std::uint64_t hwAddress;
+
+        bool operator>(const Expiry& other) const { return time > other.time; }
+    };
+
+    struct Interface
+    {
+        std::string name;
+        std::uint32_t maximumLeaseTime{};
+        std::unordered_map<std::uint64_t, Lease> leases; // By hardware address, with the lease time filled in.
+    };
+
+    struct Subscriber
+    {
+        int sockfd{ -1 };
+        std::vector<std::uint8_t> output; // Not sent yet.
+        std::uint64_t lost{}; // Events not buffered since the last Gap record.
+        std::uint64_t lastLost{}; // Sequence number of the last of them.
+    };
+
+    std::string m_path;
+    std::size_t m_bufferSize;
+    std::vector<Interface> m_interfaces;
+    std::vector<Expiry> m_expiries; // Min-heap. Entries for leases since renewed or ended are skipped.
+    std::vector<Subscriber> m_subscribers;
+    std::uint64_t m_sequence{};
+
+    std::mutex m_mutex;
+    std::deque<Change> m_pending;
+    std::uint64_t m_pendingLost{};
+
+    int m_listenfd{ -1 };
+    std::thread m_thread;
+    std::atomic_bool m_running{};
+    std::atomic_bool m_stopped{};
+
+    std::size_t findInterface(const std::string& interface);
+    void leaseChanged(std::size_t interfaceIndex, LeaseChange change, const Lease& lease);
+
+    void threadFn();
+    void acceptSubscriber();
+    void applyPending();
+    void applyChange(const Change& change);
+    void expireLeases();
+    void track(std::size_t interfaceIndex, Lease lease);
+    void compactExpiries();
+    void publish(LeaseEvents::Type type, std::size_t interfaceIndex, const Lease& lease);
+    void publishLost(std::uint64_t lost);
+    bool appendGap(Subscriber& subscriber) const;
+    bool append(Subscriber& subscriber, const LeaseEvents::Record& record) const;
+    static bool receiveInput(const Subscriber& subscriber);
+    static bool sendOutput(Subscriber& subscriber);
+};
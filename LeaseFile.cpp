@@ -0,0 +1,199 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "LeaseFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+LeaseFile::LeaseFile(const std::string& filename)
+    : m_file(filename)
+{
+}
+
+bool LeaseFile::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+std::size_t LeaseFile::getRecordCount() const
+{
+    return m_file.getData().size() / LeaseLen;
+}
+
+Lease LeaseFile::getRecord(std::size_t index) const
+{
+    const auto* ptr = m_file.getData().data() + index * LeaseLen;
+
+    Lease lease;
+    std::memcpy(&lease.startTime, ptr, StartTimeLen);
+    std::memcpy(&lease.hwAddress, ptr + StartTimeLen, HwAddressLen);
+    std::memcpy(&lease.ipAddress, ptr + StartTimeLen + HwAddressLen, IpAddressLen);
+    return lease;
+}
+
+LeaseFileWriter::LeaseFileWriter(const std::string& filename)
+    : m_filename(filename)
+    , m_tempFilename(filename + ".tmp")
+    , m_stream(m_tempFilename, std::ios::out | std::ios::binary | std::ios::trunc)
+{
+}
+
+LeaseFileWriter::~LeaseFileWriter()
+{
+    if (m_stream.is_open())
+    {
+        m_stream.close();
+        std::remove(m_tempFilename.c_str());
+    }
+}
+
+bool LeaseFileWriter::isOpen() const
+{
+    return m_stream.is_open();
+}
+
+void LeaseFileWriter::write(const Lease& lease)
+{
+    char record[LeaseLen];
+    std::memcpy(record, &lease.startTime, StartTimeLen);
+    std::memcpy(record + StartTimeLen, &lease.hwAddress, HwAddressLen);
+    std::memcpy(record + StartTimeLen + HwAddressLen, &lease.ipAddress, IpAddressLen);
+    m_stream.write(record, LeaseLen);
+}
+
+bool LeaseFileWriter::commit()
+{
+    if (!m_stream.is_open())
+        return false;
+
+    m_stream.close();
+    if (!m_stream.good() || std::rename(m_tempFilename.c_str(), m_filename.c_str()) != 0)
+    {
+        std::remove(m_tempFilename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+LeaseSorter::LeaseSorter(Compare compare, std::size_t limit, std::string tempDirectory)
+    : m_compare(compare)
+    , m_limit(std::max<std::size_t>(limit, 1))
+    , m_tempDirectory(std::move(tempDirectory))
+{
+}
+
+LeaseSorter::~LeaseSorter()
+{
+    m_runs.clear();
+    for (const auto& filename : m_runFilenames)
+        std::remove(filename.c_str());
+}
+
+void LeaseSorter::add(const Lease& lease)
+{
+    if (m_buffer.size() >= m_limit && !spill())
+        m_failed = true;
+
+    m_buffer.push_back(lease);
+}
+
+bool LeaseSorter::spill()
+{
+    std::sort(m_buffer.begin(), m_buffer.end(), m_compare);
+
+    std::string filename = m_tempDirectory + "/tdhcpd-sort-XXXXXX";
+    const int fd = mkstemp(filename.data());
+    if (fd < 0)
+    {
+        m_buffer.clear();
+        return false;
+    }
+
+    close(fd);
+    m_runFilenames.push_back(filename);
+
+    LeaseFileWriter writer(filename);
+    for (const auto& lease : m_buffer)
+        writer.write(lease);
+
+    m_buffer.clear();
+    return writer.commit();
+}
+
+bool LeaseSorter::heapLess(std::size_t a, std::size_t b) const
+{
+    // std::push_heap() keeps the greatest on top, so this is reversed to get the least.
+    return m_compare(m_runs[b]->getRecord(m_positions[b]), m_runs[a]->getRecord(m_positions[a]));
+}
+
+bool LeaseSorter::sort()
+{
+    if (m_runFilenames.empty())
+    {
+        std::sort(m_buffer.begin(), m_buffer.end(), m_compare);
+        return !m_failed;
+    }
+
+    if (!m_buffer.empty() && !spill())
+        m_failed = true;
+
+    m_buffer = {};
+
+    const auto less = [this](std::size_t a, std::size_t b) { return heapLess(a, b); };
+    for (const auto& filename : m_runFilenames)
+    {
+        auto& run = m_runs.emplace_back(std::make_unique<LeaseFile>(filename));
+        m_positions.push_back(0);
+
+        if (!run->isOpen())
+            m_failed = true;
+        else if (run->getRecordCount() > 0)
+        {
+            m_heap.push_back(m_runs.size() - 1);
+            std::push_heap(m_heap.begin(), m_heap.end(), less);
+        }
+    }
+
+    return !m_failed;
+}
+
+bool LeaseSorter::next(Lease& lease)
+{
+    if (m_runs.empty())
+    {
+        if (m_bufferPosition >= m_buffer.size())
+            return false;
+
+        lease = m_buffer[m_bufferPosition++];
+        return true;
+    }
+
+    if (m_heap.empty())
+        return false;
+
+    const auto less = [this](std::size_t a, std::size_t b) { return heapLess(a, b); };
+    std::pop_heap(m_heap.begin(), m_heap.end(), less);
+
+    const auto run = m_heap.back();
+    lease = m_runs[run]->getRecord(m_positions[run]++);
+
+    if (m_positions[run] < m_runs[run]->getRecordCount())
+        std::push_heap(m_heap.begin(), m_heap.end(), less);
+    else
+        m_heap.pop_back();
+
+    return true;
+}
+
+std::size_t LeaseSorter::getRunCount() const
+{
+    return m_runFilenames.size();
+}
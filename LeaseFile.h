@@ -0,0 +1,136 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include "MappedFile.h"
+#include "Structures.h"
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * A lease file mapped into memory and read one record at a time, so even huge files are never copied as a whole.
+ * Records are startTime, hwAddress and ipAddress back to back in native byte order, LeaseLen bytes each. Unused
+ * records have a start time of 0 and are skipped, as is a partial record at the end.
+*/
+class LeaseFile
+{
+    MappedFile m_file;
+
+public:
+    explicit LeaseFile(const std::string& filename);
+
+    // False if the file couldn't be opened. An empty file is open, with no records.
+    [[nodiscard]]
+    bool isOpen() const;
+
+    // Number of records in the file, including unused ones.
+    [[nodiscard]]
+    std::size_t getRecordCount() const;
+
+    // The record at index, whether it's used or not. index must be less than getRecordCount().
+    [[nodiscard]]
+    Lease getRecord(std::size_t index) const;
+
+    // Calls func(const Lease&) for every used record, in file order.
+    template<typename Func>
+    void forEach(Func&& func) const
+    {
+        const auto data = m_file.getData();
+        const auto count = data.size() / LeaseLen;
+        const auto* ptr = data.data();
+
+        Lease lease;
+        for (std::size_t i = 0; i < count; ++i, ptr += LeaseLen)
+        {
+            std::memcpy(&lease.startTime, ptr, StartTimeLen);
+            if (lease.startTime == 0)
+                continue;
+
+            std::memcpy(&lease.hwAddress, ptr + StartTimeLen, HwAddressLen);
+            std::memcpy(&lease.ipAddress, ptr + StartTimeLen + HwAddressLen, IpAddressLen);
+            func(lease);
+        }
+    }
+};
+
+/*
+ * Writes a lease file one record at a time. The records go to filename.tmp, which replaces filename on commit(), so
+ * whoever has the old file mapped keeps reading a complete file.
+*/
+class LeaseFileWriter
+{
+    std::string m_filename;
+    std::string m_tempFilename;
+    std::ofstream m_stream;
+
+public:
+    explicit LeaseFileWriter(const std::string& filename);
+    ~LeaseFileWriter();
+
+    LeaseFileWriter(const LeaseFileWriter&) = delete;
+    LeaseFileWriter& operator=(const LeaseFileWriter&) = delete;
+
+    [[nodiscard]]
+    bool isOpen() const;
+
+    void write(const Lease& lease);
+
+    // Returns false if anything failed to be written, the old file is left as it was then.
+    bool commit();
+};
+
+/*
+ * Sorts any number of leases in bounded memory. Leases are collected up to a limit, then sorted and written to a
+ * temporary run file. Reading them back merges the runs, one lease from each at a time, so memory use stays at the
+ * limit no matter how many leases there are. With fewer leases than the limit nothing is written to disk.
+*/
+class LeaseSorter
+{
+public:
+    using Compare = bool (*)(const Lease&, const Lease&);
+
+private:
+    Compare m_compare;
+    std::size_t m_limit;
+    std::string m_tempDirectory;
+    std::vector<Lease> m_buffer;
+    std::vector<std::string> m_runFilenames;
+    std::vector<std::unique_ptr<LeaseFile>> m_runs;
+    std::vector<std::size_t> m_positions;
+    std::vector<std::size_t> m_heap; // Indexes of the runs, by their next lease.
+    std::size_t m_bufferPosition{};
+    bool m_failed{};
+
+    bool spill();
+    bool heapLess(std::size_t a, std::size_t b) const;
+
+public:
+    // limit is the most leases held in memory. Run files are made in tempDirectory.
+    LeaseSorter(Compare compare, std::size_t limit, std::string tempDirectory);
+    ~LeaseSorter();
+
+    LeaseSorter(const LeaseSorter&) = delete;
+    LeaseSorter& operator=(const LeaseSorter&) = delete;
+
+    void add(const Lease& lease);
+
+    // Ends adding. Returns false if a run file couldn't be written or read back.
+    bool sort();
+
+    // After sort(), gives the leases in order. Returns false when there are no more.
+    bool next(Lease& lease);
+
+    // Number of run files written so far.
+    [[nodiscard]]
+    std::size_t getRunCount() const;
+};
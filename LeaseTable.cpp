@@ -0,0 +1,144 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "LeaseTable.h"
+
+LeaseTable::LeaseTable()
+    : m_chunks(std::make_unique<std::atomic<Slot*>[]>(MaxChunks))
+{}
+
+LeaseTable::~LeaseTable()
+{
+    const auto chunkCount = m_chunkCount.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < chunkCount; ++i)
+        delete[] m_chunks[i].load(std::memory_order_relaxed);
+}
+
+bool LeaseTable::set(const Lease& lease)
+{
+    auto it = m_slotByHw.find(lease.hwAddress);
+    if (it == m_slotByHw.end())
+    {
+        std::uint32_t index{};
+        if (!m_freeSlots.empty())
+        {
+            index = m_freeSlots.back();
+            m_freeSlots.pop_back();
+        }
+        else
+        {
+            const auto chunkCount = m_chunkCount.load(std::memory_order_relaxed);
+            if (m_nextSlot == chunkCount * ChunkSize)
+            {
+                if (chunkCount == MaxChunks)
+                    return false;
+
+                /* Published after it's zeroed, readers see either the chunk with free slots or no chunk. */
+                m_chunks[chunkCount].store(new Slot[ChunkSize], std::memory_order_release);
+                m_chunkCount.store(chunkCount + 1, std::memory_order_release);
+            }
+
+            index = m_nextSlot++;
+        }
+
+        it = m_slotByHw.emplace(lease.hwAddress, index).first;
+        m_size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    write(getSlot(it->second), lease);
+    return true;
+}
+
+void LeaseTable::remove(std::uint64_t hwAddress)
+{
+    auto it = m_slotByHw.find(hwAddress);
+    if (it == m_slotByHw.end())
+        return;
+
+    write(getSlot(it->second), Lease{});
+    m_freeSlots.emplace_back(it->second);
+    m_slotByHw.erase(it);
+    m_size.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void LeaseTable::clear()
+{
+    for (const auto& [hwAddress, index] : m_slotByHw)
+    {
+        write(getSlot(index), Lease{});
+        m_freeSlots.emplace_back(index);
+    }
+
+    m_slotByHw.clear();
+    m_size.store(0, std::memory_order_relaxed);
+}
+
+std::vector<Lease> LeaseTable::snapshot() const
+{
+    std::vector<Lease> leases;
+    leases.reserve(size());
+    forEach([&leases](const Lease& lease) { leases.emplace_back(lease); });
+    return leases;
+}
+
+std::uint64_t LeaseTable::getVersion() const
+{
+    return m_version.load(std::memory_order_acquire);
+}
+
+std::size_t LeaseTable::getSlotCount() const
+{
+    return m_chunkCount.load(std::memory_order_acquire) * ChunkSize;
+}
+
+std::size_t LeaseTable::size() const
+{
+    return m_size.load(std::memory_order_relaxed);
+}
+
+LeaseTable::Slot& LeaseTable::getSlot(std::uint32_t index) const
+{
+    return m_chunks[index / ChunkSize].load(std::memory_order_relaxed)[index % ChunkSize];
+}
+
+void LeaseTable::write(Slot& slot, const Lease& lease)
+{
+    const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.startTime.store(lease.startTime, std::memory_order_relaxed);
+    slot.hwAddress.store(lease.hwAddress, std::memory_order_relaxed);
+    slot.ipAddress.store(lease.ipAddress, std::memory_order_relaxed);
+    slot.leaseTime.store(lease.leaseTime, std::memory_order_relaxed);
+    slot.relayId.store(lease.relayAgent.relayId, std::memory_order_relaxed);
+    slot.remoteId.store(lease.relayAgent.remoteId, std::memory_order_relaxed);
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    m_version.fetch_add(1, std::memory_order_release);
+}
+
+bool LeaseTable::read(const Slot& slot, Lease& lease)
+{
+    while (true)
+    {
+        const auto before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            continue; // Being written, which only takes a moment.
+
+        lease.startTime = slot.startTime.load(std::memory_order_relaxed);
+        lease.hwAddress = slot.hwAddress.load(std::memory_order_relaxed);
+        lease.ipAddress = slot.ipAddress.load(std::memory_order_relaxed);
+        lease.leaseTime = slot.leaseTime.load(std::memory_order_relaxed);
+        lease.relayAgent.relayId = slot.relayId.load(std::memory_order_relaxed);
+        lease.relayAgent.remoteId = slot.remoteId.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before)
+            return lease.startTime != 0;
+    }
+}
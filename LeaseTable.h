@@ -0,0 +1,135 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include "Structures.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Copy of an interface's leases that other threads can read while the interface's thread keeps changing it.
+ *
+ * Leases live in slots of fixed size chunks, which are never moved or freed while the table exists. Each slot is
+ * guarded by its own sequence number (a seqlock): The writer makes it odd while it changes the slot and even again
+ * when done. A reader copies the slot and tries again if the sequence number was odd or changed meanwhile.
+ * Readers never take a lock and never make the writer wait.
+ *
+ * Every lease a reader gets is consistent, but the table as a whole is not frozen while iterating: Leases changed
+ * during the iteration may be seen either before or after the change. getVersion() tells if anything changed.
+*/
+class LeaseTable
+{
+public:
+    static constexpr std::size_t ChunkSize = 1024;
+    static constexpr std::size_t MaxChunks = 16384; // Room for a /8.
+
+    LeaseTable();
+    ~LeaseTable();
+
+    LeaseTable(const LeaseTable&) = delete;
+    LeaseTable& operator=(const LeaseTable&) = delete;
+
+    /*
+     * Writer side. Only one thread may change the table.
+    */
+
+    // Adds the lease, or replaces the lease of the same hardware address. Returns false if the table is full.
+    bool set(const Lease& lease);
+
+    void remove(std::uint64_t hwAddress);
+
+    void clear();
+
+    /*
+     * Reader side. Safe from any thread, at any time.
+    */
+
+    // Calls function with a copy of every lease in the table.
+    template<typename Function>
+    void forEach(Function&& function) const
+    {
+        const auto chunkCount = m_chunkCount.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < chunkCount; ++i)
+        {
+            const auto* chunk = m_chunks[i].load(std::memory_order_acquire);
+            for (std::size_t j = 0; j < ChunkSize; ++j)
+            {
+                Lease lease;
+                if (read(chunk[j], lease))
+                    function(lease);
+            }
+        }
+    }
+
+    /*
+     * Calls function with a copy of every lease in up to slotCount slots from firstSlot, and returns the slot to go
+     * on from. Lets a reader go through the table a part at a time, it's done once this reaches getSlotCount().
+    */
+    template<typename Function>
+    std::size_t forEachInSlots(std::size_t firstSlot, std::size_t slotCount, Function&& function) const
+    {
+        const auto endSlot = std::min(firstSlot + slotCount, getSlotCount());
+        for (auto index = firstSlot; index < endSlot; ++index)
+        {
+            Lease lease;
+            if (read(getSlot(static_cast<std::uint32_t>(index)), lease))
+                function(lease);
+        }
+
+        return std::max(firstSlot, endSlot);
+    }
+
+    [[nodiscard]]
+    std::vector<Lease> snapshot() const;
+
+    // Slots in use or free, grows as the table does.
+    [[nodiscard]]
+    std::size_t getSlotCount() const;
+
+    // Changes every time a lease is set or removed.
+    [[nodiscard]]
+    std::uint64_t getVersion() const;
+
+    [[nodiscard]]
+    std::size_t size() const;
+
+private:
+    /* The lease is kept in atomics, so that the reader racing the writer is well defined. A startTime of 0 is a free slot. */
+    struct Slot
+    {
+        std::atomic<std::uint32_t> sequence{};
+        std::atomic<std::time_t> startTime{};
+        std::atomic<std::uint64_t> hwAddress{};
+        std::atomic<std::uint32_t> ipAddress{};
+        std::atomic<std::uint32_t> leaseTime{};
+        std::atomic<std::uint64_t> relayId{};
+        std::atomic<std::uint64_t> remoteId{};
+    };
+
+    std::unique_ptr<std::atomic<Slot*>[]> m_chunks;
+    std::atomic<std::size_t> m_chunkCount{};
+    std::atomic<std::uint64_t> m_version{};
+    std::atomic<std::size_t> m_size{};
+
+    // Only used by the writer.
+    std::unordered_map<std::uint64_t, std::uint32_t> m_slotByHw;
+    std::vector<std::uint32_t> m_freeSlots;
+    std::uint32_t m_nextSlot{};
+
+    Slot& getSlot(std::uint32_t index) const;
+
+    void write(Slot& slot, const Lease& lease);
+
+    // Returns false for a free slot.
+    static bool read(const Slot& slot, Lease& lease);
+};
@@ -0,0 +1,343 @@
+/*
+ * TDHCPD Lease Tool - Merge, compact and compare lease files made by TDHCPD.
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "IpConverter.h"
+#include "LeaseFile.h"
+#include "Structures.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <ctime>
+#include <format>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+void print(std::string_view format, auto&&...args)
+{
+    std::cout << std::vformat(format, std::make_format_args(args...));
+}
+
+namespace
+{
+struct Options
+{
+    std::string command;
+    std::vector<std::string> inputs;
+    std::string output;
+    std::uint32_t leaseTime{}; // 0 keeps expired leases.
+    std::size_t memoryLimit{ 64 }; // MiB
+    std::string tempDirectory;
+};
+
+/* The newest lease of each hardware address, or IP address, comes first so the rest are easy to skip. */
+bool newestByHardwareAddress(const Lease& a, const Lease& b)
+{
+    return a.hwAddress != b.hwAddress ? a.hwAddress < b.hwAddress : a.startTime > b.startTime;
+}
+
+bool newestByIpAddress(const Lease& a, const Lease& b)
+{
+    return a.ipAddress != b.ipAddress ? a.ipAddress < b.ipAddress : a.startTime > b.startTime;
+}
+
+class Reader
+{
+    const Options& m_options;
+    std::time_t m_now{ std::time(nullptr) };
+
+public:
+    std::size_t records{};
+    std::size_t expired{};
+
+    explicit Reader(const Options& options)
+        : m_options(options)
+    {
+    }
+
+    // Adds the leases of a file that haven't expired to sorter.
+    bool read(const std::string& filename, LeaseSorter& sorter)
+    {
+        LeaseFile file(filename);
+        if (!file.isOpen())
+        {
+            print("Couldn't open {}\n", filename);
+            return false;
+        }
+
+        file.forEach([&](const Lease& lease)
+        {
+            ++records;
+            if (m_options.leaseTime > 0 && lease.startTime + static_cast<std::time_t>(m_options.leaseTime) <= m_now)
+                ++expired;
+            else
+                sorter.add(lease);
+        });
+
+        return true;
+    }
+};
+
+std::size_t getSortLimit(const Options& options)
+{
+    return options.memoryLimit * 1024 * 1024 / sizeof(Lease);
+}
+
+/*
+ * Every input is sorted by hardware address and only the newest lease of each is kept. Those are then sorted by IP
+ * address, and if two clients hold the same address the newest one keeps it. The output ends up sorted by IP address.
+ * The first sort keeps its last leases in memory while the second fills, so they get half the memory each.
+*/
+int merge(const Options& options)
+{
+    Reader reader(options);
+    LeaseSorter byHardwareAddress(newestByHardwareAddress, getSortLimit(options) / 2, options.tempDirectory);
+    for (const auto& input : options.inputs)
+    {
+        if (!reader.read(input, byHardwareAddress))
+            return 1;
+    }
+
+    LeaseSorter byIpAddress(newestByIpAddress, getSortLimit(options) / 2, options.tempDirectory);
+    if (!byHardwareAddress.sort())
+    {
+        print("Couldn't write temporary files to {}\n", options.tempDirectory);
+        return 1;
+    }
+
+    std::size_t superseded{};
+    Lease lease;
+    Lease previous;
+    bool first = true;
+    while (byHardwareAddress.next(lease))
+    {
+        if (!first && lease.hwAddress == previous.hwAddress)
+        {
+            ++superseded;
+            continue;
+        }
+
+        byIpAddress.add(lease);
+        previous = lease;
+        first = false;
+    }
+
+    if (!byIpAddress.sort())
+    {
+        print("Couldn't write temporary files to {}\n", options.tempDirectory);
+        return 1;
+    }
+
+    LeaseFileWriter writer(options.output);
+    if (!writer.isOpen())
+    {
+        print("Couldn't write {}\n", options.output);
+        return 1;
+    }
+
+    std::size_t conflicts{};
+    std::size_t written{};
+    first = true;
+    while (byIpAddress.next(lease))
+    {
+        if (!first && lease.ipAddress == previous.ipAddress)
+        {
+            ++conflicts;
+            continue;
+        }
+
+        writer.write(lease);
+        previous = lease;
+        first = false;
+        ++written;
+    }
+
+    if (!writer.commit())
+    {
+        print("Couldn't write {}\n", options.output);
+        return 1;
+    }
+
+    print("Read {} leases from {} files: {} expired, {} superseded, {} lost their IP address to a newer lease\n",
+          reader.records, options.inputs.size(), reader.expired, superseded, conflicts);
+    print("Wrote {} leases to {}\n", written, options.output);
+    return 0;
+}
+
+/* Gives the newest lease of each hardware address, in order. */
+class NewestLeases
+{
+    LeaseSorter& m_sorter;
+    Lease m_pending;
+    bool m_hasPending;
+
+public:
+    explicit NewestLeases(LeaseSorter& sorter)
+        : m_sorter(sorter)
+        , m_hasPending(sorter.next(m_pending))
+    {
+    }
+
+    bool next(Lease& lease)
+    {
+        if (!m_hasPending)
+            return false;
+
+        lease = m_pending;
+        while ((m_hasPending = m_sorter.next(m_pending)) && m_pending.hwAddress == lease.hwAddress)
+            ;
+
+        return true;
+    }
+};
+
+/*
+ * Compares the newest lease of each hardware address in the two files. Prints "-" for leases only in the first,
+ * "+" for those only in the second, and "~" for hardware addresses with a different IP address or start time.
+*/
+int diff(const Options& options)
+{
+    Reader reader(options);
+
+    // Both sorts are full at the same time here, so they get half the memory each.
+    LeaseSorter sorterA(newestByHardwareAddress, getSortLimit(options) / 2, options.tempDirectory);
+    LeaseSorter sorterB(newestByHardwareAddress, getSortLimit(options) / 2, options.tempDirectory);
+    if (!reader.read(options.inputs[0], sorterA) || !reader.read(options.inputs[1], sorterB))
+        return 2;
+
+    if (!sorterA.sort() || !sorterB.sort())
+    {
+        print("Couldn't write temporary files to {}\n", options.tempDirectory);
+        return 2;
+    }
+
+    NewestLeases leasesA(sorterA);
+    NewestLeases leasesB(sorterB);
+    Lease a;
+    Lease b;
+    bool hasA = leasesA.next(a);
+    bool hasB = leasesB.next(b);
+    std::size_t removed{};
+    std::size_t added{};
+    std::size_t changed{};
+
+    while (hasA || hasB)
+    {
+        if (hasA && (!hasB || a.hwAddress < b.hwAddress))
+        {
+            print("- {}  {}\n", formatHardwareAddress(a.hwAddress), formatIpAddress(a.ipAddress));
+            ++removed;
+            hasA = leasesA.next(a);
+        }
+        else if (hasB && (!hasA || b.hwAddress < a.hwAddress))
+        {
+            print("+ {}  {}\n", formatHardwareAddress(b.hwAddress), formatIpAddress(b.ipAddress));
+            ++added;
+            hasB = leasesB.next(b);
+        }
+        else
+        {
+            if (a.ipAddress != b.ipAddress || a.startTime != b.startTime)
+            {
+                print("~ {}  {} -> {}  (started {} -> {})\n", formatHardwareAddress(a.hwAddress),
+                      formatIpAddress(a.ipAddress), formatIpAddress(b.ipAddress), a.startTime, b.startTime);
+                ++changed;
+            }
+
+            hasA = leasesA.next(a);
+            hasB = leasesB.next(b);
+        }
+    }
+
+    std::cout.flush();
+    std::cerr << std::format("{} only in {}, {} only in {}, {} changed\n",
+                             removed, options.inputs[0], added, options.inputs[1], changed);
+    return removed + added + changed > 0 ? 1 : 0;
+}
+
+void printUsage(const char* program)
+{
+    print("Usage: {} merge [options] -o <output> <input>...\n", program);
+    print("       {} compact [options] -o <output> <input>\n", program);
+    print("       {} diff [options] <first> <second>\n\n", program);
+    print("merge combines lease files, keeping the newest lease of each hardware address and IP address.\n");
+    print("compact does the same for a single file, ie. to drop expired leases.\n");
+    print("diff prints leases that differ between two files, and exits with 1 if there were any.\n\n");
+    print("Options:\n");
+    print("  --lease-time <seconds>  Drop leases older than this, as the lease file doesn't store lease times\n");
+    print("  --memory <MiB>          Sort in memory up to this much, then use temporary files (default 64)\n");
+    print("  --temp <directory>      Where temporary files go (default $TMPDIR or /tmp)\n");
+}
+
+bool parseNumber(std::string_view text, auto& number)
+{
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), number);
+    return !text.empty() && result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+bool parseArguments(int argc, char* argv[], Options& options)
+{
+    if (argc < 2)
+        return false;
+
+    options.command = argv[1];
+    const char* tempDirectory = std::getenv("TMPDIR");
+    options.tempDirectory = tempDirectory && *tempDirectory ? tempDirectory : "/tmp";
+
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "-o" && hasValue)
+            options.output = argv[++i];
+        else if (arg == "--lease-time" && hasValue)
+        {
+            if (!parseNumber(argv[++i], options.leaseTime))
+                return false;
+        }
+        else if (arg == "--memory" && hasValue)
+        {
+            if (!parseNumber(argv[++i], options.memoryLimit) || options.memoryLimit == 0)
+                return false;
+        }
+        else if (arg == "--temp" && hasValue)
+            options.tempDirectory = argv[++i];
+        else if (!arg.starts_with("-"))
+            options.inputs.emplace_back(arg);
+        else
+            return false;
+    }
+
+    if (options.command == "merge")
+        return !options.inputs.empty() && !options.output.empty();
+    if (options.command == "compact")
+        return options.inputs.size() == 1 && !options.output.empty();
+    if (options.command == "diff")
+        return options.inputs.size() == 2 && options.output.empty();
+
+    return false;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    std::ios::sync_with_stdio(false);
+
+    Options options;
+    if (!parseArguments(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    if (options.command == "diff")
+        return diff(options);
+
+    return merge(options);
+}
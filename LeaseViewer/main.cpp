@@ -8,41 +8,546 @@
 #include "IpConverter.h"
 #include "Structures.h"
 #include "Configuration.h"
+#include "LeaseFile.h"
+#include "LiveLeases.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
 #include <ctime>
-
+#include <format>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 void print(std::string_view format, auto&&...args)
 {
     std::cout << std::vformat(format, std::make_format_args(args...));
 }
 
+namespace
+{
+enum class OutputFormat { Table, Csv, Json };
+enum class SortOrder { None, StartTime, IpAddress };
+enum class ExpiryFilter { Any, Active, Expired };
+
+struct Options
+{
+    std::string filename;
+    std::string liveInterface;
+    std::uint64_t hwPrefix{};
+    std::uint64_t hwPrefixMask{};
+    std::uint32_t firstIp{};
+    std::uint32_t lastIp{ 0xFFFFFFFF };
+    bool hasIpRange{};
+    ExpiryFilter expiry{ ExpiryFilter::Any };
+    std::uint32_t leaseTime{ NetworkDefaults::leaseTime };
+    SortOrder sort{ SortOrder::None };
+    OutputFormat format{ OutputFormat::Table };
+    bool summary{};
+};
+
+/*
+ * Collects the output and writes it to stdout in large chunks. Printing a million leases one formatted line at a
+ * time spends most of its time in the stream machinery, not in looking at the leases.
+*/
+class OutputBuffer
+{
+    static constexpr std::size_t Capacity = 64 * 1024;
+    std::string m_buffer;
+
+public:
+    OutputBuffer()
+    {
+        m_buffer.reserve(Capacity);
+    }
+
+    ~OutputBuffer()
+    {
+        flush();
+    }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void write(std::string_view text)
+    {
+        m_buffer.append(text);
+        if (m_buffer.size() >= Capacity)
+            flush();
+    }
+
+    // Left aligned, padded with spaces to width.
+    void writePadded(std::string_view text, std::size_t width)
+    {
+        write(text);
+        if (text.size() < width)
+            m_buffer.append(width - text.size(), ' ');
+    }
+
+    void writeNumber(std::int64_t number)
+    {
+        char text[24];
+        const auto result = std::to_chars(std::begin(text), std::end(text), number);
+        write({ text, result.ptr });
+    }
+
+    // Local time as YYYY-MM-DD HH:MM:SS.
+    void writeTime(std::time_t time)
+    {
+        std::tm tm{};
+        localtime_r(&time, &tm);
+
+        char text[20];
+        auto* ptr = text;
+        auto put = [&ptr](int value, int digits)
+        {
+            for (int i = digits - 1; i >= 0; --i, value /= 10)
+                ptr[i] = static_cast<char>('0' + value % 10);
+            ptr += digits;
+        };
+
+        put(tm.tm_year + 1900, 4); *ptr++ = '-';
+        put(tm.tm_mon + 1, 2); *ptr++ = '-';
+        put(tm.tm_mday, 2); *ptr++ = ' ';
+        put(tm.tm_hour, 2); *ptr++ = ':';
+        put(tm.tm_min, 2); *ptr++ = ':';
+        put(tm.tm_sec, 2);
+        write({ text, ptr });
+    }
+
+    void flush()
+    {
+        std::fwrite(m_buffer.data(), 1, m_buffer.size(), stdout);
+        m_buffer.clear();
+    }
+};
+
+/*
+ * Writes one lease at a time in the chosen format. The lease file doesn't store lease times, so leases from it
+ * expire after the lease time given on the command line.
+*/
+class LeaseWriter
+{
+    OutputBuffer& m_out;
+    OutputFormat m_format;
+    std::time_t m_now;
+    std::size_t m_count{};
+
+public:
+    LeaseWriter(OutputBuffer& out, OutputFormat format, std::time_t now)
+        : m_out(out)
+        , m_format(format)
+        , m_now(now)
+    {
+        switch (m_format)
+        {
+        case OutputFormat::Table:
+            m_out.write("Lease start          Expires              Hardware address   IPv4 address     State\n");
+            break;
+        case OutputFormat::Csv:
+            m_out.write("start,expires,hw_address,ip_address,state\n");
+            break;
+        case OutputFormat::Json:
+            m_out.write("[");
+            break;
+        }
+    }
+
+    ~LeaseWriter()
+    {
+        if (m_format == OutputFormat::Json)
+            m_out.write(m_count == 0 ? "]\n" : "\n]\n");
+        else if (m_format == OutputFormat::Table)
+            m_out.write(std::format("\nTotal amount of leases: {}\n", m_count));
+    }
+
+    void write(const Lease& lease, std::time_t expires)
+    {
+        const auto hwAddress = formatHardwareAddress(lease.hwAddress);
+        const auto ipAddress = formatIpAddress(lease.ipAddress);
+        const std::string_view state = expires > m_now ? "active" : "expired";
+
+        switch (m_format)
+        {
+        case OutputFormat::Table:
+            m_out.writeTime(lease.startTime);
+            m_out.write("  ");
+            m_out.writeTime(expires);
+            m_out.write("  ");
+            m_out.writePadded(hwAddress.view(), 19);
+            m_out.writePadded(ipAddress.view(), 17);
+            m_out.write(state);
+            m_out.write("\n");
+            break;
+
+        case OutputFormat::Csv:
+            m_out.writeNumber(lease.startTime);
+            m_out.write(",");
+            m_out.writeNumber(expires);
+            m_out.write(",");
+            m_out.write(hwAddress.view());
+            m_out.write(",");
+            m_out.write(ipAddress.view());
+            m_out.write(",");
+            m_out.write(state);
+            m_out.write("\n");
+            break;
+
+        case OutputFormat::Json:
+            m_out.write(m_count == 0 ? "\n  {\"start\": " : ",\n  {\"start\": ");
+            m_out.writeNumber(lease.startTime);
+            m_out.write(", \"expires\": ");
+            m_out.writeNumber(expires);
+            m_out.write(", \"hwAddress\": \"");
+            m_out.write(hwAddress.view());
+            m_out.write("\", \"ipAddress\": \"");
+            m_out.write(ipAddress.view());
+            m_out.write("\", \"state\": \"");
+            m_out.write(state);
+            m_out.write("\"}");
+            break;
+        }
+
+        ++m_count;
+    }
+};
+
+/*
+ * Counts for --summary, gathered in the same single pass as the listing would be. Addresses are counted in groups
+ * of 16, which is fine grained enough for the histogram of any pool and keeps the map small for large ones.
+*/
+class Summary
+{
+    static constexpr int GroupBits = 4;
+    static constexpr std::size_t HistogramRows = 16;
+    static constexpr std::size_t BarWidth = 40;
+
+    std::time_t m_now;
+    std::size_t m_leases{};
+    std::size_t m_active{};
+    std::time_t m_oldest{};
+    std::time_t m_newest{};
+    std::uint32_t m_lowestIp{ 0xFFFFFFFF };
+    std::uint32_t m_highestIp{};
+    std::unordered_map<std::uint32_t, std::uint32_t> m_groups;
+
+public:
+    explicit Summary(std::time_t now)
+        : m_now(now)
+    {
+    }
+
+    void add(const Lease& lease, std::time_t expires)
+    {
+        if (m_leases == 0 || lease.startTime < m_oldest)
+            m_oldest = lease.startTime;
+        if (m_leases == 0 || lease.startTime > m_newest)
+            m_newest = lease.startTime;
+
+        ++m_leases;
+        if (expires > m_now)
+            ++m_active;
+
+        m_lowestIp = std::min(m_lowestIp, lease.ipAddress);
+        m_highestIp = std::max(m_highestIp, lease.ipAddress);
+        ++m_groups[lease.ipAddress >> GroupBits];
+    }
+
+    // The histogram covers the given range, or the leased addresses if there's no range.
+    void write(OutputBuffer& out, std::size_t records, const Options& options) const
+    {
+        out.write(std::format("Records:       {}\n", records));
+        out.write(std::format("Leases:        {}\n", m_leases));
+        out.write(std::format("Active:        {}\n", m_active));
+        out.write(std::format("Expired:       {}\n", m_leases - m_active));
+
+        if (m_leases == 0)
+            return;
+
+        out.write("Oldest start:  ");
+        out.writeTime(m_oldest);
+        out.write("\nNewest start:  ");
+        out.writeTime(m_newest);
+        out.write("\n\nPool utilization\n");
+
+        const auto first = options.hasIpRange ? options.firstIp : m_lowestIp;
+        const auto last = options.hasIpRange ? options.lastIp : m_highestIp;
+        const auto firstGroup = first >> GroupBits;
+        const std::uint64_t groupCount = (last >> GroupBits) - firstGroup + 1;
+        const auto groupsPerRow = (groupCount + HistogramRows - 1) / HistogramRows;
+
+        std::vector<std::uint64_t> rows((groupCount + groupsPerRow - 1) / groupsPerRow);
+        for (const auto& [group, count] : m_groups)
+            rows[(group - firstGroup) / groupsPerRow] += count;
+
+        for (std::size_t row = 0; row < rows.size(); ++row)
+        {
+            const std::uint64_t rowGroup = firstGroup + row * groupsPerRow;
+            const auto rowFirst = std::max<std::uint64_t>(first, rowGroup << GroupBits);
+            const auto rowLast = std::min<std::uint64_t>(last, ((rowGroup + groupsPerRow) << GroupBits) - 1);
+            const auto size = rowLast - rowFirst + 1;
+            const auto percent = rows[row] * 100 / size;
+            const auto bar = std::min<std::uint64_t>(rows[row] * BarWidth / size, BarWidth);
+
+            out.writePadded(formatIpAddress(static_cast<std::uint32_t>(rowFirst)).view(), 16);
+            out.write("- ");
+            out.writePadded(formatIpAddress(static_cast<std::uint32_t>(rowLast)).view(), 16);
+            out.write("|");
+            out.writePadded(std::string(bar, '#'), BarWidth);
+            out.write(std::format("| {}/{} ({}%)\n", rows[row], size, percent));
+        }
+    }
+};
+
+// 1 to 6 octets separated by colons or dashes, ie. 00:1a:2b.
+bool parseHardwareAddressPrefix(std::string_view text, std::uint64_t& prefix, std::uint64_t& mask)
+{
+    prefix = 0;
+    mask = 0;
+
+    int shift = 40;
+    while (!text.empty() && shift >= 0)
+    {
+        const auto end = text.find_first_of(":-");
+        const auto octetText = text.substr(0, end);
+
+        unsigned int octet{};
+        const auto result = std::from_chars(octetText.data(), octetText.data() + octetText.size(), octet, 16);
+        if (octetText.empty() || octetText.size() > 2 || result.ptr != octetText.data() + octetText.size())
+            return false;
+
+        prefix |= static_cast<std::uint64_t>(octet) << shift;
+        mask |= std::uint64_t{ 0xFF } << shift;
+        shift -= 8;
+
+        if (end == std::string_view::npos)
+            return true;
+
+        text.remove_prefix(end + 1);
+    }
+
+    return false;
+}
+
+// A single address, first-last or network/prefix.
+bool parseIpRange(std::string_view text, std::uint32_t& first, std::uint32_t& last)
+{
+    if (const auto dash = text.find('-'); dash != std::string_view::npos)
+        return parseIpAddress(text.substr(0, dash), first) && parseIpAddress(text.substr(dash + 1), last) && first <= last;
+
+    if (const auto slash = text.find('/'); slash != std::string_view::npos)
+    {
+        const auto prefixText = text.substr(slash + 1);
+        unsigned int prefix{};
+        const auto result = std::from_chars(prefixText.data(), prefixText.data() + prefixText.size(), prefix);
+        if (prefixText.empty() || result.ptr != prefixText.data() + prefixText.size() || prefix > 32)
+            return false;
+
+        if (!parseIpAddress(text.substr(0, slash), first))
+            return false;
+
+        const auto hostMask = prefix == 0 ? 0xFFFFFFFFu : (1u << (32 - prefix)) - 1;
+        first &= ~hostMask;
+        last = first | hostMask;
+        return true;
+    }
+
+    if (!parseIpAddress(text, first))
+        return false;
+
+    last = first;
+    return true;
+}
+
+void printUsage(const char* program)
+{
+    print("Usage: {} [options] <filename>\n", program);
+    print("       {} [options] --live <interface>\n\n", program);
+    print("Options:\n");
+    print("  --mac <prefix>          Only hardware addresses starting with prefix, ie. 00:1a:2b\n");
+    print("  --ip <range>            Only IPv4 addresses in range, as first-last or network/prefix\n");
+    print("  --active, --expired     Only leases that have or haven't expired\n");
+    print("  --lease-time <seconds>  When leases from a file expire, as it doesn't store lease times (default {})\n", NetworkDefaults::leaseTime);
+    print("  --sort <start|ip>       Sort by lease start or IPv4 address\n");
+    print("  --format <table|csv|json>\n");
+    print("  --summary               Print counts and a pool utilization histogram instead of the leases\n");
+}
+
+bool parseArguments(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "--live" && hasValue)
+            options.liveInterface = argv[++i];
+        else if (arg == "--mac" && hasValue)
+        {
+            if (!parseHardwareAddressPrefix(argv[++i], options.hwPrefix, options.hwPrefixMask))
+            {
+                print("Invalid hardware address prefix {}\n", argv[i]);
+                return false;
+            }
+        }
+        else if (arg == "--ip" && hasValue)
+        {
+            if (!parseIpRange(argv[++i], options.firstIp, options.lastIp))
+            {
+                print("Invalid IPv4 address range {}\n", argv[i]);
+                return false;
+            }
+            options.hasIpRange = true;
+        }
+        else if (arg == "--active")
+            options.expiry = ExpiryFilter::Active;
+        else if (arg == "--expired")
+            options.expiry = ExpiryFilter::Expired;
+        else if (arg == "--lease-time" && hasValue)
+        {
+            const std::string_view value(argv[++i]);
+            const auto result = std::from_chars(value.data(), value.data() + value.size(), options.leaseTime);
+            if (value.empty() || result.ptr != value.data() + value.size())
+            {
+                print("Invalid lease time {}\n", value);
+                return false;
+            }
+        }
+        else if (arg == "--sort" && hasValue)
+        {
+            const std::string_view value(argv[++i]);
+            if (value == "start")
+                options.sort = SortOrder::StartTime;
+            else if (value == "ip")
+                options.sort = SortOrder::IpAddress;
+            else
+            {
+                print("Unknown sort order {}\n", value);
+                return false;
+            }
+        }
+        else if (arg == "--format" && hasValue)
+        {
+            const std::string_view value(argv[++i]);
+            if (value == "table")
+                options.format = OutputFormat::Table;
+            else if (value == "csv")
+                options.format = OutputFormat::Csv;
+            else if (value == "json")
+                options.format = OutputFormat::Json;
+            else
+            {
+                print("Unknown format {}\n", value);
+                return false;
+            }
+        }
+        else if (arg == "--summary")
+            options.summary = true;
+        else if (!arg.starts_with("--") && options.filename.empty())
+            options.filename = arg;
+        else
+            return false;
+    }
+
+    return options.filename.empty() != options.liveInterface.empty();
+}
+}
+
 int main(int argc, char* argv[])
 {
-    if (argc < 2)
+    Options options;
+    if (!parseArguments(argc, argv, options))
     {
-        print("Usage: {} <filename>\n", argv[0]);
+        printUsage(argv[0]);
         return 1;
     }
 
-    std::string filename(argv[1]);
-    auto leases = Configuration::GetPersistentLeasesByFile(filename);
+    const auto now = std::time(nullptr);
+
+    /* Leases are streamed through the filters, only the matching ones are kept, and only if they are to be sorted. */
+    OutputBuffer out;
+    Summary summary(now);
+    std::vector<Lease> sorted;
+    std::optional<LeaseWriter> writer;
+    if (!options.summary && options.sort == SortOrder::None)
+        writer.emplace(out, options.format, now);
 
-    for (const auto& lease : leases)
+    auto expiresAt = [&options](const Lease& lease)
     {
-        std::string leaseStart(std::ctime(&lease.startTime));
+        return lease.startTime + static_cast<std::time_t>(lease.leaseTime > 0 ? lease.leaseTime : options.leaseTime);
+    };
 
-        auto hwAddress = convertHardwareAddress(lease.hwAddress);
-        auto ipAddress = convertIpAddress(lease.ipAddress);
+    auto visit = [&](const Lease& lease)
+    {
+        if ((lease.hwAddress & options.hwPrefixMask) != options.hwPrefix)
+            return;
+        if (lease.ipAddress < options.firstIp || lease.ipAddress > options.lastIp)
+            return;
+
+        const auto expires = expiresAt(lease);
+        if ((options.expiry == ExpiryFilter::Active && expires <= now) || (options.expiry == ExpiryFilter::Expired && expires > now))
+            return;
+
+        if (options.summary)
+            summary.add(lease, expires);
+        else if (writer)
+            writer->write(lease, expires);
+        else
+            sorted.push_back(lease);
+    };
+
+    std::size_t records{};
+    if (!options.liveInterface.empty())
+    {
+        LiveLeases::Contents contents;
+        std::string error;
+        if (!LiveLeases::Read(options.liveInterface, contents, error))
+        {
+            print("Unable to read live leases of {}: {}\n", options.liveInterface, error);
+            return 1;
+        }
+
+        if (contents.truncated) // Not on stdout, that would break CSV and JSON output.
+            std::cerr << "Warning: The daemon has more leases than fit in shared memory, some are not shown\n";
 
-        print("Lease start        {}", leaseStart); // ctime() adds a \n on the end
-        print("Hardware address   {}\n", hwAddress);
-        print("IPv4 address       {}\n\n", ipAddress);
+        records = contents.leases.size();
+        for (const auto& lease : contents.leases)
+            visit(lease);
     }
+    else
+    {
+        LeaseFile file(options.filename);
+        if (!file.isOpen())
+        {
+            print("Couldn't open {}\n", options.filename);
+            return 1;
+        }
 
-    print("Total amount of leases: {}\n", leases.size());
+        records = file.getRecordCount();
+        file.forEach(visit);
+    }
+
+    if (options.summary)
+    {
+        summary.write(out, records, options);
+        return 0;
+    }
+
+    if (options.sort != SortOrder::None)
+    {
+        if (options.sort == SortOrder::StartTime)
+            std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.startTime < b.startTime; });
+        else
+            std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.ipAddress < b.ipAddress; });
+
+        writer.emplace(out, options.format, now);
+        for (const auto& lease : sorted)
+            writer->write(lease, expiresAt(lease));
+    }
 
     return 0;
 }
@@ -0,0 +1,262 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "LiveLeases.h"
+#include "Logger.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <new>
+
+namespace
+{
+constexpr auto MaxReadAttempts = 1000;
+
+std::size_t segmentSize(std::uint32_t capacity)
+{
+    return sizeof(LiveLeases::Header) + std::size_t{ capacity } * sizeof(LiveLeases::Record);
+}
+
+/* The reader maps the segment read-only, but a lock-free atomic load never writes. */
+template<typename T>
+T loadRelaxed(const T& field)
+{
+    return std::atomic_ref<T>(const_cast<T&>(field)).load(std::memory_order_relaxed);
+}
+
+template<typename T>
+void storeRelaxed(T& field, T value)
+{
+    std::atomic_ref<T>(field).store(value, std::memory_order_relaxed);
+}
+}
+
+std::string LiveLeases::GetSegmentName(std::string_view interface)
+{
+    return "/tdhcpd-" + std::string(interface);
+}
+
+bool LiveLeases::Read(std::string_view interface, Contents& contents, std::string& error)
+{
+    const auto name = GetSegmentName(interface);
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        const auto e = errno;
+        error = e == ENOENT ? "tdhcpd isn't publishing live leases for " + std::string(interface)
+                            : "Couldn't open " + name + ": " + std::strerror(e);
+        return false;
+    }
+
+    struct stat st{};
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(Header))
+        data = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        error = "Couldn't map " + name;
+        return false;
+    }
+
+    const auto size = static_cast<std::size_t>(st.st_size);
+    const auto* header = static_cast<const Header*>(data);
+    const auto* records = reinterpret_cast<const Record*>(static_cast<const std::uint8_t*>(data) + sizeof(Header));
+
+    bool ok = false;
+    if (std::memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version || size < segmentSize(header->capacity))
+    {
+        error = name + " is not a live lease segment of this version";
+    }
+    else
+    {
+        std::vector<Record> copy;
+        for (int attempt = 0; attempt < MaxReadAttempts && !ok; ++attempt)
+        {
+            const auto before = header->sequence.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            const auto count = std::min(loadRelaxed(header->count), header->capacity);
+            copy.resize(count);
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                copy[i].startTime = loadRelaxed(records[i].startTime);
+                copy[i].hwAddress = loadRelaxed(records[i].hwAddress);
+                copy[i].ipAddress = loadRelaxed(records[i].ipAddress);
+                copy[i].leaseTime = loadRelaxed(records[i].leaseTime);
+            }
+            contents.updated = loadRelaxed(header->updated);
+            contents.truncated = loadRelaxed(header->truncated) != 0;
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            ok = header->sequence.load(std::memory_order_relaxed) == before;
+        }
+
+        if (ok)
+        {
+            contents.leases.clear();
+            contents.leases.reserve(copy.size());
+            for (const auto& record : copy)
+                contents.leases.push_back({ record.startTime, record.hwAddress, record.ipAddress, record.leaseTime });
+        }
+        else
+        {
+            error = "The leases of " + std::string(interface) + " kept changing while reading them";
+        }
+    }
+
+    munmap(data, size);
+    return ok;
+}
+
+LiveLeasePublisher::LiveLeasePublisher(std::string_view interface, const LeaseTable& table, std::uint32_t capacity)
+    : m_name(LiveLeases::GetSegmentName(interface))
+    , m_table(table)
+    , m_capacity(capacity)
+    , m_data(MAP_FAILED)
+    , m_size(segmentSize(capacity))
+{
+    /* Readers only ever get read access, the daemon is the only one writing. Other users don't get to see the leases. */
+    int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0640);
+    if (fd < 0)
+    {
+        const auto e = errno;
+        Log::Warning("Couldn't create live lease segment {}, errno={}", m_name, e);
+        return;
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(m_size)) == 0)
+        m_data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (m_data == MAP_FAILED)
+    {
+        const auto e = errno;
+        Log::Warning("Couldn't map live lease segment {}, errno={}", m_name, e);
+        shm_unlink(m_name.c_str());
+        return;
+    }
+
+    auto* header = new (m_data) LiveLeases::Header{};
+    std::memcpy(header->magic, LiveLeases::Magic, sizeof(LiveLeases::Magic));
+    header->version = LiveLeases::Version;
+    header->capacity = m_capacity;
+}
+
+LiveLeasePublisher::~LiveLeasePublisher()
+{
+    if (m_data == MAP_FAILED)
+        return;
+
+    munmap(m_data, m_size);
+    shm_unlink(m_name.c_str());
+}
+
+bool LiveLeasePublisher::isOpen() const
+{
+    return m_data != MAP_FAILED;
+}
+
+void LiveLeasePublisher::publish()
+{
+    if (!isOpen())
+        return;
+
+    const auto version = m_table.getVersion();
+    if (version == m_publishedVersion)
+        return;
+
+    m_publishedVersion = version;
+
+    auto* header = static_cast<LiveLeases::Header*>(m_data);
+    auto* records = reinterpret_cast<LiveLeases::Record*>(static_cast<std::uint8_t*>(m_data) + sizeof(LiveLeases::Header));
+
+    const auto sequence = header->sequence.load(std::memory_order_relaxed);
+    header->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::uint32_t count{};
+    bool truncated{};
+    m_table.forEach([&](const Lease& lease)
+    {
+        if (count == m_capacity)
+        {
+            truncated = true;
+            return;
+        }
+
+        auto& record = records[count++];
+        storeRelaxed(record.startTime, std::int64_t{ lease.startTime });
+        storeRelaxed(record.hwAddress, lease.hwAddress);
+        storeRelaxed(record.ipAddress, lease.ipAddress);
+        storeRelaxed(record.leaseTime, lease.leaseTime);
+    });
+
+    storeRelaxed(header->count, count);
+    storeRelaxed(header->updated, std::int64_t{ std::time(nullptr) });
+    storeRelaxed(header->truncated, std::uint32_t{ truncated });
+
+    header->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+LiveLeaseExporter::LiveLeaseExporter(std::chrono::milliseconds interval)
+    : m_interval(interval)
+{}
+
+LiveLeaseExporter::~LiveLeaseExporter()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_running = false;
+    }
+    m_condition.notify_one();
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void LiveLeaseExporter::add(std::string_view interface, const LeaseTable& table, std::uint32_t capacity)
+{
+    auto publisher = std::make_unique<LiveLeasePublisher>(interface, table, capacity);
+    if (!publisher->isOpen())
+        return; // Logged by the publisher.
+
+    Log::Info("Publishing live leases of {} in {}", interface, LiveLeases::GetSegmentName(interface));
+    m_publishers.emplace_back(std::move(publisher));
+}
+
+void LiveLeaseExporter::start()
+{
+    if (m_publishers.empty())
+        return;
+
+    m_running = true;
+    m_thread = std::thread([this]
+    {
+        std::unique_lock lock(m_mutex);
+        while (m_running)
+        {
+            for (auto& publisher : m_publishers)
+                publisher->publish();
+
+            m_condition.wait_for(lock, m_interval, [this] { return !m_running; });
+        }
+    });
+}
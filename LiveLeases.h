@@ -0,0 +1,124 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include "LeaseTable.h"
+#include "Structures.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/*
+ * The leases of each interface, published by the daemon in a POSIX shared memory segment named /tdhcpd-<interface>.
+ * Other programs (ie. LeaseViewer --live) map it read-only and see the current leases without asking the daemon.
+ *
+ * The segment is a header followed by room for capacity records. The header's sequence number is a seqlock over the
+ * whole segment: It's odd while the daemon rewrites the records, so a reader copies everything and starts over if
+ * the sequence number was odd or changed meanwhile. Every field written while readers may be reading is stored and
+ * loaded through std::atomic_ref, one at a time.
+ *
+ * Segments are readable by the daemon's user and group only, the leases tell which hosts are on the network.
+*/
+namespace LiveLeases
+{
+    constexpr char Magic[4] = { 'T', 'D', 'L', 'L' };
+    constexpr std::uint32_t Version = 1;
+
+    struct Header
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t capacity;
+        std::uint32_t count;
+        std::atomic<std::uint64_t> sequence;
+        std::int64_t updated; // When the records were last written, seconds since the epoch.
+        std::uint32_t truncated; // More leases than capacity, the rest were left out.
+        std::uint32_t reserved;
+    };
+
+    struct Record
+    {
+        std::int64_t startTime;
+        std::uint64_t hwAddress;
+        std::uint32_t ipAddress;
+        std::uint32_t leaseTime;
+    };
+
+    static_assert(sizeof(Header) == 40 && sizeof(Record) == 24);
+    static_assert(alignof(Record) >= std::atomic_ref<std::int64_t>::required_alignment);
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "The sequence number is shared between processes");
+
+    std::string GetSegmentName(std::string_view interface);
+
+    struct Contents
+    {
+        std::vector<Lease> leases;
+        std::time_t updated{};
+        bool truncated{};
+    };
+
+    // Reads a consistent copy of the interface's leases. Returns false with a reason in error if it can't.
+    bool Read(std::string_view interface, Contents& contents, std::string& error);
+}
+
+/*
+ * Writes one interface's lease table to its segment. The segment is removed again when this is destroyed.
+*/
+class LiveLeasePublisher
+{
+    std::string m_name;
+    const LeaseTable& m_table;
+    std::uint32_t m_capacity{};
+    void* m_data;
+    std::size_t m_size{};
+    std::uint64_t m_publishedVersion{ ~0ull };
+
+public:
+    LiveLeasePublisher(std::string_view interface, const LeaseTable& table, std::uint32_t capacity);
+    ~LiveLeasePublisher();
+
+    LiveLeasePublisher(const LiveLeasePublisher&) = delete;
+    LiveLeasePublisher& operator=(const LiveLeasePublisher&) = delete;
+
+    [[nodiscard]]
+    bool isOpen() const;
+
+    // Rewrites the segment if the lease table changed since last time.
+    void publish();
+};
+
+/*
+ * Publishes every added interface on its own thread, at a fixed interval.
+*/
+class LiveLeaseExporter
+{
+    std::chrono::milliseconds m_interval;
+    std::vector<std::unique_ptr<LiveLeasePublisher>> m_publishers;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_running{};
+
+public:
+    explicit LiveLeaseExporter(std::chrono::milliseconds interval);
+    ~LiveLeaseExporter();
+
+    // Must be called before start(). The table must outlive the exporter.
+    void add(std::string_view interface, const LeaseTable& table, std::uint32_t capacity);
+
+    void start();
+};
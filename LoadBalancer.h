@@ -0,0 +1,59 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <span>
+
+/*
+ * Load balancing between servers sharing a segment, as described in RFC 3074. Every client hashes to one of 256
+ * buckets, and each server answers only the clients in its own buckets. All servers hash the same way, so each
+ * client is answered by exactly one of them without the servers talking to each other.
+ *
+ * A client whose server is down keeps retrying, and the secs field of its requests grows. Once it exceeds the
+ * threshold any server answers it, so the remaining servers cover for the one that is down.
+*/
+namespace LoadBalancing
+{
+    // The client's bucket, from the RFC 3074 hash of its hardware address (the hlen first octets of chaddr).
+    std::uint8_t GetHashBucket(std::span<const std::uint8_t> clientIdentifier);
+}
+
+class LoadBalancer
+{
+public:
+    enum class Verdict
+    {
+        Accept,
+        Takeover, // Not our client, but it has waited past the threshold.
+        Drop
+    };
+
+    // Server counts from 0. The buckets are split in servers ranges, and this server gets the one given.
+    // 0 servers disables load balancing, everyone is accepted.
+    void configure(std::uint8_t server, std::uint8_t servers, std::uint16_t threshold);
+
+    [[nodiscard]]
+    bool isEnabled() const;
+
+    [[nodiscard]]
+    bool isServedBucket(std::uint8_t bucket) const;
+
+    /*
+     * Clients that have an address already (ciaddr set) are always accepted: they are renewing with us, or rebinding
+     * because the server they had the address from stopped answering. Those we have no lease for aren't answered at
+     * all, their lease may be a peer's.
+    */
+    Verdict admit(std::span<const std::uint8_t> clientIdentifier, std::uint16_t secondsElapsed, bool hasAddress) const;
+
+private:
+    std::bitset<256> m_buckets;
+    std::uint16_t m_threshold{};
+    bool m_enabled{};
+};
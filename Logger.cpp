@@ -7,12 +7,13 @@
 
 #include "Logger.h"
 
+#include <atomic>
 #include <mutex>
 #include <iostream>
 
 namespace
 {
-Log::Level LogLevel = Log::Level::Info;
+std::atomic<Log::Level> LogLevel{ Log::Level::Info }; // Changed by reloads while other threads log.
 Log::LogFunction Logger;
 
 void StdoutLogger(Log::Level level, std::string_view text)
@@ -30,7 +31,7 @@ void StdoutLogger(Log::Level level, std::string_view text)
 
 void Log::detail::WriteLog(Log::Level level, const std::string& text)
 {
-    const auto currentLogLevelNum = static_cast<int>(LogLevel);
+    const auto currentLogLevelNum = static_cast<int>(LogLevel.load(std::memory_order_relaxed));
     const auto logLevelNum = static_cast<int>(level);
     if (logLevelNum < currentLogLevelNum)
         return;
@@ -0,0 +1,52 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& filename)
+    : m_data(MAP_FAILED)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st{};
+    if (fstat(fd, &st) == 0)
+    {
+        /* mmap() refuses a length of 0, there's nothing to map then anyway. */
+        m_size = static_cast<std::size_t>(st.st_size);
+        if (m_size > 0)
+            m_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        m_open = m_size == 0 || m_data != MAP_FAILED;
+    }
+
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data != MAP_FAILED)
+        munmap(m_data, m_size);
+}
+
+bool MappedFile::isOpen() const
+{
+    return m_open;
+}
+
+std::span<const std::uint8_t> MappedFile::getData() const
+{
+    if (m_data == MAP_FAILED)
+        return {};
+
+    return { static_cast<const std::uint8_t*>(m_data), m_size };
+}
@@ -0,0 +1,35 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+/* A whole file mapped read-only into memory, for loading large files without copying them first. */
+class MappedFile
+{
+    void* m_data;
+    std::size_t m_size{};
+    bool m_open{};
+
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if the file couldn't be opened, errno tells why. An empty file is open, with no data.
+    [[nodiscard]]
+    bool isOpen() const;
+
+    [[nodiscard]]
+    std::span<const std::uint8_t> getData() const;
+};
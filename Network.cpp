@@ -8,8 +8,9 @@
 #include "Network.h"
 
 #include <algorithm>
+#include <iterator>
 #include <stdexcept>
-#include <ranges>
+#include <utility>
 
 void Network::configure(NetworkConfiguration&& config, const std::vector<Lease>& leases)
 {
@@ -17,29 +18,100 @@ void Network::configure(NetworkConfiguration&& config, const std::vector<Lease>&
     m_networkSize = config.networkSize;
     m_routers = config.routers;
     m_dhcpServerIdentifier = config.dhcpServerIdentifier;
-    m_dhcpFirst = config.dhcpFirst;
-    m_dhcpLast = config.dhcpLast;
     m_dnsServers = std::move(config.dnsServers);
     m_leaseTime = config.leaseTime;
     m_renewalTime = config.renewalTime;
     m_rebindingTime = config.rebindingTime;
+    m_leaseJitter = config.leaseJitter;
+    m_minimumLeaseTime = config.minimumLeaseTime;
+    m_maximumLeaseTime = config.maximumLeaseTime;
+    m_utilizationLowWatermark = config.utilizationLowWatermark;
+    m_utilizationHighWatermark = config.utilizationHighWatermark;
     m_leaseFile = config.leaseFile;
 
     m_reservationByHw = std::move(config.reservations);
+    m_reservationByIp.clear();
+
+    m_hostOptions.clear();
+    m_maximumHostLeaseTime = 0;
+    for (auto& [hwAddress, options] : config.hostOptions)
+        setHostOptions(hwAddress, std::move(options));
+
+    m_history.setCapacity(config.historySize);
+    m_allocationPolicy = config.allocationPolicy;
+    m_quarantineTime = config.quarantineTime;
+    m_quarantine.clear();
+    m_quarantineQueue.clear();
 
     m_leasesByHw.clear();
     m_leasesByIp.clear();
+    m_leaseTable.clear();
 
-    for (const auto& lease : leases)
+    for (const auto& loaded : leases)
     {
+        const auto lease = withLeaseTime(loaded);
         m_leasesByHw[lease.hwAddress] = lease;
         m_leasesByIp[lease.ipAddress] = lease;
+        m_leaseTable.set(lease);
     }
 
     for (const auto& [hwAddress, ipAddress] : m_reservationByHw)
     {
         m_reservationByIp[ipAddress] = hwAddress;
     }
+
+    m_poolSelection = config.poolSelection;
+    if (config.pools.empty())
+        config.pools.push_back({ "default", config.dhcpFirst, config.dhcpLast });
+
+    setPools(std::move(config.pools));
+}
+
+void Network::reconfigure(Network& prepared)
+{
+    const bool sameNetwork = prepared.m_networkSpace == m_networkSpace && prepared.m_networkSize == m_networkSize;
+
+    m_networkSpace = prepared.m_networkSpace;
+    m_networkSize = prepared.m_networkSize;
+    m_routers = prepared.m_routers;
+    m_dhcpServerIdentifier = prepared.m_dhcpServerIdentifier;
+    std::swap(m_dnsServers, prepared.m_dnsServers);
+    m_leaseTime = prepared.m_leaseTime;
+    m_renewalTime = prepared.m_renewalTime;
+    m_rebindingTime = prepared.m_rebindingTime;
+    m_leaseJitter = prepared.m_leaseJitter;
+    m_minimumLeaseTime = prepared.m_minimumLeaseTime;
+    m_maximumLeaseTime = prepared.m_maximumLeaseTime;
+    m_utilizationLowWatermark = prepared.m_utilizationLowWatermark;
+    m_utilizationHighWatermark = prepared.m_utilizationHighWatermark;
+    std::swap(m_leaseFile, prepared.m_leaseFile);
+
+    std::swap(m_reservationByHw, prepared.m_reservationByHw);
+    std::swap(m_reservationByIp, prepared.m_reservationByIp);
+    std::swap(m_hostOptions, prepared.m_hostOptions);
+    m_maximumHostLeaseTime = prepared.m_maximumHostLeaseTime;
+
+    if (!sameNetwork || prepared.m_history.getCapacity() != m_history.getCapacity())
+        m_history.setCapacity(prepared.m_history.getCapacity());
+    m_allocationPolicy = prepared.m_allocationPolicy;
+    m_quarantineTime = prepared.m_quarantineTime;
+    if (!sameNetwork)
+    {
+        m_quarantine.clear();
+        m_quarantineQueue.clear();
+    }
+
+    std::swap(m_pools, prepared.m_pools);
+    std::swap(m_poolNames, prepared.m_poolNames);
+    std::swap(m_poolClasses, prepared.m_poolClasses);
+    std::swap(m_poolsByFirst, prepared.m_poolsByFirst);
+    m_poolSelection = prepared.m_poolSelection;
+
+    for (const auto& [ipAddress, lease] : m_leasesByIp)
+        markUsed(ipAddress);
+
+    for (const auto& [ipAddress, until] : m_quarantine)
+        markUsed(ipAddress);
 }
 
 void Network::setNetworkSpace(std::uint32_t networkSpace)
@@ -94,8 +166,35 @@ const std::vector<std::uint32_t>& Network::getDnsServers() const
 
 void Network::setDhcpRange(std::uint32_t first, std::uint32_t last)
 {
-    m_dhcpFirst = first;
-    m_dhcpLast = last;
+    setPools({ { "default", first, last } });
+}
+
+void Network::setPools(std::vector<PoolConfiguration> pools)
+{
+    m_pools.clear();
+    m_poolNames.clear();
+    m_poolClasses.clear();
+    m_poolsByFirst.clear();
+
+    for (auto& pool : pools)
+    {
+        m_poolsByFirst.emplace_back(m_pools.size());
+        m_pools.emplace_back(pool.first, pool.last);
+        m_poolNames.emplace_back(std::move(pool.name));
+        m_poolClasses.emplace_back(pool.clientClasses);
+    }
+
+    std::sort(m_poolsByFirst.begin(), m_poolsByFirst.end(), [this](std::size_t a, std::size_t b)
+    {
+        return m_pools[a].getFirst() < m_pools[b].getFirst();
+    });
+
+    rebuildPool();
+}
+
+void Network::setPoolSelection(PoolSelection selection)
+{
+    m_poolSelection = selection;
 }
 
 void Network::setLeaseDuration(std::uint32_t leaseTimeSeconds)
@@ -103,6 +202,20 @@ void Network::setLeaseDuration(std::uint32_t leaseTimeSeconds)
     m_leaseTime = leaseTimeSeconds;
 }
 
+void Network::setLeaseJitter(std::uint8_t percent)
+{
+    m_leaseJitter = percent;
+}
+
+void Network::setAdaptiveLeaseTime(std::uint32_t minimum, std::uint32_t maximum,
+                                   std::uint8_t lowWatermark, std::uint8_t highWatermark)
+{
+    m_minimumLeaseTime = minimum;
+    m_maximumLeaseTime = maximum;
+    m_utilizationLowWatermark = lowWatermark;
+    m_utilizationHighWatermark = highWatermark;
+}
+
 std::uint32_t Network::getBroadcastAddress() const
 {
     return getNetworkSpace() | ~(~0 << (32 - getNetworkSize()));
@@ -110,17 +223,153 @@ std::uint32_t Network::getBroadcastAddress() const
 
 std::uint32_t Network::getLeaseTime() const
 {
-    return m_leaseTime;
+    if (m_maximumLeaseTime == 0)
+        return m_leaseTime;
+
+    const auto utilization = getPoolUtilization();
+
+    if (utilization <= m_utilizationLowWatermark)
+        return m_maximumLeaseTime;
+
+    if (utilization >= m_utilizationHighWatermark)
+        return m_minimumLeaseTime;
+
+    const auto span = m_maximumLeaseTime - m_minimumLeaseTime;
+    const auto position = utilization - m_utilizationLowWatermark;
+    const auto width = m_utilizationHighWatermark - m_utilizationLowWatermark;
+    return m_maximumLeaseTime - static_cast<std::uint32_t>(static_cast<std::uint64_t>(span) * position / width);
 }
 
 std::uint32_t Network::getRenewalTime() const
 {
-    return m_renewalTime;
+    return scaleToLeaseTime(m_renewalTime, getLeaseTime());
 }
 
 std::uint32_t Network::getRebindingTime() const
 {
-    return m_rebindingTime;
+    return scaleToLeaseTime(m_rebindingTime, getLeaseTime());
+}
+
+std::uint32_t Network::getMaximumLeaseTime() const
+{
+    return longestLeaseTime(m_leaseTime, m_maximumLeaseTime, m_maximumHostLeaseTime);
+}
+
+std::uint32_t Network::getMaximumLeaseTime(const NetworkConfiguration& config)
+{
+    std::uint32_t maximumHostLeaseTime{};
+    for (const auto& [hwAddress, options] : config.hostOptions)
+        maximumHostLeaseTime = std::max(maximumHostLeaseTime, options.leaseTime);
+
+    return longestLeaseTime(config.leaseTime, config.maximumLeaseTime, maximumHostLeaseTime);
+}
+
+std::uint32_t Network::longestLeaseTime(std::uint32_t leaseTime, std::uint32_t maximumLeaseTime, std::uint32_t maximumHostLeaseTime)
+{
+    return std::max({ leaseTime, maximumLeaseTime, maximumHostLeaseTime });
+}
+
+std::uint32_t Network::getPoolUtilization() const
+{
+    const auto size = getPoolSize();
+    if (size == 0)
+        return 100;
+
+    return static_cast<std::uint32_t>(static_cast<std::uint64_t>(getPoolUsedCount()) * 100 / size);
+}
+
+std::uint32_t Network::getPoolSize() const
+{
+    std::uint32_t size{};
+    for (const auto& pool : m_pools)
+        size += pool.getSize();
+    return size;
+}
+
+std::uint32_t Network::getPoolUsedCount() const
+{
+    std::uint32_t used{};
+    for (const auto& pool : m_pools)
+        used += pool.getUsedCount();
+    return used;
+}
+
+std::size_t Network::getPoolCount() const
+{
+    return m_pools.size();
+}
+
+const AddressPool& Network::getPool(std::size_t index) const
+{
+    return m_pools.at(index);
+}
+
+const std::string& Network::getPoolName(std::size_t index) const
+{
+    return m_poolNames.at(index);
+}
+
+void Network::setAllocationPolicy(AllocationPolicy policy)
+{
+    m_allocationPolicy = policy;
+}
+
+void Network::setHistorySize(std::uint32_t historySize)
+{
+    m_history.setCapacity(historySize);
+}
+
+std::uint64_t Network::getHistoryLookups() const
+{
+    return m_historyLookups;
+}
+
+std::uint64_t Network::getHistoryHits() const
+{
+    return m_historyHits;
+}
+
+bool Network::hasHeldAddress(std::uint64_t hwAddress, std::uint32_t ipAddress) const
+{
+    const auto& lease = getLease(hwAddress);
+    if (isLeaseEntryValid(lease))
+        return lease.ipAddress == ipAddress;
+
+    return m_history.recall(hwAddress) == ipAddress;
+}
+
+std::uint32_t Network::getLeaseTime(std::uint64_t hwAddress) const
+{
+    if (const auto* options = getHostOptions(hwAddress); options && options->leaseTime != 0)
+        return options->leaseTime;
+
+    return applyJitter(getLeaseTime(), hwAddress);
+}
+
+std::uint32_t Network::getRenewalTime(std::uint64_t hwAddress) const
+{
+    if (const auto* options = getHostOptions(hwAddress); options && options->leaseTime != 0)
+        return scaleToLeaseTime(m_renewalTime, options->leaseTime);
+
+    return applyJitter(getRenewalTime(), hwAddress);
+}
+
+std::uint32_t Network::getRebindingTime(std::uint64_t hwAddress) const
+{
+    if (const auto* options = getHostOptions(hwAddress); options && options->leaseTime != 0)
+        return scaleToLeaseTime(m_rebindingTime, options->leaseTime);
+
+    return applyJitter(getRebindingTime(), hwAddress);
+}
+
+std::uint32_t Network::getRenewalTime(const Lease& lease) const
+{
+    return scaleToLeaseTime(m_renewalTime, lease.leaseTime);
+}
+
+std::uint32_t Network::getRebindingTime(const Lease& lease) const
+{
+    return scaleToLeaseTime(m_rebindingTime, lease.leaseTime);
 }
 
 const std::string& Network::getLeaseFile() const
@@ -128,6 +377,21 @@ const std::string& Network::getLeaseFile() const
     return m_leaseFile;
 }
 
+void Network::setHostOptions(std::uint64_t hwAddress, HostOptions options)
+{
+    m_maximumHostLeaseTime = std::max(m_maximumHostLeaseTime, options.leaseTime);
+    m_hostOptions[hwAddress] = std::move(options);
+}
+
+const HostOptions* Network::getHostOptions(std::uint64_t hwAddress) const
+{
+    if (m_hostOptions.empty())
+        return nullptr;
+
+    auto it = m_hostOptions.find(hwAddress);
+    return it != m_hostOptions.end() ? &it->second : nullptr;
+}
+
 std::vector<Lease> Network::getAllLeases() const
 {
     std::vector<Lease> leases;
@@ -136,6 +400,11 @@ std::vector<Lease> Network::getAllLeases() const
     return leases;
 }
 
+const LeaseTable& Network::getLeaseTable() const
+{
+    return m_leaseTable;
+}
+
 const Lease& Network::getLease(std::uint64_t hwAddress) const try
 {
     return m_leasesByHw.at(hwAddress);
@@ -154,13 +423,15 @@ catch (const std::out_of_range&)
     return m_invalidLease;
 }
 
-std::uint32_t Network::getAvailableAddress(std::uint64_t hardwareAddress, std::uint32_t preferredIpAddress)
+std::uint32_t Network::getAvailableAddress(std::uint64_t hardwareAddress, std::uint32_t preferredIpAddress,
+                                           ClientClassMask clientClasses)
 {
+    expireQuarantine();
+
     /*
-     * External requests with preferredIpAddress outside the DHCP range is not allowed.
+     * External requests with preferredIpAddress outside the DHCP range (or a pool the client may not use) is not allowed.
     */
-    if (preferredIpAddress > 0 &&
-        ((preferredIpAddress < m_dhcpFirst) || (m_dhcpLast < preferredIpAddress)))
+    if (preferredIpAddress > 0 && !isPoolAllowed(findPoolIndex(preferredIpAddress), clientClasses))
     {
         preferredIpAddress = 0;
     }
@@ -192,7 +463,7 @@ std::uint32_t Network::getAvailableAddress(std::uint64_t hardwareAddress, std::u
         {
             const auto& lease = getLease(preferredIpAddress);
             if (isLeaseEntryValid(lease) && isLeaseExpired(lease))
-                removeLease(preferredIpAddress);
+                removeLease(preferredIpAddress, LeaseChange::Expired);
         }
     }
 
@@ -207,7 +478,7 @@ std::uint32_t Network::getAvailableAddress(std::uint64_t hardwareAddress, std::u
         if (isLeaseEntryValid(lease))
         {
             if (isLeaseExpired(lease))
-                removeLease(hardwareAddress);
+                removeLease(hardwareAddress, LeaseChange::Expired);
             else
                 return lease.ipAddress;
         }
@@ -217,23 +488,79 @@ std::uint32_t Network::getAvailableAddress(std::uint64_t hardwareAddress, std::u
     if (preferredIpAddress != 0)
     {
         const auto& lease = getLease(preferredIpAddress);
-        if (!isLeaseEntryValid(lease))
+        if (!isLeaseEntryValid(lease) && (preferredFromConfig || !isAddressQuarantined(preferredIpAddress)))
             return preferredIpAddress;
     }
 
-    /* Find the first available address in the network */
-    for (std::uint32_t ip = m_dhcpFirst; ip <= m_dhcpLast; ++ip)
+    /*
+     * Give a returning client the address it had last time, if nobody else has taken it since.
+     * Keeps the client's address stable for everything downstream (neighbour caches, DNS, firewall rules).
+    */
+    if (m_history.getCapacity() > 0)
+    {
+        ++m_historyLookups;
+
+        const auto previousIpAddress = m_history.recall(hardwareAddress);
+        if (previousIpAddress != 0
+            && isPoolAllowed(findPoolIndex(previousIpAddress), clientClasses)
+            && isIpFreeForNewLease(previousIpAddress))
+        {
+            ++m_historyHits;
+            return previousIpAddress;
+        }
+    }
+
+    const auto pools = selectPools(clientClasses);
+
+    /*
+     * Hash placement: Start at an address picked by the hardware address and take the first free one from there.
+     * The cost doesn't depend on how full the start of the range is, and a client tends to land on the same address
+     * across restarts (and across servers with the same configuration).
+     * First fit: The lowest free address, in the order the pools are selected.
+    */
+    for (auto index : pools)
     {
-        const auto& lease = getLease(ip);
-        if ((!isLeaseEntryValid(lease) || isLeaseExpired(lease)) && !isIpReservedInConfig(ip))
+        const auto& pool = m_pools[index];
+        if (pool.getSize() == 0)
+            continue;
+
+        auto start = pool.getFirst();
+        if (m_allocationPolicy == AllocationPolicy::Hash)
+            start += static_cast<std::uint32_t>(hashHardwareAddress(hardwareAddress) % pool.getSize());
+
+        const auto ip = pool.findFree(start);
+        if (ip != 0)
             return ip;
     }
 
+    /*
+     * No free addresses, take over the lowest expired lease, in the order the pools are selected.
+     * Only the leases are looked at, not every address in the pools. An address found in use by a probe after its
+     * lease expired is quarantined with the lease still there, and would only be refused again at REQUEST.
+    */
+    std::uint32_t expiredIpAddress{};
+    auto expiredRank = pools.size();
+    for (const auto& [ip, lease] : m_leasesByIp)
+    {
+        if (!isLeaseExpired(lease) || isIpReservedInConfig(ip) || isAddressQuarantined(ip))
+            continue;
+
+        const auto rank = static_cast<std::size_t>(std::ranges::find(pools, findPoolIndex(ip)) - pools.begin());
+        if (rank < expiredRank || (rank == expiredRank && ip < expiredIpAddress))
+        {
+            expiredIpAddress = ip;
+            expiredRank = rank;
+        }
+    }
+
+    if (expiredIpAddress != 0)
+        return expiredIpAddress;
+
     /* IP pool is exhausted */
     return 0;
 }
 
-bool Network::reserveAddress(std::uint64_t hardwareAddress, std::uint32_t ipAddress)
+bool Network::reserveAddress(std::uint64_t hardwareAddress, std::uint32_t ipAddress, const RelayAgentIds& relayAgent)
 {
     /* Check if the IP is allowed - within the network and not the first and last address. */
     if (!isIpAllowed(ipAddress))
@@ -244,10 +571,16 @@ bool Network::reserveAddress(std::uint64_t hardwareAddress, std::uint32_t ipAddr
     /* Allow reserved address to correct hardware address */
     if (m_reservationByHw.contains(hardwareAddress) && m_reservationByHw[hardwareAddress] == ipAddress)
     {
-        addLease(hardwareAddress, ipAddress);
+        addLease(hardwareAddress, ipAddress, relayAgent);
         return true;
     }
 
+    /* Quarantined addresses (declined or found in use) are not handed out */
+    if (isAddressQuarantined(ipAddress))
+    {
+        return false;
+    }
+
     /* Check if IP has a non-expired lease by different hardware address */
     {
         const auto& lease = getLease(ipAddress);
@@ -263,13 +596,109 @@ bool Network::reserveAddress(std::uint64_t hardwareAddress, std::uint32_t ipAddr
     }
 
     /* Add lease */
-    addLease(hardwareAddress, ipAddress);
+    addLease(hardwareAddress, ipAddress, relayAgent);
     return true;
 }
 
 void Network::releaseAddress(std::uint32_t ipAddress)
 {
-    removeLease(ipAddress);
+    removeLease(ipAddress, LeaseChange::Released);
+}
+
+bool Network::declineAddress(std::uint64_t hardwareAddress, std::uint32_t ipAddress)
+{
+    const auto& lease = getLease(ipAddress);
+    if (!isLeaseEntryValid(lease) || lease.hwAddress != hardwareAddress)
+        return false;
+
+    removeLease(ipAddress, LeaseChange::Declined);
+
+    /* Don't offer the client the same address again once it's out of quarantine. */
+    m_history.forget(hardwareAddress);
+
+    quarantineAddress(ipAddress, m_quarantineTime);
+    return true;
+}
+
+void Network::quarantineAddress(std::uint32_t ipAddress, std::uint32_t seconds)
+{
+    if (seconds == 0)
+        return;
+
+    const auto until = std::time(nullptr) + seconds;
+
+    /*
+     * Extending an existing quarantine leaves its old entry in the queue. That one is recognized as stale when it
+     * comes up, because its time no longer matches the map.
+    */
+    auto [it, inserted] = m_quarantine.try_emplace(ipAddress, until);
+    if (!inserted)
+    {
+        if (it->second >= until)
+            return;
+        it->second = until;
+    }
+
+    /* Different timeouts (ie. from conflict probing) may be out of order, keep the queue sorted. */
+    auto position = m_quarantineQueue.end();
+    while (position != m_quarantineQueue.begin() && std::prev(position)->first > until)
+        --position;
+    m_quarantineQueue.emplace(position, until, ipAddress);
+
+    markUsed(ipAddress);
+    ++m_quarantinedCount;
+}
+
+bool Network::isAddressQuarantined(std::uint32_t ipAddress) const
+{
+    auto it = m_quarantine.find(ipAddress);
+    return it != m_quarantine.end() && it->second > std::time(nullptr);
+}
+
+void Network::setQuarantineTime(std::uint32_t seconds)
+{
+    m_quarantineTime = seconds;
+}
+
+std::uint32_t Network::getQuarantineTime() const
+{
+    return m_quarantineTime;
+}
+
+std::size_t Network::getQuarantineSize() const
+{
+    return m_quarantine.size();
+}
+
+std::uint64_t Network::getQuarantinedCount() const
+{
+    return m_quarantinedCount;
+}
+
+std::uint64_t Network::getQuarantineExpiredCount() const
+{
+    return m_quarantineExpiredCount;
+}
+
+void Network::expireQuarantine()
+{
+    const auto now = std::time(nullptr);
+
+    while (!m_quarantineQueue.empty() && m_quarantineQueue.front().first <= now)
+    {
+        const auto [until, ipAddress] = m_quarantineQueue.front();
+        m_quarantineQueue.pop_front();
+
+        auto it = m_quarantine.find(ipAddress);
+        if (it == m_quarantine.end() || it->second != until)
+            continue; // Stale entry, the quarantine was extended.
+
+        m_quarantine.erase(it);
+        ++m_quarantineExpiredCount;
+
+        if (!isLeaseEntryValid(getLease(ipAddress)) && !isIpReservedInConfig(ipAddress))
+            markFree(ipAddress);
+    }
 }
 
 bool Network::isLeaseEntryValid(const Lease& lease)
@@ -282,7 +711,8 @@ bool Network::isLeaseExpired(const Lease& lease) const
     if (!isLeaseEntryValid(lease))
         return true;
 
-    return std::time(nullptr) - lease.startTime > m_leaseTime;
+    const auto leaseTime = lease.leaseTime != 0 ? lease.leaseTime : getMaximumLeaseTime();
+    return std::time(nullptr) - lease.startTime > leaseTime;
 }
 
 bool Network::isIpAllowed(std::uint32_t ipAddress) const
@@ -293,20 +723,196 @@ bool Network::isIpAllowed(std::uint32_t ipAddress) const
             && ipAddress != (m_networkSpace | ~mask)); // last address
 }
 
-void Network::addLease(std::uint64_t hwAddress, std::uint32_t ipAddress)
+std::uint32_t Network::scaleToLeaseTime(std::uint32_t seconds, std::uint32_t leaseTime) const
+{
+    if (leaseTime == m_leaseTime || m_leaseTime == 0)
+        return seconds;
+
+    return static_cast<std::uint32_t>(static_cast<std::uint64_t>(seconds) * leaseTime / m_leaseTime);
+}
+
+std::uint32_t Network::applyJitter(std::uint32_t seconds, std::uint64_t hwAddress) const
+{
+    /*
+     * Times are only ever shortened, so that the client never holds on to an address longer than we think it does.
+     * All three times are scaled by the same factor, which keeps T1 < T2 < lease time.
+    */
+    if (m_leaseJitter == 0)
+        return seconds;
+
+    const auto fraction = hashHardwareAddress(hwAddress) % 1000; // in thousandths
+    const auto reduction = static_cast<std::uint64_t>(seconds) * m_leaseJitter * fraction / (100 * 1000);
+    return seconds - static_cast<std::uint32_t>(reduction);
+}
+
+bool Network::isIpFreeForNewLease(std::uint32_t ipAddress) const
+{
+    /* Addresses not used in the pool are neither leased nor reserved, so only the used ones need a closer look. */
+    const auto* pool = findPool(ipAddress);
+    if (!pool || !pool->isUsed(ipAddress))
+        return true;
+
+    const auto& lease = getLease(ipAddress);
+    return isLeaseEntryValid(lease) && isLeaseExpired(lease) && !isIpReservedInConfig(ipAddress);
+}
+
+void Network::rebuildPool()
+{
+    for (const auto& [ipAddress, lease] : m_leasesByIp)
+        markUsed(ipAddress);
+
+    for (const auto& [ipAddress, hwAddress] : m_reservationByIp)
+        markUsed(ipAddress);
+
+    for (const auto& [ipAddress, until] : m_quarantine)
+        markUsed(ipAddress);
+}
+
+std::size_t Network::findPoolIndex(std::uint32_t ipAddress) const
+{
+    /* The last pool starting at or below the address is the only one that can contain it. */
+    auto it = std::upper_bound(m_poolsByFirst.begin(), m_poolsByFirst.end(), ipAddress,
+                               [this](std::uint32_t ip, std::size_t index) { return ip < m_pools[index].getFirst(); });
+    if (it == m_poolsByFirst.begin())
+        return m_pools.size();
+
+    const auto index = *std::prev(it);
+    return m_pools[index].contains(ipAddress) ? index : m_pools.size();
+}
+
+AddressPool* Network::findPool(std::uint32_t ipAddress)
+{
+    return const_cast<AddressPool*>(std::as_const(*this).findPool(ipAddress));
+}
+
+const AddressPool* Network::findPool(std::uint32_t ipAddress) const
+{
+    const auto index = findPoolIndex(ipAddress);
+    return index < m_pools.size() ? &m_pools[index] : nullptr;
+}
+
+bool Network::isPoolAllowed(std::size_t index, ClientClassMask clientClasses) const
+{
+    return index < m_pools.size() && (m_poolClasses[index] == 0 || (m_poolClasses[index] & clientClasses) != 0);
+}
+
+std::vector<std::size_t> Network::selectPools(ClientClassMask clientClasses) const
+{
+    std::vector<std::size_t> order;
+    order.reserve(m_pools.size());
+    for (std::size_t i = 0; i < m_pools.size(); ++i)
+    {
+        if (isPoolAllowed(i, clientClasses))
+            order.emplace_back(i);
+    }
+
+    /* Pools limited to the client's classes first. Ties keep the configured order. */
+    std::stable_sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b)
+    {
+        const auto classPoolA = m_poolClasses[a] != 0;
+        const auto classPoolB = m_poolClasses[b] != 0;
+        if (classPoolA != classPoolB)
+            return classPoolA;
+
+        if (m_poolSelection != PoolSelection::LeastUsed)
+            return false;
+
+        /* Compares used / size without rounding, an empty pool counts as full. */
+        const auto& poolA = m_pools[a];
+        const auto& poolB = m_pools[b];
+        if (poolA.getSize() == 0 || poolB.getSize() == 0)
+            return poolA.getSize() > poolB.getSize();
+
+        return static_cast<std::uint64_t>(poolA.getUsedCount()) * poolB.getSize()
+             < static_cast<std::uint64_t>(poolB.getUsedCount()) * poolA.getSize();
+    });
+
+    return order;
+}
+
+void Network::markUsed(std::uint32_t ipAddress)
+{
+    if (auto* pool = findPool(ipAddress))
+        pool->markUsed(ipAddress);
+}
+
+void Network::markFree(std::uint32_t ipAddress)
+{
+    if (auto* pool = findPool(ipAddress))
+        pool->markFree(ipAddress);
+}
+
+void Network::addLease(std::uint64_t hwAddress, std::uint32_t ipAddress, const RelayAgentIds& relayAgent)
 {
-    auto& lease = m_leasesByHw[hwAddress];
+    const auto& existing = getLease(hwAddress);
+    const bool renewed = isLeaseEntryValid(existing) && existing.ipAddress == ipAddress && !isLeaseExpired(existing);
+
+    Lease lease;
     lease.startTime = std::time(nullptr);
     lease.hwAddress = hwAddress;
     lease.ipAddress = ipAddress;
-    m_leasesByIp[ipAddress] = lease;
+    lease.leaseTime = getLeaseTime(hwAddress);
+    lease.relayAgent = relayAgent;
+    storeLease(lease);
+
+    notifyLeaseListener(renewed ? LeaseChange::Renewed : LeaseChange::Added, lease);
 
     const auto& leaseFile = getLeaseFile();
     if (!leaseFile.empty())
         Configuration::SavePersistentLeases(getAllLeases(), leaseFile);
 }
 
-void Network::removeLease(std::uint64_t hwAddress)
+void Network::storeLease(const Lease& lease)
+{
+    /*
+     * Drop stale entries first: The hardware address may have had a lease on a different address, or the address
+     * may have had an expired lease by a different hardware address. Either would leave the two maps out of sync.
+    */
+    {
+        const auto& existing = getLease(lease.hwAddress);
+        if (isLeaseEntryValid(existing) && existing.ipAddress != lease.ipAddress)
+            removeLease(lease.hwAddress, isLeaseExpired(existing) ? LeaseChange::Expired : LeaseChange::Removed);
+    }
+
+    {
+        const auto& existing = getLease(lease.ipAddress);
+        if (isLeaseEntryValid(existing) && existing.hwAddress != lease.hwAddress)
+            removeLease(lease.ipAddress, isLeaseExpired(existing) ? LeaseChange::Expired : LeaseChange::Removed);
+    }
+
+    m_leasesByHw[lease.hwAddress] = lease;
+    m_leasesByIp[lease.ipAddress] = lease;
+    m_leaseTable.set(lease);
+    markUsed(lease.ipAddress);
+}
+
+void Network::setLeaseListener(LeaseListener listener)
+{
+    m_leaseListener = std::move(listener);
+}
+
+void Network::importLease(const Lease& lease)
+{
+    auto listener = std::exchange(m_leaseListener, nullptr);
+    storeLease(withLeaseTime(lease));
+    m_leaseListener = std::move(listener);
+}
+
+Lease Network::withLeaseTime(Lease lease) const
+{
+    if (lease.leaseTime == 0)
+        lease.leaseTime = getMaximumLeaseTime();
+    return lease;
+}
+
+void Network::importLeaseRemoval(std::uint64_t hwAddress)
+{
+    auto listener = std::exchange(m_leaseListener, nullptr);
+    removeLease(hwAddress);
+    m_leaseListener = std::move(listener);
+}
+
+void Network::removeLease(std::uint64_t hwAddress, LeaseChange reason)
 {
     auto lease = getLease(hwAddress);
     if (!isLeaseEntryValid(lease))
@@ -316,9 +922,16 @@ void Network::removeLease(std::uint64_t hwAddress)
 
     m_leasesByHw.erase(hwAddress);
     m_leasesByIp.erase(ipAddress);
+    m_leaseTable.remove(hwAddress);
+    m_history.remember(hwAddress, ipAddress);
+
+    if (!isIpReservedInConfig(ipAddress) && !m_quarantine.contains(ipAddress))
+        markFree(ipAddress);
+
+    notifyLeaseListener(reason, lease);
 }
 
-void Network::removeLease(std::uint32_t ipAddress)
+void Network::removeLease(std::uint32_t ipAddress, LeaseChange reason)
 {
     auto lease = getLease(ipAddress);
     if (!isLeaseEntryValid(lease))
@@ -328,12 +941,22 @@ void Network::removeLease(std::uint32_t ipAddress)
 
     m_leasesByIp.erase(ipAddress);
     m_leasesByHw.erase(hwAddress);
+    m_leaseTable.remove(hwAddress);
+    m_history.remember(hwAddress, ipAddress);
+
+    if (!isIpReservedInConfig(ipAddress) && !m_quarantine.contains(ipAddress))
+        markFree(ipAddress);
+
+    notifyLeaseListener(reason, lease);
+}
+
+void Network::notifyLeaseListener(LeaseChange change, const Lease& lease)
+{
+    if (m_leaseListener)
+        m_leaseListener(change, lease);
 }
 
 bool Network::isIpReservedInConfig(std::uint32_t ipAddress) const
 {
-    return std::ranges::any_of(m_reservationByHw,
-                               [&ipAddress](const auto& kv) {
-                                   return kv.second == ipAddress;
-                               });
+    return m_reservationByIp.contains(ipAddress);
 }
@@ -7,20 +7,54 @@
 
 #pragma once
 
+#include "AddressPool.h"
+#include "ClientHistory.h"
 #include "IpConverter.h"
+#include "LeaseTable.h"
 #include "Structures.h"
 #include "Configuration.h"
 
 #include <cstdint>
 #include <ctime>
+#include <deque>
+#include <functional>
+#include <utility>
 #include <vector>
 #include <unordered_map>
 
+enum class LeaseChange : std::uint8_t
+{
+    Added,    // New, the lease replaces any other lease on its hardware address or IP address.
+    Removed,  // Moved to another address, or taken by another client.
+    Renewed,  // Extended by the client holding it.
+    Released,
+    Expired,  // Found expired when its address or client was next looked at. Leases aren't expired as they run out.
+    Declined
+};
+
+// Whether the lease is in effect after the change.
+constexpr bool isLeaseHeld(LeaseChange change)
+{
+    return change == LeaseChange::Added || change == LeaseChange::Renewed;
+}
+
+// Told about every lease added or removed, on the thread that changed it. Must not call back into the network.
+using LeaseListener = std::function<void(LeaseChange change, const Lease& lease)>;
+
 class Network
 {
 public:
+    // Leases without a lease time (loaded from the lease file) get getMaximumLeaseTime(), see importLease().
     void configure(NetworkConfiguration&& config, const std::vector<Lease>& leases = {});
 
+    /*
+     * Takes over the configuration of prepared, a network configured without leases (ie. on another thread), and keeps
+     * the leases. The history and quarantine are kept as well, unless the network space or size changed. The pools are
+     * taken as they are, with the reservations marked, so only the leases and quarantined addresses are marked here.
+     * Containers are swapped, prepared is left with the old reservations and pools to be freed elsewhere.
+    */
+    void reconfigure(Network& prepared);
+
     void setNetworkSpace(std::uint32_t networkSpace);
 
     std::uint32_t getNetworkSpace() const;
@@ -41,32 +75,145 @@ public:
 
     const std::vector<std::uint32_t>& getDnsServers() const;
 
+    // Replaces all pools with a single one covering the range.
     void setDhcpRange(std::uint32_t first, std::uint32_t last);
 
+    // Pools must not overlap. Leases and reservations are kept, and marked used in whichever pool they fall in.
+    void setPools(std::vector<PoolConfiguration> pools);
+
+    void setPoolSelection(PoolSelection selection);
+
     void setLeaseDuration(std::uint32_t leaseTimeSeconds);
 
+    void setLeaseJitter(std::uint8_t percent);
+
+    // Lease time follows pool utilization, between minimum and maximum. Both 0 disables.
+    void setAdaptiveLeaseTime(std::uint32_t minimum, std::uint32_t maximum,
+                              std::uint8_t lowWatermark = NetworkDefaults::utilizationLowWatermark,
+                              std::uint8_t highWatermark = NetworkDefaults::utilizationHighWatermark);
+
     std::uint32_t getBroadcastAddress() const;
 
+    /*
+     * Times handed out to new leases right now. With adaptive lease time, these change with pool utilization:
+     * at or below the low watermark the maximum lease time is given, at or above the high watermark the minimum,
+     * and in between it goes linearly from one to the other. T1 and T2 keep their proportion to the lease time.
+    */
     std::uint32_t getLeaseTime() const;
 
     std::uint32_t getRenewalTime() const;
 
     std::uint32_t getRebindingTime() const;
 
+    // The longest lease time that might have been handed out. Used when a lease doesn't know its own lease time.
+    std::uint32_t getMaximumLeaseTime() const;
+
+    // The same for a network configured with config, for those reading its lease table instead of the network.
+    static std::uint32_t getMaximumLeaseTime(const NetworkConfiguration& config);
+
+    // Used addresses in all pools together, in percent.
+    std::uint32_t getPoolUtilization() const;
+
+    // Addresses in all pools together, and how many of them are used.
+    std::uint32_t getPoolSize() const;
+
+    std::uint32_t getPoolUsedCount() const;
+
+    // Pools are numbered in the order they were configured.
+    std::size_t getPoolCount() const;
+
+    const AddressPool& getPool(std::size_t index = 0) const;
+
+    const std::string& getPoolName(std::size_t index) const;
+
+    void setAllocationPolicy(AllocationPolicy policy);
+
+    // Number of clients without a lease that could be remembered, 0 disables.
+    void setHistorySize(std::uint32_t historySize);
+
+    // How often a client without a lease was looked up in the history, and got its previous address back.
+    std::uint64_t getHistoryLookups() const;
+
+    std::uint64_t getHistoryHits() const;
+
+    // Whether the address is leased to the hardware address, or was the last one it had. Expired leases count.
+    bool hasHeldAddress(std::uint64_t hwAddress, std::uint32_t ipAddress) const;
+
+    /*
+     * Per-client variants of the above, shortened by up to the configured lease jitter.
+     * The amount is derived from the hardware address, so a client gets the same times on every request, while
+     * clients that all got their leases at the same time (ie. after a power outage) spread out their renewals.
+     * A lease time given for the host on its reserve line is used as it is instead.
+    */
+    std::uint32_t getLeaseTime(std::uint64_t hwAddress) const;
+
+    std::uint32_t getRenewalTime(std::uint64_t hwAddress) const;
+
+    std::uint32_t getRebindingTime(std::uint64_t hwAddress) const;
+
+    // Times for an existing lease, matching the lease time it was granted.
+    std::uint32_t getRenewalTime(const Lease& lease) const;
+
+    std::uint32_t getRebindingTime(const Lease& lease) const;
+
     const std::string& getLeaseFile() const;
 
+    void setHostOptions(std::uint64_t hwAddress, HostOptions options);
+
+    // Returns nullptr if the host has no options of its own.
+    const HostOptions* getHostOptions(std::uint64_t hwAddress) const;
+
     std::vector<Lease> getAllLeases() const;
 
+    // The same leases, for reading from other threads. See LeaseTable.
+    const LeaseTable& getLeaseTable() const;
+
+    // Kept when reconfigured.
+    void setLeaseListener(LeaseListener listener);
+
+    /*
+     * Takes a lease as it is, ie. one replicated from another server, replacing any other lease on either address.
+     * Unlike leases handed out here, the lease file isn't written and the listener isn't told.
+     * A lease without a lease time gets getMaximumLeaseTime(), so that the lease table says how long the network
+     * considers it held, for everyone reading it on other threads.
+    */
+    void importLease(const Lease& lease);
+
+    void importLeaseRemoval(std::uint64_t hwAddress);
+
     const Lease& getLease(std::uint64_t hwAddress) const;
 
     const Lease& getLease(std::uint32_t ipAddress) const;
 
-    std::uint32_t getAvailableAddress(std::uint64_t hardwareAddress, std::uint32_t preferredIpAddress = 0);
+    // Pools limited to client classes are only used if the client is in one of them, and are tried before the others.
+    std::uint32_t getAvailableAddress(std::uint64_t hardwareAddress, std::uint32_t preferredIpAddress = 0,
+                                      ClientClassMask clientClasses = 0);
 
-    bool reserveAddress(std::uint64_t hardwareAddress, std::uint32_t ipAddress);
+    // The relay agent the request came through is kept with the lease, for bulk leasequery.
+    bool reserveAddress(std::uint64_t hardwareAddress, std::uint32_t ipAddress, const RelayAgentIds& relayAgent = {});
 
     void releaseAddress(std::uint32_t ipAddress);
 
+    // Client reports the address as already in use by someone else (DHCPDECLINE). The address is quarantined.
+    // Returns false if the hardware address doesn't hold a lease on it, in which case nothing is done.
+    bool declineAddress(std::uint64_t hardwareAddress, std::uint32_t ipAddress);
+
+    // Keeps the address from being handed out for the given number of seconds.
+    void quarantineAddress(std::uint32_t ipAddress, std::uint32_t seconds);
+
+    bool isAddressQuarantined(std::uint32_t ipAddress) const;
+
+    void setQuarantineTime(std::uint32_t seconds);
+
+    std::uint32_t getQuarantineTime() const;
+
+    // Addresses currently in quarantine, and how many have been put in or let out of it since start.
+    std::size_t getQuarantineSize() const;
+
+    std::uint64_t getQuarantinedCount() const;
+
+    std::uint64_t getQuarantineExpiredCount() const;
+
     static bool isLeaseEntryValid(const Lease& lease);
 
     bool isLeaseExpired(const Lease& lease) const;
@@ -76,29 +223,98 @@ private:
     std::uint8_t m_networkSize{ NetworkDefaults::size };
     std::uint32_t m_routers{ NetworkDefaults::routers };
     std::uint32_t m_dhcpServerIdentifier{ NetworkDefaults::serverIdentifier };
-    std::uint32_t m_dhcpFirst{ NetworkDefaults::first };
-    std::uint32_t m_dhcpLast{ NetworkDefaults::last };
+
+    /*
+     * Each pool has its own bitmap and used count. m_poolsByFirst holds indices into m_pools sorted by first
+     * address, so the pool of an address is found with a binary search.
+    */
+    std::vector<AddressPool> m_pools{ AddressPool(NetworkDefaults::first, NetworkDefaults::last) };
+    std::vector<std::string> m_poolNames{ "default" };
+    std::vector<ClientClassMask> m_poolClasses{ 0 };
+    std::vector<std::size_t> m_poolsByFirst{ 0 };
+    PoolSelection m_poolSelection{ PoolSelection::Ordered };
+
     std::vector<std::uint32_t> m_dnsServers;
     std::uint32_t m_leaseTime{ NetworkDefaults::leaseTime };
     std::uint32_t m_renewalTime{ NetworkDefaults::renewalTime };
     std::uint32_t m_rebindingTime{ NetworkDefaults::rebindingTime };
+    std::uint8_t m_leaseJitter{};
+    std::uint32_t m_minimumLeaseTime{};
+    std::uint32_t m_maximumLeaseTime{};
+    std::uint8_t m_utilizationLowWatermark{ NetworkDefaults::utilizationLowWatermark };
+    std::uint8_t m_utilizationHighWatermark{ NetworkDefaults::utilizationHighWatermark };
     std::string m_leaseFile;
 
     std::unordered_map<std::uint64_t, std::uint32_t> m_reservationByHw;
     std::unordered_map<std::uint32_t, std::uint64_t> m_reservationByIp;
+    std::unordered_map<std::uint64_t, HostOptions> m_hostOptions;
+    std::uint32_t m_maximumHostLeaseTime{};
+
+    AllocationPolicy m_allocationPolicy{ AllocationPolicy::FirstFit };
+
+    ClientHistory m_history{ NetworkDefaults::historySize };
+    std::uint64_t m_historyLookups{};
+    std::uint64_t m_historyHits{};
+
+    /*
+     * Quarantined addresses are marked used in their pool, so allocation skips them at no extra cost.
+     * The queue is in order of expiry, so expired addresses are let out without searching for them.
+    */
+    std::uint32_t m_quarantineTime{ NetworkDefaults::quarantineTime };
+    std::unordered_map<std::uint32_t, std::time_t> m_quarantine;
+    std::deque<std::pair<std::time_t, std::uint32_t>> m_quarantineQueue;
+    std::uint64_t m_quarantinedCount{};
+    std::uint64_t m_quarantineExpiredCount{};
 
     std::unordered_map<std::uint64_t, Lease> m_leasesByHw;
     std::unordered_map<std::uint32_t, Lease> m_leasesByIp;
+    LeaseTable m_leaseTable;
+    LeaseListener m_leaseListener;
 
     const Lease m_invalidLease;
 
     bool isIpAllowed(std::uint32_t ipAddress) const;
 
+    std::uint32_t applyJitter(std::uint32_t seconds, std::uint64_t hwAddress) const;
+
+    std::uint32_t scaleToLeaseTime(std::uint32_t seconds, std::uint32_t leaseTime) const;
+
+    // Both getMaximumLeaseTime() go by this, so they can't disagree.
+    static std::uint32_t longestLeaseTime(std::uint32_t leaseTime, std::uint32_t maximumLeaseTime, std::uint32_t maximumHostLeaseTime);
+
+    void rebuildPool();
+
+    // Returns the number of pools if the address isn't in any of them.
+    std::size_t findPoolIndex(std::uint32_t ipAddress) const;
+
+    AddressPool* findPool(std::uint32_t ipAddress);
+
+    const AddressPool* findPool(std::uint32_t ipAddress) const;
+
+    bool isPoolAllowed(std::size_t index, ClientClassMask clientClasses) const;
+
+    // Indices of the pools the client may use, in the order a new address should be looked for in them.
+    std::vector<std::size_t> selectPools(ClientClassMask clientClasses) const;
+
+    void markUsed(std::uint32_t ipAddress);
+
+    void markFree(std::uint32_t ipAddress);
+
+    bool isIpFreeForNewLease(std::uint32_t ipAddress) const;
+
+    void expireQuarantine();
+
     bool isIpReservedInConfig(std::uint32_t ipAddress) const;
 
-    void addLease(std::uint64_t hwAddress, std::uint32_t ipAddress);
+    void addLease(std::uint64_t hwAddress, std::uint32_t ipAddress, const RelayAgentIds& relayAgent);
+
+    Lease withLeaseTime(Lease lease) const;
+
+    void storeLease(const Lease& lease);
+
+    void removeLease(std::uint64_t hwAddress, LeaseChange reason = LeaseChange::Removed);
 
-    void removeLease(std::uint64_t hwAddress);
+    void removeLease(std::uint32_t ipAddress, LeaseChange reason = LeaseChange::Removed);
 
-    void removeLease(std::uint32_t ipAddress);
+    void notifyLeaseListener(LeaseChange change, const Lease& lease);
 };
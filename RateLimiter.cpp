@@ -0,0 +1,112 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "RateLimiter.h"
+
+#include <algorithm>
+
+bool TokenBucket::consume(std::uint32_t rate, std::uint32_t burst, std::uint64_t nowMs)
+{
+    /* Tokens per second is the same as milli-tokens per millisecond. */
+    const auto elapsedMs = nowMs > lastRefillMs ? nowMs - lastRefillMs : 0;
+    milliTokens = std::min<std::uint64_t>(milliTokens + elapsedMs * rate, burst * 1000ull);
+    lastRefillMs = nowMs;
+
+    if (milliTokens < 1000)
+        return false;
+
+    milliTokens -= 1000;
+    return true;
+}
+
+void RateLimiter::configure(std::uint32_t clientRate, std::uint32_t clientBurst,
+                            std::uint32_t interfaceRate, std::uint32_t interfaceBurst,
+                            std::uint32_t tableSize)
+{
+    m_clientRate = clientRate;
+    m_clientBurst = std::max(clientBurst, 1u);
+    m_interfaceRate = interfaceRate;
+    m_interfaceBurst = std::max(interfaceBurst, 1u);
+
+    m_interfaceBucket = { m_interfaceBurst * 1000ull, 0 };
+
+    m_clientSlots.clear();
+    m_clockHands.clear();
+    m_setCount = 0;
+
+    if (m_clientRate > 0)
+    {
+        m_setCount = std::max((tableSize + SetSize - 1) / SetSize, 1u);
+        m_clientSlots.resize(m_setCount * SetSize);
+        m_clockHands.resize(m_setCount);
+    }
+}
+
+bool RateLimiter::isEnabled() const
+{
+    return m_clientRate > 0 || m_interfaceRate > 0;
+}
+
+RateLimiter::Verdict RateLimiter::admit(std::uint64_t hwAddress, std::uint64_t nowMs)
+{
+    /*
+     * Check the client first, so that a single misbehaving client doesn't eat the tokens of the interface.
+    */
+    if (m_clientRate > 0)
+    {
+        auto& slot = findClientSlot(hwAddress, nowMs);
+        if (!slot.bucket.consume(m_clientRate, m_clientBurst, nowMs))
+            return Verdict::ClientLimited;
+    }
+
+    if (m_interfaceRate > 0 && !m_interfaceBucket.consume(m_interfaceRate, m_interfaceBurst, nowMs))
+        return Verdict::InterfaceLimited;
+
+    return Verdict::Accept;
+}
+
+RateLimiter::ClientSlot& RateLimiter::findClientSlot(std::uint64_t hwAddress, std::uint64_t nowMs)
+{
+    /* Fibonacci hashing spreads sequential hardware addresses (same vendor prefix) over all sets. */
+    const auto set = static_cast<std::uint32_t>((hwAddress * 0x9E3779B97F4A7C15ull) >> 32) % m_setCount;
+    auto* slots = m_clientSlots.data() + set * SetSize;
+
+    ClientSlot* freeSlot = nullptr;
+    for (auto i = 0u; i < SetSize; ++i)
+    {
+        auto& slot = slots[i];
+        if (!slot.used)
+        {
+            if (!freeSlot)
+                freeSlot = &slot;
+        }
+        else if (slot.hwAddress == hwAddress)
+        {
+            slot.referenced = true;
+            return slot;
+        }
+    }
+
+    if (!freeSlot)
+    {
+        /* CLOCK: Advance the hand, clearing reference bits, until an unreferenced slot comes up. */
+        auto& hand = m_clockHands[set];
+        while (slots[hand].referenced)
+        {
+            slots[hand].referenced = false;
+            hand = (hand + 1) % SetSize;
+        }
+        freeSlot = &slots[hand];
+        hand = (hand + 1) % SetSize;
+    }
+
+    freeSlot->hwAddress = hwAddress;
+    freeSlot->bucket = { m_clientBurst * 1000ull, nowMs };
+    freeSlot->used = true;
+    freeSlot->referenced = false;
+    return *freeSlot;
+}
@@ -0,0 +1,76 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Token bucket, with the token count kept in thousandths so that refilling by milliseconds needs no floating point.
+*/
+struct TokenBucket
+{
+    std::uint64_t milliTokens{};
+    std::uint64_t lastRefillMs{};
+
+    // Refills the bucket by `rate` tokens per second (never above `burst`) and tries to take one token from it.
+    bool consume(std::uint32_t rate, std::uint32_t burst, std::uint64_t nowMs);
+};
+
+/*
+ * Limits the rate of requests per hardware address, and for the interface as a whole.
+ *
+ * Per-client buckets are kept in a fixed-size table which never allocates after configure(). The table is
+ * set-associative: a hardware address can only live in one small set of slots, and when the set is full the
+ * slot to reuse is picked by the CLOCK algorithm (slots used since the hand last passed get a second chance).
+ * A flood of random hardware addresses will thus keep recycling slots rather than growing the table.
+*/
+class RateLimiter
+{
+public:
+    enum class Verdict
+    {
+        Accept,
+        ClientLimited,
+        InterfaceLimited
+    };
+
+    // A rate of 0 disables that limit. The table size is rounded up to a whole number of sets.
+    void configure(std::uint32_t clientRate, std::uint32_t clientBurst,
+                   std::uint32_t interfaceRate, std::uint32_t interfaceBurst,
+                   std::uint32_t tableSize);
+
+    [[nodiscard]]
+    bool isEnabled() const;
+
+    Verdict admit(std::uint64_t hwAddress, std::uint64_t nowMs);
+
+private:
+    static constexpr std::uint32_t SetSize{ 8 };
+
+    struct ClientSlot
+    {
+        std::uint64_t hwAddress{};
+        TokenBucket bucket;
+        bool used{};
+        bool referenced{};
+    };
+
+    std::uint32_t m_clientRate{};
+    std::uint32_t m_clientBurst{};
+    std::uint32_t m_interfaceRate{};
+    std::uint32_t m_interfaceBurst{};
+
+    TokenBucket m_interfaceBucket;
+
+    std::vector<ClientSlot> m_clientSlots;
+    std::vector<std::uint8_t> m_clockHands; // One per set.
+    std::uint32_t m_setCount{};
+
+    ClientSlot& findClientSlot(std::uint64_t hwAddress, std::uint64_t nowMs);
+};
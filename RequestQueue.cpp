@@ -0,0 +1,79 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "RequestQueue.h"
+#include "Serializer.h"
+
+#include <algorithm>
+
+RequestPriority classifyRequest(std::span<const std::uint8_t> data, DHCPMessageType messageType)
+{
+    switch (messageType)
+    {
+        case DHCP_Request:
+        {
+            std::uint32_t ciaddr{};
+            if (peekClientIpAddress(data, ciaddr) && ciaddr != 0)
+                return Priority_Renewal;
+            return Priority_Request;
+        }
+
+        case DHCP_Release: [[fallthrough]];
+        case DHCP_Decline:
+            return Priority_Renewal;
+
+        default:
+            return Priority_Discover;
+    }
+}
+
+RequestQueue::RequestQueue(Statistics::Counter& queueFullCounter, Statistics::Counter& staleDiscoverCounter)
+    : m_queueFullCounter(queueFullCounter)
+    , m_staleDiscoverCounter(staleDiscoverCounter)
+{
+}
+
+bool RequestQueue::push(std::vector<std::uint8_t>&& data, std::chrono::steady_clock::time_point received)
+{
+    const auto messageType = peekMessageType(data);
+    auto& queue = m_queues[classifyRequest(data, messageType)];
+    if (queue.size() >= MaxQueuedRequests)
+    {
+        m_queueFullCounter.increment();
+        return false;
+    }
+
+    queue.push_back({ std::move(data), received, messageType });
+    return true;
+}
+
+bool RequestQueue::pop(QueuedRequest& request, std::chrono::steady_clock::time_point now)
+{
+    for (auto& queue : m_queues)
+    {
+        while (!queue.empty())
+        {
+            request = std::move(queue.front());
+            queue.pop_front();
+
+            if (request.messageType == DHCP_Discover && now - request.received > DiscoverRetransmitInterval)
+            {
+                m_staleDiscoverCounter.increment();
+                continue;
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool RequestQueue::empty() const
+{
+    return std::ranges::all_of(m_queues, [](const auto& queue) { return queue.empty(); });
+}
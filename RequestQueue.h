@@ -0,0 +1,76 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include "Statistics.h"
+#include "Structures.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <vector>
+
+/*
+ * Served in this order. Clients renewing an existing lease come first, as they are the ones whose networking breaks
+ * if they're left waiting. New clients (DISCOVER) come last, those will retransmit anyway.
+*/
+enum RequestPriority : std::size_t
+{
+    Priority_Renewal,   // REQUEST with ciaddr set (RENEWING/REBINDING), RELEASE and DECLINE.
+    Priority_Request,   // REQUEST without ciaddr (SELECTING/INIT-REBOOT), finishing a handshake.
+    Priority_Discover,  // DISCOVER and anything we couldn't classify.
+
+    Priority_Count
+};
+
+// Only looks at the fixed header and the message type option.
+RequestPriority classifyRequest(std::span<const std::uint8_t> data, DHCPMessageType messageType);
+
+struct QueuedRequest
+{
+    std::vector<std::uint8_t> data;
+    std::chrono::steady_clock::time_point received;
+    DHCPMessageType messageType{ DHCP_UnknownMessage };
+};
+
+/*
+ * Requests waiting to be handled, one queue per priority. Not thread safe, whoever shares it between the receiving
+ * and the processing thread guards it.
+*/
+class RequestQueue
+{
+public:
+    // Upper bound on datagrams waiting in each priority queue, beyond this they're dropped on arrival.
+    static constexpr std::size_t MaxQueuedRequests{ 1024 };
+
+    /*
+     * RFC 2131 4.1: Clients retransmit DHCPDISCOVER after 4 seconds at the earliest. By then the client has given up on
+     * the one we're holding, and answering it would only delay the requests behind it.
+    */
+    static constexpr auto DiscoverRetransmitInterval = std::chrono::seconds(4);
+
+    // The counters are told about requests dropped for a full queue, and DISCOVERs dropped for being stale.
+    RequestQueue(Statistics::Counter& queueFullCounter, Statistics::Counter& staleDiscoverCounter);
+
+    // Returns false if the request's queue was full, and it was dropped.
+    bool push(std::vector<std::uint8_t>&& data, std::chrono::steady_clock::time_point received);
+
+    // Takes the next request to handle, from the highest priority queue that has one. DISCOVERs older than
+    // DiscoverRetransmitInterval are dropped on the way. Returns false if there's nothing left to handle.
+    bool pop(QueuedRequest& request, std::chrono::steady_clock::time_point now);
+
+    [[nodiscard]]
+    bool empty() const;
+
+private:
+    std::array<std::deque<QueuedRequest>, Priority_Count> m_queues;
+    Statistics::Counter& m_queueFullCounter;
+    Statistics::Counter& m_staleDiscoverCounter;
+};
@@ -0,0 +1,81 @@
+/*
+ * TDHCPD Reservation Compiler - Compile CSV reservations for TDHCPD.
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "IpConverter.h"
+#include "ReservationFile.h"
+
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+
+void print(std::string_view format, auto&&...args)
+{
+    std::cout << std::vformat(format, std::make_format_args(args...));
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        print("Usage: {} <input.csv> <output>\n", argv[0]);
+        return 1;
+    }
+
+    std::string inputFilename(argv[1]);
+    std::string outputFilename(argv[2]);
+
+    std::ifstream ifs(inputFilename, std::ios::in | std::ios::binary);
+    if (!ifs.is_open())
+    {
+        print("Couldn't open {}\n", inputFilename);
+        return 1;
+    }
+
+    std::string text(std::istreambuf_iterator<char>(ifs), {});
+
+    std::vector<ReservationFile::Record> records;
+    std::size_t errorLine{};
+    if (!ReservationFile::ParseCsv(text, records, errorLine))
+    {
+        print("{}:{}: Expected a hardware address and an IP address, separated by a comma\n", inputFilename, errorLine);
+        return 1;
+    }
+
+    /* The daemon would silently let the last one win, point them out here instead. */
+    std::unordered_map<std::uint64_t, std::uint32_t> byHwAddress;
+    std::unordered_map<std::uint32_t, std::uint64_t> byIpAddress;
+    byHwAddress.reserve(records.size());
+    byIpAddress.reserve(records.size());
+
+    int duplicates{};
+    for (const auto& record : records)
+    {
+        if (!byHwAddress.emplace(record.hwAddress, record.ipAddress).second)
+        {
+            print("Warning: {} is reserved more than once\n", formatHardwareAddress(record.hwAddress));
+            ++duplicates;
+        }
+
+        if (!byIpAddress.emplace(record.ipAddress, record.hwAddress).second)
+        {
+            print("Warning: {} is reserved for more than one hardware address\n", formatIpAddress(record.ipAddress));
+            ++duplicates;
+        }
+    }
+
+    if (!ReservationFile::Save(outputFilename, records))
+    {
+        print("Couldn't write {}\n", outputFilename);
+        return 1;
+    }
+
+    print("Compiled {} reservations to {} ({} warnings)\n", records.size(), outputFilename, duplicates);
+    return 0;
+}
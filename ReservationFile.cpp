@@ -0,0 +1,131 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "ReservationFile.h"
+#include "IpConverter.h"
+#include "Logger.h"
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fstream>
+
+namespace
+{
+std::string_view trim(std::string_view text)
+{
+    const auto first = text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos)
+        return {};
+
+    return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+}
+
+bool ReservationFile::Load(const std::string& filename, std::unordered_map<std::uint64_t, std::uint32_t>& reservations)
+{
+    MappedFile file(filename);
+    if (!file.isOpen())
+    {
+        const auto e = errno;
+        Log::Critical("Configuration error: Couldn't read reservations file {}, errno={}", filename, e);
+        return false;
+    }
+
+    const auto data = file.getData();
+
+    if (data.size() >= sizeof(Header) && std::memcmp(data.data(), Magic, sizeof(Magic)) == 0)
+    {
+        Header header{};
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        if (header.version != Version || data.size() < sizeof(Header) + std::size_t{ header.count } * sizeof(Record))
+        {
+            Log::Critical("Configuration error: Reservations file {} is truncated or of an unknown version", filename);
+            return false;
+        }
+
+        reservations.reserve(reservations.size() + header.count);
+
+        /* Copied out one at a time, the mapping gives no alignment guarantees past the page. */
+        for (std::uint32_t i = 0; i < header.count; ++i)
+        {
+            Record record{};
+            std::memcpy(&record, data.data() + sizeof(Header) + i * sizeof(Record), sizeof(Record));
+            reservations[record.hwAddress] = record.ipAddress;
+        }
+
+        Log::Info("Loaded {} reservations from {}", header.count, filename);
+        return true;
+    }
+
+    std::vector<Record> records;
+    std::size_t errorLine{};
+    if (!ParseCsv({ reinterpret_cast<const char*>(data.data()), data.size() }, records, errorLine))
+    {
+        Log::Critical("Configuration error: Reservations file {} has an invalid line {}", filename, errorLine);
+        return false;
+    }
+
+    reservations.reserve(reservations.size() + records.size());
+    for (const auto& record : records)
+        reservations[record.hwAddress] = record.ipAddress;
+
+    Log::Info("Loaded {} reservations from {}", records.size(), filename);
+    return true;
+}
+
+bool ReservationFile::ParseCsv(std::string_view text, std::vector<Record>& records, std::size_t& errorLine)
+{
+    records.reserve(records.size() + text.size() / 32); // Roughly the length of a line.
+
+    std::size_t lineNumber{};
+    while (!text.empty())
+    {
+        ++lineNumber;
+
+        const auto end = text.find('\n');
+        auto line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view{} : text.substr(end + 1);
+
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+
+        const auto comma = line.find(',');
+        const auto hwText = trim(line.substr(0, comma));
+        const auto ipText = comma == std::string_view::npos ? std::string_view{} : trim(line.substr(comma + 1, line.find(',', comma + 1) - comma - 1));
+
+        Record record{};
+        if (!parseHardwareAddress(hwText, record.hwAddress) || !parseIpAddress(ipText, record.ipAddress))
+        {
+            errorLine = lineNumber;
+            return false;
+        }
+
+        records.emplace_back(record);
+    }
+
+    return true;
+}
+
+bool ReservationFile::Save(const std::string& filename, std::span<const Record> records)
+{
+    std::ofstream ofs(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open())
+        return false;
+
+    Header header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.count = static_cast<std::uint32_t>(records.size());
+
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size_bytes()));
+    return ofs.good();
+}
@@ -0,0 +1,54 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Reservations kept outside the configuration file, for when there are too many to write as reserve lines.
+ *
+ * The file is either CSV, one "hardware address,IP address" per line (further columns are ignored), or the binary
+ * format made from it by the reservation compiler: A header followed by fixed size records in native byte order
+ * (like the lease file), which is loaded without parsing anything.
+*/
+namespace ReservationFile
+{
+    constexpr char Magic[4] = { 'T', 'D', 'R', 'V' };
+    constexpr std::uint32_t Version = 1;
+
+    struct Header
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t count;
+        std::uint32_t reserved;
+    };
+
+    struct Record
+    {
+        std::uint64_t hwAddress;
+        std::uint32_t ipAddress;
+        std::uint32_t reserved;
+    };
+
+    static_assert(sizeof(Header) == 16 && sizeof(Record) == 16);
+
+    // Loads either format through mmap, adding to the reservations. Errors are logged.
+    bool Load(const std::string& filename, std::unordered_map<std::uint64_t, std::uint32_t>& reservations);
+
+    // Returns false on the first malformed line, and its line number (counting from 1) in errorLine.
+    bool ParseCsv(std::string_view text, std::vector<Record>& records, std::size_t& errorLine);
+
+    bool Save(const std::string& filename, std::span<const Record> records);
+}
@@ -8,6 +8,8 @@
 #include "Serializer.h"
 #include "Logger.h"
 
+#include <algorithm>
+#include <bitset>
 #include <string>
 
 namespace
@@ -86,7 +88,8 @@ bool deserializeBootpOptions(std::span<const std::uint8_t> buffer, BOOTP& bootp)
             case Option_Router:           [[fallthrough]];
             case Option_DomainNameServer: [[fallthrough]];
             case Option_BroadcastAddress: [[fallthrough]];
-            case Option_RequestedIp:
+            case Option_RequestedIp:      [[fallthrough]];
+            case Option_ServerIdentifier:
             {
                 std::vector<std::uint32_t> ipList;
                 if (!deserializeIpList(buffer, ipList))
@@ -117,9 +120,21 @@ bool deserializeBootpOptions(std::span<const std::uint8_t> buffer, BOOTP& bootp)
 
             /* not applicable: */
             case Option_IPLeaseTime: break;
-            case Option_ServerIdentifier: break;
             case Option_RenewalTime: break;
             case Option_RebindingTime: break;
+            case Option_VendorClass: break; // Only looked at by ClientClassifier, in the raw datagram.
+            case Option_UserClass: break;
+            case Option_VendorSpecific: break;
+            case Option_TftpServerName: break;
+            case Option_BootFileName: break;
+            case Option_HostName: break;
+            case Option_DomainName: break;
+            case Option_ClientIdentifier: break;
+            case Option_RelayAgentInformation: break; // Only looked at in the raw datagram.
+            case Option_StatusCode: break;
+            case Option_BaseTime: break;
+            case Option_StartTimeOfState: break;
+            case Option_DhcpState: break;
         }
 
         buffer = buffer.subspan(buffer.front() + 1);
@@ -129,6 +144,55 @@ bool deserializeBootpOptions(std::span<const std::uint8_t> buffer, BOOTP& bootp)
 }
 }
 
+std::vector<std::uint8_t> serializeOptions(const BOOTP& bootp)
+{
+    std::vector<std::uint8_t> data;
+
+    for (const auto& [key, parameter] : bootp.options)
+    {
+        data.emplace_back(key);
+        auto parameterData = parameter->serialize();
+        data.insert(data.end(), parameterData.begin(), parameterData.end());
+    }
+
+    return data;
+}
+
+std::vector<std::uint8_t> mergeEncodedOptions(std::span<const std::uint8_t> base, std::span<const std::uint8_t> overrides)
+{
+    std::bitset<256> overridden;
+    for (auto options = overrides; options.size() >= 2 && options.size() >= 2u + options[1];)
+    {
+        overridden.set(options[0]);
+        options = options.subspan(2u + options[1]);
+    }
+
+    std::vector<std::uint8_t> data;
+    data.reserve(base.size() + overrides.size());
+
+    while (!base.empty())
+    {
+        const auto option = base.front();
+        if (option == Option_Pad || option == Option_End)
+        {
+            base = base.subspan(1);
+            continue;
+        }
+
+        if (base.size() < 2 || base.size() < 2u + base[1])
+            break; // Truncated option.
+
+        const auto length = 2u + base[1];
+        if (!overridden.test(option))
+            data.insert(data.end(), base.begin(), base.begin() + length);
+
+        base = base.subspan(length);
+    }
+
+    data.insert(data.end(), overrides.begin(), overrides.end());
+    return data;
+}
+
 std::vector<std::uint8_t> serializeBootp(const BOOTP& bootp)
 {
     std::vector<std::uint8_t> data;
@@ -151,9 +215,8 @@ std::vector<std::uint8_t> serializeBootp(const BOOTP& bootp)
     addIntegerToBufferAsBigEndian(bootp.chaddr << 16, data);
     addIntegerToBufferAsBigEndian<std::uint64_t>(0ull, data);
 
-    /* unused portion of BOOTP, 64 + 128 bytes. */
-    static const std::vector<std::uint8_t> padding(64 + 128, 0);
-    data.insert(data.end(), padding.begin(), padding.end());
+    data.insert(data.end(), bootp.sname.begin(), bootp.sname.end());
+    data.insert(data.end(), bootp.file.begin(), bootp.file.end());
 
     addIntegerToBufferAsBigEndian(bootp.magic, data);
 
@@ -186,6 +249,9 @@ std::vector<std::uint8_t> serializeBootp(const BOOTP& bootp)
         data.insert(data.end(), parameterData.begin(), parameterData.end());
     }
 
+    if (bootp.encodedOptions)
+        data.insert(data.end(), bootp.encodedOptions->begin(), bootp.encodedOptions->end());
+
     data.emplace_back(Option_End);
 
     /* Apparently 300 bytes is a minimum size that DHCP packet should be...? */
@@ -227,3 +293,126 @@ bool deserializeBootp(std::span<const std::uint8_t> data, BOOTP& bootp)
 
     return deserializeBootpOptions(data.subspan(240), bootp);
 }
+
+bool peekHardwareAddress(std::span<const std::uint8_t> data, std::uint64_t& hwAddress)
+{
+    if (data.size() < 36)
+        return false; // chaddr is read as a 64 bit integer from offset 28.
+
+    hwAddress = readBigEndianIntegerFromBuffer<std::uint64_t>(data, 28) >> 16;
+    return true;
+}
+
+std::span<const std::uint8_t> peekClientHardwareAddress(std::span<const std::uint8_t> data)
+{
+    if (data.size() < 44)
+        return {}; // chaddr is 16 octets from offset 28.
+
+    return data.subspan(28, std::min<std::size_t>(data[2], 16));
+}
+
+bool peekSecondsElapsed(std::span<const std::uint8_t> data, std::uint16_t& secondsElapsed)
+{
+    if (data.size() < 10)
+        return false; // secs is at offset 8.
+
+    secondsElapsed = readBigEndianIntegerFromBuffer<std::uint16_t>(data, 8);
+    return true;
+}
+
+bool peekClientIpAddress(std::span<const std::uint8_t> data, std::uint32_t& ipAddress)
+{
+    if (data.size() < 16)
+        return false; // ciaddr is at offset 12.
+
+    ipAddress = readBigEndianIntegerFromBuffer<std::uint32_t>(data, 12);
+    return true;
+}
+
+std::span<const std::uint8_t> peekOption(std::span<const std::uint8_t> data, BOOTPOptionKey key)
+{
+    if (data.size() < 241 || readBigEndianIntegerFromBuffer<std::uint32_t>(data, 236) != 0x63825363)
+        return {};
+
+    auto options = data.subspan(240);
+    while (!options.empty())
+    {
+        const auto option = options.front();
+        if (option == Option_End)
+            break;
+
+        if (option == Option_Pad)
+        {
+            options = options.subspan(1);
+            continue;
+        }
+
+        if (options.size() < 2 || options.size() < 2u + options[1])
+            break; // Truncated option.
+
+        if (option == key)
+            return options.subspan(2, options[1]);
+
+        options = options.subspan(2u + options[1]);
+    }
+
+    return {};
+}
+
+DHCPMessageType peekMessageType(std::span<const std::uint8_t> data)
+{
+    auto option = peekOption(data, Option_MessageType);
+    if (option.size() != 1)
+        return DHCP_UnknownMessage;
+
+    return static_cast<DHCPMessageType>(option.front());
+}
+
+RelayAgentIds peekRelayAgentIds(std::span<const std::uint8_t> data)
+{
+    /* FNV-1a, with 0 left for a missing suboption. */
+    auto digest = [](std::span<const std::uint8_t> value) -> std::uint64_t
+    {
+        std::uint64_t hash = 0xCBF29CE484222325ull;
+        for (auto byte : value)
+        {
+            hash ^= byte;
+            hash *= 0x100000001B3ull;
+        }
+        return hash != 0 ? hash : 1;
+    };
+
+    RelayAgentIds ids;
+    auto suboptions = peekOption(data, Option_RelayAgentInformation);
+    while (suboptions.size() >= 2 && suboptions.size() >= 2u + suboptions[1])
+    {
+        const auto value = suboptions.subspan(2, suboptions[1]);
+        if (suboptions[0] == 2) // Remote-id, RFC 3046.
+            ids.remoteId = digest(value);
+        else if (suboptions[0] == 12) // Relay-id, RFC 6925.
+            ids.relayId = digest(value);
+
+        suboptions = suboptions.subspan(2u + suboptions[1]);
+    }
+
+    return ids;
+}
+
+bool copyRequestHeader(std::span<const std::uint8_t> request, std::span<std::uint8_t> reply)
+{
+    if (request.size() < 240 || reply.size() < 240)
+        return false;
+
+    auto copyField = [&](std::size_t offset, std::size_t length)
+    {
+        std::copy_n(request.begin() + offset, length, reply.begin() + offset);
+    };
+
+    copyField(1, 2);   // htype, hlen
+    copyField(4, 4);   // xid
+    copyField(10, 2);  // flags
+    copyField(12, 4);  // ciaddr
+    copyField(24, 4);  // giaddr
+    copyField(28, 16); // chaddr
+    return true;
+}
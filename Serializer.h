@@ -15,5 +15,45 @@
 /// Serializes the given BOOTP structure into a buffer of bytes.
 std::vector<std::uint8_t> serializeBootp(const BOOTP&);
 
+/// Serializes only the options of the given BOOTP structure, without end marker. Used to encode options up front,
+/// to be placed in BOOTP::encodedOptions.
+std::vector<std::uint8_t> serializeOptions(const BOOTP&);
+
+/// Merges two blocks of encoded options (code, length, payload). Options in overrides replace the ones with the same
+/// code in base, the rest of base is kept as it is. Pad and end markers are dropped.
+std::vector<std::uint8_t> mergeEncodedOptions(std::span<const std::uint8_t> base, std::span<const std::uint8_t> overrides);
+
 /// Tries to de-serialize a buffer of bytes into a BOOTP structure. Returns false upon error.
 bool deserializeBootp(std::span<const std::uint8_t>, BOOTP&);
+
+/// Reads the client hardware address from the fixed header of a raw BOOTP message without de-serializing it.
+/// Returns false if the buffer is too short to hold one.
+bool peekHardwareAddress(std::span<const std::uint8_t>, std::uint64_t&);
+
+/// Returns the hlen first octets of chaddr from the fixed header of a raw BOOTP message, without de-serializing it.
+/// hlen is capped to the size of chaddr. Returns an empty span if the buffer is too short to hold chaddr.
+std::span<const std::uint8_t> peekClientHardwareAddress(std::span<const std::uint8_t>);
+
+/// Reads the seconds elapsed since the client started (secs) from the fixed header of a raw BOOTP message.
+/// Returns false if the buffer is too short to hold it.
+bool peekSecondsElapsed(std::span<const std::uint8_t>, std::uint16_t&);
+
+/// Reads the client IP address (ciaddr) from the fixed header of a raw BOOTP message without de-serializing it.
+/// Returns false if the buffer is too short to hold one.
+bool peekClientIpAddress(std::span<const std::uint8_t>, std::uint32_t&);
+
+/// Scans the options of a raw BOOTP message for the given option, without de-serializing anything.
+/// Returns the option's payload (without code and length), or an empty span if it's missing or the message is malformed.
+std::span<const std::uint8_t> peekOption(std::span<const std::uint8_t>, BOOTPOptionKey);
+
+/// Scans the options of a raw BOOTP message for the DHCP message type, without de-serializing anything else.
+/// Returns DHCP_UnknownMessage if the message is malformed or has no message type.
+DHCPMessageType peekMessageType(std::span<const std::uint8_t>);
+
+/// Digests the relay-id and remote-id suboptions of the relay agent information option of a raw BOOTP message.
+/// The same value gives the same digest, so they can be compared without keeping the values around.
+RelayAgentIds peekRelayAgentIds(std::span<const std::uint8_t>);
+
+/// Copies the fields identifying the client and transaction (htype, hlen, xid, flags, ciaddr, giaddr and chaddr) from
+/// a raw request into an already serialized reply. Returns false if either is too short to hold a BOOTP header.
+bool copyRequestHeader(std::span<const std::uint8_t> request, std::span<std::uint8_t> reply);
@@ -0,0 +1,75 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "Statistics.h"
+#include "Logger.h"
+
+#include <cstdio>
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+namespace
+{
+std::mutex CountersMutex;
+
+/* Keyed by interface, name and the extra label already formatted (empty if there is none). */
+std::map<std::tuple<std::string, std::string, std::string>, std::unique_ptr<Statistics::Counter>, std::less<>> Counters;
+
+Statistics::Counter& getCounter(std::string_view interface, std::string_view name, std::string label)
+{
+    std::lock_guard lockGuard(CountersMutex);
+
+    auto& counter = Counters[{ std::string(interface), std::string(name), std::move(label) }];
+    if (!counter)
+        counter = std::make_unique<Statistics::Counter>();
+
+    return *counter;
+}
+}
+
+Statistics::Counter& Statistics::GetCounter(std::string_view interface, std::string_view name)
+{
+    return getCounter(interface, name, {});
+}
+
+Statistics::Counter& Statistics::GetCounter(std::string_view interface, std::string_view name,
+                                            std::string_view labelName, std::string_view labelValue)
+{
+    std::string label;
+    label.append(",").append(labelName).append("=\"").append(labelValue).append("\"");
+    return getCounter(interface, name, std::move(label));
+}
+
+void Statistics::SaveToFile(const std::string& filename)
+{
+    const auto temporaryFilename = filename + ".tmp";
+
+    std::ofstream ofs(temporaryFilename);
+    if (!ofs.is_open())
+    {
+        Log::Warning("Couldn't write to statistics file {}", temporaryFilename);
+        return;
+    }
+
+    {
+        std::lock_guard lockGuard(CountersMutex);
+        for (const auto& [key, counter] : Counters)
+        {
+            const auto& [interface, name, label] = key;
+            ofs << "tdhcpd_" << name << "{interface=\"" << interface << "\"" << label << "} " << counter->get() << "\n";
+        }
+    }
+
+    ofs.close();
+
+    if (std::rename(temporaryFilename.c_str(), filename.c_str()) != 0)
+        Log::Warning("Couldn't replace statistics file {}", filename);
+}
@@ -0,0 +1,46 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Statistics
+{
+/*
+ * A single named value, either counting events or holding the current level of something (a gauge).
+ * Updates are relaxed atomics so that the packet handling threads never wait for whoever reads them.
+*/
+class Counter
+{
+    std::atomic<std::uint64_t> m_value{};
+
+public:
+    void increment(std::uint64_t amount = 1) { m_value.fetch_add(amount, std::memory_order_relaxed); }
+
+    void decrement(std::uint64_t amount = 1) { m_value.fetch_sub(amount, std::memory_order_relaxed); }
+
+    void set(std::uint64_t value) { m_value.store(value, std::memory_order_relaxed); }
+
+    [[nodiscard]]
+    std::uint64_t get() const { return m_value.load(std::memory_order_relaxed); }
+};
+
+// Returns the counter with the given name for the interface, creating it if needed.
+// The reference stays valid for the lifetime of the program, so look it up once and keep it.
+Counter& GetCounter(std::string_view interface, std::string_view name);
+
+// As above, for one of several counters of the same name, told apart by an extra label (ie. pool="guest").
+Counter& GetCounter(std::string_view interface, std::string_view name, std::string_view labelName, std::string_view labelValue);
+
+// Writes all counters to the file as lines of: tdhcpd_<name>{interface="<interface>"[,<label>="<value>"]} <value>
+// The file is replaced atomically, so readers never see a half written file.
+void SaveToFile(const std::string& filename);
+}
@@ -21,7 +21,10 @@ BOOTP::BOOTP(const BOOTP& other)
     siaddr                = other.siaddr;
     giaddr                = other.giaddr;
     chaddr                = other.chaddr;
+    sname                 = other.sname;
+    file                  = other.file;
     magic                 = other.magic;
+    encodedOptions        = other.encodedOptions;
 }
 
 BOOTP::BOOTP(BOOTP&& other) noexcept
@@ -38,7 +41,10 @@ BOOTP::BOOTP(BOOTP&& other) noexcept
     siaddr                = other.siaddr;
     giaddr                = other.giaddr;
     chaddr                = other.chaddr;
+    sname                 = other.sname;
+    file                  = other.file;
     magic                 = other.magic;
+    encodedOptions        = other.encodedOptions;
     options               = std::move(other.options);
 }
 
@@ -56,7 +62,10 @@ BOOTP& BOOTP::operator=(const BOOTP& other)
     siaddr                = other.siaddr;
     giaddr                = other.giaddr;
     chaddr                = other.chaddr;
+    sname                 = other.sname;
+    file                  = other.file;
     magic                 = other.magic;
+    encodedOptions        = other.encodedOptions;
     return *this;
 }
 
@@ -74,7 +83,10 @@ BOOTP& BOOTP::operator=(BOOTP&& other) noexcept
     siaddr                = other.siaddr;
     giaddr                = other.giaddr;
     chaddr                = other.chaddr;
+    sname                 = other.sname;
+    file                  = other.file;
     magic                 = other.magic;
+    encodedOptions        = other.encodedOptions;
     options               = std::move(other.options);
     return *this;
 }
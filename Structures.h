@@ -10,10 +10,12 @@
 #include <ctime>
 #include <cstdint>
 
+#include <array>
 #include <unordered_map>
 #include <memory>
 #include <vector>
 #include <span>
+#include <string_view>
 
 enum BOOTPOperation : std::uint8_t
 {
@@ -28,7 +30,10 @@ enum BOOTPOptionKey : std::uint8_t
     Option_SubnetMask           = 1,
     Option_Router               = 3,
     Option_DomainNameServer     = 6,
+    Option_HostName             = 12,
+    Option_DomainName           = 15,
     Option_BroadcastAddress     = 28,
+    Option_VendorSpecific       = 43,
     Option_RequestedIp          = 50,
     Option_IPLeaseTime          = 51,
     Option_MessageType          = 53,
@@ -36,6 +41,18 @@ enum BOOTPOptionKey : std::uint8_t
     Option_ParameterRequestList = 55,
     Option_RenewalTime          = 58,
     Option_RebindingTime        = 59,
+    Option_VendorClass          = 60,
+    Option_ClientIdentifier     = 61,
+    Option_TftpServerName       = 66,
+    Option_BootFileName         = 67,
+    Option_UserClass            = 77,
+    Option_RelayAgentInformation = 82,
+
+    /* Leasequery, RFC 6926 */
+    Option_StatusCode           = 151,
+    Option_BaseTime             = 152,
+    Option_StartTimeOfState     = 153,
+    Option_DhcpState            = 156,
 
     Option_End                  = 255
 };
@@ -50,7 +67,21 @@ enum DHCPMessageType : std::uint8_t
     DHCP_Decline    = 4,
     DHCP_ACK        = 5,
     DHCP_NAK        = 6,
-    DHCP_Release    = 7
+    DHCP_Release    = 7,
+    DHCP_Inform     = 8,
+
+    /* Bulk leasequery, RFC 6926 */
+    DHCP_LeaseActive        = 13,
+    DHCP_BulkLeaseQuery     = 14,
+    DHCP_LeaseQueryDone     = 15,
+    DHCP_LeaseQueryStatus   = 17
+};
+
+/* Digests of the relay-id (RFC 6925) and remote-id (RFC 3046) the relay agent added to a request, 0 when missing. */
+struct RelayAgentIds
+{
+    std::uint64_t relayId{};
+    std::uint64_t remoteId{};
 };
 
 struct Lease
@@ -58,6 +89,8 @@ struct Lease
     std::time_t startTime{};
     std::uint64_t hwAddress{};
     std::uint32_t ipAddress{};
+    std::uint32_t leaseTime{}; /* Seconds granted to the client. Not persisted, 0 when loaded from the lease file until the network takes it. */
+    RelayAgentIds relayAgent{}; /* Not persisted. */
 };
 
 constexpr auto StartTimeLen = sizeof(Lease::startTime);
@@ -193,6 +226,33 @@ public:
     std::span<const std::uint32_t> getIps() const { return m_ips; }
 };
 
+/* Option payload given as it is, ie. strings and vendor specific information. At most 255 bytes. */
+class RawBOOTPOption : public BOOTPOption
+{
+    std::vector<std::uint8_t> m_data;
+
+public:
+    explicit RawBOOTPOption(std::vector<std::uint8_t>&& data)
+        : m_data(std::move(data))
+    {}
+
+    explicit RawBOOTPOption(std::string_view data)
+        : m_data(data.begin(), data.end())
+    {}
+
+    std::vector<std::uint8_t> serialize() override
+    {
+        std::vector<std::uint8_t> data;
+        data.reserve(m_data.size() + 1);
+        data.emplace_back(static_cast<std::uint8_t>(m_data.size()));
+        data.insert(data.end(), m_data.begin(), m_data.end());
+        return data;
+    }
+
+    [[nodiscard]]
+    std::span<const std::uint8_t> getData() const { return m_data; }
+};
+
 template<typename T>
 class IntegerBOOTPOption : public BOOTPOption
 {
@@ -267,7 +327,14 @@ struct BOOTP
     std::uint32_t siaddr{};
     std::uint32_t giaddr{};
     std::uint64_t chaddr{}; // Hardware address (MAC) stored here
-    /* 64 + 128 bytes of unused data, padded with 0 when sending this structure. */
+    std::array<std::uint8_t, 64> sname{}; /* Boot server host name, zero terminated. Not read from requests. */
+    std::array<std::uint8_t, 128> file{}; /* Boot file name, zero terminated. Not read from requests. */
     std::uint32_t magic{ 0x63825363 };
     std::unordered_map<BOOTPOptionKey, std::unique_ptr<BOOTPOption>> options;
+
+    /*
+     * Options that were encoded up front (ie. everything only depending on the configuration), shared between
+     * messages. Written as they are, after the ones in "options", which must not hold any of the same.
+    */
+    std::shared_ptr<const std::vector<std::uint8_t>> encodedOptions;
 };
@@ -0,0 +1,107 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "AddressPool.h"
+#include "IpConverter.h"
+
+#include <gtest/gtest.h>
+
+TEST(AddressPoolStructureTests, Range)
+{
+    AddressPool pool(concatenateIpAddress(10, 0, 0, 10), concatenateIpAddress(10, 0, 0, 19));
+
+    EXPECT_EQ(10, pool.getSize());
+    EXPECT_TRUE(pool.contains(concatenateIpAddress(10, 0, 0, 10)));
+    EXPECT_TRUE(pool.contains(concatenateIpAddress(10, 0, 0, 19)));
+    EXPECT_FALSE(pool.contains(concatenateIpAddress(10, 0, 0, 9)));
+    EXPECT_FALSE(pool.contains(concatenateIpAddress(10, 0, 0, 20)));
+}
+
+TEST(AddressPoolStructureTests, MarkUsedAndFree)
+{
+    AddressPool pool(concatenateIpAddress(10, 0, 0, 0), concatenateIpAddress(10, 0, 0, 199));
+    const auto ip = concatenateIpAddress(10, 0, 0, 150);
+
+    EXPECT_FALSE(pool.isUsed(ip));
+    EXPECT_EQ(0, pool.getUsedCount());
+
+    pool.markUsed(ip);
+    pool.markUsed(ip); // Already used, must not be counted twice.
+    EXPECT_TRUE(pool.isUsed(ip));
+    EXPECT_EQ(1, pool.getUsedCount());
+
+    // Outside the range is ignored.
+    pool.markUsed(concatenateIpAddress(10, 0, 1, 0));
+    EXPECT_EQ(1, pool.getUsedCount());
+
+    pool.markFree(ip);
+    pool.markFree(ip);
+    EXPECT_FALSE(pool.isUsed(ip));
+    EXPECT_EQ(0, pool.getUsedCount());
+}
+
+TEST(AddressPoolStructureTests, Utilization)
+{
+    AddressPool pool(concatenateIpAddress(10, 0, 0, 1), concatenateIpAddress(10, 0, 0, 4));
+
+    EXPECT_EQ(0, pool.getUtilization());
+
+    pool.markUsed(concatenateIpAddress(10, 0, 0, 1));
+    EXPECT_EQ(25, pool.getUtilization());
+
+    pool.markUsed(concatenateIpAddress(10, 0, 0, 2));
+    pool.markUsed(concatenateIpAddress(10, 0, 0, 3));
+    pool.markUsed(concatenateIpAddress(10, 0, 0, 4));
+    EXPECT_EQ(100, pool.getUtilization());
+
+    // Changing the range starts over.
+    pool.setRange(concatenateIpAddress(10, 0, 0, 1), concatenateIpAddress(10, 0, 0, 8));
+    EXPECT_EQ(0, pool.getUtilization());
+}
+
+TEST(AddressPoolStructureTests, FindFree)
+{
+    const auto first = concatenateIpAddress(10, 0, 0, 0);
+    AddressPool pool(first, first + 199);
+
+    EXPECT_EQ(first, pool.findFree(first));
+    EXPECT_EQ(first + 150, pool.findFree(first + 150));
+
+    // Outside the range starts at the beginning.
+    EXPECT_EQ(first, pool.findFree(concatenateIpAddress(10, 0, 1, 0)));
+
+    // Skips used addresses, across word boundaries.
+    for (auto i = 60u; i < 140; ++i)
+        pool.markUsed(first + i);
+    EXPECT_EQ(first + 140, pool.findFree(first + 60));
+
+    // Wraps around to the beginning.
+    for (auto i = 140u; i < 200; ++i)
+        pool.markUsed(first + i);
+    EXPECT_EQ(first, pool.findFree(first + 100));
+
+    for (auto i = 1u; i < 60; ++i)
+        pool.markUsed(first + i);
+    EXPECT_EQ(first, pool.findFree(first + 1));
+    EXPECT_EQ(first, pool.findFree(first + 199));
+
+    // Full.
+    pool.markUsed(first);
+    EXPECT_EQ(0, pool.findFree(first));
+}
+
+TEST(AddressPoolStructureTests, FindFree_WrapsToStartOfSameWord)
+{
+    const auto first = concatenateIpAddress(10, 0, 0, 0);
+    AddressPool pool(first, first + 9);
+
+    for (auto i = 5u; i < 10; ++i)
+        pool.markUsed(first + i);
+    pool.markUsed(first);
+
+    EXPECT_EQ(first + 1, pool.findFree(first + 5));
+}
@@ -0,0 +1,252 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "BulkLeasequery.h"
+#include "IpConverter.h"
+#include "Network.h"
+#include "Serializer.h"
+
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <ctime>
+
+namespace
+{
+constexpr auto Loopback = concatenateIpAddress(127, 0, 0, 1);
+constexpr auto ServerIdentifier = concatenateIpAddress(192, 168, 200, 1);
+
+// Relay agent information with a remote-id suboption.
+std::vector<std::uint8_t> makeRelayAgentInformation(std::string_view remoteId)
+{
+    std::vector<std::uint8_t> data{ 2, static_cast<std::uint8_t>(remoteId.size()) };
+    data.insert(data.end(), remoteId.begin(), remoteId.end());
+    return data;
+}
+
+std::vector<std::uint8_t> makeQuery(std::uint32_t transactionId, DHCPMessageType messageType = DHCP_BulkLeaseQuery)
+{
+    BOOTP query;
+    query.operation = BOOTP_Request;
+    query.hardwareAddressLength = 0;
+    query.transactionId = transactionId;
+    query.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(messageType);
+    query.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(ServerIdentifier);
+    return serializeBootp(query);
+}
+
+Lease makeLease(std::uint64_t hwAddress, std::uint32_t ipAddress, std::time_t age, std::string_view remoteId = {})
+{
+    Lease lease;
+    lease.startTime = std::time(nullptr) - age;
+    lease.hwAddress = hwAddress;
+    lease.ipAddress = ipAddress;
+    lease.leaseTime = 3600;
+
+    if (!remoteId.empty())
+    {
+        BOOTP request;
+        request.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_Request);
+        request.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(ServerIdentifier);
+        request.options[Option_RelayAgentInformation] = std::make_unique<RawBOOTPOption>(makeRelayAgentInformation(remoteId));
+        lease.relayAgent = peekRelayAgentIds(serializeBootp(request));
+    }
+
+    return lease;
+}
+
+// Sends a query and collects the replies up to and including the one that ends it.
+std::vector<std::vector<std::uint8_t>> runQuery(std::uint16_t port, std::span<const std::uint8_t> query)
+{
+    const int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(Loopback);
+    addr.sin_port = htons(port);
+    timeval timeout{ 5, 0 };
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::vector<std::vector<std::uint8_t>> replies;
+    if (connect(sockfd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        close(sockfd);
+        return replies;
+    }
+
+    std::vector<std::uint8_t> message{ static_cast<std::uint8_t>(query.size() >> 8), static_cast<std::uint8_t>(query.size()) };
+    message.insert(message.end(), query.begin(), query.end());
+    send(sockfd, message.data(), message.size(), MSG_NOSIGNAL);
+
+    std::vector<std::uint8_t> input;
+    std::uint8_t buffer[4096];
+    while (true)
+    {
+        while (input.size() >= 2 && input.size() >= 2u + ((input[0] << 8) | input[1]))
+        {
+            const std::size_t size = (input[0] << 8) | input[1];
+            replies.emplace_back(input.begin() + 2, input.begin() + 2 + static_cast<std::ptrdiff_t>(size));
+            input.erase(input.begin(), input.begin() + 2 + static_cast<std::ptrdiff_t>(size));
+
+            const auto messageType = peekMessageType(replies.back());
+            if (messageType == DHCP_LeaseQueryDone || messageType == DHCP_LeaseQueryStatus)
+            {
+                close(sockfd);
+                return replies;
+            }
+        }
+
+        const auto received = recv(sockfd, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+            break;
+        input.insert(input.end(), buffer, buffer + received);
+    }
+
+    close(sockfd);
+    return replies;
+}
+}
+
+TEST(BulkLeasequeryTests, ParseQuery)
+{
+    BulkLeasequery::Query query;
+    EXPECT_EQ(BulkLeasequery::Status::Success, BulkLeasequery::ParseQuery(makeQuery(42), query));
+    EXPECT_EQ(42, query.transactionId);
+    EXPECT_TRUE(query.matches(makeLease(0x112233445566, concatenateIpAddress(10, 0, 0, 1), 0)));
+
+    EXPECT_EQ(BulkLeasequery::Status::MalformedQuery, BulkLeasequery::ParseQuery(makeQuery(42, DHCP_Discover), query));
+    EXPECT_EQ(42, query.transactionId);
+
+    // Address range, given as ciaddr and subnet mask.
+    BOOTP range;
+    range.operation = BOOTP_Request;
+    range.hardwareAddressLength = 0;
+    range.ciaddr = concatenateIpAddress(10, 0, 1, 0);
+    range.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_BulkLeaseQuery);
+    range.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(ServerIdentifier);
+    range.options[Option_SubnetMask] = std::make_unique<IpListBOOTPOption>(std::vector<std::uint32_t>{ concatenateIpAddress(255, 255, 255, 0) });
+    ASSERT_EQ(BulkLeasequery::Status::Success, BulkLeasequery::ParseQuery(serializeBootp(range), query));
+    EXPECT_TRUE(query.matches(makeLease(1, concatenateIpAddress(10, 0, 1, 200), 0)));
+    EXPECT_FALSE(query.matches(makeLease(1, concatenateIpAddress(10, 0, 2, 1), 0)));
+
+    // Hardware address and remote-id.
+    BOOTP client;
+    client.operation = BOOTP_Request;
+    client.chaddr = 0x112233445566;
+    client.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_BulkLeaseQuery);
+    client.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(ServerIdentifier);
+    client.options[Option_RelayAgentInformation] = std::make_unique<RawBOOTPOption>(makeRelayAgentInformation("port-1"));
+    ASSERT_EQ(BulkLeasequery::Status::Success, BulkLeasequery::ParseQuery(serializeBootp(client), query));
+    EXPECT_TRUE(query.matches(makeLease(0x112233445566, 1, 0, "port-1")));
+    EXPECT_FALSE(query.matches(makeLease(0x112233445566, 1, 0, "port-2")));
+    EXPECT_FALSE(query.matches(makeLease(0x112233445567, 1, 0, "port-1")));
+
+    // Leases don't know the client identifier.
+    client.options[Option_ClientIdentifier] = std::make_unique<RawBOOTPOption>("client");
+    EXPECT_EQ(BulkLeasequery::Status::NotAllowed, BulkLeasequery::ParseQuery(serializeBootp(client), query));
+}
+
+TEST(BulkLeasequeryTests, StreamsActiveLeases)
+{
+    LeaseTable table;
+    constexpr std::uint32_t LeaseCount = 1000; // Several pages.
+    for (std::uint32_t i = 0; i < LeaseCount; ++i)
+        table.set(makeLease(0x020000000000ull + i, concatenateIpAddress(10, 0, 0, 0) + i, 60, i % 2 ? "odd" : "even"));
+
+    Lease expired = makeLease(0x030000000000ull, concatenateIpAddress(10, 1, 0, 0), 7200);
+    expired.leaseTime = 0; // Has the interface's maximum lease time.
+    table.set(expired);
+
+    BulkLeasequeryServer server(Loopback, 0, { { Loopback, ~std::uint32_t{} } });
+    server.addInterface(table, ServerIdentifier, 3600);
+    ASSERT_TRUE(server.start());
+
+    auto replies = runQuery(server.getPort(), makeQuery(7));
+    ASSERT_EQ(LeaseCount + 1, replies.size());
+    EXPECT_EQ(DHCP_LeaseQueryDone, peekMessageType(replies.back()));
+
+    std::uint64_t hwAddress{};
+    std::uint32_t ipAddress{};
+    ASSERT_TRUE(peekHardwareAddress(replies.front(), hwAddress));
+    ASSERT_TRUE(peekClientIpAddress(replies.front(), ipAddress));
+    EXPECT_EQ(DHCP_LeaseActive, peekMessageType(replies.front()));
+    EXPECT_EQ(table.snapshot().front().ipAddress, ipAddress);
+    EXPECT_EQ(table.snapshot().front().hwAddress, hwAddress);
+
+    const auto leaseTime = peekOption(replies.front(), Option_IPLeaseTime);
+    ASSERT_EQ(4, leaseTime.size());
+    const auto remaining = (leaseTime[0] << 24) | (leaseTime[1] << 16) | (leaseTime[2] << 8) | leaseTime[3];
+    EXPECT_GE(remaining, 3600 - 61);
+    EXPECT_LE(remaining, 3600 - 60);
+
+    // By remote-id.
+    BOOTP query;
+    query.operation = BOOTP_Request;
+    query.hardwareAddressLength = 0;
+    query.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_BulkLeaseQuery);
+    query.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(ServerIdentifier);
+    query.options[Option_RelayAgentInformation] = std::make_unique<RawBOOTPOption>(makeRelayAgentInformation("odd"));
+    replies = runQuery(server.getPort(), serializeBootp(query));
+    EXPECT_EQ(LeaseCount / 2 + 1, replies.size());
+
+    replies = runQuery(server.getPort(), makeQuery(8, DHCP_Request));
+    ASSERT_EQ(1, replies.size());
+    EXPECT_EQ(DHCP_LeaseQueryStatus, peekMessageType(replies.front()));
+    const auto status = peekOption(replies.front(), Option_StatusCode);
+    ASSERT_FALSE(status.empty());
+    EXPECT_EQ(static_cast<std::uint8_t>(BulkLeasequery::Status::MalformedQuery), status.front());
+
+    server.stop();
+}
+
+TEST(BulkLeasequeryTests, RefusesOthers)
+{
+    LeaseTable table;
+    table.set(makeLease(0x020000000000ull, concatenateIpAddress(10, 0, 0, 1), 0));
+
+    BulkLeasequeryServer server(Loopback, 0, { { concatenateIpAddress(10, 0, 0, 0), 0xFF000000 } });
+    server.addInterface(table, ServerIdentifier, 3600);
+    ASSERT_TRUE(server.start());
+
+    EXPECT_TRUE(runQuery(server.getPort(), makeQuery(1)).empty());
+}
+
+TEST(BulkLeasequeryTests, LoadedLeaseHeldForMaximumLeaseTime)
+{
+    NetworkConfiguration config;
+    config.leaseTime = 3600;
+    config.hostOptions[0x020000000001].leaseTime = 86400;
+
+    // From the lease file, which doesn't say how long it was granted for. Past lease_time, but not the host's.
+    Lease loaded = makeLease(0x020000000002, NetworkDefaults::first, 7200);
+    loaded.leaseTime = 0;
+
+    Network network;
+    network.configure(NetworkConfiguration(config), { loaded });
+    ASSERT_FALSE(network.isLeaseExpired(network.getLease(loaded.ipAddress)));
+    ASSERT_EQ(1, network.getLeaseTable().snapshot().size());
+    EXPECT_EQ(86400, network.getLeaseTable().snapshot().front().leaseTime);
+
+    BulkLeasequeryServer server(Loopback, 0, { { Loopback, ~std::uint32_t{} } });
+    server.addInterface(network.getLeaseTable(), ServerIdentifier, Network::getMaximumLeaseTime(config));
+    ASSERT_TRUE(server.start());
+
+    const auto replies = runQuery(server.getPort(), makeQuery(9));
+    ASSERT_EQ(2, replies.size());
+    EXPECT_EQ(DHCP_LeaseActive, peekMessageType(replies.front()));
+
+    const auto leaseTime = peekOption(replies.front(), Option_IPLeaseTime);
+    ASSERT_EQ(4, leaseTime.size());
+    const auto remaining = (leaseTime[0] << 24) | (leaseTime[1] << 16) | (leaseTime[2] << 8) | leaseTime[3];
+    EXPECT_GE(remaining, 86400 - 7201);
+    EXPECT_LE(remaining, 86400 - 7200);
+
+    server.stop();
+}
@@ -0,0 +1,101 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "ClientClassifier.h"
+#include "Serializer.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+std::vector<ClientClassConfiguration> makeClasses()
+{
+    std::vector<ClientClassConfiguration> classes(3);
+
+    classes[0].name = "phones";
+    classes[0].ouis = { 0x0004F2, 0x001B54 };
+
+    classes[1].name = "pxe";
+    classes[1].vendorClasses = { "PXEClient*", "iPXE" };
+
+    classes[2].name = "kiosk";
+    classes[2].userClasses = { "kiosk" };
+    classes[2].ouis = { 0x001B54 };
+
+    return classes;
+}
+
+std::vector<std::uint8_t> makeRequest(std::uint64_t hwAddress, std::vector<std::uint8_t> options)
+{
+    std::vector<std::uint8_t> data;
+    data.reserve(240 + options.size() + 1);
+    data.resize(240);
+    for (int i = 0; i < 6; ++i)
+        data[28 + i] = static_cast<std::uint8_t>(hwAddress >> (40 - i * 8));
+
+    data[236] = 0x63;
+    data[237] = 0x82;
+    data[238] = 0x53;
+    data[239] = 0x63;
+
+    data.insert(data.end(), options.begin(), options.end());
+    data.emplace_back(Option_End);
+    return data;
+}
+}
+
+TEST(ClientClassifierTests, Empty)
+{
+    ClientClassifier classifier;
+    EXPECT_TRUE(classifier.isEmpty());
+    EXPECT_EQ(0, classifier.classify(makeRequest(0x0004F2112233, {})));
+}
+
+TEST(ClientClassifierTests, Oui)
+{
+    ClientClassifier classifier(makeClasses());
+    EXPECT_FALSE(classifier.isEmpty());
+
+    EXPECT_EQ(0b001, classifier.classify(makeRequest(0x0004F2112233, {})));
+    EXPECT_EQ(0b101, classifier.classify(makeRequest(0x001B54AABBCC, {})));
+    EXPECT_EQ(0, classifier.classify(makeRequest(0x0004F3112233, {})));
+}
+
+TEST(ClientClassifierTests, VendorClass)
+{
+    ClientClassifier classifier(makeClasses());
+
+    std::vector<std::uint8_t> pxe = { Option_VendorClass, 14 };
+    for (char c : std::string_view("PXEClient:Arch")) pxe.emplace_back(c);
+    EXPECT_EQ(0b010, classifier.classify(makeRequest(1, pxe)));
+
+    std::vector<std::uint8_t> ipxe = { Option_VendorClass, 4, 'i', 'P', 'X', 'E' };
+    EXPECT_EQ(0b010, classifier.classify(makeRequest(1, ipxe)));
+
+    // Exact matches aren't prefixes.
+    std::vector<std::uint8_t> ipxeLonger = { Option_VendorClass, 5, 'i', 'P', 'X', 'E', '2' };
+    EXPECT_EQ(0, classifier.classify(makeRequest(1, ipxeLonger)));
+
+    std::vector<std::uint8_t> tooShort = { Option_VendorClass, 3, 'P', 'X', 'E' };
+    EXPECT_EQ(0, classifier.classify(makeRequest(1, tooShort)));
+}
+
+TEST(ClientClassifierTests, UserClass)
+{
+    ClientClassifier classifier(makeClasses());
+
+    // Plain string.
+    std::vector<std::uint8_t> plain = { Option_UserClass, 5, 'k', 'i', 'o', 's', 'k' };
+    EXPECT_EQ(0b100, classifier.classify(makeRequest(1, plain)));
+
+    // RFC 3004 list.
+    std::vector<std::uint8_t> list = { Option_UserClass, 9, 2, 'a', 'b', 5, 'k', 'i', 'o', 's', 'k' };
+    EXPECT_EQ(0b100, classifier.classify(makeRequest(1, list)));
+
+    std::vector<std::uint8_t> other = { Option_UserClass, 3, 2, 'a', 'b' };
+    EXPECT_EQ(0, classifier.classify(makeRequest(1, other)));
+}
@@ -0,0 +1,60 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "ClientHistory.h"
+#include "IpConverter.h"
+
+#include <gtest/gtest.h>
+
+TEST(ClientHistoryTests, RememberAndRecall)
+{
+    ClientHistory history(16);
+
+    history.remember(1000, concatenateIpAddress(192, 168, 200, 100));
+    history.remember(1001, concatenateIpAddress(192, 168, 200, 101));
+
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 100), history.recall(1000));
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 101), history.recall(1001));
+    EXPECT_EQ(0, history.recall(1002));
+
+    // Remembering again replaces, not duplicates.
+    history.remember(1000, concatenateIpAddress(192, 168, 200, 102));
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 102), history.recall(1000));
+
+    history.forget(1000);
+    EXPECT_EQ(0, history.recall(1000));
+}
+
+TEST(ClientHistoryTests, Disabled)
+{
+    ClientHistory history;
+
+    history.remember(1000, concatenateIpAddress(192, 168, 200, 100));
+    EXPECT_EQ(0, history.recall(1000));
+}
+
+TEST(ClientHistoryTests, BoundedWithLeastRecentEvicted)
+{
+    ClientHistory history(64);
+
+    for (std::uint64_t hwAddress = 1; hwAddress <= 10000; ++hwAddress)
+        history.remember(hwAddress, static_cast<std::uint32_t>(hwAddress));
+
+    EXPECT_EQ(64, history.getCapacity());
+
+    // Never more remembered than the capacity, and the most recent one always is.
+    int remembered = 0;
+    for (std::uint64_t hwAddress = 1; hwAddress <= 10000; ++hwAddress)
+    {
+        if (history.recall(hwAddress) != 0)
+            ++remembered;
+    }
+
+    EXPECT_LE(remembered, 64);
+    EXPECT_EQ(10000, history.recall(10000));
+    EXPECT_EQ(0, history.recall(1));
+}
@@ -0,0 +1,439 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "Configuration.h"
+#include "ConfigurationImage.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+std::string writeConfig(std::string_view text)
+{
+    const std::string filename = testing::TempDir() + "tdhcpd-test.conf";
+    std::ofstream ofs(filename, std::ios::trunc);
+    ofs << text;
+    return filename;
+}
+}
+
+TEST(ConfigurationTests, ReloadPublishesNewSnapshot)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n"
+                                      "lease_time 3600\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+
+    const auto generation = Configuration::GetGeneration();
+    const auto snapshot = Configuration::GetSnapshot();
+    ASSERT_EQ(1, snapshot->networks.count("eth0"));
+    EXPECT_EQ(3600, snapshot->networks.at("eth0").leaseTime);
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "lease_time 7200\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+
+    EXPECT_GT(Configuration::GetGeneration(), generation);
+    EXPECT_EQ(7200, Configuration::GetSnapshot()->networks.at("eth0").leaseTime);
+
+    // Whoever held on to the old snapshot still sees it as it was.
+    EXPECT_EQ(3600, snapshot->networks.at("eth0").leaseTime);
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, FailedReloadKeepsCurrentSnapshot)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+
+    const auto generation = Configuration::GetGeneration();
+    const auto snapshot = Configuration::GetSnapshot();
+
+    // The reservation is outside the network.
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "reserve 11:22:33:44:55:66 10.0.0.1\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    EXPECT_EQ(generation, Configuration::GetGeneration());
+    EXPECT_EQ(snapshot, Configuration::GetSnapshot());
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, BadNumberKeepsCurrentSnapshot)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n"
+                                      "lease_time 3600\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+
+    const auto generation = Configuration::GetGeneration();
+    const auto snapshot = Configuration::GetSnapshot();
+
+    for (const auto* line : { "lease_time 1h\n", "lease_time one\n", "renewal_time 1800s\n", "rebinding_time -1\n" })
+    {
+        writeConfig(std::string("interface eth0\n"
+                                "network 192.168.200.0/24\n") + line);
+        EXPECT_FALSE(Configuration::LoadFromFile(filename)) << line;
+    }
+
+    EXPECT_EQ(generation, Configuration::GetGeneration());
+    EXPECT_EQ(snapshot, Configuration::GetSnapshot());
+    EXPECT_EQ(3600, Configuration::GetSnapshot()->networks.at("eth0").leaseTime);
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, AdaptiveLeaseTimeWatermarks)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n"
+                                      "adaptive_lease_time 600 86400 20 90\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+    EXPECT_EQ(20, Configuration::GetSnapshot()->networks.at("eth0").utilizationLowWatermark);
+    EXPECT_EQ(90, Configuration::GetSnapshot()->networks.at("eth0").utilizationHighWatermark);
+
+    // Out of range, not wrapped around to fit.
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "adaptive_lease_time 600 86400 25 300\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "adaptive_lease_time 600 86400 75 75\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    for (const auto* line : { "adaptive_lease_time 600 -1\n", "adaptive_lease_time 600s 86400\n",
+                              "adaptive_lease_time 600 86400 25% 75\n", "adaptive_lease_time 600 86400 25 75%\n" })
+    {
+        writeConfig(std::string("interface eth0\n"
+                                "network 192.168.200.0/24\n") + line);
+        EXPECT_FALSE(Configuration::LoadFromFile(filename)) << line;
+    }
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, LoadBalance)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n"
+                                      "load_balance 2/3\n"
+                                      "load_balance_threshold 10\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+
+    const auto& config = Configuration::GetSnapshot()->networks.at("eth0");
+    EXPECT_EQ(1, config.loadBalanceServer);
+    EXPECT_EQ(3, config.loadBalanceServers);
+    EXPECT_EQ(10, config.loadBalanceThreshold);
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "load_balance 3/2\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    for (const auto* line : { "load_balance 1x/2y\n", "load_balance +1/2\n", "load_balance 1/256\n", "load_balance 1/\n" })
+    {
+        writeConfig(std::string("interface eth0\n"
+                                "network 192.168.200.0/24\n") + line);
+        EXPECT_FALSE(Configuration::LoadFromFile(filename)) << line;
+    }
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "load_balance 1/2\n"
+                "load_balance_threshold 3s\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "load_balance 1/2\n"
+                "load_balance_threshold 65536\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, FailoverTimeout)
+{
+    const auto filename = writeConfig("failover primary\n"
+                                      "failover_address 192.168.200.2\n"
+                                      "failover_timeout 300\n"
+                                      "interface eth0\n"
+                                      "network 192.168.200.0/24\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+    EXPECT_EQ(300, Configuration::GetSnapshot()->failoverTimeout);
+
+    // Too short for heartbeats.
+    writeConfig("failover primary\n"
+                "failover_address 192.168.200.2\n"
+                "failover_timeout 2\n"
+                "interface eth0\n"
+                "network 192.168.200.0/24\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, FailoverPeer)
+{
+    const auto filename = writeConfig("failover standby\n"
+                                      "failover_address 192.168.200.2\n"
+                                      "failover_peer 192.168.200.1\n"
+                                      "interface eth0\n"
+                                      "network 192.168.200.0/24\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 1), Configuration::GetSnapshot()->failoverPeer);
+
+    // The standby would otherwise take anyone connecting for the primary.
+    writeConfig("failover standby\n"
+                "failover_address 192.168.200.2\n"
+                "interface eth0\n"
+                "network 192.168.200.0/24\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, BulkLeasequery)
+{
+    const auto filename = writeConfig("bulk_leasequery 0.0.0.0\n"
+                                      "bulk_leasequery_allow 10.1.2.3/8 192.168.1.5\n"
+                                      "interface eth0\n"
+                                      "network 192.168.200.0/24\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+
+    const auto snapshot = Configuration::GetSnapshot();
+    EXPECT_TRUE(snapshot->bulkLeasequery);
+    EXPECT_EQ(BulkLeasequeryDefaults::port, snapshot->bulkLeasequeryPort);
+    ASSERT_EQ(2, snapshot->bulkLeasequeryAllowed.size());
+    EXPECT_TRUE(snapshot->bulkLeasequeryAllowed[0].contains(concatenateIpAddress(10, 200, 0, 1)));
+    EXPECT_TRUE(snapshot->bulkLeasequeryAllowed[1].contains(concatenateIpAddress(192, 168, 1, 5)));
+    EXPECT_FALSE(snapshot->bulkLeasequeryAllowed[1].contains(concatenateIpAddress(192, 168, 1, 6)));
+
+    // Nobody allowed to connect.
+    writeConfig("bulk_leasequery 0.0.0.0\n"
+                "interface eth0\n"
+                "network 192.168.200.0/24\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, LeaseEvents)
+{
+    const auto filename = writeConfig("lease_events /run/tdhcpd/events\n"
+                                      "interface eth0\n"
+                                      "network 192.168.200.0/24\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+    EXPECT_EQ("/run/tdhcpd/events", Configuration::GetSnapshot()->leaseEventSocket);
+    EXPECT_EQ(LeaseEventDefaults::buffer, Configuration::GetSnapshot()->leaseEventBuffer);
+
+    writeConfig("lease_events /run/tdhcpd/events\n"
+                "lease_events_buffer 0\n"
+                "interface eth0\n"
+                "network 192.168.200.0/24\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, RateLimitTableSize)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n"
+                                      "rate_limit_table_size 1024\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+    EXPECT_EQ(1024, Configuration::GetSnapshot()->networks.at("eth0").rateLimitTableSize);
+
+    // Not wrapped around to a huge table.
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "rate_limit_table_size -1\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "rate_limit_table_size 4096k\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, LeaseJitter)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n"
+                                      "lease_jitter 10\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+    EXPECT_EQ(10, Configuration::GetSnapshot()->networks.at("eth0").leaseJitter);
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "lease_jitter 10%\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "lease_jitter ten\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, HistorySize)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n"
+                                      "history_size 0\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+    EXPECT_EQ(0, Configuration::GetSnapshot()->networks.at("eth0").historySize);
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "history_size -1\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "history_size 1024abc\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "history_size 1048576\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+    EXPECT_EQ(1048576, Configuration::GetSnapshot()->networks.at("eth0").historySize);
+
+    // Not an allocation of a billion entries.
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "history_size 1048577\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "history_size 4000000000\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, DeclineQuarantine)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n"
+                                      "decline_quarantine 600\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+    EXPECT_EQ(600, Configuration::GetSnapshot()->networks.at("eth0").quarantineTime);
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "decline_quarantine 1h\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    writeConfig("interface eth0\n"
+                "network 192.168.200.0/24\n"
+                "decline_quarantine -600\n");
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, RateLimit)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n"
+                                      "rate_limit_client 5\n"
+                                      "rate_limit_interface 200 300\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+
+    const auto& config = Configuration::GetSnapshot()->networks.at("eth0");
+    EXPECT_EQ(5, config.clientRateLimit);
+    EXPECT_EQ(10, config.clientRateBurst);
+    EXPECT_EQ(200, config.interfaceRateLimit);
+    EXPECT_EQ(300, config.interfaceRateBurst);
+
+    // Not wrapped around to a limit nobody reaches.
+    for (const auto* line : { "rate_limit_client -1\n", "rate_limit_client 5abc\n", "rate_limit_client 5 -1\n",
+                              "rate_limit_client 5 10abc\n", "rate_limit_client 0\n", "rate_limit_interface 4294967295\n" })
+    {
+        writeConfig(std::string("interface eth0\n"
+                                "network 192.168.200.0/24\n") + line);
+        EXPECT_FALSE(Configuration::LoadFromFile(filename)) << line;
+    }
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, ConflictProbe)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n"
+                                      "conflict_probe 500 300\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+    EXPECT_EQ(500, Configuration::GetSnapshot()->networks.at("eth0").conflictProbeTimeout);
+    EXPECT_EQ(300, Configuration::GetSnapshot()->networks.at("eth0").conflictProbeCacheTime);
+
+    for (const auto* line : { "conflict_probe 500ms\n", "conflict_probe 500 300s\n", "conflict_probe -1\n", "conflict_probe 500 0\n" })
+    {
+        writeConfig(std::string("interface eth0\n"
+                                "network 192.168.200.0/24\n") + line);
+        EXPECT_FALSE(Configuration::LoadFromFile(filename)) << line;
+    }
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, HostLeaseTime)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n"
+                                      "reserve 11:22:33:44:55:66 192.168.200.10 lease_time=86400\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+    EXPECT_EQ(86400, Configuration::GetSnapshot()->networks.at("eth0").hostOptions.at(0x112233445566).leaseTime);
+
+    // Not wrapped around to the interface's maximum lease time.
+    for (const auto* option : { "lease_time=-1", "lease_time=3600s", "lease_time=0", "lease_time=day" })
+    {
+        writeConfig(std::string("interface eth0\n"
+                                "network 192.168.200.0/24\n"
+                                "reserve 11:22:33:44:55:66 192.168.200.10 ") + option + "\n");
+        EXPECT_FALSE(Configuration::LoadFromFile(filename)) << option;
+    }
+
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigurationTests, CompiledConfigurationIsValidated)
+{
+    const auto filename = writeConfig("interface eth0\n"
+                                      "network 192.168.200.0/24\n");
+    ASSERT_TRUE(Configuration::LoadFromFile(filename));
+
+    auto snapshot = *Configuration::GetSnapshot();
+    snapshot.networks.at("eth0").renewalTime = snapshot.networks.at("eth0").leaseTime;
+    const auto data = ConfigurationImage::Encode(snapshot);
+    {
+        std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+        ofs.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    }
+
+    const auto generation = Configuration::GetGeneration();
+    EXPECT_FALSE(Configuration::LoadFromFile(filename));
+    EXPECT_EQ(generation, Configuration::GetGeneration());
+
+    std::remove(filename.c_str());
+}
@@ -0,0 +1,166 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "ConfigurationImage.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+ConfigurationSnapshot makeSnapshot()
+{
+    ConfigurationSnapshot snapshot;
+    snapshot.pidFileName = "/var/run/tdhcpd.pid";
+    snapshot.statisticsFileName = "/var/tdhcpd/stats";
+    snapshot.logLevel = Log::Level::Debug;
+    snapshot.liveLeaseInterval = 500;
+    snapshot.failoverRole = FailoverRole::Standby;
+    snapshot.failoverAddress = concatenateIpAddress(10, 0, 0, 2);
+    snapshot.failoverPort = 6470;
+    snapshot.failoverPeer = concatenateIpAddress(10, 0, 0, 1);
+    snapshot.bulkLeasequery = true;
+    snapshot.bulkLeasequeryAddress = concatenateIpAddress(10, 0, 0, 1);
+    snapshot.bulkLeasequeryAllowed = { { concatenateIpAddress(10, 0, 0, 0), 0xFF000000 } };
+    snapshot.leaseEventSocket = "/run/tdhcpd/events";
+    snapshot.leaseEventBuffer = 64;
+
+    auto& config = snapshot.networks["eth0"];
+    config.leaseFile = "/var/tdhcpd/eth0.leases";
+    config.dnsServers = { concatenateIpAddress(1, 1, 1, 1), concatenateIpAddress(8, 8, 8, 8) };
+    config.poolSelection = PoolSelection::LeastUsed;
+    config.allocationPolicy = AllocationPolicy::Hash;
+    config.conflictProbeTimeout = 500;
+    config.loadBalanceServer = 1;
+    config.loadBalanceServers = 2;
+    config.loadBalanceThreshold = 10;
+
+    auto& pool = config.pools.emplace_back();
+    pool.name = "phones";
+    pool.first = concatenateIpAddress(192, 168, 200, 20);
+    pool.last = concatenateIpAddress(192, 168, 200, 59);
+    pool.clientClasses = 1;
+
+    auto& clientClass = config.clientClasses.emplace_back();
+    clientClass.name = "pxe";
+    clientClass.ouis = { 0x0004F2 };
+    clientClass.vendorClasses = { "PXEClient*" };
+    clientClass.bootFile = "pxelinux.0";
+
+    for (std::uint32_t i = 0; i < 1000; ++i)
+        config.reservations[0x020000000000ull + i] = concatenateIpAddress(192, 168, 200, 0) + i % 250;
+
+    config.hostOptions[0x020000000001ull] = { 600, { 12, 3, 'f', 'o', 'o' } };
+
+    snapshot.networks["eth1"].networkSpace = concatenateIpAddress(10, 0, 0, 0);
+    return snapshot;
+}
+}
+
+TEST(ConfigurationImageTests, RoundTrip)
+{
+    const auto snapshot = makeSnapshot();
+    const auto data = ConfigurationImage::Encode(snapshot);
+    ASSERT_TRUE(ConfigurationImage::IsImage(data));
+
+    ConfigurationSnapshot decoded;
+    ASSERT_TRUE(ConfigurationImage::Decode(data, decoded));
+
+    EXPECT_EQ(snapshot.pidFileName, decoded.pidFileName);
+    EXPECT_EQ(snapshot.logFileName, decoded.logFileName);
+    EXPECT_EQ(snapshot.statisticsFileName, decoded.statisticsFileName);
+    EXPECT_EQ(snapshot.logLevel, decoded.logLevel);
+    EXPECT_EQ(snapshot.liveLeaseInterval, decoded.liveLeaseInterval);
+    EXPECT_EQ(snapshot.failoverRole, decoded.failoverRole);
+    EXPECT_EQ(snapshot.failoverAddress, decoded.failoverAddress);
+    EXPECT_EQ(snapshot.failoverPort, decoded.failoverPort);
+    EXPECT_EQ(snapshot.failoverTimeout, decoded.failoverTimeout);
+    EXPECT_EQ(snapshot.failoverPeer, decoded.failoverPeer);
+    EXPECT_EQ(snapshot.bulkLeasequery, decoded.bulkLeasequery);
+    EXPECT_EQ(snapshot.bulkLeasequeryAddress, decoded.bulkLeasequeryAddress);
+    EXPECT_EQ(snapshot.bulkLeasequeryPort, decoded.bulkLeasequeryPort);
+    ASSERT_EQ(1, decoded.bulkLeasequeryAllowed.size());
+    EXPECT_EQ(0xFF000000, decoded.bulkLeasequeryAllowed[0].mask);
+    EXPECT_EQ(snapshot.leaseEventSocket, decoded.leaseEventSocket);
+    EXPECT_EQ(snapshot.leaseEventBuffer, decoded.leaseEventBuffer);
+    ASSERT_EQ(2, decoded.networks.size());
+
+    const auto& expected = snapshot.networks.at("eth0");
+    const auto& config = decoded.networks.at("eth0");
+    EXPECT_EQ(expected.leaseFile, config.leaseFile);
+    EXPECT_EQ(expected.dnsServers, config.dnsServers);
+    EXPECT_EQ(expected.poolSelection, config.poolSelection);
+    EXPECT_EQ(expected.allocationPolicy, config.allocationPolicy);
+    EXPECT_EQ(expected.conflictProbeTimeout, config.conflictProbeTimeout);
+    EXPECT_EQ(expected.loadBalanceServer, config.loadBalanceServer);
+    EXPECT_EQ(expected.loadBalanceServers, config.loadBalanceServers);
+    EXPECT_EQ(expected.loadBalanceThreshold, config.loadBalanceThreshold);
+    EXPECT_EQ(expected.leaseTime, config.leaseTime);
+    EXPECT_EQ(expected.reservations, config.reservations);
+
+    ASSERT_EQ(1, config.pools.size());
+    EXPECT_EQ("phones", config.pools[0].name);
+    EXPECT_EQ(expected.pools[0].first, config.pools[0].first);
+    EXPECT_EQ(expected.pools[0].last, config.pools[0].last);
+    EXPECT_EQ(1, config.pools[0].clientClasses);
+
+    ASSERT_EQ(1, config.clientClasses.size());
+    EXPECT_EQ("pxe", config.clientClasses[0].name);
+    EXPECT_EQ(expected.clientClasses[0].ouis, config.clientClasses[0].ouis);
+    EXPECT_EQ(expected.clientClasses[0].vendorClasses, config.clientClasses[0].vendorClasses);
+    EXPECT_EQ("pxelinux.0", config.clientClasses[0].bootFile);
+
+    ASSERT_EQ(1, config.hostOptions.size());
+    EXPECT_EQ(600, config.hostOptions.at(0x020000000001ull).leaseTime);
+    EXPECT_EQ(expected.hostOptions.at(0x020000000001ull).encodedOptions, config.hostOptions.at(0x020000000001ull).encodedOptions);
+
+    EXPECT_EQ(concatenateIpAddress(10, 0, 0, 0), decoded.networks.at("eth1").networkSpace);
+
+    // The same configuration always compiles to the same image.
+    EXPECT_EQ(data, ConfigurationImage::Encode(decoded));
+}
+
+TEST(ConfigurationImageTests, RefusesDamagedImages)
+{
+    const auto data = ConfigurationImage::Encode(makeSnapshot());
+    ConfigurationSnapshot decoded;
+
+    auto truncated = data;
+    truncated.resize(truncated.size() - 1);
+    EXPECT_FALSE(ConfigurationImage::Decode(truncated, decoded));
+
+    auto damaged = data;
+    damaged[damaged.size() / 2] ^= 0x01;
+    EXPECT_FALSE(ConfigurationImage::Decode(damaged, decoded));
+
+    auto otherVersion = data;
+    otherVersion[4] ^= 0x01;
+    EXPECT_FALSE(ConfigurationImage::Decode(otherVersion, decoded));
+
+    EXPECT_FALSE(ConfigurationImage::Decode({}, decoded));
+    EXPECT_TRUE(decoded.networks.empty());
+}
+
+TEST(ConfigurationImageTests, RefusesValuesOutOfRange)
+{
+    ConfigurationSnapshot decoded;
+
+    auto snapshot = makeSnapshot();
+    snapshot.networks["eth0"].poolSelection = static_cast<PoolSelection>(7);
+    EXPECT_FALSE(ConfigurationImage::Decode(ConfigurationImage::Encode(snapshot), decoded));
+
+    snapshot = makeSnapshot();
+    snapshot.failoverRole = static_cast<FailoverRole>(3);
+    EXPECT_FALSE(ConfigurationImage::Decode(ConfigurationImage::Encode(snapshot), decoded));
+
+    snapshot = makeSnapshot();
+    snapshot.networks["eth0"].clientClasses[0].bootFile = std::string(NetworkDefaults::maximumBootFileLength + 1, 'x');
+    EXPECT_FALSE(ConfigurationImage::Decode(ConfigurationImage::Encode(snapshot), decoded));
+
+    snapshot = makeSnapshot();
+    snapshot.networks["eth0"].clientClasses[0].serverName = std::string(NetworkDefaults::maximumServerNameLength, 'x');
+    EXPECT_TRUE(ConfigurationImage::Decode(ConfigurationImage::Encode(snapshot), decoded));
+}
@@ -0,0 +1,102 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "ConflictProber.h"
+#include "IpConverter.h"
+#include "Network.h"
+
+#include <gtest/gtest.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+constexpr auto Loopback = concatenateIpAddress(127, 0, 0, 1);
+constexpr auto Unreachable = concatenateIpAddress(192, 0, 2, 1); // TEST-NET-1, nothing answers on lo.
+
+// Probing needs a raw ICMP socket, ie. root or CAP_NET_RAW.
+bool canProbe()
+{
+    const int sockfd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    if (sockfd < 0)
+        return false;
+
+    close(sockfd);
+    return true;
+}
+
+std::vector<std::uint32_t> waitForConflicts(ConflictProber& prober)
+{
+    for (int i = 0; i < 100; ++i)
+    {
+        auto conflicts = prober.takeConflicts();
+        if (!conflicts.empty())
+            return conflicts;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    return {};
+}
+}
+
+TEST(ConflictProberTests, CachesProbes)
+{
+    ConflictProber prober("lo", std::chrono::milliseconds(50), 1);
+    EXPECT_TRUE(prober.probe(Unreachable));
+    EXPECT_FALSE(prober.probe(Unreachable));
+    EXPECT_TRUE(prober.probe(Unreachable + 1));
+
+    // Probed again once the cache time is up.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    EXPECT_TRUE(prober.probe(Unreachable));
+}
+
+TEST(ConflictProberTests, NoConflictWithoutReply)
+{
+    if (!canProbe())
+        GTEST_SKIP() << "No raw ICMP socket";
+
+    ConflictProber prober("lo", std::chrono::milliseconds(100), 60);
+    ASSERT_TRUE(prober.probe(Unreachable));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_TRUE(prober.takeConflicts().empty());
+}
+
+TEST(ConflictProberTests, ReplyQuarantinesAddress)
+{
+    if (!canProbe())
+        GTEST_SKIP() << "No raw ICMP socket";
+
+    // A network on lo, where the first address offered answers.
+    Network network;
+    network.setNetworkSpace(concatenateIpAddress(127, 0, 0, 0));
+    network.setNetworkSize(24);
+    network.setDhcpRange(Loopback, Loopback + 9);
+
+    ConflictProber prober("lo", std::chrono::milliseconds(1000), 60);
+    const auto address = network.getAvailableAddress(1);
+    ASSERT_EQ(Loopback, address);
+    ASSERT_TRUE(prober.probe(address));
+
+    const auto conflicts = waitForConflicts(prober);
+    ASSERT_EQ(1, conflicts.size());
+    EXPECT_EQ(Loopback, conflicts.front());
+    EXPECT_TRUE(prober.takeConflicts().empty());
+
+    // As the handler does with them.
+    for (auto conflict : conflicts)
+        network.quarantineAddress(conflict, prober.getCacheTime());
+    EXPECT_TRUE(network.isAddressQuarantined(address));
+    EXPECT_NE(address, network.getAvailableAddress(1));
+    EXPECT_FALSE(network.reserveAddress(1, address));
+}
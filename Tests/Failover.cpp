@@ -0,0 +1,164 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "Failover.h"
+#include "IpConverter.h"
+
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+    constexpr auto Loopback = concatenateIpAddress(127, 0, 0, 1);
+
+    template<typename Predicate>
+    bool waitFor(Predicate predicate)
+    {
+        for (int i = 0; i < 500; ++i)
+        {
+            if (predicate())
+                return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        return predicate();
+    }
+}
+
+TEST(FailoverTests, StandbyFollowsPrimaryAndTakesOver)
+{
+    FailoverStandby standby(Loopback, 0, Loopback, std::chrono::milliseconds(500));
+    standby.addInterface("eth0", NetworkConfiguration{}, {});
+    ASSERT_TRUE(standby.start());
+    ASSERT_NE(0, standby.getPort());
+
+    const auto ip1 = concatenateIpAddress(192, 168, 200, 100);
+    const auto ip2 = concatenateIpAddress(192, 168, 200, 101);
+
+    Network network;
+    network.configure(NetworkConfiguration{});
+    ASSERT_TRUE(network.reserveAddress(0x112233445566, ip1)); // Before connecting, sent with all the leases.
+
+    FailoverPrimary primary(Loopback, standby.getPort(), std::chrono::milliseconds(100));
+    primary.addInterface("eth0", network.getLeaseTable());
+    network.setLeaseListener(primary.getLeaseListener("eth0"));
+    primary.start();
+
+    const auto& replicated = standby.getLeaseTable("eth0");
+    ASSERT_TRUE(waitFor([&] { return replicated.size() == 1; }));
+    EXPECT_EQ(ip1, replicated.snapshot()[0].ipAddress);
+
+    // Changes from here on are sent as they happen.
+    ASSERT_TRUE(network.reserveAddress(0x112233445567, ip2));
+    network.releaseAddress(ip1);
+    ASSERT_TRUE(waitFor([&] { return replicated.size() == 1 && replicated.snapshot()[0].ipAddress == ip2; }));
+
+    // Heartbeats keep the standby from taking over while the primary has nothing to say.
+    std::this_thread::sleep_for(std::chrono::milliseconds(800));
+    EXPECT_FALSE(standby.isPrimaryDown());
+
+    primary.stop();
+    ASSERT_TRUE(waitFor([&] { return standby.isPrimaryDown(); }));
+
+    auto leases = standby.stop();
+    ASSERT_EQ(1, leases["eth0"].size());
+    EXPECT_EQ(0x112233445567, leases["eth0"][0].hwAddress);
+    EXPECT_EQ(ip2, leases["eth0"][0].ipAddress);
+    EXPECT_EQ(network.getLease(ip2).startTime, leases["eth0"][0].startTime);
+}
+
+TEST(FailoverTests, StandbyWaitsForPrimaryToConnect)
+{
+    FailoverStandby standby(Loopback, 0, Loopback, std::chrono::milliseconds(200));
+
+    Lease lease;
+    lease.startTime = std::time(nullptr);
+    lease.hwAddress = 0x112233445566;
+    lease.ipAddress = concatenateIpAddress(192, 168, 200, 150);
+    standby.addInterface("eth0", NetworkConfiguration{}, { lease });
+    ASSERT_TRUE(standby.start());
+
+    // Long past the timeout, but the primary may just be starting later.
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    EXPECT_FALSE(standby.isPrimaryDown());
+
+    // It still listens, and takes over once a primary that came and went goes silent.
+    Network network;
+    network.configure(NetworkConfiguration{});
+    FailoverPrimary primary(Loopback, standby.getPort(), std::chrono::milliseconds(50));
+    primary.addInterface("eth0", network.getLeaseTable());
+    primary.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_FALSE(standby.isPrimaryDown());
+
+    primary.stop();
+    ASSERT_TRUE(waitFor([&] { return standby.isPrimaryDown(); }));
+
+    // The primary had no leases, its Reset replaced the ones the standby started out with.
+    auto leases = standby.stop();
+    EXPECT_TRUE(leases["eth0"].empty());
+}
+
+TEST(FailoverTests, StandbyRefusesOtherPeers)
+{
+    FailoverStandby standby(Loopback, 0, concatenateIpAddress(127, 0, 0, 2), std::chrono::milliseconds(200));
+
+    Lease lease;
+    lease.startTime = std::time(nullptr);
+    lease.hwAddress = 0x112233445566;
+    lease.ipAddress = concatenateIpAddress(192, 168, 200, 150);
+    standby.addInterface("eth0", NetworkConfiguration{}, { lease });
+    ASSERT_TRUE(standby.start());
+
+    // Connects from 127.0.0.1, so its Reset never replaces the leases and its going away is no reason to take over.
+    Network network;
+    network.configure(NetworkConfiguration{});
+    FailoverPrimary primary(Loopback, standby.getPort(), std::chrono::milliseconds(50));
+    primary.addInterface("eth0", network.getLeaseTable());
+    primary.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    primary.stop();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    EXPECT_FALSE(standby.isPrimaryDown());
+    EXPECT_EQ(1, standby.stop()["eth0"].size());
+}
+
+TEST(FailoverTests, StandbyNeedsResetFirst)
+{
+    FailoverStandby standby(Loopback, 0, Loopback, std::chrono::milliseconds(200));
+    standby.addInterface("eth0", NetworkConfiguration{}, {});
+    ASSERT_TRUE(standby.start());
+
+    // A heartbeat in place of the Reset drops the connection without the primary counting as heard.
+    const int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(sockfd, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(Loopback);
+    addr.sin_port = htons(standby.getPort());
+    ASSERT_EQ(0, connect(sockfd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)));
+
+    Failover::MessageHeader header{};
+    std::memcpy(header.magic, Failover::Magic, sizeof(header.magic));
+    header.type = Failover::MessageType::Heartbeat;
+    header.sequence = 1;
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(header)), send(sockfd, &header, sizeof(header), 0));
+    close(sockfd);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    EXPECT_FALSE(standby.isPrimaryDown());
+    standby.stop();
+}
@@ -37,3 +37,59 @@ TEST(IpConverter, IntegerToStringConvert)
     // 0xC0A80117 : 192.168.1.23
     EXPECT_EQ("192.168.1.23", addr);
 }
+
+TEST(IpConverter, ParseIpAddress)
+{
+    std::uint32_t addr{};
+    EXPECT_TRUE(parseIpAddress("192.168.1.23", addr));
+    EXPECT_EQ(0xC0A80117, addr);
+
+    EXPECT_TRUE(parseIpAddress("0.0.0.0", addr));
+    EXPECT_EQ(0, addr);
+
+    EXPECT_TRUE(parseIpAddress("255.255.255.255", addr));
+    EXPECT_EQ(0xFFFFFFFF, addr);
+
+    EXPECT_FALSE(parseIpAddress("", addr));
+    EXPECT_FALSE(parseIpAddress("192.168.1", addr));
+    EXPECT_FALSE(parseIpAddress("192.168.1.23.4", addr));
+    EXPECT_FALSE(parseIpAddress("192.168.1.256", addr));
+    EXPECT_FALSE(parseIpAddress("192.168..23", addr));
+    EXPECT_FALSE(parseIpAddress("192.168.1.23 ", addr));
+    EXPECT_FALSE(parseIpAddress("192.168.1.-1", addr));
+    EXPECT_FALSE(parseIpAddress("192.168.1.0023", addr));
+    EXPECT_EQ(0xFFFFFFFF, addr); // Left alone on failure.
+}
+
+TEST(IpConverter, ParseHardwareAddress)
+{
+    std::uint64_t addr{};
+    EXPECT_TRUE(parseHardwareAddress("AA:BB:CC:DD:EE:FF", addr));
+    EXPECT_EQ(0xAABBCCDDEEFF, addr);
+
+    EXPECT_TRUE(parseHardwareAddress("00-1b-2c-3d-4e-5f", addr));
+    EXPECT_EQ(0x001B2C3D4E5F, addr);
+
+    EXPECT_TRUE(parseHardwareAddress("0:1b:2:3c:4:5d", addr));
+    EXPECT_EQ(0x001B023C045D, addr);
+
+    EXPECT_FALSE(parseHardwareAddress("", addr));
+    EXPECT_FALSE(parseHardwareAddress("AA:BB:CC:DD:EE", addr));
+    EXPECT_FALSE(parseHardwareAddress("AA:BB:CC:DD:EE:FF:00", addr));
+    EXPECT_FALSE(parseHardwareAddress("AA:BB:CC:DD:EE:FG", addr));
+    EXPECT_FALSE(parseHardwareAddress("AA.BB.CC.DD.EE.FF", addr));
+    EXPECT_FALSE(parseHardwareAddress("AAA:B:CC:DD:EE:FF", addr));
+    EXPECT_EQ(0x001B023C045D, addr); // Left alone on failure.
+}
+
+TEST(IpConverter, FormatAddresses)
+{
+    EXPECT_EQ("192.168.1.23", formatIpAddress(0xC0A80117).view());
+    EXPECT_EQ("0.0.0.0", formatIpAddress(0).view());
+    EXPECT_EQ("255.255.255.255", formatIpAddress(0xFFFFFFFF).view());
+
+    EXPECT_EQ("AA:BB:CC:DD:EE:FF", formatHardwareAddress(0xAABBCCDDEEFF).view());
+    EXPECT_EQ("00:1B:02:3C:04:5D", formatHardwareAddress(0x001B023C045D).view());
+
+    EXPECT_EQ("10.0.0.1 is 02:00:00:00:00:01", std::format("{} is {}", formatIpAddress(0x0A000001), formatHardwareAddress(0x020000000001)));
+}
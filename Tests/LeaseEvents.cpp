@@ -0,0 +1,235 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "LeaseEvents.h"
+#include "IpConverter.h"
+#include "Network.h"
+
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <tuple>
+
+namespace
+{
+const std::string SocketPath = testing::TempDir() + "tdhcpd-lease-events";
+
+int subscribe()
+{
+    const int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, SocketPath.c_str(), sizeof(addr.sun_path) - 1);
+    timeval timeout{ 5, 0 };
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    if (connect(sockfd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        close(sockfd);
+        return -1;
+    }
+
+    // Give the publisher time to take the subscriber in, events before that aren't sent to it.
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    return sockfd;
+}
+
+bool readRecord(int sockfd, LeaseEvents::Record& record)
+{
+    auto* data = reinterpret_cast<std::uint8_t*>(&record);
+    std::size_t filled{};
+    while (filled < sizeof(record))
+    {
+        const auto received = recv(sockfd, data + filled, sizeof(record) - filled, 0);
+        if (received <= 0)
+            return false;
+        filled += static_cast<std::size_t>(received);
+    }
+
+    return record.length == sizeof(record) - sizeof(record.length);
+}
+
+Lease makeLease(std::uint64_t hwAddress, std::uint32_t ipAddress, std::time_t age, std::uint32_t leaseTime)
+{
+    Lease lease;
+    lease.startTime = std::time(nullptr) - age;
+    lease.hwAddress = hwAddress;
+    lease.ipAddress = ipAddress;
+    lease.leaseTime = leaseTime;
+    return lease;
+}
+}
+
+TEST(LeaseEventsTests, PublishesChanges)
+{
+    Network network;
+    LeaseEventPublisher publisher(SocketPath, 4096);
+    network.setLeaseListener(publisher.getLeaseListener("eth0"));
+    publisher.addInterface("eth0", network.getLeaseTable(), 3600);
+    ASSERT_TRUE(publisher.start());
+
+    const int sockfd = subscribe();
+    ASSERT_GE(sockfd, 0);
+
+    const auto adr1 = network.getAvailableAddress(1);
+    ASSERT_TRUE(network.reserveAddress(1, adr1));
+    ASSERT_TRUE(network.reserveAddress(1, adr1));
+
+    const auto adr2 = network.getAvailableAddress(2);
+    ASSERT_TRUE(network.reserveAddress(1, adr2));
+    network.releaseAddress(adr2);
+
+    ASSERT_TRUE(network.reserveAddress(3, adr1));
+    ASSERT_TRUE(network.declineAddress(3, adr1));
+
+    // Reported expired once its time is up, and not again when the network finds it expired.
+    network.setLeaseDuration(1);
+    ASSERT_TRUE(network.reserveAddress(4, adr2));
+
+    const std::vector<std::tuple<LeaseEvents::Type, std::uint64_t, std::uint32_t>> expected{
+        { LeaseEvents::Type::Granted, 1, adr1 },
+        { LeaseEvents::Type::Renewed, 1, adr1 },
+        { LeaseEvents::Type::Released, 1, adr1 },
+        { LeaseEvents::Type::Granted, 1, adr2 },
+        { LeaseEvents::Type::Released, 1, adr2 },
+        { LeaseEvents::Type::Granted, 3, adr1 },
+        { LeaseEvents::Type::Declined, 3, adr1 },
+        { LeaseEvents::Type::Granted, 4, adr2 },
+        { LeaseEvents::Type::Expired, 4, adr2 }
+    };
+
+    LeaseEvents::Record record{};
+    for (std::size_t i = 0; i < expected.size(); ++i)
+    {
+        ASSERT_TRUE(readRecord(sockfd, record)) << "event " << i;
+        EXPECT_EQ(expected[i], std::make_tuple(record.type, record.hwAddress, record.ipAddress)) << "event " << i;
+        EXPECT_EQ(i, record.sequence);
+        EXPECT_STREQ("eth0", record.interface);
+        EXPECT_NE(0, record.leaseTime);
+    }
+
+    EXPECT_NE(0, network.getAvailableAddress(4));
+    ASSERT_TRUE(network.reserveAddress(5, network.getAvailableAddress(5)));
+    ASSERT_TRUE(readRecord(sockfd, record));
+    EXPECT_EQ(LeaseEvents::Type::Granted, record.type);
+    EXPECT_EQ(5, record.hwAddress);
+
+    close(sockfd);
+    publisher.stop();
+    EXPECT_NE(0, access(SocketPath.c_str(), F_OK));
+}
+
+TEST(LeaseEventsTests, SlowSubscriberGetsGap)
+{
+    Network network;
+    LeaseEventPublisher publisher(SocketPath, 0); // Room for a Gap record and an event only.
+    network.setLeaseListener(publisher.getLeaseListener("eth0"));
+    ASSERT_TRUE(publisher.start());
+
+    const int sockfd = subscribe();
+    ASSERT_GE(sockfd, 0);
+
+    // Many more than the socket holds while nobody reads.
+    constexpr std::uint64_t Renewals = 20000;
+    const auto adr1 = network.getAvailableAddress(1);
+    for (std::uint64_t i = 0; i < Renewals; ++i)
+        ASSERT_TRUE(network.reserveAddress(1, adr1));
+
+    std::uint64_t received{};
+    std::uint64_t lost{};
+    std::uint64_t gaps{};
+    std::uint64_t nextSequence{};
+    LeaseEvents::Record record{};
+    while (received + lost < Renewals && readRecord(sockfd, record))
+    {
+        if (record.type == LeaseEvents::Type::Gap)
+        {
+            ++gaps;
+            lost += record.lost;
+            EXPECT_EQ(nextSequence + record.lost - 1, record.sequence);
+        }
+        else
+        {
+            ++received;
+            EXPECT_EQ(nextSequence, record.sequence);
+        }
+
+        nextSequence = record.sequence + 1;
+    }
+
+    EXPECT_EQ(Renewals, received + lost);
+    EXPECT_LT(0, gaps);
+
+    close(sockfd);
+}
+
+TEST(LeaseEventsTests, ExpiresLoadedLeases)
+{
+    LeaseTable table;
+    table.set(makeLease(1, concatenateIpAddress(10, 0, 0, 1), 3599, 3600));
+    table.set(makeLease(2, concatenateIpAddress(10, 0, 0, 2), 59, 0)); // Has the interface's maximum lease time.
+    table.set(makeLease(3, concatenateIpAddress(10, 0, 0, 3), 7200, 3600)); // Expired before starting.
+    table.set(makeLease(4, concatenateIpAddress(10, 0, 0, 4), 0, 3600));
+
+    LeaseEventPublisher publisher(SocketPath, 4096);
+    publisher.addInterface("eth0", table, 60);
+    ASSERT_TRUE(publisher.start());
+
+    const int sockfd = subscribe();
+    ASSERT_GE(sockfd, 0);
+
+    std::vector<std::uint64_t> expired;
+    LeaseEvents::Record record{};
+    for (int i = 0; i < 2; ++i)
+    {
+        ASSERT_TRUE(readRecord(sockfd, record));
+        EXPECT_EQ(LeaseEvents::Type::Expired, record.type);
+        expired.push_back(record.hwAddress);
+        EXPECT_EQ(record.hwAddress == 2 ? 60u : 3600u, record.leaseTime);
+    }
+
+    std::sort(expired.begin(), expired.end());
+    EXPECT_EQ((std::vector<std::uint64_t>{ 1, 2 }), expired);
+
+    close(sockfd);
+}
+
+TEST(LeaseEventsTests, LoadedLeaseHeldForMaximumLeaseTime)
+{
+    NetworkConfiguration config;
+    config.leaseTime = 3600;
+    config.hostOptions[0x020000000001].leaseTime = 86400;
+
+    // Loaded from the lease file, and about to run past lease_time, but the network holds it for the host's lease time.
+    const auto loaded = makeLease(2, NetworkDefaults::first, 3599, 0);
+    const auto expiring = makeLease(3, NetworkDefaults::first + 1, 3598, 3600);
+
+    Network network;
+    network.configure(NetworkConfiguration(config), { loaded, expiring });
+
+    LeaseEventPublisher publisher(SocketPath, 4096);
+    publisher.addInterface("eth0", network.getLeaseTable(), Network::getMaximumLeaseTime(config));
+    ASSERT_TRUE(publisher.start());
+
+    const int sockfd = subscribe();
+    ASSERT_GE(sockfd, 0);
+
+    // The loaded lease would have expired first.
+    LeaseEvents::Record record{};
+    ASSERT_TRUE(readRecord(sockfd, record));
+    EXPECT_EQ(LeaseEvents::Type::Expired, record.type);
+    EXPECT_EQ(3, record.hwAddress);
+
+    close(sockfd);
+}
@@ -0,0 +1,138 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "LeaseFile.h"
+#include "Configuration.h"
+#include "IpConverter.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+TEST(LeaseFileTests, ReadsWhatWasSaved)
+{
+    const std::string filename = testing::TempDir() + "leases.bin";
+
+    std::vector<Lease> leases;
+    for (std::uint8_t i = 1; i <= 100; ++i)
+        leases.push_back({ 1000 + i, 0x020000000000ull + i, concatenateIpAddress(10, 0, 0, i), 0 });
+    leases[50].startTime = 0; // Unused record
+    Configuration::SavePersistentLeases(leases, filename);
+
+    {
+        // A partial record at the end, as if the file was cut short.
+        std::ofstream ofs(filename, std::ios::out | std::ios::binary | std::ios::app);
+        ofs.write("\x01\x02\x03", 3);
+    }
+
+    LeaseFile file(filename);
+    ASSERT_TRUE(file.isOpen());
+    EXPECT_EQ(100, file.getRecordCount());
+
+    std::vector<Lease> read;
+    file.forEach([&read](const Lease& lease) { read.push_back(lease); });
+    ASSERT_EQ(99, read.size());
+    EXPECT_EQ(1001, read[0].startTime);
+    EXPECT_EQ(0x020000000001ull, read[0].hwAddress);
+    EXPECT_EQ(concatenateIpAddress(10, 0, 0, 1), read[0].ipAddress);
+    EXPECT_EQ(concatenateIpAddress(10, 0, 0, 52), read[50].ipAddress);
+
+    EXPECT_EQ(read.size(), Configuration::GetPersistentLeasesByFile(filename).size());
+
+    std::remove(filename.c_str());
+}
+
+TEST(LeaseFileTests, MissingFile)
+{
+    LeaseFile file(testing::TempDir() + "no-such-lease-file");
+    EXPECT_FALSE(file.isOpen());
+    EXPECT_EQ(0, file.getRecordCount());
+    EXPECT_TRUE(Configuration::GetPersistentLeasesByFile(testing::TempDir() + "no-such-lease-file").empty());
+}
+
+TEST(LeaseFileTests, EmptyFile)
+{
+    const std::string filename = testing::TempDir() + "leases-empty.bin";
+    std::ofstream(filename).close();
+
+    LeaseFile file(filename);
+    EXPECT_TRUE(file.isOpen());
+    EXPECT_EQ(0, file.getRecordCount());
+
+    std::size_t read{};
+    file.forEach([&read](const Lease&) { ++read; });
+    EXPECT_EQ(0, read);
+
+    std::remove(filename.c_str());
+}
+
+TEST(LeaseFileTests, WriterReplacesOnCommitOnly)
+{
+    const std::string filename = testing::TempDir() + "leases-writer.bin";
+    Configuration::SavePersistentLeases({ { 1, 2, 3, 0 } }, filename);
+
+    {
+        LeaseFileWriter writer(filename);
+        ASSERT_TRUE(writer.isOpen());
+        writer.write({ 4, 5, 6, 0 });
+        writer.write({ 7, 8, 9, 0 });
+        // Not committed, so the old file stays.
+    }
+    EXPECT_EQ(1, LeaseFile(filename).getRecordCount());
+
+    {
+        LeaseFileWriter writer(filename);
+        writer.write({ 4, 5, 6, 0 });
+        writer.write({ 7, 8, 9, 0 });
+        EXPECT_TRUE(writer.commit());
+    }
+
+    LeaseFile file(filename);
+    ASSERT_EQ(2, file.getRecordCount());
+    EXPECT_EQ(8, file.getRecord(1).hwAddress);
+
+    std::remove(filename.c_str());
+}
+
+TEST(LeaseFileTests, SorterInMemoryAndWithRuns)
+{
+    std::vector<Lease> leases;
+    std::mt19937 random(1234);
+    for (int i = 0; i < 1000; ++i)
+        leases.push_back({ 1 + static_cast<std::time_t>(random() % 100), random() % 500, static_cast<std::uint32_t>(random()), 0 });
+
+    auto byHwAddress = [](const Lease& a, const Lease& b) { return a.hwAddress < b.hwAddress; };
+
+    for (const std::size_t limit : { 10000, 64, 1 })
+    {
+        LeaseSorter sorter(byHwAddress, limit, testing::TempDir());
+        for (const auto& lease : leases)
+            sorter.add(lease);
+
+        ASSERT_TRUE(sorter.sort());
+        EXPECT_EQ(limit == 10000, sorter.getRunCount() == 0);
+
+        std::vector<Lease> sorted;
+        Lease lease;
+        while (sorter.next(lease))
+            sorted.push_back(lease);
+
+        ASSERT_EQ(leases.size(), sorted.size());
+        EXPECT_TRUE(std::is_sorted(sorted.begin(), sorted.end(), byHwAddress));
+
+        std::uint64_t sum{};
+        for (const auto& sortedLease : sorted)
+            sum += sortedLease.ipAddress + sortedLease.startTime;
+        std::uint64_t expected{};
+        for (const auto& original : leases)
+            expected += original.ipAddress + original.startTime;
+        EXPECT_EQ(expected, sum);
+    }
+}
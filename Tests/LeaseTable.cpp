@@ -0,0 +1,133 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "LeaseTable.h"
+#include "Network.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+TEST(LeaseTableTests, SetReplaceAndRemove)
+{
+    LeaseTable table;
+    EXPECT_EQ(0, table.size());
+
+    table.set({ 100, 0x112233445566, concatenateIpAddress(10, 0, 0, 1), 3600 });
+    table.set({ 100, 0x112233445567, concatenateIpAddress(10, 0, 0, 2), 3600 });
+    table.set({ 200, 0x112233445566, concatenateIpAddress(10, 0, 0, 3), 600 });
+    EXPECT_EQ(2, table.size());
+
+    auto leases = table.snapshot();
+    ASSERT_EQ(2, leases.size());
+    std::sort(leases.begin(), leases.end(), [](const auto& a, const auto& b) { return a.hwAddress < b.hwAddress; });
+    EXPECT_EQ(200, leases[0].startTime);
+    EXPECT_EQ(concatenateIpAddress(10, 0, 0, 3), leases[0].ipAddress);
+    EXPECT_EQ(600, leases[0].leaseTime);
+    EXPECT_EQ(0x112233445567, leases[1].hwAddress);
+
+    const auto version = table.getVersion();
+    table.remove(0x112233445566);
+    table.remove(0x112233445566);
+    EXPECT_NE(version, table.getVersion());
+    ASSERT_EQ(1, table.size());
+    EXPECT_EQ(0x112233445567, table.snapshot()[0].hwAddress);
+
+    table.clear();
+    EXPECT_EQ(0, table.size());
+    EXPECT_TRUE(table.snapshot().empty());
+}
+
+TEST(LeaseTableTests, GrowsPastOneChunk)
+{
+    LeaseTable table;
+    for (std::uint64_t i = 0; i < LeaseTable::ChunkSize * 3; ++i)
+        ASSERT_TRUE(table.set({ 100, i + 1, static_cast<std::uint32_t>(i), 3600 }));
+
+    EXPECT_EQ(LeaseTable::ChunkSize * 3, table.snapshot().size());
+}
+
+TEST(LeaseTableTests, ReadsInPages)
+{
+    LeaseTable table;
+    for (std::uint64_t i = 0; i < LeaseTable::ChunkSize + 10; ++i)
+        ASSERT_TRUE(table.set({ 100, i + 1, static_cast<std::uint32_t>(i), 3600, { i, 0 } }));
+    table.remove(5);
+
+    std::size_t count{};
+    std::size_t pages{};
+    for (std::size_t slot = 0; slot < table.getSlotCount(); ++pages)
+        slot = table.forEachInSlots(slot, 100, [&count](const Lease& lease) { count += lease.relayAgent.relayId + 1 == lease.hwAddress; });
+
+    EXPECT_EQ(LeaseTable::ChunkSize + 9, count);
+    EXPECT_EQ(LeaseTable::ChunkSize * 2 / 100 + 1, pages);
+}
+
+TEST(LeaseTableTests, ReadersNeverSeeTornLeases)
+{
+    LeaseTable table;
+    std::atomic_bool done{};
+
+    // Every lease the writer sets has all fields derived from the same number.
+    std::thread writer([&]
+    {
+        for (std::uint32_t i = 1; i < 200000; ++i)
+        {
+            const std::uint64_t hwAddress = 1 + i % 3000;
+            if (i % 7 == 0)
+                table.remove(hwAddress);
+            else
+                table.set({ static_cast<std::time_t>(i), hwAddress, i, i * 2 });
+        }
+        done = true;
+    });
+
+    std::atomic<std::uint64_t> torn{};
+    std::atomic<std::uint64_t> seen{};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; ++r)
+    {
+        readers.emplace_back([&]
+        {
+            while (!done)
+            {
+                table.forEach([&](const Lease& lease)
+                {
+                    ++seen;
+                    if (lease.ipAddress != static_cast<std::uint32_t>(lease.startTime)
+                        || lease.leaseTime != lease.ipAddress * 2
+                        || lease.hwAddress != 1 + lease.ipAddress % 3000)
+                        ++torn;
+                });
+            }
+        });
+    }
+
+    writer.join();
+    for (auto& reader : readers)
+        reader.join();
+
+    EXPECT_EQ(0, torn);
+    EXPECT_GT(seen, 0);
+}
+
+TEST(LeaseTableTests, FollowsNetworkLeases)
+{
+    Network network;
+    const auto first = network.getAvailableAddress(0x112233445566);
+    ASSERT_TRUE(network.reserveAddress(0x112233445566, first));
+
+    auto leases = network.getLeaseTable().snapshot();
+    ASSERT_EQ(1, leases.size());
+    EXPECT_EQ(0x112233445566, leases[0].hwAddress);
+    EXPECT_EQ(first, leases[0].ipAddress);
+
+    network.releaseAddress(first);
+    EXPECT_TRUE(network.getLeaseTable().snapshot().empty());
+}
@@ -0,0 +1,99 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "LiveLeases.h"
+#include "Network.h"
+
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <format>
+#include <unistd.h>
+
+namespace
+{
+    // Segments are visible system wide, so don't collide with a running daemon or another test run.
+    std::string getTestInterface()
+    {
+        return std::format("test{}", ::getpid());
+    }
+}
+
+TEST(LiveLeasesTests, PublishAndRead)
+{
+    const auto interface = getTestInterface();
+
+    LeaseTable table;
+    table.set({ 100, 0x112233445566, concatenateIpAddress(10, 0, 0, 1), 3600 });
+    table.set({ 200, 0x112233445567, concatenateIpAddress(10, 0, 0, 2), 600 });
+
+    LiveLeases::Contents contents;
+    std::string error;
+
+    {
+        LiveLeasePublisher publisher(interface, table, 16);
+        ASSERT_TRUE(publisher.isOpen());
+        publisher.publish();
+
+        ASSERT_TRUE(LiveLeases::Read(interface, contents, error)) << error;
+        EXPECT_FALSE(contents.truncated);
+        ASSERT_EQ(2, contents.leases.size());
+
+        auto& leases = contents.leases;
+        std::sort(leases.begin(), leases.end(), [](const auto& a, const auto& b) { return a.hwAddress < b.hwAddress; });
+        EXPECT_EQ(100, leases[0].startTime);
+        EXPECT_EQ(0x112233445566, leases[0].hwAddress);
+        EXPECT_EQ(concatenateIpAddress(10, 0, 0, 1), leases[0].ipAddress);
+        EXPECT_EQ(3600, leases[0].leaseTime);
+        EXPECT_EQ(concatenateIpAddress(10, 0, 0, 2), leases[1].ipAddress);
+
+        table.remove(0x112233445566);
+        publisher.publish();
+
+        ASSERT_TRUE(LiveLeases::Read(interface, contents, error)) << error;
+        ASSERT_EQ(1, contents.leases.size());
+        EXPECT_EQ(0x112233445567, contents.leases[0].hwAddress);
+    }
+
+    // The segment goes away with the publisher.
+    EXPECT_FALSE(LiveLeases::Read(interface, contents, error));
+}
+
+TEST(LiveLeasesTests, TruncatesToCapacity)
+{
+    const auto interface = getTestInterface();
+
+    LeaseTable table;
+    for (std::uint8_t i = 0; i < 10; ++i)
+        table.set({ 100, 0x112233445500ull + i, concatenateIpAddress(10, 0, 0, static_cast<std::uint8_t>(10 + i)), 3600 });
+
+    LiveLeasePublisher publisher(interface, table, 4);
+    ASSERT_TRUE(publisher.isOpen());
+    publisher.publish();
+
+    LiveLeases::Contents contents;
+    std::string error;
+    ASSERT_TRUE(LiveLeases::Read(interface, contents, error)) << error;
+    EXPECT_TRUE(contents.truncated);
+    EXPECT_EQ(4, contents.leases.size());
+}
+
+TEST(LiveLeasesTests, NotReadableByOthers)
+{
+    const auto interface = getTestInterface();
+
+    LeaseTable table;
+    LiveLeasePublisher publisher(interface, table, 4);
+    ASSERT_TRUE(publisher.isOpen());
+
+    struct stat st{};
+    ASSERT_EQ(0, stat(("/dev/shm" + LiveLeases::GetSegmentName(interface)).c_str(), &st));
+    EXPECT_EQ(0, st.st_mode & S_IRWXO);
+    EXPECT_EQ(0, st.st_mode & (S_IWGRP | S_IXGRP));
+}
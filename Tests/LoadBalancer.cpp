@@ -0,0 +1,63 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "LoadBalancer.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+
+namespace
+{
+const std::array<std::uint8_t, 6> Client{ 0x00, 0x0C, 0x29, 0x00, 0x00, 0x01 }; // Hashes to bucket 104.
+}
+
+TEST(LoadBalancerTests, HashBucket)
+{
+    EXPECT_EQ(104, LoadBalancing::GetHashBucket(Client));
+
+    // The length is part of the hash.
+    const std::array<std::uint8_t, 7> longer{ 0x00, 0x0C, 0x29, 0x00, 0x00, 0x01, 0x00 };
+    EXPECT_NE(LoadBalancing::GetHashBucket(Client), LoadBalancing::GetHashBucket(longer));
+}
+
+TEST(LoadBalancerTests, EveryBucketHasOneServer)
+{
+    for (std::uint8_t servers : { 1, 2, 3, 7, 255 })
+    {
+        std::vector<LoadBalancer> balancers(servers);
+        for (std::uint8_t server = 0; server < servers; ++server)
+            balancers[server].configure(server, servers, 3);
+
+        for (int bucket = 0; bucket < 256; ++bucket)
+        {
+            int owners{};
+            for (const auto& balancer : balancers)
+                owners += balancer.isServedBucket(static_cast<std::uint8_t>(bucket));
+
+            EXPECT_EQ(1, owners) << "bucket " << bucket << " of " << static_cast<int>(servers) << " servers";
+        }
+    }
+}
+
+TEST(LoadBalancerTests, Admit)
+{
+    LoadBalancer balancer;
+    EXPECT_FALSE(balancer.isEnabled());
+    EXPECT_EQ(LoadBalancer::Verdict::Accept, balancer.admit(Client, 0, false));
+
+    // Bucket 104 is the first server's of two.
+    balancer.configure(0, 2, 3);
+    EXPECT_TRUE(balancer.isEnabled());
+    EXPECT_EQ(LoadBalancer::Verdict::Accept, balancer.admit(Client, 0, false));
+
+    balancer.configure(1, 2, 3);
+    EXPECT_EQ(LoadBalancer::Verdict::Drop, balancer.admit(Client, 0, false));
+    EXPECT_EQ(LoadBalancer::Verdict::Drop, balancer.admit(Client, 3, false));
+    EXPECT_EQ(LoadBalancer::Verdict::Takeover, balancer.admit(Client, 4, false));
+    EXPECT_EQ(LoadBalancer::Verdict::Accept, balancer.admit(Client, 0, true));
+}
@@ -220,7 +220,13 @@ TEST(AddressPoolTests, LeaseTime_WithoutPreferred_DifferentHardware)
 {
     /* Tests with different hardware addresses, without preferred address */
 
+    /* A single address, so the expired lease is all there is to take over. */
+    NetworkConfiguration config;
+    config.dhcpFirst = concatenateIpAddress(192, 168, 200, 100);
+    config.dhcpLast = concatenateIpAddress(192, 168, 200, 100);
+
     Network net;
+    net.configure(std::move(config));
     net.setLeaseDuration(0);
 
     auto adr1 = net.getAvailableAddress(200);
@@ -486,3 +492,537 @@ TEST(ReservedAddressTests, PreferredFromDifferentHardwareAddress_InsideRange)
     auto ok = net.reserveAddress(1001, addr);
     EXPECT_TRUE(ok);
 }
+
+TEST(LeaseJitterTests, Disabled)
+{
+    Network net;
+
+    EXPECT_EQ(net.getLeaseTime(), net.getLeaseTime(1000));
+    EXPECT_EQ(net.getRenewalTime(), net.getRenewalTime(1000));
+    EXPECT_EQ(net.getRebindingTime(), net.getRebindingTime(1000));
+}
+
+TEST(LeaseJitterTests, StableAndBounded)
+{
+    Network net;
+    net.setLeaseJitter(10);
+
+    std::uint32_t shortest = net.getLeaseTime();
+    std::uint32_t longest = 0;
+
+    for (std::uint64_t hwAddress = 0xAABBCC000000; hwAddress < 0xAABBCC000000 + 1000; ++hwAddress)
+    {
+        const auto leaseTime = net.getLeaseTime(hwAddress);
+        const auto renewalTime = net.getRenewalTime(hwAddress);
+        const auto rebindingTime = net.getRebindingTime(hwAddress);
+
+        // Same client, same times (retransmits must not see different values).
+        EXPECT_EQ(leaseTime, net.getLeaseTime(hwAddress));
+
+        // Never longer than configured, never shorter than the jitter allows.
+        EXPECT_LE(leaseTime, net.getLeaseTime());
+        EXPECT_GE(leaseTime, net.getLeaseTime() * 9 / 10);
+
+        // Order is kept.
+        EXPECT_LT(renewalTime, rebindingTime);
+        EXPECT_LT(rebindingTime, leaseTime);
+
+        shortest = std::min(shortest, leaseTime);
+        longest = std::max(longest, leaseTime);
+    }
+
+    // Sequential hardware addresses (same vendor) must still be spread over most of the range.
+    EXPECT_GT(longest - shortest, net.getLeaseTime() * 8 / 100);
+}
+
+TEST(AdaptiveLeaseTimeTests, FollowsUtilization)
+{
+    Network net;
+
+    /* 10 addresses, .100 to .109 */
+    net.setDhcpRange(concatenateIpAddress(192, 168, 200, 100), concatenateIpAddress(192, 168, 200, 109));
+    net.setAdaptiveLeaseTime(600, 86400, 20, 80);
+
+    // Empty pool, longest leases.
+    EXPECT_EQ(0, net.getPoolUtilization());
+    EXPECT_EQ(86400, net.getLeaseTime());
+
+    for (std::uint64_t hwAddress = 1; hwAddress <= 5; ++hwAddress)
+        net.reserveAddress(hwAddress, net.getAvailableAddress(hwAddress));
+
+    // Half full, half way between.
+    EXPECT_EQ(50, net.getPoolUtilization());
+    EXPECT_EQ(86400 - (86400 - 600) / 2, net.getLeaseTime());
+
+    for (std::uint64_t hwAddress = 6; hwAddress <= 8; ++hwAddress)
+        net.reserveAddress(hwAddress, net.getAvailableAddress(hwAddress));
+
+    // Past the high watermark, shortest leases.
+    EXPECT_EQ(80, net.getPoolUtilization());
+    EXPECT_EQ(600, net.getLeaseTime());
+
+    // T1 and T2 keep their proportion to the lease time (defaults: 1800 and 3150 of 3600).
+    EXPECT_EQ(300, net.getRenewalTime());
+    EXPECT_EQ(525, net.getRebindingTime());
+
+    // Releasing addresses brings it back down.
+    net.releaseAddress(net.getLease(std::uint64_t{ 8 }).ipAddress);
+    net.releaseAddress(net.getLease(std::uint64_t{ 7 }).ipAddress);
+    EXPECT_EQ(60, net.getPoolUtilization());
+    EXPECT_LT(600, net.getLeaseTime());
+}
+
+TEST(AdaptiveLeaseTimeTests, LeaseRemembersItsLeaseTime)
+{
+    Network net;
+    net.setDhcpRange(concatenateIpAddress(192, 168, 200, 100), concatenateIpAddress(192, 168, 200, 101));
+    net.setAdaptiveLeaseTime(600, 86400, 0, 100);
+
+    auto ip = net.getAvailableAddress(1);
+    ASSERT_TRUE(net.reserveAddress(1, ip));
+
+    const auto& lease = net.getLease(std::uint64_t{ 1 });
+    EXPECT_EQ(86400, lease.leaseTime);
+
+    // Lease time handed out now has changed, the existing lease keeps its own.
+    EXPECT_NE(lease.leaseTime, net.getLeaseTime());
+    EXPECT_EQ(43200, net.getRenewalTime(lease));
+}
+
+TEST(AddressPoolTests, ReassigningExpiredLeaseKeepsTablesInSync)
+{
+    NetworkConfiguration config;
+    config.dhcpFirst = concatenateIpAddress(192, 168, 200, 100);
+    config.dhcpLast = concatenateIpAddress(192, 168, 200, 100);
+
+    Network net;
+    net.configure(std::move(config));
+    net.setLeaseDuration(0);
+
+    auto adr1 = net.getAvailableAddress(200);
+    net.reserveAddress(200, adr1);
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    auto adr2 = net.getAvailableAddress(201);
+    net.reserveAddress(201, adr2);
+    ASSERT_EQ(adr1, adr2);
+
+    // The old hardware address must be forgotten, so that touching it doesn't remove the new lease.
+    EXPECT_FALSE(Network::isLeaseEntryValid(net.getLease(std::uint64_t{ 200 })));
+    net.getAvailableAddress(200);
+    EXPECT_EQ(201, net.getLease(adr2).hwAddress);
+    EXPECT_EQ(1, net.getPool().getUsedCount());
+}
+
+TEST(AddressPoolTests, FreeAddressBeforeExpiredLease)
+{
+    Network net;
+    net.setLeaseDuration(0);
+
+    auto adr1 = net.getAvailableAddress(200);
+    net.reserveAddress(200, adr1);
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    // The expired lease is only taken over once there are no free addresses left.
+    EXPECT_EQ(adr1 + 1, net.getAvailableAddress(201));
+}
+
+TEST(AddressHistoryTests, ReturningClientGetsPreviousAddress)
+{
+    Network net;
+
+    auto adr1 = net.getAvailableAddress(1);
+    net.reserveAddress(1, adr1);
+
+    auto adr2 = net.getAvailableAddress(2);
+    net.reserveAddress(2, adr2);
+
+    net.releaseAddress(adr1);
+    net.releaseAddress(adr2);
+
+    // First-fit would have handed .100 to client 2.
+    EXPECT_EQ(adr2, net.getAvailableAddress(2));
+    EXPECT_EQ(1, net.getHistoryHits());
+}
+
+TEST(AddressHistoryTests, PreviousAddressTakenBySomeoneElse)
+{
+    Network net;
+
+    auto adr1 = net.getAvailableAddress(1);
+    net.reserveAddress(1, adr1);
+    net.releaseAddress(adr1);
+
+    // Client 3 gets the address first.
+    net.reserveAddress(3, net.getAvailableAddress(3));
+    ASSERT_EQ(adr1, net.getLease(std::uint64_t{ 3 }).ipAddress);
+
+    auto adr2 = net.getAvailableAddress(1);
+    EXPECT_NE(adr1, adr2);
+    EXPECT_EQ(0, net.getHistoryHits());
+    EXPECT_EQ(3, net.getHistoryLookups());
+}
+
+TEST(HashAllocationTests, SameClientSameAddress)
+{
+    Network a;
+    a.setAllocationPolicy(AllocationPolicy::Hash);
+
+    Network b;
+    b.setAllocationPolicy(AllocationPolicy::Hash);
+
+    // Clients tend to land on the same address, regardless of the order they show up in.
+    for (std::uint64_t hwAddress = 0xAABBCC000001; hwAddress <= 0xAABBCC000010; ++hwAddress)
+        a.reserveAddress(hwAddress, a.getAvailableAddress(hwAddress));
+
+    int same = 0;
+    for (std::uint64_t hwAddress = 0xAABBCC000010; hwAddress >= 0xAABBCC000001; --hwAddress)
+    {
+        b.reserveAddress(hwAddress, b.getAvailableAddress(hwAddress));
+        if (a.getLease(hwAddress).ipAddress == b.getLease(hwAddress).ipAddress)
+            ++same;
+    }
+
+    EXPECT_GE(same, 12);
+}
+
+TEST(HashAllocationTests, FillsWholeRange)
+{
+    Network net;
+    net.setAllocationPolicy(AllocationPolicy::Hash);
+    net.setDhcpRange(concatenateIpAddress(192, 168, 200, 100), concatenateIpAddress(192, 168, 200, 109));
+
+    for (std::uint64_t hwAddress = 1; hwAddress <= 10; ++hwAddress)
+    {
+        auto ip = net.getAvailableAddress(hwAddress);
+        ASSERT_NE(0, ip);
+        ASSERT_TRUE(net.reserveAddress(hwAddress, ip));
+    }
+
+    EXPECT_EQ(100, net.getPoolUtilization());
+    EXPECT_EQ(0, net.getAvailableAddress(11));
+}
+
+TEST(HashAllocationTests, TakesOverExpiredLeaseWhenFull)
+{
+    Network net;
+    net.setAllocationPolicy(AllocationPolicy::Hash);
+    net.setLeaseDuration(0);
+    net.setDhcpRange(concatenateIpAddress(192, 168, 200, 100), concatenateIpAddress(192, 168, 200, 100));
+
+    auto adr1 = net.getAvailableAddress(1);
+    net.reserveAddress(1, adr1);
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    EXPECT_EQ(adr1, net.getAvailableAddress(2));
+}
+
+TEST(QuarantineTests, DeclinedAddressIsNotHandedOut)
+{
+    Network net;
+
+    auto adr1 = net.getAvailableAddress(1);
+    ASSERT_TRUE(net.reserveAddress(1, adr1));
+
+    // Only the holder of the lease can decline it.
+    EXPECT_FALSE(net.declineAddress(2, adr1));
+    ASSERT_TRUE(net.declineAddress(1, adr1));
+
+    EXPECT_TRUE(net.isAddressQuarantined(adr1));
+    EXPECT_EQ(1, net.getQuarantineSize());
+    EXPECT_FALSE(Network::isLeaseEntryValid(net.getLease(adr1)));
+
+    // Neither the declining client, nor anyone else, gets it.
+    EXPECT_NE(adr1, net.getAvailableAddress(1));
+    EXPECT_NE(adr1, net.getAvailableAddress(2));
+    EXPECT_NE(adr1, net.getAvailableAddress(3, adr1));
+    EXPECT_FALSE(net.reserveAddress(3, adr1));
+}
+
+TEST(QuarantineTests, Expires)
+{
+    Network net;
+    net.setQuarantineTime(1);
+
+    auto adr1 = net.getAvailableAddress(1);
+    ASSERT_TRUE(net.reserveAddress(1, adr1));
+    ASSERT_TRUE(net.declineAddress(1, adr1));
+
+    EXPECT_NE(adr1, net.getAvailableAddress(2));
+
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    EXPECT_EQ(adr1, net.getAvailableAddress(2));
+    EXPECT_EQ(0, net.getQuarantineSize());
+    EXPECT_EQ(1, net.getQuarantinedCount());
+    EXPECT_EQ(1, net.getQuarantineExpiredCount());
+    EXPECT_EQ(0, net.getPool().getUsedCount());
+}
+
+TEST(QuarantineTests, Disabled)
+{
+    Network net;
+    net.setQuarantineTime(0);
+
+    auto adr1 = net.getAvailableAddress(1);
+    ASSERT_TRUE(net.reserveAddress(1, adr1));
+    ASSERT_TRUE(net.declineAddress(1, adr1));
+
+    EXPECT_EQ(adr1, net.getAvailableAddress(2));
+}
+
+TEST(QuarantineTests, ExpiredLeaseFoundInUseIsNotTakenOver)
+{
+    NetworkConfiguration config;
+    config.dhcpFirst = concatenateIpAddress(192, 168, 200, 100);
+    config.dhcpLast = concatenateIpAddress(192, 168, 200, 100);
+
+    Network net;
+    net.configure(std::move(config));
+    net.setLeaseDuration(0);
+
+    auto adr1 = net.getAvailableAddress(1);
+    ASSERT_TRUE(net.reserveAddress(1, adr1));
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    // A probe found someone using it, the expired lease is still there.
+    net.quarantineAddress(adr1, 60);
+    ASSERT_TRUE(Network::isLeaseEntryValid(net.getLease(adr1)));
+
+    EXPECT_EQ(0, net.getAvailableAddress(2));
+}
+
+TEST(MultiplePoolTests, OrderedFillsPoolsInConfiguredOrder)
+{
+    Network net;
+    net.setPools({ { "devices", concatenateIpAddress(192, 168, 200, 150), concatenateIpAddress(192, 168, 200, 151) },
+                   { "guest", concatenateIpAddress(192, 168, 200, 20), concatenateIpAddress(192, 168, 200, 20) } });
+
+    ASSERT_EQ(2, net.getPoolCount());
+    EXPECT_EQ("devices", net.getPoolName(0));
+    EXPECT_EQ(3, net.getPoolSize());
+
+    auto adr1 = net.getAvailableAddress(1);
+    ASSERT_TRUE(net.reserveAddress(1, adr1));
+    auto adr2 = net.getAvailableAddress(2);
+    ASSERT_TRUE(net.reserveAddress(2, adr2));
+    auto adr3 = net.getAvailableAddress(3);
+    ASSERT_TRUE(net.reserveAddress(3, adr3));
+
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 150), adr1);
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 151), adr2);
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 20), adr3);
+    EXPECT_EQ(0, net.getAvailableAddress(4));
+
+    EXPECT_EQ(2, net.getPool(0).getUsedCount());
+    EXPECT_EQ(1, net.getPool(1).getUsedCount());
+    EXPECT_EQ(100, net.getPoolUtilization());
+}
+
+TEST(MultiplePoolTests, LeastUsedSpreadsClients)
+{
+    Network net;
+    net.setPoolSelection(PoolSelection::LeastUsed);
+    net.setPools({ { "a", concatenateIpAddress(192, 168, 200, 100), concatenateIpAddress(192, 168, 200, 109) },
+                   { "b", concatenateIpAddress(192, 168, 200, 200), concatenateIpAddress(192, 168, 200, 209) } });
+
+    for (std::uint64_t hw = 1; hw <= 6; ++hw)
+        ASSERT_TRUE(net.reserveAddress(hw, net.getAvailableAddress(hw)));
+
+    EXPECT_EQ(3, net.getPool(0).getUsedCount());
+    EXPECT_EQ(3, net.getPool(1).getUsedCount());
+    EXPECT_EQ(30, net.getPoolUtilization());
+}
+
+TEST(MultiplePoolTests, AddressesBetweenPoolsAreNotHandedOut)
+{
+    Network net;
+    net.setPools({ { "low", concatenateIpAddress(192, 168, 200, 100), concatenateIpAddress(192, 168, 200, 101) },
+                   { "high", concatenateIpAddress(192, 168, 200, 110), concatenateIpAddress(192, 168, 200, 111) } });
+
+    // Requesting an address in the gap gets one from a pool instead.
+    const auto gap = concatenateIpAddress(192, 168, 200, 105);
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 100), net.getAvailableAddress(1, gap));
+
+    const auto high = concatenateIpAddress(192, 168, 200, 111);
+    EXPECT_EQ(high, net.getAvailableAddress(1, high));
+    ASSERT_TRUE(net.reserveAddress(1, high));
+    EXPECT_EQ(1, net.getPool(1).getUsedCount());
+
+    net.releaseAddress(high);
+    EXPECT_EQ(0, net.getPool(1).getUsedCount());
+}
+
+TEST(MultiplePoolTests, HashAllocationStaysWithinPools)
+{
+    Network net;
+    net.setAllocationPolicy(AllocationPolicy::Hash);
+    net.setPools({ { "low", concatenateIpAddress(192, 168, 200, 100), concatenateIpAddress(192, 168, 200, 103) },
+                   { "high", concatenateIpAddress(192, 168, 200, 200), concatenateIpAddress(192, 168, 200, 203) } });
+
+    for (std::uint64_t hw = 1; hw <= 8; ++hw)
+    {
+        auto ip = net.getAvailableAddress(hw);
+        ASSERT_NE(0, ip);
+        ASSERT_TRUE(net.reserveAddress(hw, ip));
+    }
+
+    EXPECT_EQ(4, net.getPool(0).getUsedCount());
+    EXPECT_EQ(4, net.getPool(1).getUsedCount());
+    EXPECT_EQ(0, net.getAvailableAddress(9));
+}
+
+TEST(MultiplePoolTests, ClassPoolsOnlyServeTheirClass)
+{
+    Network net;
+    net.setPools({ { "general", concatenateIpAddress(192, 168, 200, 100), concatenateIpAddress(192, 168, 200, 109), 0 },
+                   { "phones", concatenateIpAddress(192, 168, 200, 20), concatenateIpAddress(192, 168, 200, 29), 0b10 } });
+
+    // Class members prefer their pool, even though it comes last.
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 20), net.getAvailableAddress(1, 0, 0b10));
+
+    // Others never get an address from it, not even when asking for one.
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 100), net.getAvailableAddress(2, 0, 0b01));
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 100), net.getAvailableAddress(2, concatenateIpAddress(192, 168, 200, 25)));
+}
+
+TEST(HostOptionsTests, LeaseTimeOverridesInterface)
+{
+    Network net;
+    net.setLeaseDuration(3600);
+    net.setLeaseJitter(50);
+
+    HostOptions options;
+    options.leaseTime = 86400;
+    net.setHostOptions(1, std::move(options));
+
+    EXPECT_EQ(86400, net.getLeaseTime(1));
+    EXPECT_EQ(43200, net.getRenewalTime(1));
+    EXPECT_EQ(nullptr, net.getHostOptions(2));
+    EXPECT_GE(3600, net.getLeaseTime(2));
+    EXPECT_EQ(86400, net.getMaximumLeaseTime());
+
+    auto ip = net.getAvailableAddress(1);
+    ASSERT_TRUE(net.reserveAddress(1, ip));
+    EXPECT_EQ(86400, net.getLease(std::uint64_t{ 1 }).leaseTime);
+}
+
+TEST(HostOptionsTests, MaximumLeaseTimeOfConfiguration)
+{
+    NetworkConfiguration config;
+    config.leaseTime = 3600;
+    config.maximumLeaseTime = 7200;
+    EXPECT_EQ(7200, Network::getMaximumLeaseTime(config));
+
+    config.hostOptions[1].leaseTime = 86400;
+    EXPECT_EQ(86400, Network::getMaximumLeaseTime(config));
+
+    Network net;
+    net.configure(NetworkConfiguration(config));
+    EXPECT_EQ(Network::getMaximumLeaseTime(config), net.getMaximumLeaseTime());
+}
+
+TEST(LeaseListenerTests, ChangeReasons)
+{
+    Network net;
+    net.setLeaseDuration(1);
+
+    std::vector<std::pair<LeaseChange, std::uint32_t>> changes;
+    net.setLeaseListener([&changes](LeaseChange change, const Lease& lease) { changes.emplace_back(change, lease.ipAddress); });
+
+    const auto adr1 = net.getAvailableAddress(1);
+    ASSERT_TRUE(net.reserveAddress(1, adr1));
+    ASSERT_TRUE(net.reserveAddress(1, adr1));
+
+    // Moving to another address leaves the old lease behind.
+    const auto adr2 = net.getAvailableAddress(2);
+    ASSERT_TRUE(net.reserveAddress(1, adr2));
+    net.releaseAddress(adr2);
+
+    ASSERT_TRUE(net.reserveAddress(3, adr1));
+    ASSERT_TRUE(net.declineAddress(3, adr1));
+
+    ASSERT_TRUE(net.reserveAddress(4, adr2));
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    EXPECT_NE(0, net.getAvailableAddress(4));
+
+    const std::vector<std::pair<LeaseChange, std::uint32_t>> expected{
+        { LeaseChange::Added, adr1 },
+        { LeaseChange::Renewed, adr1 },
+        { LeaseChange::Removed, adr1 },
+        { LeaseChange::Added, adr2 },
+        { LeaseChange::Released, adr2 },
+        { LeaseChange::Added, adr1 },
+        { LeaseChange::Declined, adr1 },
+        { LeaseChange::Added, adr2 },
+        { LeaseChange::Expired, adr2 }
+    };
+    EXPECT_EQ(expected, changes);
+}
+
+TEST(ClientHistoryTests, HeldAddress)
+{
+    Network net;
+
+    const auto adr1 = net.getAvailableAddress(1);
+    ASSERT_TRUE(net.reserveAddress(1, adr1));
+    EXPECT_TRUE(net.hasHeldAddress(1, adr1));
+    EXPECT_FALSE(net.hasHeldAddress(2, adr1));
+
+    // Still the last address it had once the lease is gone.
+    net.releaseAddress(adr1);
+    EXPECT_TRUE(net.hasHeldAddress(1, adr1));
+    EXPECT_FALSE(net.hasHeldAddress(1, adr1 + 1));
+}
+
+TEST(ReconfigureTests, KeepsLeasesAndQuarantine)
+{
+    Network net;
+    net.configure(NetworkConfiguration{});
+
+    const auto adr1 = net.getAvailableAddress(1);
+    ASSERT_TRUE(net.reserveAddress(1, adr1));
+    const auto adr2 = net.getAvailableAddress(2);
+    ASSERT_TRUE(net.reserveAddress(2, adr2));
+    ASSERT_TRUE(net.declineAddress(2, adr2));
+    net.releaseAddress(adr1);
+    ASSERT_TRUE(net.reserveAddress(1, adr1));
+
+    NetworkConfiguration config;
+    config.leaseTime = 600;
+    config.reservations[3] = concatenateIpAddress(192, 168, 200, 200);
+    Network prepared;
+    prepared.configure(std::move(config));
+    net.reconfigure(prepared);
+
+    EXPECT_EQ(600, net.getLeaseTime());
+    EXPECT_EQ(1, net.getLeaseTable().size());
+    EXPECT_EQ(adr1, net.getLease(std::uint64_t{ 1 }).ipAddress);
+    EXPECT_TRUE(net.isAddressQuarantined(adr2));
+    EXPECT_TRUE(net.hasHeldAddress(1, adr1));
+    EXPECT_EQ(3, net.getPoolUsedCount()); // The lease, the quarantined address and the reservation.
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 200), net.getAvailableAddress(3));
+
+    const auto adr4 = net.getAvailableAddress(4);
+    EXPECT_NE(adr1, adr4);
+    EXPECT_NE(adr2, adr4);
+
+    // A different network forgets the addresses of the old one, but not the leases.
+    NetworkConfiguration otherConfig;
+    otherConfig.networkSpace = concatenateIpAddress(10, 0, 0, 0);
+    otherConfig.networkSize = 8;
+    otherConfig.dhcpFirst = concatenateIpAddress(10, 0, 0, 10);
+    otherConfig.dhcpLast = concatenateIpAddress(10, 0, 0, 20);
+    Network otherPrepared;
+    otherPrepared.configure(std::move(otherConfig));
+    net.reconfigure(otherPrepared);
+
+    EXPECT_FALSE(net.isAddressQuarantined(adr2));
+    EXPECT_EQ(0, net.getQuarantineSize());
+    EXPECT_FALSE(net.hasHeldAddress(2, adr2));
+    EXPECT_EQ(1, net.getLeaseTable().size());
+}
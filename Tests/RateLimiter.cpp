@@ -0,0 +1,102 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "RateLimiter.h"
+
+#include <gtest/gtest.h>
+
+TEST(RateLimiterTests, TokenBucket_Burst)
+{
+    TokenBucket bucket{ 3000, 0 };
+
+    EXPECT_TRUE(bucket.consume(1, 3, 0));
+    EXPECT_TRUE(bucket.consume(1, 3, 0));
+    EXPECT_TRUE(bucket.consume(1, 3, 0));
+    EXPECT_FALSE(bucket.consume(1, 3, 0));
+}
+
+TEST(RateLimiterTests, TokenBucket_Refill)
+{
+    TokenBucket bucket{ 0, 0 };
+
+    // 2 tokens per second: one token every 500ms.
+    EXPECT_FALSE(bucket.consume(2, 2, 499));
+    EXPECT_TRUE(bucket.consume(2, 2, 500));
+    EXPECT_FALSE(bucket.consume(2, 2, 500));
+
+    // Refill is capped at the burst size.
+    EXPECT_TRUE(bucket.consume(2, 2, 60000));
+    EXPECT_TRUE(bucket.consume(2, 2, 60000));
+    EXPECT_FALSE(bucket.consume(2, 2, 60000));
+}
+
+TEST(RateLimiterTests, Disabled)
+{
+    RateLimiter limiter;
+    limiter.configure(0, 0, 0, 0, 16);
+
+    EXPECT_FALSE(limiter.isEnabled());
+    for (int i = 0; i < 1000; ++i)
+        EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(1, 0));
+}
+
+TEST(RateLimiterTests, PerClient)
+{
+    RateLimiter limiter;
+    limiter.configure(1, 2, 0, 0, 16);
+
+    EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(1, 1000));
+    EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(1, 1000));
+    EXPECT_EQ(RateLimiter::Verdict::ClientLimited, limiter.admit(1, 1000));
+
+    // Other clients are not affected.
+    EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(2, 1000));
+
+    // One second later, one more token is available.
+    EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(1, 2000));
+    EXPECT_EQ(RateLimiter::Verdict::ClientLimited, limiter.admit(1, 2000));
+}
+
+TEST(RateLimiterTests, PerInterface)
+{
+    RateLimiter limiter;
+    limiter.configure(0, 0, 10, 3, 16);
+
+    EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(1, 1000));
+    EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(2, 1000));
+    EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(3, 1000));
+    EXPECT_EQ(RateLimiter::Verdict::InterfaceLimited, limiter.admit(4, 1000));
+    EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(4, 1100));
+}
+
+TEST(RateLimiterTests, ClientLimitedDoesNotConsumeInterfaceTokens)
+{
+    RateLimiter limiter;
+    limiter.configure(1, 1, 1, 2, 16);
+
+    EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(1, 1000));
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(RateLimiter::Verdict::ClientLimited, limiter.admit(1, 1000));
+
+    EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(2, 1000));
+}
+
+TEST(RateLimiterTests, FloodOfRandomClientsIsBounded)
+{
+    RateLimiter limiter;
+    limiter.configure(1, 1, 0, 0, 64);
+
+    // A well-behaved client, seen regularly so that CLOCK keeps giving it second chances.
+    constexpr std::uint64_t regular = 0xAABBCCDDEEFF;
+    EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(regular, 0));
+
+    for (std::uint64_t i = 1; i <= 100000; ++i)
+        EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(i, 0));
+
+    // The regular client was evicted at some point and gets a fresh bucket - it must never be stuck.
+    EXPECT_EQ(RateLimiter::Verdict::Accept, limiter.admit(regular, 5000));
+}
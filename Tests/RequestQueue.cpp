@@ -0,0 +1,110 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "RequestQueue.h"
+#include "Serializer.h"
+#include "IpConverter.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+std::vector<std::uint8_t> makeRequest(DHCPMessageType messageType, std::uint64_t chaddr, std::uint32_t ciaddr = 0)
+{
+    BOOTP bootp;
+    bootp.operation = BOOTP_Request;
+    bootp.ciaddr = ciaddr;
+    bootp.chaddr = chaddr;
+    bootp.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(messageType);
+    bootp.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(concatenateIpAddress(192, 168, 200, 1));
+    return serializeBootp(bootp);
+}
+
+std::uint64_t popClient(RequestQueue& queue, std::chrono::steady_clock::time_point now)
+{
+    QueuedRequest request;
+    std::uint64_t chaddr{};
+    if (!queue.pop(request, now) || !peekHardwareAddress(request.data, chaddr))
+        return 0;
+    return chaddr;
+}
+}
+
+TEST(RequestQueueTests, Classify)
+{
+    auto renewing = makeRequest(DHCP_Request, 1, concatenateIpAddress(192, 168, 200, 100));
+    auto selecting = makeRequest(DHCP_Request, 2);
+    auto release = makeRequest(DHCP_Release, 3, concatenateIpAddress(192, 168, 200, 100));
+    auto discover = makeRequest(DHCP_Discover, 4);
+
+    EXPECT_EQ(Priority_Renewal, classifyRequest(renewing, DHCP_Request));
+    EXPECT_EQ(Priority_Request, classifyRequest(selecting, DHCP_Request));
+    EXPECT_EQ(Priority_Renewal, classifyRequest(release, DHCP_Release));
+    EXPECT_EQ(Priority_Discover, classifyRequest(discover, DHCP_Discover));
+    EXPECT_EQ(Priority_Discover, classifyRequest(std::vector<std::uint8_t>(20, 0), DHCP_UnknownMessage));
+}
+
+TEST(RequestQueueTests, RenewalsBeforeDiscovers)
+{
+    Statistics::Counter queueFull;
+    Statistics::Counter staleDiscover;
+    RequestQueue queue(queueFull, staleDiscover);
+
+    const auto now = std::chrono::steady_clock::now();
+    ASSERT_TRUE(queue.push(makeRequest(DHCP_Discover, 1), now));
+    ASSERT_TRUE(queue.push(makeRequest(DHCP_Request, 2), now));
+    ASSERT_TRUE(queue.push(makeRequest(DHCP_Discover, 3), now));
+    ASSERT_TRUE(queue.push(makeRequest(DHCP_Request, 4, concatenateIpAddress(192, 168, 200, 100)), now));
+
+    // Renewals, then handshakes, then new clients. First come first served within each.
+    EXPECT_EQ(4, popClient(queue, now));
+    EXPECT_EQ(2, popClient(queue, now));
+    EXPECT_EQ(1, popClient(queue, now));
+    EXPECT_EQ(3, popClient(queue, now));
+
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(0, popClient(queue, now));
+}
+
+TEST(RequestQueueTests, StaleDiscoversAreDropped)
+{
+    Statistics::Counter queueFull;
+    Statistics::Counter staleDiscover;
+    RequestQueue queue(queueFull, staleDiscover);
+
+    const auto then = std::chrono::steady_clock::now();
+    const auto now = then + RequestQueue::DiscoverRetransmitInterval + std::chrono::milliseconds(1);
+    ASSERT_TRUE(queue.push(makeRequest(DHCP_Discover, 1), then));
+    ASSERT_TRUE(queue.push(makeRequest(DHCP_Request, 2), then));
+    ASSERT_TRUE(queue.push(makeRequest(DHCP_Discover, 3), now));
+
+    // Only DISCOVERs go stale, the client retransmits those.
+    EXPECT_EQ(2, popClient(queue, now));
+    EXPECT_EQ(3, popClient(queue, now));
+    EXPECT_EQ(1, staleDiscover.get());
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(RequestQueueTests, FullQueueDropsOnArrival)
+{
+    Statistics::Counter queueFull;
+    Statistics::Counter staleDiscover;
+    RequestQueue queue(queueFull, staleDiscover);
+
+    const auto now = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < RequestQueue::MaxQueuedRequests; ++i)
+        ASSERT_TRUE(queue.push(makeRequest(DHCP_Discover, i + 1), now));
+
+    EXPECT_FALSE(queue.push(makeRequest(DHCP_Discover, 0xFFFF), now));
+    EXPECT_EQ(1, queueFull.get());
+
+    // The other priorities have queues of their own.
+    EXPECT_TRUE(queue.push(makeRequest(DHCP_Request, 0xFFFE, concatenateIpAddress(192, 168, 200, 100)), now));
+    EXPECT_EQ(0xFFFE, popClient(queue, now));
+    EXPECT_EQ(1, popClient(queue, now));
+    EXPECT_EQ(1, queueFull.get());
+}
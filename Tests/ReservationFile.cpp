@@ -0,0 +1,88 @@
+/*
+ * TDHCPD - A Dynamic Host Configuration Protocol (DHCP) server
+ * Copyright (C) 2024  Tom-Andre Barstad.
+ * This software is licensed under the Software Attribution License.
+ * See LICENSE for more information.
+*/
+
+#include "ReservationFile.h"
+#include "IpConverter.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+
+TEST(ReservationFileTests, ParseCsv)
+{
+    constexpr std::string_view csv =
+        "# hardware address, ip address, comment\n"
+        "11:22:33:44:55:66,192.168.200.10\n"
+        "\n"
+        "aa-bb-cc-dd-ee-ff , 192.168.200.11 ,printer\r\n";
+
+    std::vector<ReservationFile::Record> records;
+    std::size_t errorLine{};
+    ASSERT_TRUE(ReservationFile::ParseCsv(csv, records, errorLine));
+    ASSERT_EQ(2, records.size());
+
+    EXPECT_EQ(0x112233445566, records[0].hwAddress);
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 10), records[0].ipAddress);
+    EXPECT_EQ(0xAABBCCDDEEFF, records[1].hwAddress);
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 11), records[1].ipAddress);
+}
+
+TEST(ReservationFileTests, ParseCsv_InvalidLine)
+{
+    std::vector<ReservationFile::Record> records;
+    std::size_t errorLine{};
+
+    EXPECT_FALSE(ReservationFile::ParseCsv("11:22:33:44:55:66,192.168.200.10\n11:22:33:44:55,192.168.200.11\n", records, errorLine));
+    EXPECT_EQ(2, errorLine);
+
+    EXPECT_FALSE(ReservationFile::ParseCsv("11:22:33:44:55:66,192.168.200.256\n", records, errorLine));
+    EXPECT_FALSE(ReservationFile::ParseCsv("11:22:33:44:55:66\n", records, errorLine));
+    EXPECT_FALSE(ReservationFile::ParseCsv("11:22:33:44:55:6g,192.168.200.1\n", records, errorLine));
+}
+
+TEST(ReservationFileTests, BinaryAndCsvLoadTheSame)
+{
+    const std::string csvFilename = testing::TempDir() + "reservations.csv";
+    const std::string binaryFilename = testing::TempDir() + "reservations.bin";
+
+    {
+        std::ofstream ofs(csvFilename);
+        for (int i = 0; i < 1000; ++i)
+            ofs << convertHardwareAddress(0x020000000000ull + i) << "," << convertIpAddress(concatenateIpAddress(10, 0, i / 256, i % 256)) << "\n";
+    }
+
+    std::unordered_map<std::uint64_t, std::uint32_t> fromCsv;
+    ASSERT_TRUE(ReservationFile::Load(csvFilename, fromCsv));
+    ASSERT_EQ(1000, fromCsv.size());
+    EXPECT_EQ(concatenateIpAddress(10, 0, 3, 231), fromCsv[0x020000000000ull + 999]);
+
+    std::vector<ReservationFile::Record> records;
+    for (const auto& [hwAddress, ipAddress] : fromCsv)
+        records.push_back({ hwAddress, ipAddress, 0 });
+    ASSERT_TRUE(ReservationFile::Save(binaryFilename, records));
+
+    std::unordered_map<std::uint64_t, std::uint32_t> fromBinary;
+    ASSERT_TRUE(ReservationFile::Load(binaryFilename, fromBinary));
+    EXPECT_EQ(fromCsv, fromBinary);
+
+    std::remove(csvFilename.c_str());
+    std::remove(binaryFilename.c_str());
+}
+
+TEST(ReservationFileTests, EmptyFile)
+{
+    const std::string filename = testing::TempDir() + "reservations-empty.csv";
+    std::ofstream(filename).close();
+
+    std::unordered_map<std::uint64_t, std::uint32_t> reservations;
+    EXPECT_TRUE(ReservationFile::Load(filename, reservations));
+    EXPECT_TRUE(reservations.empty());
+
+    std::remove(filename.c_str());
+    EXPECT_FALSE(ReservationFile::Load(filename, reservations));
+}
@@ -111,3 +111,155 @@ TEST(Serializer, Deserialize)
     EXPECT_EQ(0x8A31790CFCF8, bootp.chaddr);
     EXPECT_EQ(0x63825363, bootp.magic);
 }
+
+TEST(Serializer, DeserializeServerIdentifier)
+{
+    BOOTP bootp;
+    bootp.operation = BOOTP_Request;
+    bootp.chaddr = 0x8A31790CFCF8;
+    bootp.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_Request);
+    bootp.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(concatenateIpAddress(192, 168, 200, 2));
+
+    BOOTP request;
+    ASSERT_TRUE(deserializeBootp(serializeBootp(bootp), request));
+
+    // Read back as an address, like the requested IP option.
+    const auto& serverIdentifier = dynamic_cast<const IpListBOOTPOption&>(*request.options.at(Option_ServerIdentifier));
+    ASSERT_EQ(1, serverIdentifier.getIps().size());
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 2), serverIdentifier.getIps().front());
+}
+
+TEST(Serializer, PeekHeader)
+{
+    BOOTP bootp;
+    bootp.operation = BOOTP_Request;
+    bootp.ciaddr = concatenateIpAddress(192, 168, 200, 100);
+    bootp.chaddr = 0x8A31790CFCF8;
+    bootp.secondsElapsed = 300;
+    bootp.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_Request);
+    bootp.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(concatenateIpAddress(127,0,0,1));
+
+    auto data = serializeBootp(bootp);
+
+    std::uint64_t chaddr{};
+    ASSERT_TRUE(peekHardwareAddress(data, chaddr));
+    EXPECT_EQ(0x8A31790CFCF8, chaddr);
+
+    const std::vector<std::uint8_t> chaddrOctets = { 0x8A, 0x31, 0x79, 0x0C, 0xFC, 0xF8 };
+    const auto hardwareAddress = peekClientHardwareAddress(data);
+    EXPECT_EQ(chaddrOctets, std::vector<std::uint8_t>(hardwareAddress.begin(), hardwareAddress.end()));
+
+    std::uint16_t secs{};
+    ASSERT_TRUE(peekSecondsElapsed(data, secs));
+    EXPECT_EQ(300, secs);
+
+    std::uint32_t ciaddr{};
+    ASSERT_TRUE(peekClientIpAddress(data, ciaddr));
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 100), ciaddr);
+
+    EXPECT_EQ(DHCP_Request, peekMessageType(data));
+
+    std::vector<std::uint8_t> tooShort(20, 0);
+    EXPECT_FALSE(peekHardwareAddress(tooShort, chaddr));
+    EXPECT_TRUE(peekClientHardwareAddress(tooShort).empty());
+    EXPECT_EQ(DHCP_UnknownMessage, peekMessageType(tooShort));
+}
+
+TEST(Serializer, PeekMessageType_SkipsOtherOptions)
+{
+    std::vector<std::uint8_t> data(240, 0);
+    data[236] = 0x63;
+    data[237] = 0x82;
+    data[238] = 0x53;
+    data[239] = 0x63;
+
+    // Pad, parameter request list, then message type.
+    const std::vector<std::uint8_t> options = { 0x00, 0x37, 0x02, 0x01, 0x03, 0x35, 0x01, 0x01, 0xff };
+    data.insert(data.end(), options.begin(), options.end());
+
+    EXPECT_EQ(DHCP_Discover, peekMessageType(data));
+
+    // Truncated message type.
+    data.resize(data.size() - 3);
+    EXPECT_EQ(DHCP_UnknownMessage, peekMessageType(data));
+}
+
+TEST(Serializer, CopyRequestHeader)
+{
+    BOOTP request;
+    request.operation = BOOTP_Request;
+    request.hardwareType = 1;
+    request.hardwareAddressLength = 6;
+    request.hops = 2;
+    request.transactionId = 0x8DA13D88;
+    request.flags = 0x8000;
+    request.ciaddr = concatenateIpAddress(192, 168, 200, 50);
+    request.giaddr = concatenateIpAddress(10, 0, 0, 1);
+    request.chaddr = 0x8A31790CFCF8;
+    request.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_Inform);
+    request.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(concatenateIpAddress(127,0,0,1));
+
+    BOOTP reply;
+    reply.operation = BOOTP_Reply;
+    reply.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_ACK);
+    reply.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(concatenateIpAddress(192,168,200,1));
+
+    auto requestData = serializeBootp(request);
+    auto replyData = serializeBootp(reply);
+    ASSERT_TRUE(copyRequestHeader(requestData, replyData));
+
+    BOOTP result;
+    ASSERT_TRUE(deserializeBootp(replyData, result));
+    EXPECT_EQ(BOOTP_Reply, result.operation);
+    EXPECT_EQ(1, result.hardwareType);
+    EXPECT_EQ(6, result.hardwareAddressLength);
+    EXPECT_EQ(0, result.hops);
+    EXPECT_EQ(0x8DA13D88, result.transactionId);
+    EXPECT_EQ(0x8000, result.flags);
+    EXPECT_EQ(concatenateIpAddress(192, 168, 200, 50), result.ciaddr);
+    EXPECT_EQ(0u, result.yiaddr);
+    EXPECT_EQ(concatenateIpAddress(10, 0, 0, 1), result.giaddr);
+    EXPECT_EQ(0x8A31790CFCF8, result.chaddr);
+    EXPECT_EQ(DHCP_ACK, peekMessageType(replyData));
+
+    std::vector<std::uint8_t> tooShort(20, 0);
+    EXPECT_FALSE(copyRequestHeader(tooShort, replyData));
+}
+
+TEST(Serializer, BootFieldsAndEncodedOptions)
+{
+    BOOTP options;
+    options.options[Option_BootFileName] = std::make_unique<RawBOOTPOption>("pxelinux.0");
+
+    BOOTP bootp;
+    bootp.siaddr = concatenateIpAddress(192, 168, 200, 2);
+    bootp.sname[0] = 't';
+    bootp.file[0] = 'p';
+    bootp.options[Option_MessageType] = std::make_unique<DHCPMessageTypeBOOTPOption>(DHCP_Offer);
+    bootp.options[Option_ServerIdentifier] = std::make_unique<IntegerBOOTPOption<std::uint32_t>>(concatenateIpAddress(127,0,0,1));
+    bootp.encodedOptions = std::make_shared<const std::vector<std::uint8_t>>(serializeOptions(options));
+
+    auto data = serializeBootp(bootp);
+    ASSERT_GT(data.size(), 240u);
+    EXPECT_EQ(192, data[20]);
+    EXPECT_EQ(2, data[23]);
+    EXPECT_EQ('t', data[44]);
+    EXPECT_EQ('p', data[108]);
+
+    auto bootFile = peekOption(data, Option_BootFileName);
+    EXPECT_EQ("pxelinux.0", std::string_view(reinterpret_cast<const char*>(bootFile.data()), bootFile.size()));
+    EXPECT_EQ(DHCP_Offer, peekMessageType(data));
+}
+
+TEST(Serializer, MergeEncodedOptions)
+{
+    // Router, DNS server, then a pad.
+    const std::vector<std::uint8_t> base = { 3, 4, 192, 168, 0, 1, 6, 4, 8, 8, 8, 8, 0 };
+    // Different router, and a host name.
+    const std::vector<std::uint8_t> overrides = { 3, 4, 192, 168, 0, 2, 12, 2, 'p', 'c' };
+
+    const std::vector<std::uint8_t> expected = { 6, 4, 8, 8, 8, 8, 3, 4, 192, 168, 0, 2, 12, 2, 'p', 'c' };
+    EXPECT_EQ(expected, mergeEncodedOptions(base, overrides));
+
+    EXPECT_EQ(std::vector<std::uint8_t>(base.begin(), base.end() - 1), mergeEncodedOptions(base, {}));
+}
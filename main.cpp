@@ -7,9 +7,14 @@
 
 #include "BootpSocket.h"
 #include "BootpHandler.h"
+#include "BulkLeasequery.h"
 #include "Configuration.h"
+#include "Failover.h"
+#include "LeaseEvents.h"
+#include "LiveLeases.h"
 #include "StaticConfig.h"
 #include "Logger.h"
+#include "Statistics.h"
 
 #include <unistd.h>
 #include <syslog.h>
@@ -17,15 +22,26 @@
 #include <csignal>
 #include <ctime>
 
+#include <algorithm>
+#include <chrono>
 #include <forward_list>
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace
 {
+constexpr auto StatisticsInterval{ std::chrono::seconds(10) };
+
 std::atomic_bool running{ true };
+std::atomic_bool reloadRequested{ false };
 std::condition_variable cv_running;
 std::mutex cv_m;
 std::ofstream logfile;
@@ -37,6 +53,34 @@ void sigtermFn(int)
     cv_running.notify_one();
 }
 
+void sighupFn(int)
+{
+    reloadRequested = true;
+    cv_running.notify_one();
+}
+
+/*
+ * The new configuration is loaded here, on the main thread. The interfaces' threads pick it up before their next
+ * request, so they're never held up by the parsing. Interfaces added or removed need a restart.
+*/
+void reloadConfiguration(const std::string& configFile)
+{
+    Log::Info("Reloading configuration from {}", configFile);
+
+    const auto interfaces = Configuration::GetConfiguredInterfaces();
+
+    if (!Configuration::LoadFromFile(configFile))
+    {
+        Log::Warning("Reloading the configuration failed, keeping the current one");
+        return;
+    }
+
+    Log::SetLogLevel(Configuration::GetLogLevel());
+
+    if (Configuration::GetConfiguredInterfaces() != interfaces)
+        Log::Warning("Interfaces added to or removed from the configuration are not started or stopped until restarted");
+}
+
 void daemonize()
 {
     auto pid = fork();
@@ -146,13 +190,84 @@ void closeLogging()
     }
 }
 
+// Every address in the network could end up leased.
+std::uint32_t getLiveLeaseCapacity(const NetworkConfiguration& config)
+{
+    const auto hostBits = 32 - std::min<int>(config.networkSize, 32);
+    return static_cast<std::uint32_t>(std::min<std::uint64_t>(std::uint64_t{ 1 } << hostBits,
+                                                               LeaseTable::ChunkSize * LeaseTable::MaxChunks));
+}
+
+/*
+ * Keeps a copy of the primary's leases without serving anyone, until the primary goes silent. Returns false if told
+ * to exit before that.
+*/
+bool runStandby(const ConfigurationSnapshot& snapshot, std::unordered_map<std::string, std::vector<Lease>>& leases)
+{
+    FailoverStandby standby(snapshot.failoverAddress, snapshot.failoverPort, snapshot.failoverPeer,
+                            std::chrono::milliseconds(snapshot.failoverTimeout));
+    for (const auto& [interface, config] : snapshot.networks)
+        standby.addInterface(interface, config, Configuration::GetPersistentLeasesByInterface(interface));
+
+    if (!standby.start())
+        return false;
+
+    {
+        std::unique_lock lk(cv_m);
+        while (running && !standby.isPrimaryDown())
+            cv_running.wait_for(lk, std::chrono::milliseconds(100));
+    }
+
+    if (!running)
+        return false;
+
+    leases = standby.stop();
+    Log::Info("Failover standby taking over, serving clients");
+    return true;
+}
+
+void printUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " [--config <path>] [--compile-config <output>]\n"
+              << "  --config <path>            Read the configuration from path instead of " << StaticConfig::ConfigFile << "\n"
+              << "  --compile-config <output>  Validate the configuration and write it compiled to output, then exit.\n"
+              << "                             Give the compiled configuration to --config to start without parsing it.\n";
+}
+
 } // anonymous ns
 
-int main()
+int main(int argc, char* argv[])
 {
-    if (!Configuration::LoadFromFile(StaticConfig::ConfigFile))
+    std::string configFile(StaticConfig::ConfigFile);
+    std::string compiledConfigFile;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+
+        if (arg == "--config" && i + 1 < argc)
+            configFile = argv[++i];
+        else if (arg == "--compile-config" && i + 1 < argc)
+            compiledConfigFile = argv[++i];
+        else
+        {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (!Configuration::LoadFromFile(configFile))
         return -1;
 
+    if (!compiledConfigFile.empty())
+    {
+        if (!Configuration::SaveCompiled(compiledConfigFile))
+            return -1;
+
+        Log::Info("Configuration {} is valid, compiled to {}", configFile, compiledConfigFile);
+        return 0;
+    }
+
     if (!Configuration::GetPidFileName().empty())
     {
         daemonize();
@@ -176,6 +291,13 @@ int main()
         sigaction(SIGINT, &sighandler, nullptr);
     }
 
+    /* SIGHUP */
+    {
+        struct sigaction sighandler{};
+        sighandler.sa_handler = &sighupFn;
+        sigaction(SIGHUP, &sighandler, nullptr);
+    }
+
     Log::Info("Starting TDHCPD[{}] version {}, serverPort {}, clientPort {}",
               getpid(),
               StaticConfig::Version,
@@ -186,21 +308,130 @@ int main()
 
     std::forward_list<BootpSocket> sockets;
 
+    /* Not changed by reloads, like the interfaces. */
+    const auto snapshot = Configuration::GetSnapshot();
+    std::unique_ptr<LiveLeaseExporter> liveLeaseExporter;
+    if (snapshot->liveLeaseInterval > 0)
+        liveLeaseExporter = std::make_unique<LiveLeaseExporter>(std::chrono::milliseconds(snapshot->liveLeaseInterval));
+
+    std::unordered_map<std::string, std::vector<Lease>> standbyLeases;
+    if (snapshot->failoverRole == FailoverRole::Standby && !runStandby(*snapshot, standbyLeases))
+        running = false;
+
+    std::unique_ptr<FailoverPrimary> failoverPrimary;
+    if (snapshot->failoverRole == FailoverRole::Primary)
+    {
+        failoverPrimary = std::make_unique<FailoverPrimary>(snapshot->failoverAddress, snapshot->failoverPort,
+                                                            std::chrono::milliseconds(snapshot->failoverTimeout / 3));
+    }
+
+    std::unique_ptr<BulkLeasequeryServer> bulkLeasequery;
+    if (snapshot->bulkLeasequery)
+    {
+        bulkLeasequery = std::make_unique<BulkLeasequeryServer>(snapshot->bulkLeasequeryAddress, snapshot->bulkLeasequeryPort,
+                                                                snapshot->bulkLeasequeryAllowed);
+    }
+
+    std::unique_ptr<LeaseEventPublisher> leaseEvents;
+    if (!snapshot->leaseEventSocket.empty())
+        leaseEvents = std::make_unique<LeaseEventPublisher>(snapshot->leaseEventSocket, snapshot->leaseEventBuffer * 1024u);
+
     for (const auto& interface : interfaces)
-        sockets.emplace_front(StaticConfig::ServerPort, StaticConfig::ClientPort, interface);
+    {
+        if (!running)
+            break;
+
+        LeaseListener leaseListener;
+        if (failoverPrimary)
+            leaseListener = failoverPrimary->getLeaseListener(interface);
+
+        if (leaseEvents)
+        {
+            leaseListener = [first = std::move(leaseListener), second = leaseEvents->getLeaseListener(interface)](LeaseChange change, const Lease& lease)
+            {
+                if (first)
+                    first(change, lease);
+                second(change, lease);
+            };
+        }
+
+        std::optional<std::vector<Lease>> leases;
+        if (const auto it = standbyLeases.find(interface); it != standbyLeases.end())
+            leases = std::move(it->second);
+
+        const auto& socket = sockets.emplace_front(StaticConfig::ServerPort, StaticConfig::ClientPort, interface,
+                                                   std::move(leaseListener), std::move(leases));
+
+        if (liveLeaseExporter)
+            liveLeaseExporter->add(interface, socket.getLeaseTable(), getLiveLeaseCapacity(snapshot->networks.at(interface)));
+
+        if (failoverPrimary)
+            failoverPrimary->addInterface(interface, socket.getLeaseTable());
+
+        if (bulkLeasequery)
+        {
+            const auto& config = snapshot->networks.at(interface);
+            bulkLeasequery->addInterface(socket.getLeaseTable(), config.dhcpServerIdentifier,
+                                         Network::getMaximumLeaseTime(config));
+        }
+
+        if (leaseEvents)
+        {
+            const auto& config = snapshot->networks.at(interface);
+            leaseEvents->addInterface(interface, socket.getLeaseTable(), Network::getMaximumLeaseTime(config));
+        }
+    }
+
+    if (liveLeaseExporter)
+        liveLeaseExporter->start();
+
+    if (failoverPrimary)
+        failoverPrimary->start();
+
+    /* Logged by start(), DHCP is served regardless. */
+    if (bulkLeasequery && !bulkLeasequery->start())
+        bulkLeasequery.reset();
+
+    /* The sockets hold on to its listeners, so it's only stopped if it fails. */
+    if (leaseEvents && !leaseEvents->start())
+        leaseEvents->stop();
 
     /*
-     * Put main thread to sleep since it doesn't have anything more to do.
-     * SIGTERM will unblock the condition variable and terminate the program.
+     * Put main thread to sleep since it doesn't have anything more to do, except for periodically writing statistics.
+     * SIGTERM will unblock the condition variable and terminate the program, SIGHUP reloads the configuration.
      *
      * TODO propagate any errors during start (ie. bind error, etc) so that we can exit.
     */
     {
         std::unique_lock lk(cv_m);
-        cv_running.wait(lk, [] { return !running; });
+        while (running)
+        {
+            cv_running.wait_for(lk, StatisticsInterval, [] { return !running || reloadRequested; });
+            if (!running)
+                break;
+
+            if (reloadRequested.exchange(false))
+            {
+                reloadConfiguration(configFile);
+                continue;
+            }
+
+            const auto statisticsFileName = Configuration::GetStatisticsFileName();
+            if (!statisticsFileName.empty())
+                Statistics::SaveToFile(statisticsFileName);
+        }
     }
 
+    /* These read the sockets' lease tables, and the sockets tell the failover primary and lease events about changes. */
+    if (failoverPrimary)
+        failoverPrimary->stop();
+    if (leaseEvents)
+        leaseEvents->stop();
+    bulkLeasequery.reset();
+    liveLeaseExporter.reset();
     sockets.clear();
+    failoverPrimary.reset();
+    leaseEvents.reset();
 
     closeLogging();
 